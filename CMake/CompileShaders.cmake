@@ -0,0 +1,31 @@
+# Builds the SPIR-V fallbacks which materials load when shaders can't be compiled at runtime (see ShaderModules).
+# Uses glslangValidator from the Vulkan SDK, or the copy in Resources. Shader variants are built from the same
+# source with different defines, and written next to it under the name the material loads.
+find_program(GLSLANG_VALIDATOR glslangValidator
+  HINTS
+    "$ENV{VULKAN_SDK}/bin"
+    "$ENV{VULKAN_SDK}/Bin"
+    "${PROJECT_SOURCE_DIR}/Resources")
+
+if(NOT GLSLANG_VALIDATOR)
+  message(STATUS "glslangValidator not found, shader variants will only be available through the runtime compiler")
+endif()
+
+# compile_shader(<source> <output> [DEFINES <define>...])
+function(compile_shader SOURCE OUTPUT)
+  if(NOT GLSLANG_VALIDATOR)
+    return()
+  endif()
+  cmake_parse_arguments(SHADER "" "" "DEFINES" ${ARGN})
+  set(DEFINE_FLAGS "")
+  foreach(DEFINE ${SHADER_DEFINES})
+    list(APPEND DEFINE_FLAGS "-D${DEFINE}")
+  endforeach()
+  add_custom_command(
+    OUTPUT ${OUTPUT}
+    COMMAND ${GLSLANG_VALIDATOR} -V ${DEFINE_FLAGS} ${SOURCE} -o ${OUTPUT}
+    DEPENDS ${SOURCE}
+    COMMENT "Compiling ${OUTPUT}"
+    VERBATIM)
+  set(SHADER_BINARIES ${SHADER_BINARIES} ${OUTPUT} PARENT_SCOPE)
+endfunction()
@@ -1,7 +1,17 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : enable
+#endif
 precision highp float;
 
+/* See shader.vert */
+#ifdef BINDLESS
+#define DRAW_SET 1
+#else
+#define DRAW_SET 0
+#endif
+
 #define MAX_MULTIVIEW 6
 struct PerspectiveObject {
     mat4 view;
@@ -13,14 +23,17 @@ struct PerspectiveObject {
     float pad1, pad2;
 };
 
-layout(binding = 0) uniform PerspectiveBufferObject {
+layout(set = DRAW_SET, binding = 0) uniform PerspectiveBufferObject {
     PerspectiveObject at[MAX_MULTIVIEW];
 } pbo;
 
-layout(binding = 1) uniform TransformBufferObject{
+/* Unused here, and a storage buffer when built with -DPUSHED_TRANSFORMS */
+#ifndef PUSHED_TRANSFORMS
+layout(set = DRAW_SET, binding = 1) uniform TransformBufferObject{
     mat4 worldToLocal;
     mat4 localToWorld;
 } tbo;
+#endif
 
 #define MAXLIGHTS 10
 struct PointLightBufferItem {
@@ -41,22 +54,55 @@ struct PointLightBufferItem {
   mat4 dproj;
 };
 
-layout(binding = 2) uniform PointLightBufferObject{
+layout(set = DRAW_SET, binding = 2) uniform PointLightBufferObject{
     PointLightBufferItem lights[MAXLIGHTS];
     int totalLights;
 } plbo;
 
-layout(binding = 3) uniform MaterialBufferObject {
+/* Features are specialization constants, so each material's pipeline only contains the features it uses.
+  The matching material buffer flags are kept for the buffer layout. */
+layout(constant_id = 0) const bool useDiffuseTexture = false;
+layout(constant_id = 1) const bool useSpecularTexture = false;
+layout(constant_id = 2) const bool useCubemapTexture = false;
+layout(constant_id = 3) const bool useGI = false;
+layout(constant_id = 4) const bool useShadowMap = false;
+layout(constant_id = 5) const bool useRoughnessLod = false;
+
+/* With a sparse voxel octree, the volume texture is its brick pool, and cones walk the node pool to find bricks */
+layout(constant_id = 6) const bool useOctree = false;
+layout(constant_id = 7) const int octreeDepth = 1;
+
+layout(set = DRAW_SET, binding = 10) readonly buffer NodePool {
+  uint nodes[];
+} nodePool;
+
+layout(set = DRAW_SET, binding = 3) uniform MaterialBufferObject {
   vec4 ka, kd, ks, kr;
   bool useRoughnessLod; float roughness;
   bool useDiffuseTexture, useSpecularTexture, useCubemapTexture, useGI, useShadowMap;
+#ifdef BINDLESS
+  uint diffuseIndex, specularIndex, cubemapIndex, volumeIndex, shadowMapIndex;
+#endif
 } mbo;
 
+#ifdef BINDLESS
+layout(set = 0, binding = 0) uniform sampler2D textures2D[];
+layout(set = 0, binding = 1) uniform samplerCube texturesCube[];
+layout(set = 0, binding = 2) uniform sampler3D textures3D[];
+
+/* Indices are uniform across a draw, so no nonuniformEXT is needed */
+#define diffuseSampler textures2D[mbo.diffuseIndex]
+#define specSampler textures2D[mbo.specularIndex]
+#define samplerCubeMap texturesCube[mbo.cubemapIndex]
+#define volumeTexture textures3D[mbo.volumeIndex]
+#define shadowMap texturesCube[mbo.shadowMapIndex]
+#else
 layout(binding = 4) uniform sampler2D diffuseSampler;
 layout(binding = 5) uniform sampler2D specSampler;
 layout(binding = 6) uniform samplerCube samplerCubeMap;
 layout(binding = 7) uniform sampler3D volumeTexture;
 layout(binding = 8) uniform samplerCube shadowMap; /* Todo: make this a cubemap array. */
+#endif
 
 layout(location = 0) in vec3 w_normal;
 layout(location = 1) in vec3 w_position;
@@ -74,7 +120,7 @@ float gold_noise(in vec2 coordinate, in float seed){
     return fract(sin(dot(coordinate*(seed+PHI), vec2(PHI, PI)))*SQ2);
 }
 
-#define VOXEL_SIZE (1/128.0)
+#define VOXEL_SIZE (useOctree ? 1.0 / float(1 << octreeDepth) : 1/128.0)
 #define MIPMAP_HARDCAP 20.f
 #define MIPMAP_OFFSET .5f
 #define TSQRT2 2.828427
@@ -98,6 +144,41 @@ vec3 orthogonal(vec3 u){
 bool isInsideCube(const vec3 p, float e) { return abs(p.x) < 1 + e && abs(p.y) < 1 + e && abs(p.z) < 1 + e; }
 
 
+/* Samples the octree at a depth, where the volume has 2^depth voxels along a side. Nodes at that depth are the
+  children of a node one level up, whose brick holds a texel per child. Lookups are filtered within that brick only. */
+vec4 sampleOctree(vec3 c, int depth) {
+  vec3 p = c * float(1 << (depth - 1));
+  uvec3 cell = uvec3(p);
+
+  uint node = 0u;
+  for (int level = 0; level < depth; ++level) {
+    uint tile = nodePool.nodes[node];
+    if (tile == 0u) return vec4(0.0);
+    if (level == depth - 1) {
+      uint bricksPerSide = uint(textureSize(volumeTexture, 0).x) / 2u;
+      vec3 brick = vec3(tile % bricksPerSide, (tile / bricksPerSide) % bricksPerSide, tile / (bricksPerSide * bricksPerSide));
+      vec3 texel = 2.0 * brick + clamp(2.0 * fract(p), vec3(0.5), vec3(1.5));
+      return textureLod(volumeTexture, texel / float(2u * bricksPerSide), 0.0);
+    }
+    uvec3 octant = (cell >> uint(depth - 2 - level)) & 1u;
+    node = tile * 8u + octant.x + octant.y * 2u + octant.z * 4u;
+  }
+  return vec4(0.0);
+}
+
+/* Samples the voxels at a mip level of the volume, where level 0 is its full resolution */
+vec4 sampleVoxels(vec3 c, float level) {
+  if (!useOctree) return textureLod(volumeTexture, c, level);
+  if (any(lessThan(c, vec3(0.0))) || any(greaterThanEqual(c, vec3(1.0)))) return vec4(0.0);
+
+  /* Levels between two depths blend them, like trilinear filtering between mips */
+  float depth = clamp(float(octreeDepth) - level, 1.0, float(octreeDepth));
+  int fine = int(ceil(depth));
+  vec4 fineVoxel = sampleOctree(c, fine);
+  if (float(fine) == depth) return fineVoxel;
+  return mix(sampleOctree(c, fine - 1), fineVoxel, depth - float(fine - 1));
+}
+
 // Traces a diffuse voxel cone.
 vec3 traceDiffuseVoxelCone(vec3 from, vec3 direction){
   direction = normalize(direction);
@@ -118,7 +199,7 @@ vec3 traceDiffuseVoxelCone(vec3 from, vec3 direction){
     float l = (1 + coneSpread * dist / VOXEL_SIZE);
     float level = log2(l);
     float ll = (level + 1) * (level + 1);
-    vec4 voxel = textureLod(volumeTexture, c, min(MIPMAP_HARDCAP, level + MIPMAP_OFFSET));
+    vec4 voxel = sampleVoxels(c, min(MIPMAP_HARDCAP, level + MIPMAP_OFFSET));
     acc += .1*ll * voxel * pow(1 - voxel.a, 2);
     dist += ll * diffuseStepSize;
   }
@@ -141,8 +222,8 @@ float traceShadowCone(vec3 from, vec3 direction, float targetDistance){
     if(!isInsideCube(c, 0)) break;
     c = scaleAndBias(c);
     float l = pow(dist, 2); // Experimenting with inverse square falloff for shadows.
-    float s1 = 0.32 * textureLod(volumeTexture, c, 0.75 * l).a;
-    float s2 = 0.15 * textureLod(volumeTexture, c, 4.5 * l).a;
+    float s1 = 0.32 * sampleVoxels(c, 0.75 * l).a;
+    float s2 = 0.15 * sampleVoxels(c, 4.5 * l).a;
     float s = s1 + s2;
     acc += (1 - acc) * s;
     dist += 0.9 * VOXEL_SIZE * (1 + 0.05 * l);
@@ -191,8 +272,8 @@ vec3 getDirectIllumination() {
   /*Blinn-Phong shading model
     I = ka + Il * kd * (l dot n) + Il * ks * (h dot n)^N */ 
 
-  vec4 diffMatColor = (mbo.useDiffuseTexture) ? texture(diffuseSampler, fragTexCoord) : mbo.kd;
-  vec4 specMatColor = (mbo.useSpecularTexture) ? texture(specSampler, fragTexCoord) : mbo.ks;
+  vec4 diffMatColor = (useDiffuseTexture) ? texture(diffuseSampler, fragTexCoord) : mbo.kd;
+  vec4 specMatColor = (useSpecularTexture) ? texture(specSampler, fragTexCoord) : mbo.ks;
 
   vec3 ambientColor = vec3(0.0,0.0,0.0);
   vec3 diffuseColor = vec3(0.0,0.0,0.0);
@@ -212,7 +293,7 @@ vec3 getDirectIllumination() {
     float specterm = max(dot(h, w_normal), 0.0);
 
     float shadowBlend = 1;
-    if(mbo.useShadowMap && diffterm > 0)
+    if(useShadowMap && diffterm > 0)
       shadowBlend = traceShadowMap(i, w_position, lightPos);
       //shadowBlend = traceShadowCone(w_position, l, lightDist);
     float dist = 1.0;
@@ -229,7 +310,7 @@ vec3 getDirectIllumination() {
 
 vec3 getIndirectIllumination() {
   vec3 acc = vec3(0.0);
-  if(mbo.useGI) {
+  if(useGI) {
     float ANGLE_MIX = .5; // Angle mix (1.0f => orthogonal direction, 0.0f => direction of normal).
 
     /* Get a base derived from the normal */
@@ -283,8 +364,8 @@ vec3 getIndirectIllumination() {
 vec3 getReflectedIllumination() {
   vec3 reflectedIllumination = vec3(0.0, 0.0, 0.0);
 
-  if(mbo.useCubemapTexture) {
-    if (mbo.useRoughnessLod) {
+  if(useCubemapTexture) {
+    if (useRoughnessLod) {
       reflectedIllumination += vec3(textureLod(samplerCubeMap, w_reflection, mbo.roughness) * mbo.kr);
     } else {
       reflectedIllumination += vec3(texture(samplerCubeMap, w_reflection) * mbo.kr);
@@ -295,12 +376,12 @@ vec3 getReflectedIllumination() {
 }
 
 void main() {
-  vec4 diffMatColor = (mbo.useDiffuseTexture) ? texture(diffuseSampler, fragTexCoord) : mbo.kd;
+  vec4 diffMatColor = (useDiffuseTexture) ? texture(diffuseSampler, fragTexCoord) : mbo.kd;
 
 
   vec3 directIllumination = getDirectIllumination();
-  vec3 indirectIllumination = (mbo.useGI) ? getIndirectIllumination() * diffMatColor.rgb : vec3(0.0);
-	vec3 reflectedIllumination = (mbo.useCubemapTexture) ? getReflectedIllumination() : vec3(0.0);
+  vec3 indirectIllumination = (useGI) ? getIndirectIllumination() * diffMatColor.rgb : vec3(0.0);
+	vec3 reflectedIllumination = (useCubemapTexture) ? getReflectedIllumination() : vec3(0.0);
 
   outColor = vec4(directIllumination + indirectIllumination * DIFFUSE_INDIRECT_FACTOR + reflectedIllumination, 1.0);  
 
@@ -3,6 +3,14 @@
 #extension GL_EXT_multiview : enable
 precision highp float;
 
+/* Both stages are built with the same defines. With -DBINDLESS, textures are read from
+  the global texture table in set 0, and per draw buffers move to set 1 */
+#ifdef BINDLESS
+#define DRAW_SET 1
+#else
+#define DRAW_SET 0
+#endif
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inTexCoord;
@@ -23,15 +31,42 @@ struct PerspectiveObject {
     float pad1, pad2;
 };
 
-layout(binding = 0) uniform PerspectiveBufferObject {
+layout(set = DRAW_SET, binding = 0) uniform PerspectiveBufferObject {
     PerspectiveObject at[MAX_MULTIVIEW];
 } pbo;
 
 
-layout(binding = 1) uniform TransformBufferObject{
+struct TransformObject {
+    mat4 worldToLocal;
+    mat4 localToWorld;
+};
+
+/* Built with -DINSTANCED, each instance reads its own transform, indexed by gl_InstanceIndex */
+#if defined(INSTANCED)
+layout(std430, set = DRAW_SET, binding = 9) readonly buffer InstanceBufferObject {
+    TransformObject instances[];
+} ibo;
+
+#define tbo ibo.instances[gl_InstanceIndex]
+
+/* Built with -DPUSHED_TRANSFORMS, the transform is selected from the shared transform table
+  by a push constant, instead of coming from a per entity uniform buffer */
+#elif defined(PUSHED_TRANSFORMS)
+layout(std430, set = DRAW_SET, binding = 1) readonly buffer TransformTable {
+    TransformObject transforms[];
+} transformTable;
+
+layout(push_constant) uniform DrawConstants {
+    uint transformIndex;
+} draw;
+
+#define tbo transformTable.transforms[draw.transformIndex]
+#else
+layout(set = DRAW_SET, binding = 1) uniform TransformBufferObject{
     mat4 worldToLocal;
     mat4 localToWorld;
 } tbo;
+#endif
 
 #define MAXLIGHTS 10
 struct PointLightBufferItem {
@@ -52,15 +87,18 @@ struct PointLightBufferItem {
   mat4 dproj;
 };
 
-layout(binding = 2) uniform PointLightBufferObject{
+layout(set = DRAW_SET, binding = 2) uniform PointLightBufferObject{
     PointLightBufferItem lights[MAXLIGHTS];
     int totalLights;
 } plbo;
 
-layout(binding = 3) uniform MaterialBufferObject {
+layout(set = DRAW_SET, binding = 3) uniform MaterialBufferObject {
   vec4 ka, kd, ks, kr;
   bool useRoughnessLod; float roughness;
   bool useDiffuseTexture, useSpecularTexture, useCubemapTexture, useGI, useShadowMap;
+#ifdef BINDLESS
+  uint diffuseIndex, specularIndex, cubemapIndex, volumeIndex, shadowMapIndex;
+#endif
 } mbo;
 
 out gl_PerVertex {
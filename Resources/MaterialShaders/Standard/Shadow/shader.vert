@@ -24,10 +24,24 @@ layout(binding = 0) uniform PerspectiveBufferObject {
     PerspectiveObject at[MAX_MULTIVIEW];
 } pbo;
 
+/* Built with -DINSTANCED, each instance reads its own transform, indexed by gl_InstanceIndex */
+#ifdef INSTANCED
+struct TransformObject {
+    mat4 worldToLocal;
+    mat4 localToWorld;
+};
+
+layout(std430, binding = 4) readonly buffer InstanceBufferObject {
+    TransformObject instances[];
+} ibo;
+
+#define tbo ibo.instances[gl_InstanceIndex]
+#else
 layout(binding = 1) uniform TransformBufferObject{
     mat4 worldToLocal;
     mat4 localToWorld;
 } tbo;
+#endif
 
 layout(binding = 2) uniform MaterialBufferObject {
     vec4 color;
@@ -58,6 +58,18 @@ layout(binding = 5) uniform sampler2D specSampler;
 layout(binding = 6, rgba32f) writeonly uniform image3D volume;
 layout(binding = 7) uniform samplerCube shadowMap;
 
+/* When voxelizing into a sparse voxel octree, fragments are appended to a list the octree is built from,
+  with their voxel at the octree's deepest level packed into 10 bits per axis */
+layout(constant_id = 0) const bool useOctree = false;
+layout(constant_id = 1) const int octreeDepth = 1;
+
+layout(binding = 8) buffer FragmentList {
+  uint count;
+  uint capacity;
+  uint pad0, pad1;
+  uvec2 fragments[];
+} fragmentList;
+
 layout(location = 0) out vec4 outColor;
 
 vec3 sampleOffsetDirections[20] = vec3[]
@@ -149,7 +161,14 @@ void main(){
 	// Output lighting to 3D texture.
 	/* Go from -1,1 to 0,1 */
 	vec3 voxel = 0.5f * pos + vec3(0.5f); 
-	ivec3 dim = imageSize(volume);
 	vec4 res = alpha * vec4(vec3(diffuseColor + specularColor + ambientColor), 1.0);
+  if (useOctree) {
+    uvec3 cell = min(uvec3(voxel * float(1 << octreeDepth)), uvec3((1 << octreeDepth) - 1));
+    uint index = atomicAdd(fragmentList.count, 1u);
+    if (index < fragmentList.capacity)
+      fragmentList.fragments[index] = uvec2(cell.x | (cell.y << 10) | (cell.z << 20), packUnorm4x8(res));
+    return;
+  }
+	ivec3 dim = imageSize(volume);
     imageStore(volume, ivec3(dim * voxel), res);
 }
\ No newline at end of file
@@ -0,0 +1,224 @@
+#include "DescriptorAllocator.hpp"
+
+#include <algorithm>
+#include <map>
+
+namespace Components::Materials {
+	namespace {
+		std::mutex recordingMutex;
+		uint64_t currentRecording = 0;
+		std::unordered_map<const void*, uint64_t> liveRecordings;
+	}
+
+	DescriptorAllocator::DescriptorAllocator(VkDescriptorSetLayout layout, std::vector<VkDescriptorSetLayoutBinding> bindings, uint32_t setsPerPage) {
+		this->layout = layout;
+		this->bindings = bindings;
+		this->setsPerPage = nextPageSize = std::max(1u, setsPerPage);
+
+		if (!VKDK::descriptorUpdateTemplateSupported) return;
+
+		/* Each binding reads its descriptor from the matching slot of a Descriptor array */
+		std::vector<VkDescriptorUpdateTemplateEntryKHR> entries(bindings.size());
+		for (size_t i = 0; i < bindings.size(); ++i) {
+			entries[i].dstBinding = bindings[i].binding;
+			entries[i].dstArrayElement = 0;
+			entries[i].descriptorCount = 1;
+			entries[i].descriptorType = bindings[i].descriptorType;
+			entries[i].offset = i * sizeof(Descriptor);
+			entries[i].stride = sizeof(Descriptor);
+		}
+
+		VkDescriptorUpdateTemplateCreateInfoKHR templateInfo = {};
+		templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+		templateInfo.descriptorUpdateEntryCount = (uint32_t)entries.size();
+		templateInfo.pDescriptorUpdateEntries = entries.data();
+		templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+		templateInfo.descriptorSetLayout = layout;
+
+		if (VKDK::CreateDescriptorUpdateTemplate(VKDK::device, &templateInfo, nullptr, &updateTemplate) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor update template!");
+		}
+	}
+
+	VkDescriptorSet DescriptorAllocator::find(size_t key) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto cached = cachedSets.find(key);
+		if (cached == cachedSets.end()) return VK_NULL_HANDLE;
+
+		/* Move to the back of the list, as the most recently used set */
+		{
+			std::lock_guard<std::mutex> recordingLock(recordingMutex);
+			cached->second->lastUsed = currentRecording;
+		}
+		lruSets.splice(lruSets.end(), lruSets, cached->second);
+		return cached->second->descriptorSet;
+	}
+
+	VkDescriptorSet DescriptorAllocator::create(size_t key, const std::vector<Descriptor> &descriptors) {
+		if (descriptors.size() != bindings.size()) {
+			throw std::runtime_error("descriptor count doesn't match the descriptor set layout!");
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		uint64_t oldestRecording = OldestRecording();
+		uint64_t recording;
+		{
+			std::lock_guard<std::mutex> recordingLock(recordingMutex);
+			recording = currentRecording;
+		}
+
+		/* If the key was already cached, its old set is rewritten if nothing references it anymore. Otherwise it's
+			retired: no longer returned, but recycled like any other set once it's unreferenced. */
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		auto cached = cachedSets.find(key);
+		if (cached != cachedSets.end()) {
+			if (cached->second->lastUsed < oldestRecording) {
+				descriptorSet = cached->second->descriptorSet;
+				lruSets.erase(cached->second);
+			}
+			else cached->second->retired = true;
+			cachedSets.erase(cached);
+		}
+
+		/* Recycle the least recently used set once the cache holds more than a page */
+		if (descriptorSet == VK_NULL_HANDLE && lruSets.size() >= setsPerPage && lruSets.front().lastUsed < oldestRecording) {
+			descriptorSet = lruSets.front().descriptorSet;
+			if (!lruSets.front().retired) cachedSets.erase(lruSets.front().key);
+			lruSets.pop_front();
+		}
+
+		if (descriptorSet == VK_NULL_HANDLE) descriptorSet = allocate();
+		write(descriptorSet, descriptors);
+
+		lruSets.push_back({ key, descriptorSet, recording });
+		cachedSets[key] = std::prev(lruSets.end());
+		return descriptorSet;
+	}
+
+	size_t DescriptorAllocator::getSetCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return lruSets.size();
+	}
+
+	size_t DescriptorAllocator::getPageCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return pages.size();
+	}
+
+	void DescriptorAllocator::cleanup() {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto page : pages)
+			vkDestroyDescriptorPool(VKDK::device, page, nullptr);
+		pages.clear();
+		lruSets.clear();
+		cachedSets.clear();
+		nextPageSize = setsPerPage;
+		pageSetsLeft = 0;
+
+		if (updateTemplate != VK_NULL_HANDLE)
+			VKDK::DestroyDescriptorUpdateTemplate(VKDK::device, updateTemplate, nullptr);
+		updateTemplate = VK_NULL_HANDLE;
+	}
+
+	uint64_t DescriptorAllocator::BeginRecording(const void *recorder) {
+		std::lock_guard<std::mutex> lock(recordingMutex);
+		uint64_t recording = ++currentRecording;
+
+		/* A recorder's previous recording stays live until this one finishes */
+		if (liveRecordings.find(recorder) == liveRecordings.end())
+			liveRecordings[recorder] = recording;
+		return recording;
+	}
+
+	void DescriptorAllocator::FinishRecording(const void *recorder, uint64_t recording) {
+		std::lock_guard<std::mutex> lock(recordingMutex);
+		liveRecordings[recorder] = recording;
+	}
+
+	void DescriptorAllocator::ReleaseRecording(const void *recorder) {
+		std::lock_guard<std::mutex> lock(recordingMutex);
+		liveRecordings.erase(recorder);
+	}
+
+	uint64_t DescriptorAllocator::OldestRecording() {
+		std::lock_guard<std::mutex> lock(recordingMutex);
+		uint64_t oldest = currentRecording + 1;
+		for (auto &recording : liveRecordings)
+			oldest = std::min(oldest, recording.second);
+		return oldest;
+	}
+
+	void DescriptorAllocator::addPage() {
+		/* Enough descriptors of each type for every set in the page */
+		std::map<VkDescriptorType, uint32_t> typeCounts;
+		for (auto &binding : bindings)
+			typeCounts[binding.descriptorType] += binding.descriptorCount;
+
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (auto &typeCount : typeCounts) {
+			VkDescriptorPoolSize poolSize = {};
+			poolSize.type = typeCount.first;
+			poolSize.descriptorCount = typeCount.second * nextPageSize;
+			poolSizes.push_back(poolSize);
+		}
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = nextPageSize;
+
+		VkDescriptorPool pool;
+		if (vkCreateDescriptorPool(VKDK::device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create descriptor pool page!");
+		}
+		pages.push_back(pool);
+		pageSetsLeft = nextPageSize;
+		nextPageSize *= 2;
+	}
+
+	VkDescriptorSet DescriptorAllocator::allocate() {
+		/* Pools are never freed into, so a page is full once it has handed out maxSets sets. Tracking this here avoids
+			relying on VK_ERROR_OUT_OF_POOL_MEMORY, which Vulkan 1.0 drivers aren't required to return. */
+		if (pageSetsLeft == 0) addPage();
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pages.back();
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet descriptorSet;
+		auto error = vkAllocateDescriptorSets(VKDK::device, &allocInfo, &descriptorSet);
+		if (error != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate descriptor set! " + std::to_string(error));
+		}
+		pageSetsLeft--;
+		return descriptorSet;
+	}
+
+	void DescriptorAllocator::write(VkDescriptorSet descriptorSet, const std::vector<Descriptor> &descriptors) {
+		if (updateTemplate != VK_NULL_HANDLE) {
+			VKDK::UpdateDescriptorSetWithTemplate(VKDK::device, descriptorSet, updateTemplate, descriptors.data());
+			return;
+		}
+
+		std::vector<VkWriteDescriptorSet> descriptorWrites(bindings.size());
+		for (size_t i = 0; i < bindings.size(); ++i) {
+			descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[i].dstSet = descriptorSet;
+			descriptorWrites[i].dstBinding = bindings[i].binding;
+			descriptorWrites[i].dstArrayElement = 0;
+			descriptorWrites[i].descriptorType = bindings[i].descriptorType;
+			descriptorWrites[i].descriptorCount = 1;
+
+			bool isBuffer = bindings[i].descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+				|| bindings[i].descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+				|| bindings[i].descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+				|| bindings[i].descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+			if (isBuffer) descriptorWrites[i].pBufferInfo = &descriptors[i].buffer;
+			else descriptorWrites[i].pImageInfo = &descriptors[i].image;
+		}
+		vkUpdateDescriptorSets(VKDK::device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
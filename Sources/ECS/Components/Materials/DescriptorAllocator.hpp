@@ -0,0 +1,98 @@
+#pragma once
+
+#include "vkdk.hpp"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Components::Materials {
+	/* Allocates and caches descriptor sets for a single descriptor set layout.
+
+		Sets come from pages of descriptor pools. When a page runs out, a new page twice the size of the last one is
+		added, so a material never runs out of sets. Sets are written in one call with a descriptor update template
+		when VK_KHR_descriptor_update_template is available, and with vkUpdateDescriptorSets otherwise. Either way,
+		descriptors are given in the order of the bindings passed to the constructor, which materials list in binding
+		order, so the template's entries line up with the layout.
+
+		Cached sets are kept in least recently used order. A set is unreferenced once every perspective has
+		re-recorded its command buffers since the set was last requested. Once more than a page worth of sets is
+		cached, the oldest unreferenced set is rewritten and reused instead of allocating a new one. */
+	class DescriptorAllocator {
+	public:
+		/* One descriptor per binding of the layout, in binding order. This is the data layout read by the update template. */
+		union Descriptor {
+			VkDescriptorBufferInfo buffer;
+			VkDescriptorImageInfo image;
+		};
+
+		static Descriptor BufferDescriptor(VkBuffer buffer, VkDeviceSize range = VK_WHOLE_SIZE, VkDeviceSize offset = 0) {
+			Descriptor descriptor = {};
+			descriptor.buffer.buffer = buffer;
+			descriptor.buffer.offset = offset;
+			descriptor.buffer.range = range;
+			return descriptor;
+		}
+
+		static Descriptor ImageDescriptor(VkImageView imageView, VkSampler sampler,
+			VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		{
+			Descriptor descriptor = {};
+			descriptor.image.imageView = imageView;
+			descriptor.image.sampler = sampler;
+			descriptor.image.imageLayout = imageLayout;
+			return descriptor;
+		}
+
+		/* Bindings must each hold a single descriptor, and setsPerPage sets the size of the first pool */
+		DescriptorAllocator(VkDescriptorSetLayout layout, std::vector<VkDescriptorSetLayoutBinding> bindings, uint32_t setsPerPage);
+
+		/* Returns the cached set for a key, or VK_NULL_HANDLE if there isn't one */
+		VkDescriptorSet find(size_t key);
+
+		/* Returns a set for a key holding the given descriptors, recycling an unreferenced set if possible */
+		VkDescriptorSet create(size_t key, const std::vector<Descriptor> &descriptors);
+
+		/* Number of sets currently cached, and number of pool pages allocated */
+		size_t getSetCount();
+		size_t getPageCount();
+
+		/* Destroys every pool and the update template */
+		void cleanup();
+
+		/* Command buffer recordings which might still reference descriptor sets. Call BeginRecording before requesting sets
+			for a recording, FinishRecording once it's done, and ReleaseRecording when the recorder's command buffers are gone. */
+		static uint64_t BeginRecording(const void *recorder);
+		static void FinishRecording(const void *recorder, uint64_t recording);
+		static void ReleaseRecording(const void *recorder);
+
+	private:
+		struct CachedSet {
+			size_t key;
+			VkDescriptorSet descriptorSet;
+			uint64_t lastUsed;
+
+			/* Replaced by a newer set for the same key, and only kept until it can be recycled */
+			bool retired = false;
+		};
+
+		VkDescriptorSetLayout layout;
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		std::vector<VkDescriptorPool> pages;
+		uint32_t setsPerPage, nextPageSize, pageSetsLeft = 0;
+		VkDescriptorUpdateTemplateKHR updateTemplate = VK_NULL_HANDLE;
+
+		/* Least recently used sets are at the front */
+		std::list<CachedSet> lruSets;
+		std::unordered_map<size_t, std::list<CachedSet>::iterator> cachedSets;
+		std::mutex mutex;
+
+		void addPage();
+		VkDescriptorSet allocate();
+		void write(VkDescriptorSet descriptorSet, const std::vector<Descriptor> &descriptors);
+
+		/* Descriptor sets requested before this recording might still be referenced */
+		static uint64_t OldestRecording();
+	};
+}
@@ -4,30 +4,126 @@
 #include "Components/Component.hpp"
 #include "Components/Meshes/Mesh.hpp"
 #include "Components/Math/Perspective.hpp"
+#include "Components/Textures/Texture.hpp"
 
 #include "PipelineParameters.hpp"
 #include "MaterialProperties.hpp"
+#include "ShaderModules.hpp"
 #include "Tools/HashCombiner.hpp"
 #include "Tools/FileReader.hpp"
 #include "Systems/ComponentManager.hpp"
+#include "Systems/SceneGraph.hpp"
 
 #include <unordered_set>
+#include <set>
+#include <future>
+#include <mutex>
+#include <deque>
+#include <algorithm>
 namespace Components::Materials {
 	struct UBOSet {
 		VkBuffer transformUBO;
 		VkBuffer perspectiveUBO;
 		VkBuffer pointLightUBO;
+
+		/* Storage buffer of per instance transforms for instanced draws. If null, the transform UBO is bound in its place. */
+		VkBuffer instanceBuffer = VK_NULL_HANDLE;
+	};
+
+	/* Describes how a mesh should be drawn. If no indirect buffer is provided, the entire mesh is drawn directly.
+		Otherwise, drawCount VkDrawIndexedIndirectCommands are read from the indirect buffer, starting at indirectOffset. */
+	struct DrawInfo {
+		VkBuffer indirectBuffer = VK_NULL_HANDLE;
+		VkDeviceSize indirectOffset = 0;
+		uint32_t drawCount = 0;
+
+		/* If provided, the number of commands to draw is read from this buffer at countOffset, and drawCount is the maximum */
+		VkBuffer countBuffer = VK_NULL_HANDLE;
+		VkDeviceSize countOffset = 0;
+
+		/* If true, the material's instanced pipeline is used, which reads transforms from UBOSet::instanceBuffer */
+		bool instanced = false;
+
+		/* Slot of the entity's transform in the shared transform table, or ~0u if it doesn't have one */
+		uint32_t transformIndex = ~0u;
+	};
+
+	/* Per draw data for materials which read it through push constants instead of per entity descriptor sets.
+		Kept well below the 128 bytes every device supports. */
+	struct DrawConstants {
+		uint32_t transformIndex;
 	};
 
 	class MaterialInterface {
 	public:
 		/* A material can be rendered for a particular command buffer/renderpass/descriptorset/mesh */
 		virtual void render(PipelineKey pipelineKey, VkCommandBuffer commandBuffer,
-			VkDescriptorSet descriptorSet, std::shared_ptr<Components::Meshes::Mesh> meshComponent) {};
+			VkDescriptorSet descriptorSet, std::shared_ptr<Components::Meshes::Mesh> meshComponent, DrawInfo drawInfo = DrawInfo()) {};
 
 		/* Returns either a preexisting descriptor set, or a new one if one doesn't exist */
 		virtual VkDescriptorSet getDescriptorSet(UBOSet uboSet) { return VK_NULL_HANDLE; };
 
+		/* Binds descriptors shared by every draw using this material's pipeline, like the bindless texture table.
+			Called by the render queue whenever it switches to a new pipeline. */
+		virtual void bindSharedDescriptors(PipelineKey pipelineKey, VkCommandBuffer commandBuffer) {};
+
+		/* Returns true if this material has an instanced pipeline for the given key */
+		virtual bool supportsInstancing(PipelineKey pipelineKey) { return false; };
+
+		/* Returns the properties shared by every instance of this material type */
+		virtual MaterialProperties *getProperties() { return nullptr; };
+
+		/* Returns the pipelines this instance draws with. Materials with specialized variants override this to
+			return the pipelines matching the instance's features. */
+		virtual std::unordered_map<PipelineKey, VkPipeline> *getPipelines(bool instanced = false) {
+			auto properties = getProperties();
+			if (!properties) return nullptr;
+			return instanced ? &properties->instancedPipelines : &properties->pipelines;
+		}
+
+		/* True once the pipeline this material draws with for a key has finished compiling. Requests it otherwise. */
+		bool isPipelineReady(PipelineKey pipelineKey, bool instanced = false) {
+			auto pipelines = getPipelines(instanced);
+			if (!pipelines) return true;
+			return getPipeline(*pipelines, pipelineKey) != VK_NULL_HANDLE;
+		}
+
+		/* Starts compiling the pipelines for this material's current key */
+		void requestPipelines() {
+			auto pipelines = getPipelines();
+			if (!pipelines) return;
+			requestPipeline(*pipelines, pipelineKey);
+			auto instancedPipelines = getPipelines(true);
+			if (hasPipelines(*instancedPipelines))
+				requestPipeline(*instancedPipelines, pipelineKey);
+		}
+
+		/* Blocks until every pipeline compile in flight has finished */
+		static void WaitForPipelines() {
+			std::vector<std::shared_future<void>> compiles;
+			{
+				std::lock_guard<std::mutex> lock(getPipelineMutex());
+				for (auto &entry : getPipelineVariants())
+					if (entry.second.variant)
+						compiles.insert(compiles.end(), entry.second.variant->compiles.begin(), entry.second.variant->compiles.end());
+			}
+			for (auto &compile : compiles) compile.wait();
+		}
+
+		/* Returns the textures this material samples. Used to prioritize streamed textures by screen size. */
+		virtual std::vector<std::shared_ptr<Components::Textures::Texture>> getTextures() { return {}; };
+
+		/* Combines the views currently returned by this material's textures. Hashed into descriptor set keys, so that
+			new sets are written once a streamed texture swaps its placeholder for the real image. */
+		size_t getTexturesHash() {
+			size_t hash = 0;
+			for (auto &texture : getTextures()) {
+				if (!texture || !texture->texture) continue;
+				hash_combine(hash, texture->texture->getColorImageView());
+			}
+			return hash;
+		}
+
 		/* Leave it up to inheriting materials to upload UBO data */
 		virtual void uploadUBO() {};
 
@@ -40,6 +136,14 @@ namespace Components::Materials {
 			return pipelineKey;
 		}
 
+		/* Moves this material to another pipeline. Perspectives on both the old and new render pass will re-record. */
+		void setPipelineKey(PipelineKey pipelineKey) {
+			Systems::SceneGraph::MarkDirty(this->pipelineKey.renderpass);
+			this->pipelineKey = pipelineKey;
+			requestPipelines();
+			Systems::SceneGraph::MarkDirty(pipelineKey.renderpass);
+		}
+
 		/* Destroys UBO resources */
 		void cleanup() {
 			vkDestroyBuffer(VKDK::device, materialUBO, nullptr);
@@ -48,6 +152,46 @@ namespace Components::Materials {
 
 	protected:
 
+		/* Records the draw for a mesh whose buffers have already been bound */
+		static void draw(VkCommandBuffer commandBuffer, std::shared_ptr<Components::Meshes::Mesh> meshComponent, const DrawInfo &drawInfo) {
+			if (drawInfo.indirectBuffer == VK_NULL_HANDLE) {
+				vkCmdDrawIndexed(commandBuffer, meshComponent->mesh->getTotalIndices(), 1, 0, 0, 0);
+				return;
+			}
+
+			const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+			if (drawInfo.countBuffer != VK_NULL_HANDLE && VKDK::drawIndirectCountSupported) {
+				VKDK::CmdDrawIndexedIndirectCount(commandBuffer, drawInfo.indirectBuffer, drawInfo.indirectOffset,
+					drawInfo.countBuffer, drawInfo.countOffset, drawInfo.drawCount, stride);
+			}
+			else if (VKDK::deviceFeatures.multiDrawIndirect) {
+				vkCmdDrawIndexedIndirect(commandBuffer, drawInfo.indirectBuffer, drawInfo.indirectOffset, drawInfo.drawCount, stride);
+			}
+			/* Without multi draw indirect, issue one indirect draw per command */
+			else {
+				for (uint32_t i = 0; i < drawInfo.drawCount; ++i)
+					vkCmdDrawIndexedIndirect(commandBuffer, drawInfo.indirectBuffer, drawInfo.indirectOffset + i * stride, 1, stride);
+			}
+		}
+
+		/* The push constant range covering DrawConstants */
+		static VkPushConstantRange getDrawConstantsRange(VkShaderStageFlags stageFlags = VK_SHADER_STAGE_VERTEX_BIT) {
+			VkPushConstantRange range = {};
+			range.stageFlags = stageFlags;
+			range.offset = 0;
+			range.size = sizeof(DrawConstants);
+			return range;
+		}
+
+		/* Records the per draw constants for a layout created with getDrawConstantsRange */
+		static void pushDrawConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, const DrawInfo &drawInfo,
+			VkShaderStageFlags stageFlags = VK_SHADER_STAGE_VERTEX_BIT)
+		{
+			DrawConstants constants = {};
+			constants.transformIndex = drawInfo.transformIndex;
+			vkCmdPushConstants(commandBuffer, layout, stageFlags, 0, sizeof(constants), &constants);
+		}
+
 		/* Wrapper for shader module creation */
 		static VkShaderModule createShaderModule(const std::vector<char>& code) {
 			VkShaderModuleCreateInfo createInfo = {};
@@ -63,87 +207,151 @@ namespace Components::Materials {
 			return shaderModule;
 		}
 
-		/* Under the hood, all material types have a set of Vulkan pipeline objects. */
+		/* Under the hood, all material types have a set of Vulkan pipeline objects. Pipelines aren't compiled here.
+			Instead, this records how to build them, and each pipeline is compiled on a worker thread the first
+			time a material instance uses its key. Takes ownership of the shader modules in shaderStages, unless
+			they're shared modules from ShaderModules. */
 		static void createPipelines(
 			std::vector<VkPipelineShaderStageCreateInfo> shaderStages,
 			std::vector<VkVertexInputBindingDescription> bindingDescriptions,
 			std::vector<VkVertexInputAttributeDescription> attributeDescriptions,
 			std::vector<VkDescriptorSetLayout> descriptorSetLayouts,
 			std::unordered_map<PipelineKey, VkPipeline> &pipelines,
-			VkPipelineLayout &layout
+			VkPipelineLayout &layout,
+			bool createLayout = true,
+			std::vector<VkPushConstantRange> pushConstantRanges = {}
 		) {
-			std::vector<VkPipeline> pipelineVector;
-			pipelineVector.resize(Systems::ComponentManager::PipelineSettings.size());
-			std::vector<VkGraphicsPipelineCreateInfo> pipelineInfos(Systems::ComponentManager::PipelineSettings.size());
-
-			/* Vertex Input */
-			VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-			vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-			vertexInputInfo.vertexBindingDescriptionCount = (uint32_t)bindingDescriptions.size();
-			vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
-			vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)attributeDescriptions.size();
-			vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
 			/* Connect things together with pipeline layout */
 			VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
 			pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 			pipelineLayoutInfo.setLayoutCount = (uint32_t)descriptorSetLayouts.size();
 			pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-			pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-			pipelineLayoutInfo.pPushConstantRanges = 0; // Optional
+			pipelineLayoutInfo.pushConstantRangeCount = (uint32_t)pushConstantRanges.size();
+			pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
 
-			if (vkCreatePipelineLayout(VKDK::device, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
+			/* Shader variants of a material can share an existing layout */
+			if (createLayout && vkCreatePipelineLayout(VKDK::device, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
 				throw std::runtime_error("failed to create pipeline layout!");
 			}
 
-			/* Any of the following parameters may change depending on pipeline parameters. */
-			int i = 0;
-			for (auto pair : Systems::ComponentManager::PipelineSettings) {
-				pipelineInfos[i].sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-				pipelineInfos[i].stageCount = (uint32_t)shaderStages.size();
-				pipelineInfos[i].pStages = shaderStages.data();
-				pipelineInfos[i].pVertexInputState = &vertexInputInfo;
-				pipelineInfos[i].pInputAssemblyState = &pair.second->inputAssembly;
-				pipelineInfos[i].pViewportState = &pair.second->viewportState;
-				pipelineInfos[i].pRasterizationState = &pair.second->rasterizer;
-				pipelineInfos[i].pMultisampleState = &pair.second->multisampling;
-				pipelineInfos[i].pDepthStencilState = &pair.second->depthStencil;
-				pipelineInfos[i].pColorBlendState = &pair.second->colorBlending;
-				pipelineInfos[i].pDynamicState = &pair.second->dynamicState; // Optional
-				pipelineInfos[i].layout = layout;
-				pipelineInfos[i].renderPass = pair.first.renderpass;
-				pipelineInfos[i].subpass = pair.first.subpass;
-				pipelineInfos[i].basePipelineHandle = VK_NULL_HANDLE; // Optional
-				pipelineInfos[i].basePipelineIndex = -1; // Optional
-				i++;
-			}
+			auto variant = std::make_shared<PipelineVariant>();
+			variant->shaderStages = shaderStages;
+			variant->bindingDescriptions = bindingDescriptions;
+			variant->attributeDescriptions = attributeDescriptions;
+			variant->layout = layout;
+
+			/* Keys requested before a refresh are compiled again right away, along with specialized variants */
+			std::lock_guard<std::mutex> lock(getPipelineMutex());
+			auto &entry = getPipelineVariants()[&pipelines];
+			if (entry.variant) throw std::runtime_error("pipelines must be destroyed before they're created again!");
+			entry.variant = variant;
+			entry.failures.clear();
+			for (auto &key : entry.requested)
+				compilePipeline(variant.get(), &pipelines, key);
+			for (auto &specialization : entry.specializations)
+				setVariant(*specialization.first, specializeVariant(*variant, specialization.second));
+		}
 
-			if (vkCreateGraphicsPipelines(VKDK::device, VK_NULL_HANDLE, (uint32_t)pipelineInfos.size(), 
-				pipelineInfos.data(), nullptr, pipelineVector.data()) != VK_SUCCESS) {
-				throw std::runtime_error("failed to create graphics pipeline!");
+		/* Returns the pipelines built from a material's shaders with the given specialization constants, where
+			constant_id i is constants[i]. Pipelines are only compiled for the keys requested from them. */
+		static MaterialProperties::SpecializedPipelines &getSpecializedPipelines(MaterialProperties &properties, std::vector<uint32_t> constants) {
+			std::lock_guard<std::mutex> lock(getPipelineMutex());
+			auto existing = properties.specializedPipelines.find(constants);
+			if (existing != properties.specializedPipelines.end()) return existing->second;
+
+			auto &specialized = properties.specializedPipelines[constants];
+			auto &variants = getPipelineVariants();
+			std::pair<std::unordered_map<PipelineKey, VkPipeline>*, std::unordered_map<PipelineKey, VkPipeline>*> maps[] = {
+				{ &properties.pipelines, &specialized.pipelines },
+				{ &properties.instancedPipelines, &specialized.instancedPipelines } };
+			for (auto &map : maps) {
+				auto &entry = variants[map.first];
+				entry.specializations.push_back({ map.second, constants });
+				if (entry.variant) setVariant(*map.second, specializeVariant(*entry.variant, constants));
 			}
+			return specialized;
+		}
 
-			/* Create unordered map of pipeline keys to pipelines */
-			i = 0;
-			for (auto pair : Systems::ComponentManager::PipelineSettings) {
-				pipelines[pair.first] = pipelineVector[i];
-				i++;
+		/* Starts compiling the pipeline for a key in the background, if it hasn't been requested yet. Keys which
+			failed to compile MaxCompileAttempts times are never requested again, so their draws stay skipped. */
+		static void requestPipeline(std::unordered_map<PipelineKey, VkPipeline> &pipelines, PipelineKey key) {
+			std::lock_guard<std::mutex> lock(getPipelineMutex());
+			auto &entry = getPipelineVariants()[&pipelines];
+			auto failures = entry.failures.find(key);
+			if (failures != entry.failures.end() && failures->second >= MaxCompileAttempts) return;
+			if (!entry.requested.insert(key).second) return;
+			if (entry.variant) compilePipeline(entry.variant.get(), &pipelines, key);
+		}
+
+		/* Returns the pipeline for a key, or VK_NULL_HANDLE if it's still compiling. Requests it if needed. */
+		static VkPipeline getPipeline(std::unordered_map<PipelineKey, VkPipeline> &pipelines, PipelineKey key) {
+			{
+				std::lock_guard<std::mutex> lock(getPipelineMutex());
+				auto pipeline = pipelines.find(key);
+				if (pipeline != pipelines.end()) return pipeline->second;
 			}
+			requestPipeline(pipelines, key);
+			return VK_NULL_HANDLE;
+		}
+
+		/* True if createPipelines was called for these pipelines, so they can be compiled for any key */
+		static bool hasPipelines(std::unordered_map<PipelineKey, VkPipeline> &pipelines) {
+			std::lock_guard<std::mutex> lock(getPipelineMutex());
+			auto entry = getPipelineVariants().find(&pipelines);
+			return entry != getPipelineVariants().end() && entry->second.variant;
 		}
 
-		/* Clean up descriptor pool, descriptor layout, pipeline layout, and pipeline */
+		/* Clean up descriptor pools, descriptor layout, pipeline layout, and pipeline */
 		static void Destroy(MaterialProperties &properties) {
-			vkDestroyDescriptorPool(VKDK::device, properties.descriptorPool, nullptr);
+			if (properties.descriptorAllocator) properties.descriptorAllocator->cleanup();
+			properties.descriptorAllocator = nullptr;
 			vkDestroyDescriptorSetLayout(VKDK::device, properties.descriptorSetLayout, nullptr);
-			vkDestroyPipelineLayout(VKDK::device, properties.pipelineLayout, nullptr);
-			for (auto pipeline : properties.pipelines)
-				vkDestroyPipeline(VKDK::device, pipeline.second, nullptr);
+			DestroyPipeline(properties);
+
+			/* Nothing is recompiled after a full destroy */
+			std::lock_guard<std::mutex> lock(getPipelineMutex());
+			getPipelineVariants().erase(&properties.pipelines);
+			getPipelineVariants().erase(&properties.instancedPipelines);
+			for (auto &specialized : properties.specializedPipelines) {
+				getPipelineVariants().erase(&specialized.second.pipelines);
+				getPipelineVariants().erase(&specialized.second.instancedPipelines);
+			}
+			properties.specializedPipelines.clear();
+			++properties.specializationGeneration;
 		}
 
 		static void DestroyPipeline(MaterialProperties &properties) {
+			/* Detach the variants, so that compiles still in flight discard their results, then wait for them */
+			std::vector<std::shared_ptr<PipelineVariant>> variants;
+			std::vector<std::unordered_map<PipelineKey, VkPipeline>*> maps = { &properties.pipelines, &properties.instancedPipelines };
+			{
+				std::lock_guard<std::mutex> lock(getPipelineMutex());
+				for (auto &specialized : properties.specializedPipelines) {
+					maps.push_back(&specialized.second.pipelines);
+					maps.push_back(&specialized.second.instancedPipelines);
+				}
+				for (auto pipelines : maps) {
+					auto entry = getPipelineVariants().find(pipelines);
+					if (entry == getPipelineVariants().end() || !entry->second.variant) continue;
+					variants.push_back(entry->second.variant);
+					entry->second.variant = nullptr;
+				}
+			}
+			std::set<VkShaderModule> shaderModules;
+			for (auto &variant : variants) {
+				for (auto &compile : variant->compiles) compile.wait();
+				for (auto &stage : variant->shaderStages) shaderModules.insert(stage.module);
+			}
+
 			vkDestroyPipelineLayout(VKDK::device, properties.pipelineLayout, nullptr);
-			for (auto pipeline : properties.pipelines)
-				vkDestroyPipeline(VKDK::device, pipeline.second, nullptr);
+			for (auto pipelines : maps) {
+				for (auto pipeline : *pipelines)
+					vkDestroyPipeline(VKDK::device, pipeline.second, nullptr);
+				pipelines->clear();
+			}
+			for (auto shaderModule : shaderModules)
+				if (!ShaderModules::Owns(shaderModule)) vkDestroyShaderModule(VKDK::device, shaderModule, nullptr);
+			Systems::SceneGraph::MarkDirty();
 		}
 
 		/* All material instances have these */
@@ -159,6 +367,212 @@ namespace Components::Materials {
 				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 				materialUBO, materialUBOMemory);
 		}
+
+	private:
+		/* How to build one of a material's sets of pipelines, for any pipeline key */
+		struct PipelineVariant {
+			std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+			std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+			std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+			VkPipelineLayout layout;
+			std::vector<uint32_t> specializationConstants;
+			std::vector<std::shared_future<void>> compiles;
+		};
+
+		/* Keys stay requested across pipeline refreshes, so they're recompiled for the new variant */
+		struct PipelineVariantEntry {
+			std::shared_ptr<PipelineVariant> variant;
+			std::unordered_set<PipelineKey> requested;
+
+			/* Failed compiles by key. Cleared whenever the variant changes, since new shaders may fix them. */
+			std::unordered_map<PipelineKey, uint32_t> failures;
+
+			/* Pipeline maps built from this variant with specialization constants, which follow it across refreshes */
+			std::vector<std::pair<std::unordered_map<PipelineKey, VkPipeline>*, std::vector<uint32_t>>> specializations;
+		};
+
+		/* Variants by the pipeline map they compile into */
+		static std::unordered_map<const void*, PipelineVariantEntry> &getPipelineVariants() {
+			static std::unordered_map<const void*, PipelineVariantEntry> variants;
+			return variants;
+		}
+
+		/* A failed compile is requested again on the key's next use, up to this many times */
+		static const uint32_t MaxCompileAttempts = 3;
+
+		/* Compiles waiting for one of a bounded number of worker threads. Guarded by the pipeline mutex. */
+		struct CompileQueue {
+			std::deque<std::packaged_task<void()>> jobs;
+			uint32_t running = 0;
+			std::vector<std::future<void>> workers;
+		};
+
+		/* The mutex is constructed first, so that it outlives the workers this waits for on exit */
+		static CompileQueue &getCompileQueue() {
+			getPipelineMutex();
+			static CompileQueue queue;
+			return queue;
+		}
+
+		/* Leaves a core each for the update and render threads, like texture decoding */
+		static uint32_t getCompileThreadCount() {
+			uint32_t cores = std::thread::hardware_concurrency();
+			return std::max(1u, (cores > 2) ? cores - 2 : 1u);
+		}
+
+		/* Runs queued compiles until none are left, then exits */
+		static void runCompiles() {
+			while (true) {
+				std::packaged_task<void()> job;
+				{
+					std::lock_guard<std::mutex> lock(getPipelineMutex());
+					auto &queue = getCompileQueue();
+					if (queue.jobs.empty()) {
+						--queue.running;
+						return;
+					}
+					job = std::move(queue.jobs.front());
+					queue.jobs.pop_front();
+				}
+				job();
+			}
+		}
+
+		/* Must be called with the pipeline mutex held. True if the map still compiles from this variant. */
+		static bool isCurrentVariant(std::unordered_map<PipelineKey, VkPipeline> *pipelines, PipelineVariant *variant) {
+			auto entry = getPipelineVariants().find(pipelines);
+			return entry != getPipelineVariants().end() && entry->second.variant.get() == variant;
+		}
+
+		/* Guards the variants, and every material's pipeline maps */
+		static std::mutex &getPipelineMutex() {
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		/* A copy of a variant compiled with specialization constants. Shares the shader modules and layout. */
+		static std::shared_ptr<PipelineVariant> specializeVariant(const PipelineVariant &variant, std::vector<uint32_t> constants) {
+			auto specialized = std::make_shared<PipelineVariant>();
+			specialized->shaderStages = variant.shaderStages;
+			specialized->bindingDescriptions = variant.bindingDescriptions;
+			specialized->attributeDescriptions = variant.attributeDescriptions;
+			specialized->layout = variant.layout;
+			specialized->specializationConstants = constants;
+			return specialized;
+		}
+
+		/* Must be called with the pipeline mutex held. Compiles the keys already requested from the map. */
+		static void setVariant(std::unordered_map<PipelineKey, VkPipeline> &pipelines, std::shared_ptr<PipelineVariant> variant) {
+			auto &entry = getPipelineVariants()[&pipelines];
+			entry.variant = variant;
+			entry.failures.clear();
+			for (auto &key : entry.requested)
+				compilePipeline(variant.get(), &pipelines, key);
+		}
+
+		/* Must be called with the pipeline mutex held. Queues the compile for the worker threads, starting another
+			if fewer than getCompileThreadCount are running. The variant outlives its compiles, since DestroyPipeline
+			waits for them. Pipelines share VKDK::pipelineCache, which is internally synchronized. */
+		static void compilePipeline(PipelineVariant *variant,
+			std::unordered_map<PipelineKey, VkPipeline> *pipelines, PipelineKey key)
+		{
+			auto settings = Systems::ComponentManager::PipelineSettings.find(key);
+			if (settings == Systems::ComponentManager::PipelineSettings.end()) return;
+			std::shared_ptr<PipelineParameters> parameters = settings->second;
+
+			std::packaged_task<void()> job([variant, pipelines, key, parameters]() {
+				/* Compiles still queued when the variant was refreshed or destroyed are skipped */
+				{
+					std::lock_guard<std::mutex> lock(getPipelineMutex());
+					if (!isCurrentVariant(pipelines, variant)) return;
+				}
+
+				/* Vertex Input */
+				VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+				vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+				vertexInputInfo.vertexBindingDescriptionCount = (uint32_t)variant->bindingDescriptions.size();
+				vertexInputInfo.pVertexBindingDescriptions = variant->bindingDescriptions.data();
+				vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)variant->attributeDescriptions.size();
+				vertexInputInfo.pVertexAttributeDescriptions = variant->attributeDescriptions.data();
+
+				/* Every constant is 32 bits wide. Stages ignore the constants they don't declare. */
+				std::vector<VkSpecializationMapEntry> specializationEntries(variant->specializationConstants.size());
+				for (uint32_t i = 0; i < specializationEntries.size(); ++i) {
+					specializationEntries[i].constantID = i;
+					specializationEntries[i].offset = i * sizeof(uint32_t);
+					specializationEntries[i].size = sizeof(uint32_t);
+				}
+				VkSpecializationInfo specializationInfo = {};
+				specializationInfo.mapEntryCount = (uint32_t)specializationEntries.size();
+				specializationInfo.pMapEntries = specializationEntries.data();
+				specializationInfo.dataSize = variant->specializationConstants.size() * sizeof(uint32_t);
+				specializationInfo.pData = variant->specializationConstants.data();
+
+				auto shaderStages = variant->shaderStages;
+				if (!specializationEntries.empty())
+					for (auto &stage : shaderStages) stage.pSpecializationInfo = &specializationInfo;
+
+				/* Any of the following parameters may change depending on pipeline parameters. */
+				VkGraphicsPipelineCreateInfo pipelineInfo = {};
+				pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+				pipelineInfo.stageCount = (uint32_t)shaderStages.size();
+				pipelineInfo.pStages = shaderStages.data();
+				pipelineInfo.pVertexInputState = &vertexInputInfo;
+				pipelineInfo.pInputAssemblyState = &parameters->inputAssembly;
+				pipelineInfo.pViewportState = &parameters->viewportState;
+				pipelineInfo.pRasterizationState = &parameters->rasterizer;
+				pipelineInfo.pMultisampleState = &parameters->multisampling;
+				pipelineInfo.pDepthStencilState = &parameters->depthStencil;
+				pipelineInfo.pColorBlendState = &parameters->colorBlending;
+				pipelineInfo.pDynamicState = &parameters->dynamicState; // Optional
+				pipelineInfo.layout = variant->layout;
+				pipelineInfo.renderPass = key.renderpass;
+				pipelineInfo.subpass = key.subpass;
+				pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+				pipelineInfo.basePipelineIndex = -1; // Optional
+
+				auto start = std::chrono::steady_clock::now();
+				VkPipeline pipeline;
+				if (vkCreateGraphicsPipelines(VKDK::device, VKDK::pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+					/* Unrequest the key, so that its next use retries it */
+					std::lock_guard<std::mutex> lock(getPipelineMutex());
+					if (!isCurrentVariant(pipelines, variant)) return;
+					auto &entry = getPipelineVariants()[pipelines];
+					entry.requested.erase(key);
+					uint32_t attempts = ++entry.failures[key];
+					VKDK::print("failed to create graphics pipeline! (attempt " + std::to_string(attempts) + " of "
+						+ std::to_string(MaxCompileAttempts) + ")", true);
+					return;
+				}
+				VKDK::RecordPipelineCreation(1, std::chrono::steady_clock::now() - start);
+
+				/* If the variant was refreshed or destroyed meanwhile, this pipeline is stale */
+				{
+					std::lock_guard<std::mutex> lock(getPipelineMutex());
+					if (!isCurrentVariant(pipelines, variant)) {
+						vkDestroyPipeline(VKDK::device, pipeline, nullptr);
+						return;
+					}
+					getPipelineVariants()[pipelines].failures.erase(key);
+					(*pipelines)[key] = pipeline;
+				}
+
+				/* Perspectives on this render pass skipped the material until now */
+				Systems::SceneGraph::MarkDirty(key.renderpass);
+			});
+			variant->compiles.push_back(job.get_future().share());
+
+			auto &queue = getCompileQueue();
+			queue.jobs.push_back(std::move(job));
+			if (queue.running >= getCompileThreadCount()) return;
+
+			/* Workers which ran out of jobs have exited, so their futures are ready */
+			queue.workers.erase(std::remove_if(queue.workers.begin(), queue.workers.end(), [](std::future<void> &worker) {
+				return worker.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+			}), queue.workers.end());
+			++queue.running;
+			queue.workers.push_back(std::async(std::launch::async, runCompiles));
+		}
 	};
 
 	class Material : public Component {
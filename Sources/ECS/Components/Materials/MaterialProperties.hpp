@@ -1,6 +1,11 @@
 #pragma once
 
 #include "vkdk.hpp"
+#include "DescriptorAllocator.hpp"
+
+#include <map>
+#include <memory>
+#include <vector>
 
 namespace Components::Materials { class MaterialInterface; }
 
@@ -8,9 +13,25 @@ namespace Components::Materials { class MaterialInterface; }
 struct MaterialProperties {
 	VkPipelineLayout pipelineLayout;
 	std::unordered_map<PipelineKey, VkPipeline> pipelines;
-	VkDescriptorPool descriptorPool;
+
+	/* Pipelines reading per instance transforms from a storage buffer, if the material has an instanced shader variant */
+	std::unordered_map<PipelineKey, VkPipeline> instancedPipelines;
+
+	/* Pipelines built from the shaders above with specialization constants, by constant values. Instances
+		whose features map to the same constants share the same pipelines. */
+	struct SpecializedPipelines {
+		std::unordered_map<PipelineKey, VkPipeline> pipelines;
+		std::unordered_map<PipelineKey, VkPipeline> instancedPipelines;
+	};
+	std::map<std::vector<uint32_t>, SpecializedPipelines> specializedPipelines;
+
+	/* Bumped whenever specializedPipelines is cleared, so that instances caching an entry know to look it up again */
+	uint32_t specializationGeneration = 0;
+
 	VkDescriptorSetLayout descriptorSetLayout;
+
+	/* Size of the first descriptor pool page. Later pages grow as needed. */
 	uint32_t maxDescriptorSets;
-	std::unordered_map<size_t, VkDescriptorSet> descriptorSets;
+	std::shared_ptr<Components::Materials::DescriptorAllocator> descriptorAllocator;
 	//std::vector<Components::Materials::MaterialInterface> instances;
 };
\ No newline at end of file
@@ -46,6 +46,9 @@ struct PipelineParameters {
 	VkPipelineColorBlendStateCreateInfo colorBlending = {};
 	VkPipelineDynamicStateCreateInfo dynamicState = {};
 
+	/* Transparent pipelines blend over what has already been drawn, and are drawn back to front after opaque ones */
+	bool transparent = false;
+
 	VkDynamicState dynamicStates[3] = {
 		VK_DYNAMIC_STATE_VIEWPORT,
 		VK_DYNAMIC_STATE_SCISSOR,
@@ -110,8 +113,8 @@ struct PipelineParameters {
 
 		/* Default Color Blending Attachment State */
 		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		colorBlendAttachment.blendEnable = VK_TRUE;
-		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA; // Optional /* TRANSPARENCY STUFF HERE! */
+		colorBlendAttachment.blendEnable = VK_TRUE; /* Opaque pipelines can opt out with setTransparent(false) */
+		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA; // Optional
 		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA; // Optional
 		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; // Optional
 		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
@@ -134,4 +137,12 @@ struct PipelineParameters {
 		dynamicState.dynamicStateCount = 3;
 		dynamicState.pDynamicStates = dynamicStates;
 	}
+
+	/* Transparent pipelines blend, skip depth writes and are drawn back to front after opaque ones. Opaque
+		pipelines write depth and drop blending, which the defaults leave on for materials writing partial alpha. */
+	void setTransparent(bool transparent) {
+		this->transparent = transparent;
+		colorBlendAttachment.blendEnable = (transparent) ? VK_TRUE : VK_FALSE;
+		depthStencil.depthWriteEnable = (transparent) ? VK_FALSE : VK_TRUE;
+	}
 };
\ No newline at end of file
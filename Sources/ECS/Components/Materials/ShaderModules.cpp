@@ -0,0 +1,247 @@
+#include "ShaderModules.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#ifdef USE_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+namespace Components::Materials {
+	namespace {
+		std::mutex mutex;
+		std::string cacheDirectory;
+
+		/* Pending and finished modules, by content hash */
+		std::unordered_map<uint64_t, std::shared_future<VkShaderModule>> modules;
+		std::unordered_map<VkShaderModule, uint64_t> ownedModules;
+
+		const uint32_t SpirvMagic = 0x07230203;
+
+		/* FNV-1a, which unlike std::hash is stable between runs and platforms */
+		void hashBytes(uint64_t &hash, const void *data, size_t size) {
+			auto bytes = (const uint8_t*)data;
+			for (size_t i = 0; i < size; ++i) {
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+		}
+
+		std::string toHex(uint64_t value) {
+			std::stringstream stream;
+			stream << std::hex;
+			stream.width(16);
+			stream.fill('0');
+			stream << value;
+			return stream.str();
+		}
+	}
+
+	void ShaderModules::Initialize(std::string cachePath) {
+		std::lock_guard<std::mutex> lock(mutex);
+		ownedModules.clear();
+		cacheDirectory = cachePath;
+		if (cacheDirectory.empty()) return;
+
+		std::error_code error;
+		std::filesystem::create_directories(cacheDirectory, error);
+		if (error) {
+			VKDK::print("Failed to create shader cache directory " + cacheDirectory + ", shaders won't be cached");
+			cacheDirectory.clear();
+		}
+	}
+
+	void ShaderModules::Destroy() {
+		/* Let background compiles finish before destroying what they created */
+		std::unordered_map<uint64_t, std::shared_future<VkShaderModule>> pending;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending.swap(modules);
+		}
+		for (auto &shaderModule : pending) {
+			try {
+				VkShaderModule module = shaderModule.second.get();
+				if (module != VK_NULL_HANDLE) vkDestroyShaderModule(VKDK::device, module, nullptr);
+			}
+			catch (std::exception&) {}
+		}
+	}
+
+	bool ShaderModules::IsCompilerAvailable() {
+#ifdef USE_SHADERC
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	bool ShaderModules::CanLoad(std::string sourcePath, std::string fallbackPath) {
+		auto exists = [](const std::string &path) {
+			return !path.empty() && std::ifstream(path, std::ios::binary).is_open();
+		};
+		return (IsCompilerAvailable() && exists(sourcePath)) || exists(fallbackPath);
+	}
+
+	VkShaderModule ShaderModules::Get(std::string sourcePath, VkShaderStageFlagBits stage,
+		std::vector<std::string> defines, std::string fallbackPath)
+	{
+		return GetAsync(sourcePath, stage, defines, fallbackPath).get();
+	}
+
+	std::shared_future<VkShaderModule> ShaderModules::GetAsync(std::string sourcePath, VkShaderStageFlagBits stage,
+		std::vector<std::string> defines, std::string fallbackPath)
+	{
+		/* The order defines are given in doesn't change the result */
+		std::sort(defines.begin(), defines.end());
+
+		/* Key modules by what they're built from. Without a compiler, only the fallback SPIR-V matters. */
+		std::string source;
+		if (IsCompilerAvailable()) {
+			std::ifstream file(sourcePath, std::ios::binary);
+			if (file.is_open()) {
+				std::stringstream contents;
+				contents << file.rdbuf();
+				source = contents.str();
+			}
+		}
+
+		uint64_t hash = 14695981039346656037ull;
+		hashBytes(hash, &stage, sizeof(stage));
+		for (auto &define : defines) hashBytes(hash, define.c_str(), define.size() + 1);
+		if (!source.empty()) hashBytes(hash, source.data(), source.size());
+		else hashBytes(hash, fallbackPath.data(), fallbackPath.size());
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto existing = modules.find(hash);
+		if (existing != modules.end()) return existing->second;
+
+		auto shaderModule = std::async(std::launch::async, [sourcePath, source, stage, defines, fallbackPath, hash]() {
+			auto module = CreateModule(Load(sourcePath, source, stage, defines, fallbackPath, hash));
+			std::lock_guard<std::mutex> lock(mutex);
+			ownedModules[module] = hash;
+			return module;
+		}).share();
+		modules[hash] = shaderModule;
+		return shaderModule;
+	}
+
+	bool ShaderModules::Owns(VkShaderModule shaderModule) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return ownedModules.find(shaderModule) != ownedModules.end();
+	}
+
+	std::vector<uint32_t> ShaderModules::Load(std::string sourcePath, std::string source, VkShaderStageFlagBits stage,
+		std::vector<std::string> defines, std::string fallbackPath, uint64_t hash)
+	{
+		if (!source.empty()) {
+			/* A previous run might have compiled this exact source already */
+			std::string cachePath;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!cacheDirectory.empty()) cachePath = cacheDirectory + "/" + toHex(hash) + ".spv";
+			}
+			if (!cachePath.empty()) {
+				auto spirv = ReadSpirv(cachePath);
+				if (!spirv.empty()) return spirv;
+			}
+
+			auto spirv = Compile(sourcePath, source, stage, defines);
+			if (!spirv.empty()) {
+				if (!cachePath.empty()) WriteSpirv(cachePath, spirv);
+				return spirv;
+			}
+		}
+
+		auto spirv = ReadSpirv(fallbackPath);
+		if (spirv.empty()) {
+			throw std::runtime_error("failed to load shader " + sourcePath + "!");
+		}
+		return spirv;
+	}
+
+	std::vector<uint32_t> ShaderModules::Compile(std::string sourcePath, std::string source, VkShaderStageFlagBits stage,
+		std::vector<std::string> defines)
+	{
+#ifdef USE_SHADERC
+		shaderc_shader_kind kind;
+		switch (stage) {
+		case VK_SHADER_STAGE_VERTEX_BIT: kind = shaderc_glsl_vertex_shader; break;
+		case VK_SHADER_STAGE_FRAGMENT_BIT: kind = shaderc_glsl_fragment_shader; break;
+		case VK_SHADER_STAGE_GEOMETRY_BIT: kind = shaderc_glsl_geometry_shader; break;
+		case VK_SHADER_STAGE_COMPUTE_BIT: kind = shaderc_glsl_compute_shader; break;
+		case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT: kind = shaderc_glsl_tess_control_shader; break;
+		case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT: kind = shaderc_glsl_tess_evaluation_shader; break;
+		default: throw std::runtime_error("unsupported shader stage!");
+		}
+
+		/* Compiling is thread safe, so every worker shares one compiler */
+		static shaderc::Compiler compiler;
+		shaderc::CompileOptions options;
+		options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_0);
+		options.SetOptimizationLevel(shaderc_optimization_level_performance);
+		for (auto &define : defines) {
+			auto equals = define.find('=');
+			if (equals == std::string::npos) options.AddMacroDefinition(define);
+			else options.AddMacroDefinition(define.substr(0, equals), define.substr(equals + 1));
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		auto result = compiler.CompileGlslToSpv(source, kind, sourcePath.c_str(), options);
+		if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+			VKDK::print("Failed to compile " + sourcePath + ":\n" + result.GetErrorMessage(), true);
+			return {};
+		}
+		auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+		VKDK::print("Compiled " + sourcePath + " in " + std::to_string(duration.count()) + " ms");
+		return std::vector<uint32_t>(result.cbegin(), result.cend());
+#else
+		return {};
+#endif
+	}
+
+	std::vector<uint32_t> ShaderModules::ReadSpirv(std::string path) {
+		if (path.empty()) return {};
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open()) return {};
+
+		size_t fileSize = (size_t)file.tellg();
+		if (fileSize < sizeof(uint32_t) || fileSize % sizeof(uint32_t) != 0) return {};
+
+		std::vector<uint32_t> spirv(fileSize / sizeof(uint32_t));
+		file.seekg(0);
+		file.read((char*)spirv.data(), fileSize);
+		if (!file || spirv[0] != SpirvMagic) return {};
+		return spirv;
+	}
+
+	void ShaderModules::WriteSpirv(std::string path, const std::vector<uint32_t> &spirv) {
+		/* Write to a temporary file first, so an interrupted write never leaves a truncated shader behind */
+		std::string tempPath = path + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				VKDK::print("Failed to write shader cache entry " + tempPath);
+				return;
+			}
+			file.write((const char*)spirv.data(), spirv.size() * sizeof(uint32_t));
+			if (!file) return;
+		}
+		std::remove(path.c_str());
+		std::rename(tempPath.c_str(), path.c_str());
+	}
+
+	VkShaderModule ShaderModules::CreateModule(const std::vector<uint32_t> &spirv) {
+		VkShaderModuleCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = spirv.size() * sizeof(uint32_t);
+		createInfo.pCode = spirv.data();
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(VKDK::device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create shader module!");
+		}
+		return shaderModule;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "vkdk.hpp"
+
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Components::Materials {
+	/* Shader modules shared by every material, compiled from GLSL at runtime.
+
+		When the build finds shaderc, sources like shader.vert, shader.frag and shader.geom are compiled with a set of
+		preprocessor defines. The SPIR-V is written to an on disk cache, named by a hash of the stage, the defines and
+		the source text, so a shader is only compiled again once its source changes. Without shaderc, or if a source
+		fails to compile, the precompiled SPIR-V file passed as a fallback is loaded instead.
+
+		Each module is created once, and is owned by this cache until Destroy. Compiles can run in the background with
+		GetAsync, and several requests for the same module share one compile. */
+	class ShaderModules {
+	public:
+		/* The cache lives next to the resources by default, so it doesn't depend on the working directory */
+		static void Initialize(std::string cachePath = ResourcePath "shader_cache");
+		static void Destroy();
+
+		/* True if shaders can be compiled from source at runtime */
+		static bool IsCompilerAvailable();
+
+		/* True if Get would find either the source, when it can be compiled, or the fallback SPIR-V */
+		static bool CanLoad(std::string sourcePath, std::string fallbackPath = "");
+
+		/* Returns the module for a source compiled with the given defines, compiling it if needed */
+		static VkShaderModule Get(std::string sourcePath, VkShaderStageFlagBits stage,
+			std::vector<std::string> defines = {}, std::string fallbackPath = "");
+
+		/* Like Get, but compiles on a worker thread */
+		static std::shared_future<VkShaderModule> GetAsync(std::string sourcePath, VkShaderStageFlagBits stage,
+			std::vector<std::string> defines = {}, std::string fallbackPath = "");
+
+		/* True if a module was created by this cache, and so mustn't be destroyed by its users. Stays true after
+			Destroy, so that materials torn down later don't destroy modules twice. */
+		static bool Owns(VkShaderModule shaderModule);
+
+	private:
+		static std::vector<uint32_t> Load(std::string sourcePath, std::string source, VkShaderStageFlagBits stage,
+			std::vector<std::string> defines, std::string fallbackPath, uint64_t hash);
+		static std::vector<uint32_t> Compile(std::string sourcePath, std::string source, VkShaderStageFlagBits stage,
+			std::vector<std::string> defines);
+		static std::vector<uint32_t> ReadSpirv(std::string path);
+		static void WriteSpirv(std::string path, const std::vector<uint32_t> &spirv);
+		static VkShaderModule CreateModule(const std::vector<uint32_t> &spirv);
+	};
+}
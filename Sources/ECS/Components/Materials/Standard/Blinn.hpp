@@ -6,6 +6,8 @@
 #include "Components/Meshes/Mesh.hpp"
 #include "Components/Lights/PointLight/PointLight.hpp"
 #include "Components/Textures/Texture2D.hpp"
+#include "Components/Textures/TextureTable.hpp"
+#include "Components/Textures/SparseVoxelOctree.hpp"
 #include <glm/glm.hpp>
 #include <memory>
 #include <array>
@@ -30,8 +32,17 @@ namespace Components::Materials::Standard {
 
     static void Initialize(int maxDescriptorSets) {
       getStaticProperties().maxDescriptorSets = maxDescriptorSets;
+
+      /* Textures are read from the global texture table when descriptor indexing is available */
+      bindlessTextures() = Textures::TextureTable::IsEnabled()
+        && hasShader("vert", true, false)
+        && hasShader("frag", true, false);
+
+      /* Transforms are read from the shared transform table by push constant index when it's available */
+      pushedTransforms() = Transform::GetTableBuffer() != VK_NULL_HANDLE
+        && hasShader("vert", bindlessTextures(), true)
+        && hasShader("frag", bindlessTextures(), true);
       createDescriptorSetLayout();
-      createDescriptorPool();
       setupGraphicsPipeline();
     }
 
@@ -40,164 +51,66 @@ namespace Components::Materials::Standard {
       return properties;
     }
 
+    MaterialProperties *getProperties() {
+      return &getStaticProperties();
+    }
+
     static void Destroy() {
       MaterialInterface::Destroy(getStaticProperties());
     }
 
+    /* True if textures are indexed from the texture table, leaving only buffers in the per draw descriptor set */
+    static bool UsesBindlessTextures() {
+      return bindlessTextures();
+    }
+
+    /* True if the per draw transform is selected with a push constant, so descriptor sets aren't per entity */
+    static bool UsesPushedTransforms() {
+      return pushedTransforms();
+    }
+
     /* Primarily used to account for render pass changes */
     static void RefreshPipeline() {
       MaterialInterface::DestroyPipeline(getStaticProperties());
       setupGraphicsPipeline();
     }
 
-    static VkDescriptorSet CreateDescriptorSet(
+    static VkDescriptorSet CreateDescriptorSet(size_t key,
       VkBuffer materialUBO, VkBuffer perspectiveUBO, VkBuffer transformUBO, VkBuffer pointLightUBO,
       VkImageView diffuseImageView, VkSampler diffuseSampler,
       VkImageView specularImageView, VkSampler specularSampler,
       VkImageView reflectionImageView, VkSampler reflectionSampler,
       VkImageView shadowMapImageView, VkSampler shadowMapSampler,
-      VkSampler voxelSampler, VkImageView voxelImageView)
+      VkSampler voxelSampler, VkImageView voxelImageView,
+      VkBuffer instanceBuffer, VkBuffer nodeBuffer)
     {
-      VkDescriptorSet descriptorSet;
-
-      VkDescriptorSetLayout layouts[] = { getStaticProperties().descriptorSetLayout };
-      VkDescriptorSetAllocateInfo allocInfo = {};
-      allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-      allocInfo.descriptorPool = getStaticProperties().descriptorPool;
-      allocInfo.descriptorSetCount = 1;
-      allocInfo.pSetLayouts = layouts;
-
-      auto error = vkAllocateDescriptorSets(VKDK::device, &allocInfo, &descriptorSet);
-      if (error != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate descriptor set! " + error);
-      }
+      return getStaticProperties().descriptorAllocator->create(key, {
+        DescriptorAllocator::BufferDescriptor(perspectiveUBO, sizeof(Components::Math::PerspectiveBufferObject)),
+        DescriptorAllocator::BufferDescriptor(transformUBO, getTransformRange()),
+        DescriptorAllocator::BufferDescriptor(pointLightUBO, sizeof(Components::Lights::PointLightBufferObject)),
+        DescriptorAllocator::BufferDescriptor(materialUBO, sizeof(MaterialBufferObject)),
+        DescriptorAllocator::ImageDescriptor(diffuseImageView, diffuseSampler),
+        DescriptorAllocator::ImageDescriptor(specularImageView, specularSampler),
+        DescriptorAllocator::ImageDescriptor(reflectionImageView, reflectionSampler),
+        DescriptorAllocator::ImageDescriptor(voxelImageView, voxelSampler, VK_IMAGE_LAYOUT_GENERAL),
+        DescriptorAllocator::ImageDescriptor(shadowMapImageView, shadowMapSampler),
+        DescriptorAllocator::BufferDescriptor(instanceBuffer, VK_WHOLE_SIZE),
+        DescriptorAllocator::BufferDescriptor(nodeBuffer, VK_WHOLE_SIZE)
+      });
+    }
 
-      VkDescriptorBufferInfo perspectiveBufferInfo = {};
-      perspectiveBufferInfo.buffer = perspectiveUBO;
-      perspectiveBufferInfo.offset = 0;
-      perspectiveBufferInfo.range = sizeof(Components::Math::PerspectiveBufferObject);
-
-      VkDescriptorBufferInfo transformBufferInfo = {};
-      transformBufferInfo.buffer = transformUBO;
-      transformBufferInfo.offset = 0;
-      transformBufferInfo.range = sizeof(Components::Math::TransformBufferObject);
-
-      VkDescriptorBufferInfo pointLightBufferInfo = {};
-      pointLightBufferInfo.buffer = pointLightUBO;
-      pointLightBufferInfo.offset = 0;
-      pointLightBufferInfo.range = sizeof(Components::Lights::PointLightBufferObject);
-
-      VkDescriptorBufferInfo materialBufferInfo = {};
-      materialBufferInfo.buffer = materialUBO;
-      materialBufferInfo.offset = 0;
-      materialBufferInfo.range = sizeof(MaterialBufferObject);
-
-      /* Diffuse Image sampler */
-      VkDescriptorImageInfo diffuseImageInfo = {};
-      diffuseImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      diffuseImageInfo.imageView = diffuseImageView;
-      diffuseImageInfo.sampler = diffuseSampler;
-
-      /* Specular Image sampler */
-      VkDescriptorImageInfo specularImageInfo = {};
-      specularImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      specularImageInfo.imageView = specularImageView;
-      specularImageInfo.sampler = specularSampler;
-
-      /* Reflection Image sampler */
-      VkDescriptorImageInfo reflectionImageInfo = {};
-      reflectionImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      reflectionImageInfo.imageView = reflectionImageView;
-      reflectionImageInfo.sampler = reflectionSampler;
-
-      /* Voxel cone tracing volume */
-      VkDescriptorImageInfo voxelImageInfo = {};
-      voxelImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-      voxelImageInfo.imageView = voxelImageView;
-      voxelImageInfo.sampler = voxelSampler;
-
-      /* Shadowmap Image sampler */
-      VkDescriptorImageInfo shadowMapImageInfo = {};
-      shadowMapImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      shadowMapImageInfo.imageView = shadowMapImageView;
-      shadowMapImageInfo.sampler = shadowMapSampler;
-
-      std::array<VkWriteDescriptorSet, 9> descriptorWrites = {};
-
-      descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descriptorWrites[0].dstSet = descriptorSet;
-      descriptorWrites[0].dstBinding = 0;
-      descriptorWrites[0].dstArrayElement = 0;
-      descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      descriptorWrites[0].descriptorCount = 1;
-      descriptorWrites[0].pBufferInfo = &perspectiveBufferInfo;
-
-      descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descriptorWrites[1].dstSet = descriptorSet;
-      descriptorWrites[1].dstBinding = 1;
-      descriptorWrites[1].dstArrayElement = 0;
-      descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      descriptorWrites[1].descriptorCount = 1;
-      descriptorWrites[1].pBufferInfo = &transformBufferInfo;
-
-      descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descriptorWrites[2].dstSet = descriptorSet;
-      descriptorWrites[2].dstBinding = 2;
-      descriptorWrites[2].dstArrayElement = 0;
-      descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      descriptorWrites[2].descriptorCount = 1;
-      descriptorWrites[2].pBufferInfo = &pointLightBufferInfo;
-
-      descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descriptorWrites[3].dstSet = descriptorSet;
-      descriptorWrites[3].dstBinding = 3;
-      descriptorWrites[3].dstArrayElement = 0;
-      descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      descriptorWrites[3].descriptorCount = 1;
-      descriptorWrites[3].pBufferInfo = &materialBufferInfo;
-
-      descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descriptorWrites[4].dstSet = descriptorSet;
-      descriptorWrites[4].dstBinding = 4;
-      descriptorWrites[4].dstArrayElement = 0;
-      descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      descriptorWrites[4].descriptorCount = 1;
-      descriptorWrites[4].pImageInfo = &diffuseImageInfo;
-
-      descriptorWrites[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descriptorWrites[5].dstSet = descriptorSet;
-      descriptorWrites[5].dstBinding = 5;
-      descriptorWrites[5].dstArrayElement = 0;
-      descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      descriptorWrites[5].descriptorCount = 1;
-      descriptorWrites[5].pImageInfo = &specularImageInfo;
-
-      descriptorWrites[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descriptorWrites[6].dstSet = descriptorSet;
-      descriptorWrites[6].dstBinding = 6;
-      descriptorWrites[6].dstArrayElement = 0;
-      descriptorWrites[6].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      descriptorWrites[6].descriptorCount = 1;
-      descriptorWrites[6].pImageInfo = &reflectionImageInfo;
-
-      descriptorWrites[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descriptorWrites[7].dstSet = descriptorSet;
-      descriptorWrites[7].dstBinding = 7;
-      descriptorWrites[7].dstArrayElement = 0;
-      descriptorWrites[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      descriptorWrites[7].descriptorCount = 1;
-      descriptorWrites[7].pImageInfo = &voxelImageInfo;
-
-      descriptorWrites[8].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descriptorWrites[8].dstSet = descriptorSet;
-      descriptorWrites[8].dstBinding = 8;
-      descriptorWrites[8].dstArrayElement = 0;
-      descriptorWrites[8].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      descriptorWrites[8].descriptorCount = 1;
-      descriptorWrites[8].pImageInfo = &shadowMapImageInfo;
-
-      vkUpdateDescriptorSets(VKDK::device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-      return descriptorSet;
+    static VkDescriptorSet CreateBindlessDescriptorSet(size_t key,
+      VkBuffer materialUBO, VkBuffer perspectiveUBO, VkBuffer transformUBO, VkBuffer pointLightUBO,
+      VkBuffer instanceBuffer, VkBuffer nodeBuffer)
+    {
+      return getStaticProperties().descriptorAllocator->create(key, {
+        DescriptorAllocator::BufferDescriptor(perspectiveUBO, sizeof(Components::Math::PerspectiveBufferObject)),
+        DescriptorAllocator::BufferDescriptor(transformUBO, getTransformRange()),
+        DescriptorAllocator::BufferDescriptor(pointLightUBO, sizeof(Components::Lights::PointLightBufferObject)),
+        DescriptorAllocator::BufferDescriptor(materialUBO, sizeof(MaterialBufferObject)),
+        DescriptorAllocator::BufferDescriptor(instanceBuffer, VK_WHOLE_SIZE),
+        DescriptorAllocator::BufferDescriptor(nodeBuffer, VK_WHOLE_SIZE)
+      });
     }
 
     /* Note: one material instance per entity! Cleanup before destroying VKDK stuff */
@@ -221,6 +134,7 @@ namespace Components::Materials::Standard {
       mbo.useCubemapTexture = useReflectionTextureComponent;
       mbo.useShadowMap = useShadowMapTextureComponent;
       mbo.useGI = useGI;
+      if (bindlessTextures()) getTextureIndices(mbo);
 
       /* Map uniform buffer, copy data directly, then unmap */
       void* data;
@@ -229,14 +143,44 @@ namespace Components::Materials::Standard {
       vkUnmapMemory(VKDK::device, materialUBOMemory);
     }
 
+    std::vector<std::shared_ptr<Texture>> getTextures() {
+      std::vector<std::shared_ptr<Texture>> textures;
+      if (diffuseTextureComponent && useDiffuseTextureComponent) textures.push_back(diffuseTextureComponent);
+      if (specularTextureComponent && useSpecularTextureComponent) textures.push_back(specularTextureComponent);
+      if (reflectionTextureComponent && useReflectionTextureComponent) textures.push_back(reflectionTextureComponent);
+      if (shadowMapTextureComponent && useShadowMapTextureComponent) textures.push_back(shadowMapTextureComponent);
+      if (voxelTextureComponent && useGI) textures.push_back(voxelTextureComponent);
+      return textures;
+    }
+
     /* Returns a preexisting descriptor set, or creates a new one */
     VkDescriptorSet getDescriptorSet(UBOSet uboSet) {
+      /* With pushed transforms, every entity shares the transform table, so sets are per material and perspective */
+      if (pushedTransforms()) uboSet.transformUBO = Transform::GetTableBuffer();
+
+      /* The node pool is only read when the volume is an octree. Transform buffers are also storage buffers. */
+      auto octree = getOctree();
+      VkBuffer nodeBuffer = octree ? octree->getNodeBuffer() : uboSet.transformUBO;
+
+      /* Sets also hold the material's own UBO, which the transform no longer tells apart */
       size_t key = 0;
+      hash_combine(key, materialUBO);
       hash_combine(key, uboSet.transformUBO);
       hash_combine(key, uboSet.perspectiveUBO);
       hash_combine(key, uboSet.pointLightUBO);
+      hash_combine(key, uboSet.instanceBuffer);
+      hash_combine(key, nodeBuffer);
 
-      if (getStaticProperties().descriptorSets.find(key) == getStaticProperties().descriptorSets.end()) {
+      /* Bindless sets only hold buffers. Texture indices are looked up again with every UBO upload. */
+      if (!bindlessTextures()) hash_combine(key, getTexturesHash());
+
+      VkDescriptorSet descriptorSet = getStaticProperties().descriptorAllocator->find(key);
+      if (descriptorSet == VK_NULL_HANDLE && bindlessTextures()) {
+        descriptorSet = CreateBindlessDescriptorSet(key, materialUBO, uboSet.perspectiveUBO,
+          uboSet.transformUBO, uboSet.pointLightUBO,
+          (uboSet.instanceBuffer != VK_NULL_HANDLE) ? uboSet.instanceBuffer : uboSet.transformUBO, nodeBuffer);
+      }
+      else if (descriptorSet == VK_NULL_HANDLE) {
         VkSampler diffuseSampler, specularSampler, reflectionSampler, shadowMapSampler, voxelSampler;
         VkImageView diffuseImageView, specularImageView, reflectionImageView, shadowMapImageView, voxelImageView;
         auto missingTexture = Systems::ComponentManager::Textures["DefaultTexture"];
@@ -276,19 +220,48 @@ namespace Components::Materials::Standard {
           voxelImageView = voxelTextureComponent->texture->getColorImageView();
         }
 
-        getStaticProperties().descriptorSets[key] = CreateDescriptorSet(materialUBO, uboSet.perspectiveUBO,
+        descriptorSet = CreateDescriptorSet(key, materialUBO, uboSet.perspectiveUBO,
           uboSet.transformUBO, uboSet.pointLightUBO, diffuseImageView, diffuseSampler,
           specularImageView, specularSampler, reflectionImageView, reflectionSampler,
-          shadowMapImageView, shadowMapSampler, voxelSampler, voxelImageView);
-        return getStaticProperties().descriptorSets[key];
+          shadowMapImageView, shadowMapSampler, voxelSampler, voxelImageView,
+          (uboSet.instanceBuffer != VK_NULL_HANDLE) ? uboSet.instanceBuffer : uboSet.transformUBO, nodeBuffer);
       }
-      else return getStaticProperties().descriptorSets[key];
+      return descriptorSet;
     }
 
-    void render(PipelineKey pipelineKey, VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, std::shared_ptr<Mesh> meshComponent) {
+    bool supportsInstancing(PipelineKey pipelineKey) {
+      return hasPipelines(*getPipelines(true));
+    }
+
+    /* Each combination of enabled features has its own specialized pipelines, so disabled features cost nothing.
+      The lookup takes the global pipeline mutex, so its result is kept until the features change. */
+    std::unordered_map<PipelineKey, VkPipeline> *getPipelines(bool instanced = false) {
+      auto &properties = getStaticProperties();
+      if (!specialized || specializedGeneration != properties.specializationGeneration) {
+        specialized = &getSpecializedPipelines(properties, getSpecializationConstants());
+        specializedGeneration = properties.specializationGeneration;
+      }
+      return instanced ? &specialized->instancedPipelines : &specialized->pipelines;
+    }
+
+    /* Binds the texture table once per pipeline change instead of binding textures per draw */
+    void bindSharedDescriptors(PipelineKey pipelineKey, VkCommandBuffer commandBuffer) {
+      if (bindlessTextures()) Textures::TextureTable::Bind(commandBuffer, getStaticProperties().pipelineLayout);
+
+      /* Another material might have bound its own sets since the last Blinn draw */
+      lastBoundSet() = { commandBuffer, VK_NULL_HANDLE };
+    }
+
+    void render(PipelineKey pipelineKey, VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, std::shared_ptr<Mesh> meshComponent, DrawInfo drawInfo) {
 
       /* Look up the pipeline cooresponding to this render pass */
-      VkPipeline pipeline = getStaticProperties().pipelines[pipelineKey];
+      VkPipeline pipeline = getPipeline(*getPipelines(drawInfo.instanced), pipelineKey);
+
+      /* Still compiling. The perspective re-records once it's ready. */
+      if (pipeline == VK_NULL_HANDLE) return;
+
+      /* Transforms created before the transform table have no slot in it, and would read another entity's transform */
+      if (pushedTransforms() && !drawInfo.instanced && drawInfo.transformIndex == ~0u) return;
 
       /* Bind the pipeline for this material */
       vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
@@ -298,7 +271,6 @@ namespace Components::Materials::Standard {
       VkBuffer normalBuffer = meshComponent->mesh->getNormalBuffer();
       VkBuffer texcoordBuffer = meshComponent->mesh->getTexCoordBuffer();
       VkBuffer indexBuffer = meshComponent->mesh->getIndexBuffer();
-      uint32_t totalIndices = meshComponent->mesh->getTotalIndices();
 
       VkBuffer vertexBuffers[] = { vertexBuffer, normalBuffer, texcoordBuffer };
       VkDeviceSize offsets[] = { 0 , 0, 0 };
@@ -307,12 +279,21 @@ namespace Components::Materials::Standard {
 
       vkCmdBindVertexBuffers(commandBuffer, 0, 3, vertexBuffers, offsets);
       vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
-      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-        getStaticProperties().pipelineLayout, 0, 1,
-        &descriptorSet, 0, nullptr);
+
+      /* Consecutive draws of the same material share a set when transforms are pushed, so only bind when it changes.
+        In bindless mode, set 0 is the texture table, which is already bound. */
+      auto &bound = lastBoundSet();
+      if (bound.first != commandBuffer || bound.second != descriptorSet) {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+          getStaticProperties().pipelineLayout, bindlessTextures() ? 1 : 0, 1,
+          &descriptorSet, 0, nullptr);
+        bound = { commandBuffer, descriptorSet };
+      }
+
+      if (pushedTransforms()) pushDrawConstants(commandBuffer, getStaticProperties().pipelineLayout, drawInfo);
 
       /* Draw elements indexed */
-      vkCmdDrawIndexed(commandBuffer, totalIndices, 1, 0, 0, 0);
+      draw(commandBuffer, meshComponent, drawInfo);
     }
 
     void setColor(
@@ -327,23 +308,30 @@ namespace Components::Materials::Standard {
       this->kr = kr;
     }
 
+    /* Changing which features are used switches this material to another specialized pipeline */
     void useDiffuseTexture(bool useTexture) {
       this->useDiffuseTextureComponent = useTexture;
+      featuresChanged();
     }
     void useSpecularTexture(bool useTexture) {
       this->useSpecularTextureComponent = useTexture;
+      featuresChanged();
     }
     void useCubemapTexture(bool useTexture) {
       this->useReflectionTextureComponent = useTexture;
+      featuresChanged();
     }
     void useShadowMapTexture(bool useTexture) {
       this->useShadowMapTextureComponent = useTexture;
+      featuresChanged();
     }
     void useGlobalIllumination(bool useGI) {
       this->useGI = useGI;
+      featuresChanged();
     }
     void useRoughness(bool useRoughnessLod) {
       this->useRoughnessLod = useRoughnessLod;
+      featuresChanged();
     }
 
     void setDiffuseTexture(std::shared_ptr<Components::Textures::Texture> texture) {
@@ -361,8 +349,10 @@ namespace Components::Materials::Standard {
     void setRoughness(float roughness) {
       this->roughness = roughness;
     }
+    /* The volume is either a dense Texture3D, or a SparseVoxelOctree traced with its own specialized pipeline */
     void setGlobalIlluminationVolume(std::shared_ptr<Components::Textures::Texture> texture) {
       this->voxelTextureComponent = texture;
+      featuresChanged();
     }
 
   private:
@@ -378,8 +368,111 @@ namespace Components::Materials::Standard {
       uint32_t useCubemapTexture;
       uint32_t useGI;
       uint32_t useShadowMap;
+
+      /* Texture table indices, only read by the bindless shaders */
+      uint32_t diffuseIndex;
+      uint32_t specularIndex;
+      uint32_t cubemapIndex;
+      uint32_t volumeIndex;
+      uint32_t shadowMapIndex;
     };
 
+    /* The specialized pipelines for the current features, and the properties' generation they were looked up in */
+    MaterialProperties::SpecializedPipelines *specialized = nullptr;
+    uint32_t specializedGeneration = 0;
+
+    static bool &bindlessTextures() {
+      static bool bindless = false;
+      return bindless;
+    }
+
+    static bool &pushedTransforms() {
+      static bool pushed = false;
+      return pushed;
+    }
+
+    /* The per draw set last bound on this thread's command buffer */
+    static std::pair<VkCommandBuffer, VkDescriptorSet> &lastBoundSet() {
+      static thread_local std::pair<VkCommandBuffer, VkDescriptorSet> bound = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+      return bound;
+    }
+
+    /* Shader variants are prefixed by the features they were built with, e.g. bindless_pushed_vert.spv */
+    static std::string getShaderPath(std::string name, bool bindless, bool pushed) {
+      return std::string(ResourcePath "MaterialShaders/Standard/Blinn/")
+        + (bindless ? "bindless_" : "") + (pushed ? "pushed_" : "") + name + ".spv";
+    }
+
+    /* Values for the feature specialization constants of shader.frag, in constant_id order. Roughness only
+      matters with a cubemap, and the octree only with GI, so they're dropped without them to share pipelines
+      with identical results. */
+    std::vector<uint32_t> getSpecializationConstants() {
+      auto octree = useGI ? getOctree() : nullptr;
+      return {
+        useDiffuseTextureComponent,
+        useSpecularTextureComponent,
+        useReflectionTextureComponent,
+        useGI,
+        useShadowMapTextureComponent,
+        useReflectionTextureComponent && useRoughnessLod,
+        octree != nullptr,
+        octree ? octree->getMaxDepth() : 1u };
+    }
+
+    std::shared_ptr<SparseVoxelOctree> getOctree() {
+      if (!voxelTextureComponent) return nullptr;
+      return std::dynamic_pointer_cast<SparseVoxelOctree>(voxelTextureComponent->texture);
+    }
+
+    /* The new pipelines are requested by the next draw, like any other */
+    void featuresChanged() {
+      specialized = nullptr;
+      Systems::SceneGraph::MarkDirty(pipelineKey.renderpass);
+    }
+
+    /* Variants are compiled at runtime from the same sources, with the features passed as defines.
+      The instanced vertex shader is shader.vert built with INSTANCED. */
+    static std::string getShaderSource(std::string name) {
+      return std::string(ResourcePath "MaterialShaders/Standard/Blinn/shader.")
+        + ((name == "instanced_vert") ? "vert" : name);
+    }
+
+    static bool hasShader(std::string name, bool bindless, bool pushed) {
+      return ShaderModules::CanLoad(getShaderSource(name), getShaderPath(name, bindless, pushed));
+    }
+
+    static std::shared_future<VkShaderModule> loadShader(std::string name, VkShaderStageFlagBits stage, bool bindless, bool pushed) {
+      std::vector<std::string> defines;
+      if (bindless) defines.push_back("BINDLESS");
+      if (pushed) defines.push_back("PUSHED_TRANSFORMS");
+      if (name == "instanced_vert") defines.push_back("INSTANCED");
+      return ShaderModules::GetAsync(getShaderSource(name), stage, defines, getShaderPath(name, bindless, pushed));
+    }
+
+    /* A single transform, or the whole transform table */
+    static VkDeviceSize getTransformRange() {
+      return pushedTransforms() ? VK_WHOLE_SIZE : sizeof(Components::Math::TransformBufferObject);
+    }
+
+    /* Mirrors the fallbacks used for per draw texture descriptors */
+    void getTextureIndices(MaterialBufferObject &mbo) {
+      using Textures::TextureTable;
+      auto missingTexture = TextureTable::GetColorIndex(Systems::ComponentManager::Textures["DefaultTexture"]);
+      auto missingCubemap = TextureTable::GetColorIndex(Systems::ComponentManager::Textures["DefaultTextureCube"]);
+      auto missingVolume = TextureTable::GetColorIndex(Systems::ComponentManager::Textures["DefaultTexture3D"], VK_IMAGE_LAYOUT_GENERAL);
+
+      mbo.diffuseIndex = (diffuseTextureComponent && useDiffuseTextureComponent)
+        ? TextureTable::GetColorIndex(diffuseTextureComponent) : missingTexture;
+      mbo.specularIndex = (specularTextureComponent && useSpecularTextureComponent)
+        ? TextureTable::GetColorIndex(specularTextureComponent) : missingTexture;
+      mbo.cubemapIndex = (reflectionTextureComponent && useReflectionTextureComponent)
+        ? TextureTable::GetColorIndex(reflectionTextureComponent) : missingCubemap;
+      mbo.shadowMapIndex = (shadowMapTextureComponent && useShadowMapTextureComponent)
+        ? TextureTable::GetDepthIndex(shadowMapTextureComponent) : missingCubemap;
+      mbo.volumeIndex = (voxelTextureComponent && useGI)
+        ? TextureTable::GetColorIndex(voxelTextureComponent, VK_IMAGE_LAYOUT_GENERAL) : missingVolume;
+    }
+
     /* A descriptor set layout describes how uniforms are used in the pipeline */
     static void createDescriptorSetLayout() {
       VkDescriptorSetLayoutBinding perspectiveLayoutBinding = {};
@@ -450,10 +543,35 @@ namespace Components::Materials::Standard {
       shadowMapTextureLayoutBinding.pImmutableSamplers = nullptr;
       shadowMapTextureLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-      std::array<VkDescriptorSetLayoutBinding, 9> bindings = {
+      /* Instance transforms */
+      VkDescriptorSetLayoutBinding instanceLayoutBinding = {};
+      instanceLayoutBinding.binding = 9;
+      instanceLayoutBinding.descriptorCount = 1;
+      instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      instanceLayoutBinding.pImmutableSamplers = nullptr;
+      instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+      /* Sparse voxel octree node pool, a buffer so it stays in the per draw set in bindless mode */
+      VkDescriptorSetLayoutBinding nodePoolLayoutBinding = {};
+      nodePoolLayoutBinding.binding = 10;
+      nodePoolLayoutBinding.descriptorCount = 1;
+      nodePoolLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      nodePoolLayoutBinding.pImmutableSamplers = nullptr;
+      nodePoolLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+      /* Pushed transforms index into the transform table, a storage buffer */
+      if (pushedTransforms()) transformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+      std::vector<VkDescriptorSetLayoutBinding> bindings = {
         perspectiveLayoutBinding, transformLayoutBinding, pointLightLayoutBinding, materialLayoutBinding,
         diffuseTextureLayoutBinding, specularTextureLayoutBinding, cubemapTextureLayoutBinding,
-        voxelTextureLayoutBinding, shadowMapTextureLayoutBinding };
+        voxelTextureLayoutBinding, shadowMapTextureLayoutBinding, instanceLayoutBinding, nodePoolLayoutBinding };
+
+      /* Bindless textures come from the texture table, so only buffers remain */
+      if (bindlessTextures()) {
+        bindings = { perspectiveLayoutBinding, transformLayoutBinding, pointLightLayoutBinding,
+          materialLayoutBinding, instanceLayoutBinding, nodePoolLayoutBinding };
+      }
 
       VkDescriptorSetLayoutCreateInfo layoutInfo = {};
       layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -463,73 +581,58 @@ namespace Components::Materials::Standard {
       if (vkCreateDescriptorSetLayout(VKDK::device, &layoutInfo, nullptr, &getStaticProperties().descriptorSetLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create BlinnSurface descriptor set layout!");
       }
-    }
 
-    static void createDescriptorPool() {
-      std::array<VkDescriptorPoolSize, 9> poolSizes = {};
-      poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      poolSizes[0].descriptorCount = getStaticProperties().maxDescriptorSets;
-      poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      poolSizes[1].descriptorCount = getStaticProperties().maxDescriptorSets;
-      poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      poolSizes[2].descriptorCount = getStaticProperties().maxDescriptorSets;
-      poolSizes[3].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      poolSizes[3].descriptorCount = getStaticProperties().maxDescriptorSets;
-      poolSizes[4].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      poolSizes[4].descriptorCount = getStaticProperties().maxDescriptorSets;
-      poolSizes[5].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      poolSizes[5].descriptorCount = getStaticProperties().maxDescriptorSets;
-      poolSizes[6].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      poolSizes[6].descriptorCount = getStaticProperties().maxDescriptorSets;
-      poolSizes[7].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      poolSizes[7].descriptorCount = getStaticProperties().maxDescriptorSets;
-      poolSizes[8].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      poolSizes[8].descriptorCount = getStaticProperties().maxDescriptorSets;
-
-      VkDescriptorPoolCreateInfo poolInfo = {};
-      poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-      poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-      poolInfo.pPoolSizes = poolSizes.data();
-      poolInfo.maxSets = getStaticProperties().maxDescriptorSets;
-      poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-
-      if (vkCreateDescriptorPool(VKDK::device, &poolInfo, nullptr, &getStaticProperties().descriptorPool) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create Blinn descriptor pool!");
-      }
+      getStaticProperties().descriptorAllocator = std::make_shared<DescriptorAllocator>(getStaticProperties().descriptorSetLayout,
+        bindings, getStaticProperties().maxDescriptorSets);
     }
 
     static void setupGraphicsPipeline() {
-      /* Read in shader modules */
-      auto vertShaderCode = readFile(ResourcePath "MaterialShaders/Standard/Blinn/vert.spv");
-      auto fragShaderCode = readFile(ResourcePath "MaterialShaders/Standard/Blinn/frag.spv");
+      bool bindless = bindlessTextures();
+      bool pushed = pushedTransforms();
 
-      /* Create shader modules */
-      auto vertShaderModule = createShaderModule(vertShaderCode);
-      auto fragShaderModule = createShaderModule(fragShaderCode);
+      /* Compile shader modules in parallel from source, or fall back to the precompiled SPIR-V */
+      auto vertShaderModule = loadShader("vert", VK_SHADER_STAGE_VERTEX_BIT, bindless, pushed);
+      auto fragShaderModule = loadShader("frag", VK_SHADER_STAGE_FRAGMENT_BIT, bindless, pushed);
+      bool instanced = hasShader("instanced_vert", bindless, false);
+      std::shared_future<VkShaderModule> instancedVertShaderModule;
+      if (instanced) instancedVertShaderModule = loadShader("instanced_vert", VK_SHADER_STAGE_VERTEX_BIT, bindless, false);
 
       /* Info for shader stages */
       VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
       vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
       vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-      vertShaderStageInfo.module = vertShaderModule;
+      vertShaderStageInfo.module = vertShaderModule.get();
       vertShaderStageInfo.pName = "main";
 
       VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
       fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
       fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-      fragShaderStageInfo.module = fragShaderModule;
+      fragShaderStageInfo.module = fragShaderModule.get();
       fragShaderStageInfo.pName = "main";
 
       std::vector<VkPipelineShaderStageCreateInfo> shaderStages = { vertShaderStageInfo, fragShaderStageInfo };
       std::vector<VkPipeline> newPipelines;
       std::vector<VkPipelineLayout> newLayouts;
 
-      createPipelines(shaderStages, getBindingDescriptions(),
-        getAttributeDescriptions(), { getStaticProperties().descriptorSetLayout },
-        getStaticProperties().pipelines, getStaticProperties().pipelineLayout);
+      /* Set 0 is the texture table in bindless mode, followed by the per draw set */
+      std::vector<VkDescriptorSetLayout> setLayouts = { getStaticProperties().descriptorSetLayout };
+      if (bindless) setLayouts.insert(setLayouts.begin(), Textures::TextureTable::GetDescriptorSetLayout());
+
+      std::vector<VkPushConstantRange> pushConstantRanges;
+      if (pushed) pushConstantRanges.push_back(getDrawConstantsRange());
 
-      vkDestroyShaderModule(VKDK::device, fragShaderModule, nullptr);
-      vkDestroyShaderModule(VKDK::device, vertShaderModule, nullptr);
+      createPipelines(shaderStages, getBindingDescriptions(),
+        getAttributeDescriptions(), setLayouts,
+        getStaticProperties().pipelines, getStaticProperties().pipelineLayout, true, pushConstantRanges);
+
+      /* The instanced variant only replaces the vertex shader, and shares the pipeline layout. Instances already
+        read their transforms from the instance buffer, so there's no pushed variant. */
+      if (instanced) {
+        shaderStages[0].module = instancedVertShaderModule.get();
+        createPipelines(shaderStages, getBindingDescriptions(),
+          getAttributeDescriptions(), setLayouts,
+          getStaticProperties().instancedPipelines, getStaticProperties().pipelineLayout, false, pushConstantRanges);
+      }
     }
 
     static std::vector<VkVertexInputBindingDescription> getBindingDescriptions() {
@@ -21,13 +21,13 @@ namespace Components::Materials::Standard {
 			auto shadow = std::make_shared<Shadow>(pipelineKey);
 			material->material = shadow;
 			Systems::ComponentManager::Materials[name] = material;
+			shadow->requestPipelines();
 			return shadow;
 		}
 
 		static void Initialize(int maxDescriptorSets) {
 			getStaticProperties().maxDescriptorSets = maxDescriptorSets;
 			createDescriptorSetLayout();
-			createDescriptorPool();
 			setupGraphicsPipeline();
 		}
 
@@ -36,6 +36,10 @@ namespace Components::Materials::Standard {
 			return properties;
 		}
 
+		MaterialProperties *getProperties() {
+			return &getStaticProperties();
+		}
+
 		static void Destroy() {
 			MaterialInterface::Destroy(getStaticProperties());
 		}
@@ -45,82 +49,16 @@ namespace Components::Materials::Standard {
 			setupGraphicsPipeline();
 		}
 		
-		static VkDescriptorSet CreateDescriptorSet(VkBuffer materialUBO, VkBuffer perspectiveUBO, VkBuffer transformUBO, 
-			VkImageView imageView, VkSampler sampler) 
+		static VkDescriptorSet CreateDescriptorSet(size_t key, VkBuffer materialUBO, VkBuffer perspectiveUBO, VkBuffer transformUBO, 
+			VkImageView imageView, VkSampler sampler, VkBuffer instanceBuffer) 
 		{
-			VkDescriptorSet descriptorSet;
-
-			VkDescriptorSetLayout layouts[] = { getStaticProperties().descriptorSetLayout };
-			VkDescriptorSetAllocateInfo allocInfo = {};
-			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-			allocInfo.descriptorPool = getStaticProperties().descriptorPool;
-			allocInfo.descriptorSetCount = 1;
-			allocInfo.pSetLayouts = layouts;
-
-			auto error = vkAllocateDescriptorSets(VKDK::device, &allocInfo, &descriptorSet);
-			if (error != VK_SUCCESS) {
-				std::cout << "failed to allocate descriptor set! " + error << std::endl;
-				throw std::runtime_error("failed to allocate descriptor set! " + error);
-			}
-
-			VkDescriptorBufferInfo perspectiveBufferInfo = {};
-			perspectiveBufferInfo.buffer = perspectiveUBO;
-			perspectiveBufferInfo.offset = 0;
-			perspectiveBufferInfo.range = sizeof(Components::Math::PerspectiveBufferObject);
-
-			VkDescriptorBufferInfo transformBufferInfo = {};
-			transformBufferInfo.buffer = transformUBO;
-			transformBufferInfo.offset = 0;
-			transformBufferInfo.range = sizeof(Components::Math::TransformBufferObject);
-
-			VkDescriptorBufferInfo materialBufferInfo = {};
-			materialBufferInfo.buffer = materialUBO;
-			materialBufferInfo.offset = 0;
-			materialBufferInfo.range = sizeof(MaterialBufferObject);
-
-			/* Image sampler */
-			VkDescriptorImageInfo imageInfo = {};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = imageView;
-			imageInfo.sampler = sampler;
-
-			std::array<VkWriteDescriptorSet, 4> descriptorWrites = {};
-
-			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[0].dstSet = descriptorSet;
-			descriptorWrites[0].dstBinding = 0;
-			descriptorWrites[0].dstArrayElement = 0;
-			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[0].descriptorCount = 1;
-			descriptorWrites[0].pBufferInfo = &perspectiveBufferInfo;
-
-			descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[1].dstSet = descriptorSet;
-			descriptorWrites[1].dstBinding = 1;
-			descriptorWrites[1].dstArrayElement = 0;
-			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[1].descriptorCount = 1;
-			descriptorWrites[1].pBufferInfo = &transformBufferInfo;
-
-			descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[2].dstSet = descriptorSet;
-			descriptorWrites[2].dstBinding = 2;
-			descriptorWrites[2].dstArrayElement = 0;
-			descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[2].descriptorCount = 1;
-			descriptorWrites[2].pBufferInfo = &materialBufferInfo;
-
-			descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[3].dstSet = descriptorSet;
-			descriptorWrites[3].dstBinding = 3;
-			descriptorWrites[3].dstArrayElement = 0;
-			descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrites[3].descriptorCount = 1;
-			descriptorWrites[3].pImageInfo = &imageInfo;
-
-			vkUpdateDescriptorSets(VKDK::device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-
-			return descriptorSet;
+			return getStaticProperties().descriptorAllocator->create(key, {
+				DescriptorAllocator::BufferDescriptor(perspectiveUBO, sizeof(Components::Math::PerspectiveBufferObject)),
+				DescriptorAllocator::BufferDescriptor(transformUBO, sizeof(Components::Math::TransformBufferObject)),
+				DescriptorAllocator::BufferDescriptor(materialUBO, sizeof(MaterialBufferObject)),
+				DescriptorAllocator::ImageDescriptor(imageView, sampler),
+				DescriptorAllocator::BufferDescriptor(instanceBuffer, VK_WHOLE_SIZE)
+			});
 		}
 		
 		Shadow(PipelineKey pipelineKey) {
@@ -142,13 +80,21 @@ namespace Components::Materials::Standard {
 			vkUnmapMemory(VKDK::device, materialUBOMemory);
 		}
 
+		std::vector<std::shared_ptr<Components::Textures::Texture>> getTextures() {
+			if (textureComponent && useTextureComponent) return { textureComponent };
+			return {};
+		}
+
 		/* Returns a preexisting descriptor set, or creates a new one */
 		VkDescriptorSet getDescriptorSet(UBOSet uboSet) {
 			size_t key = 0;
 			hash_combine(key, uboSet.transformUBO);
 			hash_combine(key, uboSet.perspectiveUBO);
+			hash_combine(key, uboSet.instanceBuffer);
+			hash_combine(key, getTexturesHash());
 			
-			if (getStaticProperties().descriptorSets.find(key) == getStaticProperties().descriptorSets.end()) {
+			VkDescriptorSet descriptorSet = getStaticProperties().descriptorAllocator->find(key);
+			if (descriptorSet == VK_NULL_HANDLE) {
 				auto missingTexture = Systems::ComponentManager::Textures["DefaultTexture"]; 
 				VkSampler sampler = missingTexture->texture->getColorSampler();
 				VkImageView imageView = missingTexture->texture->getColorImageView();
@@ -158,17 +104,26 @@ namespace Components::Materials::Standard {
 					imageView = textureComponent->texture->getColorImageView();
 				}
 
-				getStaticProperties().descriptorSets[key] = CreateDescriptorSet(materialUBO, uboSet.perspectiveUBO, 
-					uboSet.transformUBO, imageView, sampler);
-				return getStaticProperties().descriptorSets[key];
+				descriptorSet = CreateDescriptorSet(key, materialUBO, uboSet.perspectiveUBO, 
+					uboSet.transformUBO, imageView, sampler,
+					(uboSet.instanceBuffer != VK_NULL_HANDLE) ? uboSet.instanceBuffer : uboSet.transformUBO);
 			}
-			else return getStaticProperties().descriptorSets[key];
+			return descriptorSet;
 		}
 
-		void render(PipelineKey pipelineKey, VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, std::shared_ptr<Mesh> meshComponent) 
+		bool supportsInstancing(PipelineKey pipelineKey) {
+			return hasPipelines(getStaticProperties().instancedPipelines);
+		}
+
+		void render(PipelineKey pipelineKey, VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, std::shared_ptr<Mesh> meshComponent, DrawInfo drawInfo) 
 		{
 			/* Look up the pipeline cooresponding to this render pass */
-			VkPipeline pipeline = getStaticProperties().pipelines[pipelineKey];
+			VkPipeline pipeline = (drawInfo.instanced)
+				? getPipeline(getStaticProperties().instancedPipelines, pipelineKey)
+				: getPipeline(getStaticProperties().pipelines, pipelineKey);
+
+			/* Still compiling. The perspective re-records once it's ready. */
+			if (pipeline == VK_NULL_HANDLE) return;
 
 			/* Bind the pipeline for this material */
 			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
@@ -177,7 +132,6 @@ namespace Components::Materials::Standard {
 			VkBuffer vertexBuffer = meshComponent->mesh->getVertexBuffer();
 			VkBuffer texCoordBuffer = meshComponent->mesh->getTexCoordBuffer();
 			VkBuffer indexBuffer = meshComponent->mesh->getIndexBuffer();
-			uint32_t totalIndices = meshComponent->mesh->getTotalIndices();
 
 			VkBuffer vertexBuffers[] = { vertexBuffer, texCoordBuffer };
 			VkDeviceSize offsets[] = { 0, 0 };
@@ -190,7 +144,7 @@ namespace Components::Materials::Standard {
 				0, 1, &descriptorSet, 0, nullptr);
 
 			/* Draw elements indexed */
-			vkCmdDrawIndexed(commandBuffer, totalIndices, 1, 0, 0, 0);
+			draw(commandBuffer, meshComponent, drawInfo);
 		}
 
 		void setColor(glm::vec4 color) {
@@ -243,7 +197,15 @@ namespace Components::Materials::Standard {
 			textureLayoutBinding.pImmutableSamplers = nullptr;
 			textureLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
-			std::array<VkDescriptorSetLayoutBinding, 4> bindings = { pboLayoutBinding, tboLayoutBinding, mboLayoutBinding, textureLayoutBinding };
+			/* Instance transforms */
+			VkDescriptorSetLayoutBinding instanceLayoutBinding = {};
+			instanceLayoutBinding.binding = 4;
+			instanceLayoutBinding.descriptorCount = 1;
+			instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			instanceLayoutBinding.pImmutableSamplers = nullptr;
+			instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+			std::array<VkDescriptorSetLayoutBinding, 5> bindings = { pboLayoutBinding, tboLayoutBinding, mboLayoutBinding, textureLayoutBinding, instanceLayoutBinding };
 			VkDescriptorSetLayoutCreateInfo layoutInfo = {};
 			layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 			layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
@@ -252,51 +214,29 @@ namespace Components::Materials::Standard {
 			if (vkCreateDescriptorSetLayout(VKDK::device, &layoutInfo, nullptr, &getStaticProperties().descriptorSetLayout) != VK_SUCCESS) {
 				throw std::runtime_error("failed to create ShadowedPoints descriptor set layout!");
 			}
-		}
 
-		static void createDescriptorPool() {
-			std::array<VkDescriptorPoolSize, 4> poolSizes = {};
-			poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			poolSizes[0].descriptorCount = getStaticProperties().maxDescriptorSets;
-			poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			poolSizes[1].descriptorCount = getStaticProperties().maxDescriptorSets;
-			poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			poolSizes[2].descriptorCount = getStaticProperties().maxDescriptorSets;
-			poolSizes[3].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			poolSizes[3].descriptorCount = getStaticProperties().maxDescriptorSets;
-
-			VkDescriptorPoolCreateInfo poolInfo = {};
-			poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-			poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-			poolInfo.pPoolSizes = poolSizes.data();
-			poolInfo.maxSets = getStaticProperties().maxDescriptorSets;
-			poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-
-			if (vkCreateDescriptorPool(VKDK::device, &poolInfo, nullptr, &getStaticProperties().descriptorPool) != VK_SUCCESS) {
-				throw std::runtime_error("failed to create Uniform Colored Points descriptor pool!");
-			}
+			getStaticProperties().descriptorAllocator = std::make_shared<DescriptorAllocator>(getStaticProperties().descriptorSetLayout,
+				std::vector<VkDescriptorSetLayoutBinding>(bindings.begin(), bindings.end()), getStaticProperties().maxDescriptorSets);
 		}
 
 		static void setupGraphicsPipeline() {
-			/* Read in shader modules */
-			auto vertShaderCode = readFile(ResourcePath "MaterialShaders/Standard/Shadow/vert.spv");
-			auto fragShaderCode = readFile(ResourcePath "MaterialShaders/Standard/Shadow/frag.spv");
-
-			/* Create shader modules */
-			auto vertShaderModule = createShaderModule(vertShaderCode);
-			auto fragShaderModule = createShaderModule(fragShaderCode);
+			/* Compile shader modules in parallel from source, or fall back to the precompiled SPIR-V */
+			auto vertShaderModule = ShaderModules::GetAsync(ResourcePath "MaterialShaders/Standard/Shadow/shader.vert", VK_SHADER_STAGE_VERTEX_BIT,
+				{}, ResourcePath "MaterialShaders/Standard/Shadow/vert.spv");
+			auto fragShaderModule = ShaderModules::GetAsync(ResourcePath "MaterialShaders/Standard/Shadow/shader.frag", VK_SHADER_STAGE_FRAGMENT_BIT,
+				{}, ResourcePath "MaterialShaders/Standard/Shadow/frag.spv");
 
 			/* Info for shader stages */
 			VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
 			vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 			vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-			vertShaderStageInfo.module = vertShaderModule;
+			vertShaderStageInfo.module = vertShaderModule.get();
 			vertShaderStageInfo.pName = "main"; // entry point here? would be nice to combine shaders into one file
 
 			VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
 			fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 			fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-			fragShaderStageInfo.module = fragShaderModule;
+			fragShaderStageInfo.module = fragShaderModule.get();
 			fragShaderStageInfo.pName = "main";
 
 			std::vector<VkPipelineShaderStageCreateInfo> shaderStages = { vertShaderStageInfo, fragShaderStageInfo };
@@ -305,8 +245,14 @@ namespace Components::Materials::Standard {
 				getAttributeDescriptions(), { getStaticProperties().descriptorSetLayout },
 				getStaticProperties().pipelines, getStaticProperties().pipelineLayout);
 
-			vkDestroyShaderModule(VKDK::device, fragShaderModule, nullptr);
-			vkDestroyShaderModule(VKDK::device, vertShaderModule, nullptr);
+			/* The instanced variant only replaces the vertex shader, built from the same source, and shares the pipeline layout */
+			if (ShaderModules::CanLoad(ResourcePath "MaterialShaders/Standard/Shadow/shader.vert", ResourcePath "MaterialShaders/Standard/Shadow/instanced_vert.spv")) {
+				shaderStages[0].module = ShaderModules::Get(ResourcePath "MaterialShaders/Standard/Shadow/shader.vert", VK_SHADER_STAGE_VERTEX_BIT,
+					{ "INSTANCED" }, ResourcePath "MaterialShaders/Standard/Shadow/instanced_vert.spv");
+				createPipelines(shaderStages, getBindingDescriptions(), 
+					getAttributeDescriptions(), { getStaticProperties().descriptorSetLayout },
+					getStaticProperties().instancedPipelines, getStaticProperties().pipelineLayout, false);
+			}
 		}
 
 		static std::vector<VkVertexInputBindingDescription> getBindingDescriptions() {
@@ -26,13 +26,13 @@ namespace Components::Materials::Volume {
 			RaycastMat->texture3DComponent = texture;
 			material->material = RaycastMat;
 			Systems::ComponentManager::Materials[name] = material;
+			RaycastMat->requestPipelines();
 			return RaycastMat;
 		}
 
 		static void Initialize(int maxDescriptorSets) {
 			getStaticProperties().maxDescriptorSets = maxDescriptorSets;
 			createDescriptorSetLayout();
-			createDescriptorPool();
 			setupGraphicsPipeline();
 		}
 
@@ -41,6 +41,10 @@ namespace Components::Materials::Volume {
 			return properties;
 		}
 
+		MaterialProperties *getProperties() {
+			return &getStaticProperties();
+		}
+
 		static void Destroy() {
 			MaterialInterface::Destroy(getStaticProperties());
 		}
@@ -51,79 +55,14 @@ namespace Components::Materials::Volume {
 			setupGraphicsPipeline();
 		}
 
-		static VkDescriptorSet CreateDescriptorSet(VkBuffer materialUBO, VkBuffer perspectiveUBO, VkBuffer transformUBO,
+		static VkDescriptorSet CreateDescriptorSet(size_t key, VkBuffer materialUBO, VkBuffer perspectiveUBO, VkBuffer transformUBO,
 			VkImageView imageView, VkSampler sampler) {
-			VkDescriptorSet descriptorSet;
-
-			VkDescriptorSetLayout layouts[] = { getStaticProperties().descriptorSetLayout };
-			VkDescriptorSetAllocateInfo allocInfo = {};
-			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-			allocInfo.descriptorPool = getStaticProperties().descriptorPool;
-			allocInfo.descriptorSetCount = 1;
-			allocInfo.pSetLayouts = layouts;
-
-			auto error = vkAllocateDescriptorSets(VKDK::device, &allocInfo, &descriptorSet);
-			if (error != VK_SUCCESS) {
-				throw std::runtime_error("failed to allocate descriptor set! " + error);
-			}
-
-			VkDescriptorBufferInfo perspectiveBufferInfo = {};
-			perspectiveBufferInfo.buffer = perspectiveUBO;
-			perspectiveBufferInfo.offset = 0;
-			perspectiveBufferInfo.range = sizeof(Components::Math::PerspectiveBufferObject);
-
-			VkDescriptorBufferInfo transformBufferInfo = {};
-			transformBufferInfo.buffer = transformUBO;
-			transformBufferInfo.offset = 0;
-			transformBufferInfo.range = sizeof(Components::Math::TransformBufferObject);
-
-			VkDescriptorBufferInfo materialBufferInfo = {};
-			materialBufferInfo.buffer = materialUBO;
-			materialBufferInfo.offset = 0;
-			materialBufferInfo.range = sizeof(MaterialBufferObject);
-
-			/* Tex3D sampler */
-			VkDescriptorImageInfo imageInfo = {};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-			imageInfo.imageView = imageView;
-			imageInfo.sampler = sampler;
-
-			std::array<VkWriteDescriptorSet, 4> descriptorWrites = {};
-
-			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[0].dstSet = descriptorSet;
-			descriptorWrites[0].dstBinding = 0;
-			descriptorWrites[0].dstArrayElement = 0;
-			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[0].descriptorCount = 1;
-			descriptorWrites[0].pBufferInfo = &perspectiveBufferInfo;
-
-			descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[1].dstSet = descriptorSet;
-			descriptorWrites[1].dstBinding = 1;
-			descriptorWrites[1].dstArrayElement = 0;
-			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[1].descriptorCount = 1;
-			descriptorWrites[1].pBufferInfo = &transformBufferInfo;
-
-			descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[2].dstSet = descriptorSet;
-			descriptorWrites[2].dstBinding = 2;
-			descriptorWrites[2].dstArrayElement = 0;
-			descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[2].descriptorCount = 1;
-			descriptorWrites[2].pBufferInfo = &materialBufferInfo;
-
-			descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[3].dstSet = descriptorSet;
-			descriptorWrites[3].dstBinding = 3;
-			descriptorWrites[3].dstArrayElement = 0;
-			descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrites[3].descriptorCount = 1;
-			descriptorWrites[3].pImageInfo = &imageInfo;
-
-			vkUpdateDescriptorSets(VKDK::device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-			return descriptorSet;
+			return getStaticProperties().descriptorAllocator->create(key, {
+				DescriptorAllocator::BufferDescriptor(perspectiveUBO, sizeof(Components::Math::PerspectiveBufferObject)),
+				DescriptorAllocator::BufferDescriptor(transformUBO, sizeof(Components::Math::TransformBufferObject)),
+				DescriptorAllocator::BufferDescriptor(materialUBO, sizeof(MaterialBufferObject)),
+				DescriptorAllocator::ImageDescriptor(imageView, sampler, VK_IMAGE_LAYOUT_GENERAL)
+			});
 		}
 		
 		/* Note: one material instance per entity! Cleanup before destroying VKDK stuff */
@@ -146,14 +85,21 @@ namespace Components::Materials::Volume {
 			vkUnmapMemory(VKDK::device, materialUBOMemory);
 		}
 
+		std::vector<std::shared_ptr<Texture>> getTextures() {
+			if (texture3DComponent) return { texture3DComponent };
+			return {};
+		}
+
 		/* Returns a preexisting descriptor set, or creates a new one */
 		VkDescriptorSet getDescriptorSet(UBOSet uboSet) {
 			size_t key = 0;
 			hash_combine(key, uboSet.transformUBO);
 			hash_combine(key, uboSet.perspectiveUBO);
 			hash_combine(key, uboSet.pointLightUBO);
+			hash_combine(key, getTexturesHash());
 
-			if (getStaticProperties().descriptorSets.find(key) == getStaticProperties().descriptorSets.end()) {
+			VkDescriptorSet descriptorSet = getStaticProperties().descriptorAllocator->find(key);
+			if (descriptorSet == VK_NULL_HANDLE) {
 				VkSampler sampler;;
 				VkImageView imageView;
 				auto missingTexture = Systems::ComponentManager::Textures["DefaultTexture3D"];
@@ -165,16 +111,18 @@ namespace Components::Materials::Volume {
 					imageView = texture3DComponent->texture->getColorImageView();
 				}
 
-				getStaticProperties().descriptorSets[key] = CreateDescriptorSet(materialUBO, uboSet.perspectiveUBO,
+				descriptorSet = CreateDescriptorSet(key, materialUBO, uboSet.perspectiveUBO,
 					uboSet.transformUBO, imageView, sampler);
-				return getStaticProperties().descriptorSets[key];
 			}
-			else return getStaticProperties().descriptorSets[key];
+			return descriptorSet;
 		}
 
-		void render(PipelineKey pipelineKey, VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, std::shared_ptr<Mesh> meshComponent) {
+		void render(PipelineKey pipelineKey, VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, std::shared_ptr<Mesh> meshComponent, DrawInfo drawInfo) {
 			/* Look up the pipeline cooresponding to this render pass */
-			VkPipeline pipeline = getStaticProperties().pipelines[pipelineKey];
+			VkPipeline pipeline = getPipeline(getStaticProperties().pipelines, pipelineKey);
+
+			/* Still compiling. The perspective re-records once it's ready. */
+			if (pipeline == VK_NULL_HANDLE) return;
 
 			/* Bind the pipeline for this material */
 			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
@@ -184,7 +132,6 @@ namespace Components::Materials::Volume {
 			VkBuffer normalBuffer = meshComponent->mesh->getNormalBuffer();
 			VkBuffer texcoordBuffer = meshComponent->mesh->getTexCoordBuffer();
 			VkBuffer indexBuffer = meshComponent->mesh->getIndexBuffer();
-			uint32_t totalIndices = meshComponent->mesh->getTotalIndices();
 
 			VkBuffer vertexBuffers[] = { vertexBuffer, normalBuffer, texcoordBuffer };
 			VkDeviceSize offsets[] = { 0 , 0, 0 };
@@ -197,7 +144,7 @@ namespace Components::Materials::Volume {
 				0, 1, &descriptorSet, 0, nullptr);
 
 			/* Draw elements indexed */
-			vkCmdDrawIndexed(commandBuffer, totalIndices, 1, 0, 0, 0);
+			draw(commandBuffer, meshComponent, drawInfo);
 		}
 
 		void setNumSamples(int newNumSamples) {
@@ -252,51 +199,29 @@ namespace Components::Materials::Volume {
 			if (vkCreateDescriptorSetLayout(VKDK::device, &layoutInfo, nullptr, &getStaticProperties().descriptorSetLayout) != VK_SUCCESS) {
 				throw std::runtime_error("failed to create Raycast descriptor set layout!");
 			}
-		}
 
-		static void createDescriptorPool() {
-			std::array<VkDescriptorPoolSize, 4> poolSizes = {};
-			poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			poolSizes[0].descriptorCount = getStaticProperties().maxDescriptorSets;
-			poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			poolSizes[1].descriptorCount = getStaticProperties().maxDescriptorSets;
-			poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			poolSizes[2].descriptorCount = getStaticProperties().maxDescriptorSets;
-			poolSizes[3].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			poolSizes[3].descriptorCount = getStaticProperties().maxDescriptorSets;
-
-			VkDescriptorPoolCreateInfo poolInfo = {};
-			poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-			poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-			poolInfo.pPoolSizes = poolSizes.data();
-			poolInfo.maxSets = getStaticProperties().maxDescriptorSets;
-			poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-
-			if (vkCreateDescriptorPool(VKDK::device, &poolInfo, nullptr, &getStaticProperties().descriptorPool) != VK_SUCCESS) {
-				throw std::runtime_error("failed to create Raycast descriptor pool!");
-			}
+			getStaticProperties().descriptorAllocator = std::make_shared<DescriptorAllocator>(getStaticProperties().descriptorSetLayout,
+				std::vector<VkDescriptorSetLayoutBinding>(bindings.begin(), bindings.end()), getStaticProperties().maxDescriptorSets);
 		}
 
 		static void setupGraphicsPipeline() {
-			/* Read in shader modules */
-			auto vertShaderCode = readFile(ResourcePath "MaterialShaders/Volume/Raycast/vert.spv");
-			auto fragShaderCode = readFile(ResourcePath "MaterialShaders/Volume/Raycast/frag.spv");
-
-			/* Create shader modules */
-			auto vertShaderModule = createShaderModule(vertShaderCode);
-			auto fragShaderModule = createShaderModule(fragShaderCode);
+			/* Compile shader modules in parallel from source, or fall back to the precompiled SPIR-V */
+			auto vertShaderModule = ShaderModules::GetAsync(ResourcePath "MaterialShaders/Volume/Raycast/shader.vert", VK_SHADER_STAGE_VERTEX_BIT,
+				{}, ResourcePath "MaterialShaders/Volume/Raycast/vert.spv");
+			auto fragShaderModule = ShaderModules::GetAsync(ResourcePath "MaterialShaders/Volume/Raycast/shader.frag", VK_SHADER_STAGE_FRAGMENT_BIT,
+				{}, ResourcePath "MaterialShaders/Volume/Raycast/frag.spv");
 
 			/* Info for shader stages */
 			VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
 			vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 			vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-			vertShaderStageInfo.module = vertShaderModule;
+			vertShaderStageInfo.module = vertShaderModule.get();
 			vertShaderStageInfo.pName = "main";
 
 			VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
 			fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 			fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-			fragShaderStageInfo.module = fragShaderModule;
+			fragShaderStageInfo.module = fragShaderModule.get();
 			fragShaderStageInfo.pName = "main";
 
 			std::vector<VkPipelineShaderStageCreateInfo> shaderStages = { vertShaderStageInfo, fragShaderStageInfo };
@@ -306,9 +231,6 @@ namespace Components::Materials::Volume {
 			createPipelines(shaderStages, getBindingDescriptions(),
 				getAttributeDescriptions(), { getStaticProperties().descriptorSetLayout },
 				getStaticProperties().pipelines, getStaticProperties().pipelineLayout);
-
-			vkDestroyShaderModule(VKDK::device, fragShaderModule, nullptr);
-			vkDestroyShaderModule(VKDK::device, vertShaderModule, nullptr);
 		}
 
 		static std::vector<VkVertexInputBindingDescription> getBindingDescriptions() {
@@ -6,6 +6,7 @@
 #include "Components/Meshes/Mesh.hpp"
 #include "Components/Lights/PointLight/PointLight.hpp"
 #include "Components/Textures/Texture2D.hpp"
+#include "Components/Textures/SparseVoxelOctree.hpp"
 #include <glm/glm.hpp>
 #include <memory>
 #include <array>
@@ -32,6 +33,7 @@ namespace Components::Materials::Volume {
 			voxelizeMat->setColor(diffuse, specular, ambient);
 			material->material = voxelizeMat;
 			Systems::ComponentManager::Materials[name] = material;
+			voxelizeMat->requestPipelines();
 			return voxelizeMat;
 		}
 
@@ -51,13 +53,13 @@ namespace Components::Materials::Volume {
 			voxelizeMat->setColor(glm::vec4(1.0, 0.0, 1.0, 1.0), specular, ambient);
 			material->material = voxelizeMat;
 			Systems::ComponentManager::Materials[name] = material;
+			voxelizeMat->requestPipelines();
 			return voxelizeMat;
 		}
 
 		static void Initialize(int maxDescriptorSets) {
 			getStaticProperties().maxDescriptorSets = maxDescriptorSets;
 			createDescriptorSetLayout();
-			createDescriptorPool();
 			setupGraphicsPipeline();
 		}
 
@@ -66,6 +68,10 @@ namespace Components::Materials::Volume {
 			return properties;
 		}
 
+		MaterialProperties *getProperties() {
+			return &getStaticProperties();
+		}
+
 		static void Destroy() {
 			MaterialInterface::Destroy(getStaticProperties());
 		}
@@ -76,138 +82,24 @@ namespace Components::Materials::Volume {
 			setupGraphicsPipeline();
 		}
 
-		static VkDescriptorSet CreateDescriptorSet(
+		static VkDescriptorSet CreateDescriptorSet(size_t key,
       VkBuffer materialUBO, VkBuffer perspectiveUBO, VkBuffer transformUBO, VkBuffer pointLightUBO,
 			VkImageView diffuseImageView, VkSampler diffuseSampler, 
       VkImageView specularImageView, VkSampler specularSampler, 
       VkImageView tex3DImageView, VkSampler tex3DSampler,
-      VkImageView shadowMapImageView, VkSampler shadowMapSampler) {
-			VkDescriptorSet descriptorSet;
-
-			VkDescriptorSetLayout layouts[] = { getStaticProperties().descriptorSetLayout };
-			VkDescriptorSetAllocateInfo allocInfo = {};
-			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-			allocInfo.descriptorPool = getStaticProperties().descriptorPool;
-			allocInfo.descriptorSetCount = 1;
-			allocInfo.pSetLayouts = layouts;
-
-			auto error = vkAllocateDescriptorSets(VKDK::device, &allocInfo, &descriptorSet);
-			if (error != VK_SUCCESS) {
-				throw std::runtime_error("failed to allocate descriptor set! " + error);
-			}
-
-			VkDescriptorBufferInfo perspectiveBufferInfo = {};
-			perspectiveBufferInfo.buffer = perspectiveUBO;
-			perspectiveBufferInfo.offset = 0;
-			perspectiveBufferInfo.range = sizeof(Components::Math::PerspectiveBufferObject);
-
-			VkDescriptorBufferInfo transformBufferInfo = {};
-			transformBufferInfo.buffer = transformUBO;
-			transformBufferInfo.offset = 0;
-			transformBufferInfo.range = sizeof(Components::Math::TransformBufferObject);
-
-			VkDescriptorBufferInfo pointLightBufferInfo = {};
-			pointLightBufferInfo.buffer = pointLightUBO;
-			pointLightBufferInfo.offset = 0;
-			pointLightBufferInfo.range = sizeof(Components::Lights::PointLightBufferObject);
-
-			VkDescriptorBufferInfo materialBufferInfo = {};
-			materialBufferInfo.buffer = materialUBO;
-			materialBufferInfo.offset = 0;
-			materialBufferInfo.range = sizeof(MaterialBufferObject);
-
-			/* Diffuse Image sampler */
-			VkDescriptorImageInfo diffuseImageInfo = {};
-			diffuseImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			diffuseImageInfo.imageView = diffuseImageView;
-			diffuseImageInfo.sampler = diffuseSampler;
-
-			/* Specular Image sampler */
-			VkDescriptorImageInfo specularImageInfo = {};
-			specularImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			specularImageInfo.imageView = specularImageView;
-			specularImageInfo.sampler = specularSampler;
-
-      /* Output voxelization */
-			VkDescriptorImageInfo tex3DImageInfo = {};
-			tex3DImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL; /* This might not be right */
-			tex3DImageInfo.imageView = tex3DImageView;
-			tex3DImageInfo.sampler = tex3DSampler;
-
-      /* Shadow map sampler */
-      VkDescriptorImageInfo shadowMapImageInfo = {};
-      shadowMapImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      shadowMapImageInfo.imageView = shadowMapImageView;
-      shadowMapImageInfo.sampler = shadowMapSampler;
-			
-			std::array<VkWriteDescriptorSet, 8> descriptorWrites = {};
-
-			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[0].dstSet = descriptorSet;
-			descriptorWrites[0].dstBinding = 0;
-			descriptorWrites[0].dstArrayElement = 0;
-			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[0].descriptorCount = 1;
-			descriptorWrites[0].pBufferInfo = &perspectiveBufferInfo;
-
-			descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[1].dstSet = descriptorSet;
-			descriptorWrites[1].dstBinding = 1;
-			descriptorWrites[1].dstArrayElement = 0;
-			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[1].descriptorCount = 1;
-			descriptorWrites[1].pBufferInfo = &transformBufferInfo;
-
-			descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[2].dstSet = descriptorSet;
-			descriptorWrites[2].dstBinding = 2;
-			descriptorWrites[2].dstArrayElement = 0;
-			descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[2].descriptorCount = 1;
-			descriptorWrites[2].pBufferInfo = &pointLightBufferInfo;
-
-			descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[3].dstSet = descriptorSet;
-			descriptorWrites[3].dstBinding = 3;
-			descriptorWrites[3].dstArrayElement = 0;
-			descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[3].descriptorCount = 1;
-			descriptorWrites[3].pBufferInfo = &materialBufferInfo;
-
-			descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[4].dstSet = descriptorSet;
-			descriptorWrites[4].dstBinding = 4;
-			descriptorWrites[4].dstArrayElement = 0;
-			descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrites[4].descriptorCount = 1;
-			descriptorWrites[4].pImageInfo = &diffuseImageInfo;
-
-			descriptorWrites[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[5].dstSet = descriptorSet;
-			descriptorWrites[5].dstBinding = 5;
-			descriptorWrites[5].dstArrayElement = 0;
-			descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrites[5].descriptorCount = 1;
-			descriptorWrites[5].pImageInfo = &specularImageInfo;
-
-			descriptorWrites[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[6].dstSet = descriptorSet;
-			descriptorWrites[6].dstBinding = 6;
-			descriptorWrites[6].dstArrayElement = 0;
-			descriptorWrites[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-			descriptorWrites[6].descriptorCount = 1;
-			descriptorWrites[6].pImageInfo = &tex3DImageInfo;
-
-      descriptorWrites[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descriptorWrites[7].dstSet = descriptorSet;
-      descriptorWrites[7].dstBinding = 7;
-      descriptorWrites[7].dstArrayElement = 0;
-      descriptorWrites[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      descriptorWrites[7].descriptorCount = 1;
-      descriptorWrites[7].pImageInfo = &shadowMapImageInfo;
-
-			vkUpdateDescriptorSets(VKDK::device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-			return descriptorSet;
+      VkImageView shadowMapImageView, VkSampler shadowMapSampler,
+      VkBuffer fragmentBuffer) {
+			return getStaticProperties().descriptorAllocator->create(key, {
+				DescriptorAllocator::BufferDescriptor(perspectiveUBO, sizeof(Components::Math::PerspectiveBufferObject)),
+				DescriptorAllocator::BufferDescriptor(transformUBO, sizeof(Components::Math::TransformBufferObject)),
+				DescriptorAllocator::BufferDescriptor(pointLightUBO, sizeof(Components::Lights::PointLightBufferObject)),
+				DescriptorAllocator::BufferDescriptor(materialUBO, sizeof(MaterialBufferObject)),
+				DescriptorAllocator::ImageDescriptor(diffuseImageView, diffuseSampler),
+				DescriptorAllocator::ImageDescriptor(specularImageView, specularSampler),
+				DescriptorAllocator::ImageDescriptor(tex3DImageView, tex3DSampler, VK_IMAGE_LAYOUT_GENERAL),
+				DescriptorAllocator::ImageDescriptor(shadowMapImageView, shadowMapSampler),
+				DescriptorAllocator::BufferDescriptor(fragmentBuffer, VK_WHOLE_SIZE)
+			});
 		}
 		
 		/* Note: one material instance per entity! Cleanup before destroying VKDK stuff */
@@ -238,14 +130,24 @@ namespace Components::Materials::Volume {
 			vkUnmapMemory(VKDK::device, materialUBOMemory);
 		}
 
+		std::vector<std::shared_ptr<Texture>> getTextures() {
+			std::vector<std::shared_ptr<Texture>> textures;
+			if (useDiffuseTexture && diffuseTextureComponent) textures.push_back(diffuseTextureComponent);
+			if (output3DTexture) textures.push_back(output3DTexture);
+			if (useShadowMapTextureComponent && shadowMapTextureComponent) textures.push_back(shadowMapTextureComponent);
+			return textures;
+		}
+
 		/* Returns a preexisting descriptor set, or creates a new one */
 		VkDescriptorSet getDescriptorSet(UBOSet uboSet) {
 			size_t key = 0;
 			hash_combine(key, uboSet.transformUBO);
 			hash_combine(key, uboSet.perspectiveUBO);
 			hash_combine(key, uboSet.pointLightUBO);
+			hash_combine(key, getTexturesHash());
 
-			if (getStaticProperties().descriptorSets.find(key) == getStaticProperties().descriptorSets.end()) {
+			VkDescriptorSet descriptorSet = getStaticProperties().descriptorAllocator->find(key);
+			if (descriptorSet == VK_NULL_HANDLE) {
 				VkSampler diffuseSampler, specularSampler, tex3DSampler, shadowMapSampler;
 				VkImageView diffuseImageView, specularImageView, tex3DImageView, shadowMapImageView;
 				auto missingTexture = Systems::ComponentManager::Textures["DefaultTexture"];
@@ -273,17 +175,32 @@ namespace Components::Materials::Volume {
           shadowMapImageView = shadowMapTextureComponent->texture->getDepthImageView();
         }
 
-				getStaticProperties().descriptorSets[key] = CreateDescriptorSet(materialUBO, uboSet.perspectiveUBO,
+				/* The fragment list is only written when voxelizing into an octree. Transform buffers are also storage buffers. */
+				auto octree = getOctree();
+				VkBuffer fragmentBuffer = octree ? octree->getFragmentBuffer() : uboSet.transformUBO;
+
+				descriptorSet = CreateDescriptorSet(key, materialUBO, uboSet.perspectiveUBO,
 					uboSet.transformUBO, uboSet.pointLightUBO, diffuseImageView, diffuseSampler,
-					specularImageView, specularSampler, tex3DImageView, tex3DSampler, shadowMapImageView, shadowMapSampler);
-				return getStaticProperties().descriptorSets[key];
+					specularImageView, specularSampler, tex3DImageView, tex3DSampler, shadowMapImageView, shadowMapSampler,
+					fragmentBuffer);
 			}
-			else return getStaticProperties().descriptorSets[key];
+			return descriptorSet;
 		}
 
-		void render(PipelineKey pipelineKey, VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, std::shared_ptr<Mesh> meshComponent) {
+		/* Voxelizing into an octree appends fragments instead of storing voxels, which is a specialized pipeline */
+		std::unordered_map<PipelineKey, VkPipeline> *getPipelines(bool instanced = false) {
+			auto octree = getOctree();
+			auto &specialized = getSpecializedPipelines(getStaticProperties(),
+				{ octree ? 1u : 0u, octree ? octree->getMaxDepth() : 1u });
+			return instanced ? &specialized.instancedPipelines : &specialized.pipelines;
+		}
+
+		void render(PipelineKey pipelineKey, VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, std::shared_ptr<Mesh> meshComponent, DrawInfo drawInfo) {
 			/* Look up the pipeline cooresponding to this render pass */
-			VkPipeline pipeline = getStaticProperties().pipelines[pipelineKey];
+			VkPipeline pipeline = getPipeline(*getPipelines(), pipelineKey);
+
+			/* Still compiling. The perspective re-records once it's ready. */
+			if (pipeline == VK_NULL_HANDLE) return;
 
 			/* Bind the pipeline for this material */
 			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
@@ -293,7 +210,6 @@ namespace Components::Materials::Volume {
 			VkBuffer normalBuffer = meshComponent->mesh->getNormalBuffer();
 			VkBuffer texcoordBuffer = meshComponent->mesh->getTexCoordBuffer();
 			VkBuffer indexBuffer = meshComponent->mesh->getIndexBuffer();
-			uint32_t totalIndices = meshComponent->mesh->getTotalIndices();
 
 			VkBuffer vertexBuffers[] = { vertexBuffer, normalBuffer, texcoordBuffer };
 			VkDeviceSize offsets[] = { 0 , 0, 0 };
@@ -306,7 +222,7 @@ namespace Components::Materials::Volume {
 				0, 1, &descriptorSet, 0, nullptr);
 
 			/* Draw elements indexed */
-			vkCmdDrawIndexed(commandBuffer, totalIndices, 1, 0, 0, 0);
+			draw(commandBuffer, meshComponent, drawInfo);
 		}
 
 		void setColor(glm::vec4 kd, glm::vec4 ks, glm::vec4 ka) {
@@ -338,6 +254,11 @@ namespace Components::Materials::Volume {
       uint32_t useShadowMap;
 		};
 
+		std::shared_ptr<SparseVoxelOctree> getOctree() {
+			if (!output3DTexture) return nullptr;
+			return std::dynamic_pointer_cast<SparseVoxelOctree>(output3DTexture->texture);
+		}
+
 		/* A descriptor set layout describes how uniforms are used in the pipeline */
 		static void createDescriptorSetLayout() {
 			VkDescriptorSetLayoutBinding perspectiveLayoutBinding = {};
@@ -400,10 +321,18 @@ namespace Components::Materials::Volume {
       shadowMapLayoutBinding.pImmutableSamplers = nullptr;
       shadowMapLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-			std::array<VkDescriptorSetLayoutBinding, 8> bindings = {
+			/* Sparse voxel octree fragment list */
+			VkDescriptorSetLayoutBinding fragmentListLayoutBinding = {};
+			fragmentListLayoutBinding.binding = 8;
+			fragmentListLayoutBinding.descriptorCount = 1;
+			fragmentListLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			fragmentListLayoutBinding.pImmutableSamplers = nullptr;
+			fragmentListLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+			std::array<VkDescriptorSetLayoutBinding, 9> bindings = {
 				perspectiveLayoutBinding, transformLayoutBinding, pointLightLayoutBinding, materialLayoutBinding,
 				diffuseTextureLayoutBinding, specularTextureLayoutBinding, image3DLayoutBinding, 
-        shadowMapLayoutBinding };
+        shadowMapLayoutBinding, fragmentListLayoutBinding };
 
 			VkDescriptorSetLayoutCreateInfo layoutInfo = {};
 			layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -413,67 +342,37 @@ namespace Components::Materials::Volume {
 			if (vkCreateDescriptorSetLayout(VKDK::device, &layoutInfo, nullptr, &getStaticProperties().descriptorSetLayout) != VK_SUCCESS) {
 				throw std::runtime_error("failed to create Voxelize descriptor set layout!");
 			}
-		}
 
-		static void createDescriptorPool() {
-			std::array<VkDescriptorPoolSize, 8> poolSizes = {};
-			poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			poolSizes[0].descriptorCount = getStaticProperties().maxDescriptorSets;
-			poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			poolSizes[1].descriptorCount = getStaticProperties().maxDescriptorSets;
-			poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			poolSizes[2].descriptorCount = getStaticProperties().maxDescriptorSets;
-			poolSizes[3].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			poolSizes[3].descriptorCount = getStaticProperties().maxDescriptorSets;
-			poolSizes[4].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			poolSizes[4].descriptorCount = getStaticProperties().maxDescriptorSets;
-			poolSizes[5].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			poolSizes[5].descriptorCount = getStaticProperties().maxDescriptorSets;
-			poolSizes[6].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-			poolSizes[6].descriptorCount = getStaticProperties().maxDescriptorSets;
-      poolSizes[7].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      poolSizes[7].descriptorCount = getStaticProperties().maxDescriptorSets;
-
-			VkDescriptorPoolCreateInfo poolInfo = {};
-			poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-			poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-			poolInfo.pPoolSizes = poolSizes.data();
-			poolInfo.maxSets = getStaticProperties().maxDescriptorSets;
-			poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-
-			if (vkCreateDescriptorPool(VKDK::device, &poolInfo, nullptr, &getStaticProperties().descriptorPool) != VK_SUCCESS) {
-				throw std::runtime_error("failed to create Voxelize descriptor pool!");
-			}
+			getStaticProperties().descriptorAllocator = std::make_shared<DescriptorAllocator>(getStaticProperties().descriptorSetLayout,
+				std::vector<VkDescriptorSetLayoutBinding>(bindings.begin(), bindings.end()), getStaticProperties().maxDescriptorSets);
 		}
 
 		static void setupGraphicsPipeline() {
-			/* Read in shader modules */
-			auto vertShaderCode = readFile(ResourcePath "MaterialShaders/Volume/Voxelize/vert.spv");
-			auto geomShaderCode = readFile(ResourcePath "MaterialShaders/Volume/Voxelize/geom.spv");
-			auto fragShaderCode = readFile(ResourcePath "MaterialShaders/Volume/Voxelize/frag.spv");
-
-			/* Create shader modules */
-			auto vertShaderModule = createShaderModule(vertShaderCode);
-			auto geomShaderModule = createShaderModule(geomShaderCode);
-			auto fragShaderModule = createShaderModule(fragShaderCode);
+			/* Compile shader modules in parallel from source, or fall back to the precompiled SPIR-V */
+			auto vertShaderModule = ShaderModules::GetAsync(ResourcePath "MaterialShaders/Volume/Voxelize/shader.vert", VK_SHADER_STAGE_VERTEX_BIT,
+				{}, ResourcePath "MaterialShaders/Volume/Voxelize/vert.spv");
+			auto geomShaderModule = ShaderModules::GetAsync(ResourcePath "MaterialShaders/Volume/Voxelize/shader.geom", VK_SHADER_STAGE_GEOMETRY_BIT,
+				{}, ResourcePath "MaterialShaders/Volume/Voxelize/geom.spv");
+			auto fragShaderModule = ShaderModules::GetAsync(ResourcePath "MaterialShaders/Volume/Voxelize/shader.frag", VK_SHADER_STAGE_FRAGMENT_BIT,
+				{}, ResourcePath "MaterialShaders/Volume/Voxelize/frag.spv");
 
 			/* Info for shader stages */
 			VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
 			vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 			vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-			vertShaderStageInfo.module = vertShaderModule;
+			vertShaderStageInfo.module = vertShaderModule.get();
 			vertShaderStageInfo.pName = "main";
 
 			VkPipelineShaderStageCreateInfo geomShaderStageInfo = {};
 			geomShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 			geomShaderStageInfo.stage = VK_SHADER_STAGE_GEOMETRY_BIT;
-			geomShaderStageInfo.module = geomShaderModule;
+			geomShaderStageInfo.module = geomShaderModule.get();
 			geomShaderStageInfo.pName = "main";
 
 			VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
 			fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 			fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-			fragShaderStageInfo.module = fragShaderModule;
+			fragShaderStageInfo.module = fragShaderModule.get();
 			fragShaderStageInfo.pName = "main";
 
 			std::vector<VkPipelineShaderStageCreateInfo> shaderStages = { vertShaderStageInfo, geomShaderStageInfo, fragShaderStageInfo };
@@ -483,10 +382,6 @@ namespace Components::Materials::Volume {
 			createPipelines(shaderStages, getBindingDescriptions(),
 				getAttributeDescriptions(), { getStaticProperties().descriptorSetLayout },
 				getStaticProperties().pipelines, getStaticProperties().pipelineLayout);
-
-			vkDestroyShaderModule(VKDK::device, fragShaderModule, nullptr);
-			vkDestroyShaderModule(VKDK::device, geomShaderModule, nullptr);
-			vkDestroyShaderModule(VKDK::device, vertShaderModule, nullptr);
 		}
 
 		static std::vector<VkVertexInputBindingDescription> getBindingDescriptions() {
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "vkdk.hpp"
+#include <cstring>
+
+namespace Components::Math {
+	/* A device local buffer which recorded commands read from, fed by a persistently mapped staging copy per
+		frame in flight. The CPU writes the copy of the current frame slot, which recordUpload then copies into
+		the device local buffer ahead of the frame's draws. A frame only has to wait for the frame which last
+		used its slot (see VKDK::WaitForFrameSlot), instead of the one right before it. */
+	class FrameUploadBuffer {
+	public:
+		void create(VkDeviceSize size, VkBufferUsageFlags usage) {
+			this->size = size;
+			VKDK::CreateBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+			for (uint32_t i = 0; i < VKDK::MaxFramesInFlight; ++i) {
+				VKDK::CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging[i], stagingMemory[i]);
+				vkMapMemory(VKDK::device, stagingMemory[i], 0, size, 0, &stagingData[i]);
+			}
+		}
+
+		void destroy() {
+			if (buffer == VK_NULL_HANDLE) return;
+			for (uint32_t i = 0; i < VKDK::MaxFramesInFlight; ++i) {
+				vkUnmapMemory(VKDK::device, stagingMemory[i]);
+				vkDestroyBuffer(VKDK::device, staging[i], nullptr);
+				vkFreeMemory(VKDK::device, stagingMemory[i], nullptr);
+				staging[i] = VK_NULL_HANDLE;
+				stagingMemory[i] = VK_NULL_HANDLE;
+				stagingData[i] = nullptr;
+			}
+			vkDestroyBuffer(VKDK::device, buffer, nullptr);
+			vkFreeMemory(VKDK::device, memory, nullptr);
+			buffer = VK_NULL_HANDLE;
+			memory = VK_NULL_HANDLE;
+		}
+
+		/* The buffer to reference from descriptors and recorded commands */
+		VkBuffer getBuffer() { return buffer; }
+		VkDeviceSize getSize() { return size; }
+
+		/* The staging copy of the current frame slot */
+		template<typename T> T *getData() { return (T*)stagingData[VKDK::GetFrameSlot()]; }
+
+		/* Copies the current slot's contents to every other slot. Only safe while no frame is in flight. */
+		void copyToAllSlots() {
+			uint32_t slot = VKDK::GetFrameSlot();
+			for (uint32_t i = 0; i < VKDK::MaxFramesInFlight; ++i)
+				if (i != slot) memcpy(stagingData[i], stagingData[slot], size);
+		}
+
+		/* Records a copy of the current slot into the device local buffer. Callers synchronize it with the reads. */
+		void recordUpload(VkCommandBuffer commandBuffer) {
+			if (buffer == VK_NULL_HANDLE) return;
+			VkBufferCopy region = { 0, 0, size };
+			vkCmdCopyBuffer(commandBuffer, staging[VKDK::GetFrameSlot()], buffer, 1, &region);
+		}
+
+	private:
+		VkDeviceSize size = 0;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkBuffer staging[VKDK::MaxFramesInFlight] = {};
+		VkDeviceMemory stagingMemory[VKDK::MaxFramesInFlight] = {};
+		void *stagingData[VKDK::MaxFramesInFlight] = {};
+	};
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#ifndef GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_access.hpp>
+#include <array>
+
+namespace Components::Math {
+	/* A frustum is a set of six inward facing planes, extracted from a (projection * view * model) matrix.
+		If the model matrix is included, the planes will be in that object's local space. */
+	class Frustum {
+	public:
+		enum { Left = 0, Right, Bottom, Top, Near, Far };
+		std::array<glm::vec4, 6> planes;
+
+		Frustum() {
+			for (auto &p : planes) p = glm::vec4(0.0, 0.0, 0.0, 1.0);
+		}
+
+		/* Gribb/Hartmann plane extraction, assuming a [0, 1] depth range */
+		Frustum(glm::mat4 matrix) {
+			glm::vec4 r0 = glm::row(matrix, 0);
+			glm::vec4 r1 = glm::row(matrix, 1);
+			glm::vec4 r2 = glm::row(matrix, 2);
+			glm::vec4 r3 = glm::row(matrix, 3);
+			planes[Left] = r3 + r0;
+			planes[Right] = r3 - r0;
+			planes[Bottom] = r3 + r1;
+			planes[Top] = r3 - r1;
+			planes[Near] = r2;
+			planes[Far] = r3 - r2;
+			for (auto &p : planes) {
+				float l = glm::length(glm::vec3(p));
+				if (l > 0.0f) p /= l;
+			}
+		}
+
+		/* Returns false if the sphere is completely outside of any plane */
+		bool intersectsSphere(glm::vec3 center, float radius) const {
+			for (auto &p : planes)
+				if (glm::dot(glm::vec3(p), center) + p.w < -radius) return false;
+			return true;
+		}
+
+		/* Returns false if the box is completely outside of any plane */
+		bool intersectsAABB(glm::vec3 minP, glm::vec3 maxP) const {
+			for (auto &p : planes) {
+				/* Test the corner furthest along the plane normal */
+				glm::vec3 positive(
+					(p.x >= 0.0f) ? maxP.x : minP.x,
+					(p.y >= 0.0f) ? maxP.y : minP.y,
+					(p.z >= 0.0f) ? maxP.z : minP.z);
+				if (glm::dot(glm::vec3(p), positive) + p.w < 0.0f) return false;
+			}
+			return true;
+		}
+	};
+}
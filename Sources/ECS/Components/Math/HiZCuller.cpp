@@ -0,0 +1,388 @@
+#include "HiZCuller.hpp"
+#include "Frustum.hpp"
+#include "Components/Materials/ShaderModules.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace Components::Math {
+	bool HiZCuller::IsSupported() {
+		using Materials::ShaderModules;
+		return VKDK::deviceFeatures.drawIndirectFirstInstance
+			&& ShaderModules::CanLoad(ResourcePath "ComputeShaders/HiZDownsample/shader.comp", ResourcePath "ComputeShaders/HiZDownsample/comp.spv")
+			&& ShaderModules::CanLoad(ResourcePath "ComputeShaders/HiZCull/shader.comp", ResourcePath "ComputeShaders/HiZCull/comp.spv");
+	}
+
+	HiZCuller::HiZCuller(VkImage depthImage, VkImageView depthImageView, VkFormat depthFormat, uint32_t width, uint32_t height) {
+		this->depthImage = depthImage;
+		this->depthImageView = depthImageView;
+		this->depthWidth = width;
+		this->depthHeight = height;
+
+		/* Layout transitions of combined depth stencil images must include both aspects */
+		depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (depthFormat == VK_FORMAT_D16_UNORM_S8_UINT || depthFormat == VK_FORMAT_D24_UNORM_S8_UINT || depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT)
+			depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+		/* Compacting draws requires both an indirect count, and more than one draw per indirect call */
+		compact = VKDK::drawIndirectCountSupported && VKDK::deviceFeatures.multiDrawIndirect;
+
+		createPyramid();
+		createPipelines();
+		createBuffers(64, 16);
+	}
+
+	void HiZCuller::createPyramid() {
+		/* The pyramid's base is the largest power of two which fits in the depth attachment, so that each
+			texel of a level covers exactly 2x2 texels of the level below */
+		pyramidWidth = pyramidHeight = 1;
+		while (pyramidWidth * 2 <= depthWidth) pyramidWidth *= 2;
+		while (pyramidHeight * 2 <= depthHeight) pyramidHeight *= 2;
+		mipCount = 1;
+		while ((std::max(pyramidWidth, pyramidHeight) >> mipCount) > 0) mipCount++;
+
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageInfo.extent = { pyramidWidth, pyramidHeight, 1 };
+		imageInfo.mipLevels = mipCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(VKDK::device, &imageInfo, nullptr, &pyramid));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(VKDK::device, pyramid, &memReqs);
+		VkMemoryAllocateInfo memAlloc = {};
+		memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = VKDK::FindMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(VKDK::device, &memAlloc, nullptr, &pyramidMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(VKDK::device, pyramid, pyramidMemory, 0));
+
+		/* One view over every level for culling, and one per level for the downsample passes */
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.image = pyramid;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(VKDK::device, &viewInfo, nullptr, &pyramidView));
+
+		pyramidLevelViews.resize(mipCount);
+		for (uint32_t level = 0; level < mipCount; ++level) {
+			viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+			VK_CHECK_RESULT(vkCreateImageView(VKDK::device, &viewInfo, nullptr, &pyramidLevelViews[level]));
+		}
+
+		/* Levels are read with texelFetch, so filtering doesn't matter */
+		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.maxLod = (float)mipCount;
+		samplerInfo.maxAnisotropy = 1.0f;
+		VK_CHECK_RESULT(vkCreateSampler(VKDK::device, &samplerInfo, nullptr, &sampler));
+
+		/* Move the pyramid into the general layout, and make sure the depth attachment starts in the layout the culling pass expects */
+		VkCommandBuffer commandBuffer = VKDK::beginSingleTimeCommands();
+		VkImageMemoryBarrier barriers[2] = { vks::initializers::imageMemoryBarrier(), vks::initializers::imageMemoryBarrier() };
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barriers[0].image = pyramid;
+		barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount, 0, 1 };
+		barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		barriers[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		barriers[1].image = depthImage;
+		barriers[1].subresourceRange = { depthAspect, 0, 1, 0, 1 };
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0, 0, nullptr, 0, nullptr, 2, barriers);
+		VKDK::endSingleTimeCommands(commandBuffer);
+	}
+
+	void HiZCuller::createPipelines() {
+		/* Downsample: the previous level (or the depth attachment) is sampled, and the next level is written */
+		std::vector<VkDescriptorSetLayoutBinding> downsampleBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo layoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(downsampleBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(VKDK::device, &layoutInfo, nullptr, &downsampleSetLayout));
+
+		std::vector<VkDescriptorSetLayoutBinding> cullBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+		};
+		layoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(cullBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(VKDK::device, &layoutInfo, nullptr, &cullSetLayout));
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = vks::initializers::pipelineLayoutCreateInfo(&downsampleSetLayout);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(VKDK::device, &pipelineLayoutInfo, nullptr, &downsampleLayout));
+		pipelineLayoutInfo = vks::initializers::pipelineLayoutCreateInfo(&cullSetLayout);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(VKDK::device, &pipelineLayoutInfo, nullptr, &cullLayout));
+
+		/* Modules are owned by ShaderModules, and shared with anything else built from the same source */
+		auto createComputePipeline = [](std::string directory, VkPipelineLayout layout, VkPipeline &pipeline) {
+			VkComputePipelineCreateInfo pipelineInfo = vks::initializers::computePipelineCreateInfo(layout);
+			pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			pipelineInfo.stage.module = Materials::ShaderModules::Get(directory + "shader.comp", VK_SHADER_STAGE_COMPUTE_BIT,
+				{}, directory + "comp.spv");
+			pipelineInfo.stage.pName = "main";
+			auto start = std::chrono::steady_clock::now();
+			if (vkCreateComputePipelines(VKDK::device, VKDK::pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create compute pipeline!");
+			}
+			VKDK::RecordPipelineCreation(1, std::chrono::steady_clock::now() - start);
+		};
+		createComputePipeline(ResourcePath "ComputeShaders/HiZDownsample/", downsampleLayout, downsamplePipeline);
+		createComputePipeline(ResourcePath "ComputeShaders/HiZCull/", cullLayout, cullPipeline);
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, mipCount + 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, mipCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4),
+		};
+		VkDescriptorPoolCreateInfo poolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, mipCount + 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(VKDK::device, &poolInfo, nullptr, &descriptorPool));
+
+		/* Level 0 reduces the depth attachment, every other level reduces the level before it */
+		std::vector<VkDescriptorSetLayout> layouts(mipCount, downsampleSetLayout);
+		downsampleSets.resize(mipCount);
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, layouts.data(), mipCount);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(VKDK::device, &allocInfo, downsampleSets.data()));
+		for (uint32_t level = 0; level < mipCount; ++level) {
+			VkDescriptorImageInfo source = (level == 0)
+				? vks::initializers::descriptorImageInfo(sampler, depthImageView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL)
+				: vks::initializers::descriptorImageInfo(sampler, pyramidLevelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL);
+			VkDescriptorImageInfo destination = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, pyramidLevelViews[level], VK_IMAGE_LAYOUT_GENERAL);
+			std::vector<VkWriteDescriptorSet> writes = {
+				vks::initializers::writeDescriptorSet(downsampleSets[level], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &source),
+				vks::initializers::writeDescriptorSet(downsampleSets[level], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &destination),
+			};
+			vkUpdateDescriptorSets(VKDK::device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+		}
+
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &cullSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(VKDK::device, &allocInfo, &cullSet));
+
+		cullUBO.create(sizeof(CullBufferObject), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+		*cullUBO.getData<CullBufferObject>() = {};
+		cullUBO.copyToAllSlots();
+	}
+
+	void HiZCuller::createBuffers(uint32_t instanceCapacity, uint32_t bucketCapacity) {
+		this->instanceCapacity = instanceCapacity;
+		this->bucketCapacity = bucketCapacity;
+
+		instanceBuffer.create(instanceCapacity * sizeof(Instance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		VKDK::CreateBuffer(bucketCapacity * sizeof(Bucket), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, bucketBuffer, bucketMemory);
+		VKDK::CreateBuffer(instanceCapacity * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawBuffer, drawMemory);
+		VKDK::CreateBuffer(bucketCapacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, countBuffer, countMemory);
+
+		void *data;
+		vkMapMemory(VKDK::device, bucketMemory, 0, bucketCapacity * sizeof(Bucket), 0, &data);
+		bucketData = (Bucket*)data;
+
+		updateCullDescriptorSet();
+	}
+
+	void HiZCuller::destroyBuffers() {
+		instanceBuffer.destroy();
+		vkUnmapMemory(VKDK::device, bucketMemory);
+		vkDestroyBuffer(VKDK::device, bucketBuffer, nullptr);
+		vkDestroyBuffer(VKDK::device, drawBuffer, nullptr);
+		vkDestroyBuffer(VKDK::device, countBuffer, nullptr);
+		vkFreeMemory(VKDK::device, bucketMemory, nullptr);
+		vkFreeMemory(VKDK::device, drawMemory, nullptr);
+		vkFreeMemory(VKDK::device, countMemory, nullptr);
+	}
+
+	void HiZCuller::updateCullDescriptorSet() {
+		VkDescriptorBufferInfo uboInfo = { cullUBO.getBuffer(), 0, sizeof(CullBufferObject) };
+		VkDescriptorBufferInfo instanceInfo = { instanceBuffer.getBuffer(), 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo bucketInfo = { bucketBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo drawInfo = { drawBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo countInfo = { countBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorImageInfo pyramidInfo = vks::initializers::descriptorImageInfo(sampler, pyramidView, VK_IMAGE_LAYOUT_GENERAL);
+		std::vector<VkWriteDescriptorSet> writes = {
+			vks::initializers::writeDescriptorSet(cullSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uboInfo),
+			vks::initializers::writeDescriptorSet(cullSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &instanceInfo),
+			vks::initializers::writeDescriptorSet(cullSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &bucketInfo),
+			vks::initializers::writeDescriptorSet(cullSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &drawInfo),
+			vks::initializers::writeDescriptorSet(cullSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &countInfo),
+			vks::initializers::writeDescriptorSet(cullSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, &pyramidInfo),
+		};
+		vkUpdateDescriptorSets(VKDK::device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+	}
+
+	void HiZCuller::setBuckets(std::vector<Bucket> buckets) {
+		uint32_t instanceCount = 0;
+		for (auto &bucket : buckets) {
+			bucket.commandOffset = instanceCount;
+			instanceCount += bucket.instanceCount;
+		}
+
+		/* Grow by doubling, so that adding entities one at a time doesn't reallocate every frame */
+		if (instanceCount > instanceCapacity || buckets.size() > bucketCapacity) {
+			uint32_t newInstanceCapacity = instanceCapacity, newBucketCapacity = bucketCapacity;
+			while (newInstanceCapacity < instanceCount) newInstanceCapacity *= 2;
+			while (newBucketCapacity < buckets.size()) newBucketCapacity *= 2;
+			destroyBuffers();
+			createBuffers(newInstanceCapacity, newBucketCapacity);
+		}
+
+		this->buckets = buckets;
+		if (!buckets.empty()) memcpy(bucketData, buckets.data(), buckets.size() * sizeof(Bucket));
+
+		/* Until the next update, every command is written as hidden. Perspective copies this to the other frame slots once it's done recording. */
+		auto instanceData = instanceBuffer.getData<Instance>();
+		uint32_t i = 0;
+		for (uint32_t b = 0; b < buckets.size(); ++b) {
+			for (uint32_t j = 0; j < buckets[b].instanceCount; ++j, ++i) {
+				instanceData[i] = {};
+				instanceData[i].bucket = b;
+				instanceData[i].instance = j;
+				instanceData[i].flags = Missing;
+			}
+		}
+		cullUBO.getData<CullBufferObject>()->instanceCount = instanceCount;
+	}
+
+	void HiZCuller::getDraw(uint32_t bucket, VkBuffer &buffer, VkDeviceSize &offset, uint32_t &drawCount, VkBuffer &countBuffer, VkDeviceSize &countOffset) {
+		buffer = drawBuffer;
+		offset = buckets[bucket].commandOffset * sizeof(VkDrawIndexedIndirectCommand);
+		drawCount = buckets[bucket].instanceCount;
+		countBuffer = (compact) ? this->countBuffer : VK_NULL_HANDLE;
+		countOffset = bucket * sizeof(uint32_t);
+	}
+
+	void HiZCuller::update(const glm::mat4 &viewProjection, const std::vector<Instance> &instances, bool occlusion) {
+		uint32_t instanceCount = std::min((uint32_t)instances.size(), instanceCapacity);
+		if (instanceCount > 0) memcpy(instanceBuffer.getData<Instance>(), instances.data(), instanceCount * sizeof(Instance));
+
+		Frustum frustum(viewProjection);
+		auto cullData = cullUBO.getData<CullBufferObject>();
+		cullData->viewProjection = viewProjection;
+		for (uint32_t i = 0; i < 6; ++i) cullData->frustumPlanes[i] = frustum.planes[i];
+		cullData->pyramidSize = glm::vec2(pyramidWidth, pyramidHeight);
+		cullData->instanceCount = instanceCount;
+		cullData->mipCount = mipCount;
+		cullData->compact = (compact) ? 1 : 0;
+		cullData->occlusion = (occlusion && !firstUpdate) ? 1 : 0;
+		firstUpdate = false;
+	}
+
+	void HiZCuller::copyToAllSlots() {
+		cullUBO.copyToAllSlots();
+		instanceBuffer.copyToAllSlots();
+	}
+
+	void HiZCuller::recordUploads(VkCommandBuffer commandBuffer) {
+		cullUBO.recordUpload(commandBuffer);
+		instanceBuffer.recordUpload(commandBuffer);
+	}
+
+	void HiZCuller::record(VkCommandBuffer commandBuffer) {
+		if (buckets.empty()) return;
+
+		/* Wait for last frame's depth writes, and for last frame's culling to be done reading the pyramid */
+		VkImageMemoryBarrier depthBarrier = vks::initializers::imageMemoryBarrier();
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		depthBarrier.image = depthImage;
+		depthBarrier.subresourceRange = { depthAspect, 0, 1, 0, 1 };
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+
+		/* Build the pyramid one level at a time */
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, downsamplePipeline);
+		for (uint32_t level = 0; level < mipCount; ++level) {
+			uint32_t width = std::max(1u, pyramidWidth >> level);
+			uint32_t height = std::max(1u, pyramidHeight >> level);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, downsampleLayout, 0, 1, &downsampleSets[level], 0, nullptr);
+			vkCmdDispatch(commandBuffer, (width + 7) / 8, (height + 7) / 8, 1);
+
+			VkMemoryBarrier levelBarrier = vks::initializers::memoryBarrier();
+			levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		/* Hand the depth attachment back to the render pass */
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+
+		/* Last frame's draws must be done reading the commands before they're rewritten */
+		VkMemoryBarrier drawBarrier = vks::initializers::memoryBarrier();
+		drawBarrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		drawBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+
+		if (compact) {
+			vkCmdFillBuffer(commandBuffer, countBuffer, 0, bucketCapacity * sizeof(uint32_t), 0);
+			VkMemoryBarrier clearBarrier = vks::initializers::memoryBarrier();
+			clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		/* One invocation per instance. The dispatch covers every instance registered when this was recorded. */
+		uint32_t instanceCount = 0;
+		for (auto &bucket : buckets) instanceCount += bucket.instanceCount;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullLayout, 0, 1, &cullSet, 0, nullptr);
+		vkCmdDispatch(commandBuffer, (instanceCount + 63) / 64, 1, 1);
+
+		VkMemoryBarrier cullBarrier = vks::initializers::memoryBarrier();
+		cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void HiZCuller::cleanup() {
+		destroyBuffers();
+		cullUBO.destroy();
+
+		vkDestroyPipeline(VKDK::device, downsamplePipeline, nullptr);
+		vkDestroyPipeline(VKDK::device, cullPipeline, nullptr);
+		vkDestroyPipelineLayout(VKDK::device, downsampleLayout, nullptr);
+		vkDestroyPipelineLayout(VKDK::device, cullLayout, nullptr);
+		vkDestroyDescriptorSetLayout(VKDK::device, downsampleSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(VKDK::device, cullSetLayout, nullptr);
+		vkDestroyDescriptorPool(VKDK::device, descriptorPool, nullptr);
+
+		vkDestroySampler(VKDK::device, sampler, nullptr);
+		for (auto view : pyramidLevelViews)
+			vkDestroyImageView(VKDK::device, view, nullptr);
+		vkDestroyImageView(VKDK::device, pyramidView, nullptr);
+		vkDestroyImage(VKDK::device, pyramid, nullptr);
+		vkFreeMemory(VKDK::device, pyramidMemory, nullptr);
+	}
+}
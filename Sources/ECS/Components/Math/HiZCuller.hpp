@@ -0,0 +1,137 @@
+#pragma once
+
+#ifndef GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include "vkdk.hpp"
+#include "FrameUploadBuffer.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace Components::Math {
+	/* GPU driven culling for instanced draws. Before a render pass, the previous frame's depth attachment is reduced
+		into a hierarchical-Z pyramid, where each texel holds the farthest depth of the texels below it. A compute pass
+		then tests the world bounds of every instance against the view frustum and the pyramid, and writes a
+		VkDrawIndexedIndirectCommand stream per bucket. Each bucket is a set of instances sharing a pipeline,
+		material and mesh, drawn with a single indirect call.
+
+		If an indirect count extension is available, visible commands are compacted and their count is read from
+		a buffer. Otherwise, every instance keeps its own command, and hidden ones get an instance count of zero. */
+	class HiZCuller {
+	public:
+		/* Matches the InstanceObject struct in the cull shader */
+		struct Instance {
+			glm::vec4 aabbMin;
+			glm::vec4 aabbMax;
+			uint32_t bucket;
+
+			/* Index of this instance's transform, passed to the draw as its first instance */
+			uint32_t instance;
+			uint32_t flags;
+			uint32_t pad;
+		};
+
+		/* Instances without bounds are always drawn. Missing instances are never drawn. */
+		static const uint32_t HasBounds = 1;
+		static const uint32_t Missing = 2;
+
+		struct Bucket {
+			uint32_t indexCount;
+			uint32_t firstIndex;
+
+			/* Index of the bucket's first command in the draw buffer */
+			uint32_t commandOffset;
+			uint32_t instanceCount;
+		};
+
+		/* Returns true if the compute shaders are available, and the device can draw indirectly with a first instance */
+		static bool IsSupported();
+
+		/* Builds a pyramid over the given depth attachment, which must have been created with the sampled usage bit */
+		HiZCuller(VkImage depthImage, VkImageView depthImageView, VkFormat depthFormat, uint32_t width, uint32_t height);
+
+		VkImage getDepthImage() { return depthImage; }
+
+		/* Replaces the buckets to cull. Each bucket reserves one command per instance. */
+		void setBuckets(std::vector<Bucket> buckets);
+
+		uint32_t getBucketCount() { return (uint32_t)buckets.size(); }
+
+		/* Fills in an indirect draw for the commands of a bucket */
+		void getDraw(uint32_t bucket, VkBuffer &buffer, VkDeviceSize &offset, uint32_t &drawCount, VkBuffer &countBuffer, VkDeviceSize &countOffset);
+
+		/* Writes this frame's instance bounds and camera into the current frame slot, which callers must have waited for
+			(see VKDK::WaitForFrameSlot). Occlusion is skipped on the first frame, since there is no previous depth yet. */
+		void update(const glm::mat4 &viewProjection, const std::vector<Instance> &instances, bool occlusion);
+
+		/* Copies the current slot's inputs to the other frame slots. Only safe while no frame is in flight. */
+		void copyToAllSlots();
+
+		/* Records the copy of the current slot's inputs into the buffers read by the cull dispatch. Callers
+			synchronize it with the dispatch of earlier frames and of this one. */
+		void recordUploads(VkCommandBuffer commandBuffer);
+
+		/* Records the pyramid build and the cull dispatch. Must be recorded outside of a render pass. */
+		void record(VkCommandBuffer commandBuffer);
+
+		void cleanup();
+
+	private:
+		/* Matches the CullBufferObject struct in the cull shader */
+		struct CullBufferObject {
+			glm::mat4 viewProjection;
+			glm::vec4 frustumPlanes[6];
+			glm::vec2 pyramidSize;
+			uint32_t instanceCount;
+			uint32_t mipCount;
+			uint32_t compact;
+			uint32_t occlusion;
+			uint32_t pad0, pad1;
+		};
+
+		VkImage depthImage;
+		VkImageView depthImageView;
+		VkImageAspectFlags depthAspect;
+		uint32_t depthWidth, depthHeight;
+
+		/* The pyramid stays in the general layout, so levels can be read and written between dispatches */
+		VkImage pyramid = VK_NULL_HANDLE;
+		VkDeviceMemory pyramidMemory = VK_NULL_HANDLE;
+		VkImageView pyramidView = VK_NULL_HANDLE;
+		std::vector<VkImageView> pyramidLevelViews;
+		uint32_t pyramidWidth, pyramidHeight, mipCount;
+		VkSampler sampler = VK_NULL_HANDLE;
+
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout downsampleSetLayout = VK_NULL_HANDLE, cullSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout downsampleLayout = VK_NULL_HANDLE, cullLayout = VK_NULL_HANDLE;
+		VkPipeline downsamplePipeline = VK_NULL_HANDLE, cullPipeline = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet> downsampleSets;
+		VkDescriptorSet cullSet = VK_NULL_HANDLE;
+
+		/* Inputs rewritten every frame, with a copy per frame in flight */
+		FrameUploadBuffer cullUBO;
+		FrameUploadBuffer instanceBuffer;
+
+		/* Buckets only change when the perspective is recorded, so they're a single persistently mapped buffer */
+		VkBuffer bucketBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory bucketMemory = VK_NULL_HANDLE;
+		Bucket *bucketData = nullptr;
+
+		/* Device local outputs, written by the cull shader and read by indirect draws */
+		VkBuffer drawBuffer = VK_NULL_HANDLE, countBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory drawMemory = VK_NULL_HANDLE, countMemory = VK_NULL_HANDLE;
+
+		std::vector<Bucket> buckets;
+		uint32_t instanceCapacity = 0, bucketCapacity = 0;
+		bool compact = false;
+		bool firstUpdate = true;
+
+		void createPyramid();
+		void createPipelines();
+		void createBuffers(uint32_t instanceCapacity, uint32_t bucketCapacity);
+		void destroyBuffers();
+		void updateCullDescriptorSet();
+	};
+}
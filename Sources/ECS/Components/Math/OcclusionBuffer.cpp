@@ -0,0 +1,188 @@
+#include "OcclusionBuffer.hpp"
+
+#include "Components/Meshes/Occluder.hpp"
+#include "Tools/WorkerPool.hpp"
+
+#include <algorithm>
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_BUFFER_SSE
+#include <emmintrin.h>
+#endif
+
+namespace Components::Math {
+	/* Triangles or boxes with a vertex closer than this (in clip space w) aren't projected */
+	static const float MinW = 1e-5f;
+
+	OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height) {
+		this->width = ((std::max(width, TileSize) + TileSize - 1) / TileSize) * TileSize;
+		this->height = ((std::max(height, TileSize) + TileSize - 1) / TileSize) * TileSize;
+		tilesX = this->width / TileSize;
+		tilesY = this->height / TileSize;
+		depth.resize(this->width * this->height, 1.0f);
+		tileDepth.resize(tilesX * tilesY, 1.0f);
+	}
+
+	void OcclusionBuffer::render(const glm::mat4 &viewProjection, const std::vector<OccluderInstance> &occluders, uint32_t threadCount) {
+		/* Project occluder triangles into screen space */
+		triangles.clear();
+		for (auto &instance : occluders) {
+			glm::mat4 mvp = viewProjection * instance.localToWorld;
+			auto &points = instance.occluder->points;
+			auto &indices = instance.occluder->indices;
+			std::vector<glm::vec4> clip(points.size());
+			for (size_t i = 0; i < points.size(); ++i)
+				clip[i] = mvp * glm::vec4(points[i], 1.0);
+
+			for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+				const glm::vec4 &c0 = clip[indices[i]], &c1 = clip[indices[i + 1]], &c2 = clip[indices[i + 2]];
+
+				/* Skipping triangles which cross the near plane only makes the occluder smaller, so it stays conservative */
+				if (c0.w < MinW || c1.w < MinW || c2.w < MinW) continue;
+
+				ScreenTriangle t;
+				t.v0 = glm::vec2((c0.x / c0.w * 0.5f + 0.5f) * width, (c0.y / c0.w * 0.5f + 0.5f) * height);
+				t.v1 = glm::vec2((c1.x / c1.w * 0.5f + 0.5f) * width, (c1.y / c1.w * 0.5f + 0.5f) * height);
+				t.v2 = glm::vec2((c2.x / c2.w * 0.5f + 0.5f) * width, (c2.y / c2.w * 0.5f + 0.5f) * height);
+				t.z0 = c0.z / c0.w;
+				t.z1 = c1.z / c1.w;
+				t.z2 = c2.z / c2.w;
+				if (std::max(t.z0, std::max(t.z1, t.z2)) > 1.0f) continue;
+
+				/* Both windings are kept, since occluders may be seen from inside */
+				float area = (t.v1.x - t.v0.x) * (t.v2.y - t.v0.y) - (t.v1.y - t.v0.y) * (t.v2.x - t.v0.x);
+				if (area == 0.0f) continue;
+				if (area < 0.0f) {
+					std::swap(t.v1, t.v2);
+					std::swap(t.z1, t.z2);
+				}
+
+				t.minX = std::max(0, (int)std::floor(std::min(t.v0.x, std::min(t.v1.x, t.v2.x))));
+				t.minY = std::max(0, (int)std::floor(std::min(t.v0.y, std::min(t.v1.y, t.v2.y))));
+				t.maxX = std::min((int)width - 1, (int)std::ceil(std::max(t.v0.x, std::max(t.v1.x, t.v2.x))));
+				t.maxY = std::min((int)height - 1, (int)std::ceil(std::max(t.v0.y, std::max(t.v1.y, t.v2.y))));
+				if (t.minX > t.maxX || t.minY > t.maxY) continue;
+				triangles.push_back(t);
+			}
+		}
+
+		/* Each task owns a band of whole tile rows, so no two threads write the same pixels. The bands run on
+			the shared worker pool, whose threads are reused every frame. */
+		threadCount = std::max(1u, std::min(threadCount, tilesY));
+		uint32_t tileRowsPerBand = (tilesY + threadCount - 1) / threadCount;
+		uint32_t bandCount = (tilesY + tileRowsPerBand - 1) / tileRowsPerBand;
+		Tools::WorkerPool::Get().run(bandCount, [this, tileRowsPerBand](uint32_t band) {
+			uint32_t firstTileRow = band * tileRowsPerBand;
+			uint32_t lastTileRow = std::min(tilesY, firstTileRow + tileRowsPerBand);
+			rasterizeBand(firstTileRow * TileSize, lastTileRow * TileSize);
+			buildTileDepth(firstTileRow, lastTileRow);
+		});
+	}
+
+	void OcclusionBuffer::rasterizeBand(uint32_t firstRow, uint32_t lastRow) {
+		std::fill(depth.begin() + firstRow * width, depth.begin() + lastRow * width, 1.0f);
+		for (auto &triangle : triangles) {
+			if (triangle.maxY < (int)firstRow || triangle.minY >= (int)lastRow) continue;
+			rasterizeTriangle(triangle, std::max(triangle.minY, (int)firstRow), std::min(triangle.maxY, (int)lastRow - 1));
+		}
+	}
+
+	void OcclusionBuffer::rasterizeTriangle(const ScreenTriangle &t, int firstRow, int lastRow) {
+		/* Edge functions, positive inside a counter clockwise triangle, evaluated at pixel centers */
+		float a0 = t.v1.y - t.v2.y, b0 = t.v2.x - t.v1.x;
+		float a1 = t.v2.y - t.v0.y, b1 = t.v0.x - t.v2.x;
+		float a2 = t.v0.y - t.v1.y, b2 = t.v1.x - t.v0.x;
+		float area = a2 * (t.v2.x - t.v0.x) + b2 * (t.v2.y - t.v0.y);
+		float inverseArea = 1.0f / area;
+
+		/* Depth is linear in screen space after the perspective divide */
+		float dzdx = (a0 * t.z0 + a1 * t.z1 + a2 * t.z2) * inverseArea;
+		float dzdy = (b0 * t.z0 + b1 * t.z1 + b2 * t.z2) * inverseArea;
+
+		int startX = t.minX & ~3;
+		for (int y = firstRow; y <= lastRow; ++y) {
+			float px = startX + 0.5f, py = y + 0.5f;
+			float e0 = a0 * (px - t.v1.x) + b0 * (py - t.v1.y);
+			float e1 = a1 * (px - t.v2.x) + b1 * (py - t.v2.y);
+			float e2 = a2 * (px - t.v0.x) + b2 * (py - t.v0.y);
+			float z = t.z0 + dzdx * (px - t.v0.x) + dzdy * (py - t.v0.y);
+			float *row = &depth[y * width];
+
+#ifdef OCCLUSION_BUFFER_SSE
+			__m128 steps = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+			__m128 e0v = _mm_add_ps(_mm_set1_ps(e0), _mm_mul_ps(steps, _mm_set1_ps(a0)));
+			__m128 e1v = _mm_add_ps(_mm_set1_ps(e1), _mm_mul_ps(steps, _mm_set1_ps(a1)));
+			__m128 e2v = _mm_add_ps(_mm_set1_ps(e2), _mm_mul_ps(steps, _mm_set1_ps(a2)));
+			__m128 zv = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(steps, _mm_set1_ps(dzdx)));
+			__m128 e0Step = _mm_set1_ps(a0 * 4.0f), e1Step = _mm_set1_ps(a1 * 4.0f), e2Step = _mm_set1_ps(a2 * 4.0f);
+			__m128 zStep = _mm_set1_ps(dzdx * 4.0f);
+			__m128 zero = _mm_setzero_ps();
+			for (int x = startX; x <= t.maxX; x += 4) {
+				__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0v, zero), _mm_cmpge_ps(e1v, zero)), _mm_cmpge_ps(e2v, zero));
+				if (_mm_movemask_ps(inside)) {
+					__m128 current = _mm_loadu_ps(row + x);
+					__m128 closer = _mm_min_ps(current, zv);
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, current)));
+				}
+				e0v = _mm_add_ps(e0v, e0Step);
+				e1v = _mm_add_ps(e1v, e1Step);
+				e2v = _mm_add_ps(e2v, e2Step);
+				zv = _mm_add_ps(zv, zStep);
+			}
+#else
+			for (int x = startX; x <= t.maxX; ++x) {
+				if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f)
+					row[x] = std::min(row[x], z);
+				e0 += a0;
+				e1 += a1;
+				e2 += a2;
+				z += dzdx;
+			}
+#endif
+		}
+	}
+
+	void OcclusionBuffer::buildTileDepth(uint32_t firstTileRow, uint32_t lastTileRow) {
+		for (uint32_t ty = firstTileRow; ty < lastTileRow; ++ty) {
+			for (uint32_t tx = 0; tx < tilesX; ++tx) {
+				float farthest = 0.0f;
+				for (uint32_t y = ty * TileSize; y < (ty + 1) * TileSize; ++y) {
+					const float *row = &depth[y * width + tx * TileSize];
+					for (uint32_t x = 0; x < TileSize; ++x)
+						farthest = std::max(farthest, row[x]);
+				}
+				tileDepth[ty * tilesX + tx] = farthest;
+			}
+		}
+	}
+
+	bool OcclusionBuffer::isVisible(const glm::mat4 &viewProjection, glm::vec3 minP, glm::vec3 maxP) const {
+		glm::vec2 screenMin(FLT_MAX), screenMax(-FLT_MAX);
+		float nearestZ = FLT_MAX;
+		for (int i = 0; i < 8; ++i) {
+			glm::vec3 corner((i & 1) ? maxP.x : minP.x, (i & 2) ? maxP.y : minP.y, (i & 4) ? maxP.z : minP.z);
+			glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0);
+
+			/* Boxes which cross the near plane are assumed visible */
+			if (clip.w < MinW) return true;
+			glm::vec2 screen((clip.x / clip.w * 0.5f + 0.5f) * width, (clip.y / clip.w * 0.5f + 0.5f) * height);
+			screenMin = glm::min(screenMin, screen);
+			screenMax = glm::max(screenMax, screen);
+			nearestZ = std::min(nearestZ, clip.z / clip.w);
+		}
+
+		int minTileX = std::max(0, (int)std::floor(screenMin.x) / (int)TileSize);
+		int minTileY = std::max(0, (int)std::floor(screenMin.y) / (int)TileSize);
+		int maxTileX = std::min((int)tilesX - 1, (int)std::floor(screenMax.x) / (int)TileSize);
+		int maxTileY = std::min((int)tilesY - 1, (int)std::floor(screenMax.y) / (int)TileSize);
+
+		/* Off screen boxes are left to the frustum test */
+		if (minTileX > maxTileX || minTileY > maxTileY) return true;
+
+		for (int ty = minTileY; ty <= maxTileY; ++ty)
+			for (int tx = minTileX; tx <= maxTileX; ++tx)
+				if (nearestZ <= tileDepth[ty * tilesX + tx]) return true;
+		return false;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#ifndef GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+
+namespace Components::Meshes { class Occluder; }
+
+namespace Components::Math {
+	/* A coarse CPU depth buffer for occlusion culling. Occluders are rasterized into it with SIMD, split
+		into horizontal bands across threads, then each tile of the buffer is reduced to its farthest depth.
+		Bounds whose nearest point is behind every tile they cover are considered hidden. */
+	class OcclusionBuffer {
+	public:
+		static constexpr uint32_t TileSize = 8;
+
+		struct OccluderInstance {
+			glm::mat4 localToWorld;
+			std::shared_ptr<Components::Meshes::Occluder> occluder;
+		};
+
+		/* Width and height are rounded up to a multiple of the tile size */
+		OcclusionBuffer(uint32_t width, uint32_t height);
+
+		uint32_t getWidth() { return width; }
+		uint32_t getHeight() { return height; }
+
+		/* Clears, rasterizes all occluders, then rebuilds the tile depths. The work is split into at most threadCount
+			bands, which run on the shared Tools::WorkerPool. */
+		void render(const glm::mat4 &viewProjection, const std::vector<OccluderInstance> &occluders, uint32_t threadCount);
+
+		/* Returns false only if the box is certainly hidden behind previously rendered occluders */
+		bool isVisible(const glm::mat4 &viewProjection, glm::vec3 minP, glm::vec3 maxP) const;
+
+	private:
+		struct ScreenTriangle {
+			glm::vec2 v0, v1, v2;
+			float z0, z1, z2;
+			int minX, minY, maxX, maxY;
+		};
+
+		uint32_t width, height;
+		uint32_t tilesX, tilesY;
+		std::vector<float> depth;
+		std::vector<float> tileDepth;
+		std::vector<ScreenTriangle> triangles;
+
+		void rasterizeBand(uint32_t firstRow, uint32_t lastRow);
+		void rasterizeTriangle(const ScreenTriangle &triangle, int firstRow, int lastRow);
+		void buildTileDepth(uint32_t firstTileRow, uint32_t lastTileRow);
+	};
+}
@@ -5,8 +5,197 @@
 #include "Components/Materials/Materials.hpp"
 #include "Components/Meshes/Meshes.hpp"
 #include "Components/Lights/PointLight/PointLight.hpp"
+#include "Systems/SceneBVH.hpp"
+#include "Systems/RenderQueue.hpp"
+#include "Tools/WorkerPool.hpp"
+
+#include <thread>
+
+namespace {
+	/* Which faces a pipeline culls, as stored in IndirectDraws::clusterFacing. Front face culling and clockwise
+		winding each flip the culled side, and nothing can be skipped if the pipeline culls no faces, or all of them. */
+	int32_t getClusterFacing(const PipelineKey &key) {
+		VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+		VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		auto settings = Systems::ComponentManager::PipelineSettings.find(key);
+		if (settings != Systems::ComponentManager::PipelineSettings.end()) {
+			cullMode = settings->second->rasterizer.cullMode;
+			frontFace = settings->second->rasterizer.frontFace;
+		}
+		if (cullMode != VK_CULL_MODE_BACK_BIT && cullMode != VK_CULL_MODE_FRONT_BIT) return 0;
+		int32_t facing = (cullMode == VK_CULL_MODE_BACK_BIT) ? 1 : -1;
+		return (frontFace == VK_FRONT_FACE_CLOCKWISE) ? -facing : facing;
+	}
+}
 
 void Components::Math::Perspective::recordRenderPass(glm::vec4 clearColor, float clearDepth, uint32_t clearStencil) {
+	/* Read the version first, so changes made while recording trigger another recording */
+	recordedVersion = Systems::SceneGraph::GetVersion(renderpass);
+	recordedClearColor = clearColor;
+	recordedClearDepth = clearDepth;
+	recordedClearStencil = clearStencil;
+	recorded = true;
+
+	/* Descriptor sets requested from here on are referenced by this recording */
+	uint64_t descriptorRecording = Components::Materials::DescriptorAllocator::BeginRecording(this);
+
+	/* Draws are ordered by their distance from the camera at the time of recording */
+	glm::vec3 cameraPosition = glm::vec3(glm::inverse(views[0])[3]);
+
+	auto culler = getHiZCuller();
+
+	/* Group entities which share a mesh and a material instance into instanced batches. With GPU culling,
+		lone entities get a batch too, so that they can be culled with everything else. */
+	std::map<BatchKey, std::vector<std::string>> batches;
+	std::map<BatchKey, std::shared_ptr<Components::Meshes::Mesh>> batchMeshes;
+	if (instancing || culler) {
+		for (auto pair : Systems::SceneGraph::Entities) {
+			if (!pair.second->isActive()) continue;
+			auto meshComponent = pair.second->getFirstComponent<Components::Meshes::Mesh>();
+			if (!meshComponent) continue;
+			for (auto &material : pair.second->getComponents<Components::Materials::Material>()) {
+				PipelineKey matPipelineKey = material->material->getPipelineKey();
+				if (matPipelineKey.renderpass != renderpass) continue;
+				if (!material->material->supportsInstancing(matPipelineKey)) continue;
+				BatchKey batchKey(material->material.get(), meshComponent->mesh.get());
+				batches[batchKey].push_back(pair.first);
+				batchMeshes[batchKey] = meshComponent;
+			}
+		}
+	}
+	uint32_t minBatchSize = (culler) ? 1 : 2;
+
+	/* Drop batches whose entities were removed, hidden or given other materials since the last recording */
+	for (auto it = instanceBatches.begin(); it != instanceBatches.end();) {
+		auto batch = batches.find(it->first);
+		if (batch != batches.end() && batch->second.size() >= minBatchSize) { ++it; continue; }
+		destroyInstanceBatch(it->second);
+		it = instanceBatches.erase(it);
+	}
+	instancedDraws = instancedEntities = 0;
+	for (auto &batch : batches) {
+		if (batch.second.size() < 2) continue;
+		instancedDraws++;
+		instancedEntities += (uint32_t)batch.second.size();
+	}
+
+	/* Each GPU culled batch gets a bucket of indirect commands */
+	for (auto &pair : instanceBatches) pair.second.gpuBucket = ~0u;
+	if (culler) {
+		std::vector<HiZCuller::Bucket> buckets;
+		for (auto &batch : batches) {
+			auto instanceBatch = getInstanceBatch(batch.first, batch.second, batchMeshes[batch.first]);
+			instanceBatch->gpuBucket = (uint32_t)buckets.size();
+			HiZCuller::Bucket bucket = {};
+			bucket.indexCount = batchMeshes[batch.first]->mesh->getTotalIndices();
+			bucket.firstIndex = 0;
+			bucket.instanceCount = (uint32_t)batch.second.size();
+			buckets.push_back(bucket);
+		}
+		culler->setBuckets(buckets);
+	}
+
+	/* Todo: implement this */
+	int totalRenderPasses = 1;
+
+	/* The draws are the same for every framebuffer, so each subpass's queue is only built once */
+	std::vector<Systems::RenderQueue> queues(totalRenderPasses);
+	std::unordered_map<std::string, int32_t> clusterFacings;
+	for (int subpassIdx = 0; subpassIdx < totalRenderPasses; ++subpassIdx) {
+		/* Gather a draw for each entity and material in this subpass, then sort them by state and depth */
+		auto &queue = queues[subpassIdx];
+		for (auto pair : Systems::SceneGraph::Entities) {
+			if (!pair.second->isActive()) continue;
+			auto materialComponents = pair.second->getComponents<Components::Materials::Material>();
+			auto meshComponent = pair.second->getFirstComponent<Components::Meshes::Mesh>();
+
+			/* If an entity has all of the above components */
+			if (materialComponents.size() > 0 && meshComponent) {
+				/* Distance from the camera, normalized between the near and far planes */
+				glm::vec3 position = (pair.second->hasBounds) ? pair.second->worldSphereCenter
+					: glm::vec3(glm::inverse(pair.second->getWorldToLocalMatrix())[3]);
+				float depth = (glm::distance(position, cameraPosition) - getNear()) / (getFar() - getNear());
+
+				for (int matIdx = 0; matIdx < materialComponents.size(); ++matIdx) {
+					PipelineKey matPipelineKey = materialComponents[matIdx]->material->getPipelineKey();
+
+					/* If the material's key doesnt match the current pass/subpass, continue. */
+					if (matPipelineKey.renderpass != renderpass
+						|| matPipelineKey.subpass != subpassIdx) continue;
+
+					auto settings = Systems::ComponentManager::PipelineSettings.find(matPipelineKey);
+					bool transparent = settings != Systems::ComponentManager::PipelineSettings.end() && settings->second->transparent;
+
+					/* Batched entities are queued once, by the first entity of the batch */
+					BatchKey batchKey(materialComponents[matIdx]->material.get(), meshComponent->mesh.get());
+					auto batch = batches.find(batchKey);
+					if (batch != batches.end() && batch->second.size() >= minBatchSize) {
+						if (batch->second[0] != pair.first) continue;
+						/* Pipelines compile in the background. Finishing one re-records this perspective. */
+						if (!materialComponents[matIdx]->material->isPipelineReady(matPipelineKey, true)) continue;
+						auto instanceBatch = getInstanceBatch(batchKey, batch->second, meshComponent);
+
+						Components::Materials::UBOSet uboset = {};
+						uboset.transformUBO = pair.second->transform->getUBO();
+						uboset.perspectiveUBO = perspectiveUBO;
+						uboset.pointLightUBO = Components::Lights::PointLights::GetUBO();
+						uboset.instanceBuffer = instanceBatch->instances.getBuffer();
+						VkDescriptorSet descriptor = materialComponents[matIdx]->material->getDescriptorSet(uboset);
+
+						Components::Materials::DrawInfo drawInfo = {};
+						drawInfo.indirectBuffer = instanceBatch->command.getBuffer();
+						drawInfo.drawCount = 1;
+						drawInfo.instanced = true;
+						if (culler && instanceBatch->gpuBucket != ~0u) {
+							culler->getDraw(instanceBatch->gpuBucket, drawInfo.indirectBuffer, drawInfo.indirectOffset,
+								drawInfo.drawCount, drawInfo.countBuffer, drawInfo.countOffset);
+						}
+						queue.add(matPipelineKey, materialComponents[matIdx], meshComponent, descriptor, drawInfo, depth, transparent);
+						continue;
+					}
+
+					if (!materialComponents[matIdx]->material->isPipelineReady(matPipelineKey)) continue;
+
+					Components::Materials::UBOSet uboset = {};
+					uboset.transformUBO = pair.second->transform->getUBO();
+					uboset.perspectiveUBO = perspectiveUBO;
+					uboset.pointLightUBO = Components::Lights::PointLights::GetUBO();
+					VkDescriptorSet descriptor = materialComponents[matIdx]->material->getDescriptorSet(uboset);
+
+					/* Clustered meshes are drawn indirectly, so that culling can change what's drawn without re-recording */
+					Components::Materials::DrawInfo drawInfo = {};
+					drawInfo.transformIndex = pair.second->transform->getTableIndex();
+					auto draws = getIndirectDraws(pair.first, meshComponent);
+					if (draws) {
+						drawInfo.indirectBuffer = draws->commands.getBuffer();
+						drawInfo.drawCount = draws->drawCount;
+
+						/* An entity's commands are shared by all of its materials, which might cull different faces */
+						int32_t facing = getClusterFacing(matPipelineKey);
+						auto previous = clusterFacings.find(pair.first);
+						if (previous != clusterFacings.end() && previous->second != facing) facing = 0;
+						clusterFacings[pair.first] = facing;
+						draws->clusterFacing = facing;
+					}
+					queue.add(matPipelineKey, materialComponents[matIdx], meshComponent, descriptor, drawInfo, depth, transparent);
+				}
+			}
+		}
+		queue.sort();
+	}
+
+	/* Large passes are split into contiguous ranges of the sorted queue, recorded into secondary command buffers in parallel */
+	uint32_t workerCount = 1;
+	if (parallelRecording) {
+		size_t totalDraws = 0;
+		for (auto &queue : queues) totalDraws = std::max(totalDraws, queue.getItems().size());
+		uint32_t maxThreads = (recordingThreadCount > 0) ? recordingThreadCount : std::max(1u, std::thread::hardware_concurrency());
+		workerCount = (uint32_t)std::min<size_t>(maxThreads, totalDraws / std::max(1u, minDrawsPerThread));
+		workerCount = std::max(1u, workerCount);
+	}
+	bool secondary = workerCount > 1;
+	if (secondary) recordSecondaryCommandBuffers(queues, workerCount);
+
 	for (int i = 0; i < commandBuffers.size(); ++i) {
 		/* Render to offscreen texture */
 		VkCommandBufferBeginInfo beginInfo = {};
@@ -32,29 +221,14 @@ void Components::Math::Perspective::recordRenderPass(glm::vec4 clearColor, float
 			preRenderPassCallback(commandBuffers[i]);
 		}
 
-		/* Start the render pass */
-		vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-		/* Set viewport*/
-		VkViewport viewport{};
-		viewport.width = (float)framebufferWidth;
-		viewport.height = (float)framebufferHeight;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
-
-		/* Set Scissors */
-		VkRect2D rect2D{};
-		rect2D.extent.width = framebufferWidth;
-		rect2D.extent.height = framebufferHeight;
-		rect2D.offset.x = 0;
-		rect2D.offset.y = 0;
+		/* Build this frame's draws from last frame's depth, before the render pass clears it */
+		if (culler) {
+			culler->record(commandBuffers[i]);
+		}
 
-		vkCmdSetScissor(commandBuffers[i], 0, 1, &rect2D);
-		
-		/* Todo: implement this */
-		int totalRenderPasses = 1;
+		/* Start the render pass */
+		vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, 
+			(secondary) ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
 
 		/* For each subpass */
 		for (int subpassIdx = 0; subpassIdx < totalRenderPasses; ++subpassIdx) {
@@ -62,33 +236,502 @@ void Components::Math::Perspective::recordRenderPass(glm::vec4 clearColor, float
 			//if (subpassIdx != 0)
 				//vkCmdNextSubpass(...)
 
-			/* For each entity */
-			for (auto pair : Systems::SceneGraph::Entities) {
-				auto materialComponents = pair.second->getComponents<Components::Materials::Material>();
-				auto meshComponent = pair.second->getFirstComponent<Components::Meshes::Mesh>();
+			if (secondary) {
+				std::vector<VkCommandBuffer> subpassBuffers;
+				for (uint32_t w = 0; w < workerCount; ++w)
+					subpassBuffers.push_back(secondaryCommandBuffers[w][i * totalRenderPasses + subpassIdx]);
+				vkCmdExecuteCommands(commandBuffers[i], (uint32_t)subpassBuffers.size(), subpassBuffers.data());
+				continue;
+			}
 
-				/* If an entity has all of the above components */
-				if (materialComponents.size() > 0 && meshComponent) {
-					for (int matIdx = 0; matIdx < materialComponents.size(); ++matIdx) {
-						PipelineKey matPipelineKey = materialComponents[matIdx]->material->getPipelineKey();
+			setViewportAndScissor(commandBuffers[i]);
+			queues[subpassIdx].record(commandBuffers[i]);
+		}
+		
+		/* End the render pass */
+		vkCmdEndRenderPass(commandBuffers[i]);
 
-						/* If the material's key doesnt match the current pass/subpass, continue. */
-						if (matPipelineKey.renderpass != renderpass
-							|| matPipelineKey.subpass != subpassIdx) continue;
+		/* Rebuild the mip chain of a mipmapped render texture from what was just rendered */
+		if (renderTexture && renderTexture->texture->getColorMipLevels() > 1)
+			renderTexture->texture->generateColorMipMaps(commandBuffers[i],
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-						Components::Materials::UBOSet uboset = {};
-						uboset.transformUBO = pair.second->transform->getUBO();
-						uboset.perspectiveUBO = perspectiveUBO;
-						uboset.pointLightUBO = Components::Lights::PointLights::GetUBO();
-						VkDescriptorSet descriptor = materialComponents[matIdx]->material->getDescriptorSet(uboset);
-						materialComponents[matIdx]->material->render(matPipelineKey, commandBuffers[i], descriptor, meshComponent);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffers[i]));
+	}
+
+	/* Nothing is in flight while recording (see updateRecording), so every frame slot starts from the contents
+		written above, and the buffers this recording reads are filled before it's first submitted */
+	if (!indirectDraws.empty() || !instanceBatches.empty() || culler) {
+		for (auto &pair : indirectDraws) pair.second.commands.copyToAllSlots();
+		for (auto &pair : instanceBatches) {
+			pair.second.instances.copyToAllSlots();
+			pair.second.command.copyToAllSlots();
+		}
+		if (culler) culler->copyToAllSlots();
+		VkCommandBuffer uploadCommandBuffer = VKDK::beginSingleTimeCommands();
+		recordUploads(uploadCommandBuffer);
+		VKDK::endSingleTimeCommands(uploadCommandBuffer);
+	}
+
+	/* Sets only used by the previous recording can now be recycled */
+	Components::Materials::DescriptorAllocator::FinishRecording(this, descriptorRecording);
+}
+
+bool Components::Math::Perspective::updateRecording() {
+	if (!recorded || !canRender) return false;
+	if (Systems::SceneGraph::GetVersion(renderpass) == recordedVersion) return false;
+
+	/* Command buffers are recorded once and reused, so they can't be reset while the last frame might still use them */
+	VKDK::WaitForFrame();
+	recordRenderPass(recordedClearColor, recordedClearDepth, recordedClearStencil);
+	return true;
+}
+
+void Components::Math::Perspective::setViewportAndScissor(VkCommandBuffer commandBuffer) {
+	/* Set viewport*/
+	VkViewport viewport{};
+	viewport.width = (float)framebufferWidth;
+	viewport.height = (float)framebufferHeight;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	/* Set Scissors */
+	VkRect2D rect2D{};
+	rect2D.extent.width = framebufferWidth;
+	rect2D.extent.height = framebufferHeight;
+	rect2D.offset.x = 0;
+	rect2D.offset.y = 0;
+
+	vkCmdSetScissor(commandBuffer, 0, 1, &rect2D);
+}
+
+void Components::Math::Perspective::recordSecondaryCommandBuffers(std::vector<Systems::RenderQueue> &queues, uint32_t workerCount) {
+	uint32_t buffersPerWorker = (uint32_t)(commandBuffers.size() * queues.size());
+
+	/* Command pools can't be used by more than one thread at a time, so each range gets its own */
+	while (recordingPools.size() < workerCount) {
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = VKDK::FindQueueFamilies(VKDK::physicalDevice).graphicsFamily;
+		VkCommandPool pool;
+		if (vkCreateCommandPool(VKDK::device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create recording command pool!");
+		}
+		recordingPools.push_back(pool);
+		secondaryCommandBuffers.push_back({});
+		secondarySignatures.push_back(0);
+	}
+
+	/* Recordings depend on the framebuffers and viewport as well as the draws */
+	size_t targetHash = 0;
+	hash_combine(targetHash, (const void*)renderpass, framebufferWidth, framebufferHeight);
+	for (auto frameBuffer : frameBuffers) hash_combine(targetHash, (const void*)frameBuffer);
+
+	auto recordWorker = [&](uint32_t w) {
+		size_t signature = targetHash;
+		for (uint32_t subpassIdx = 0; subpassIdx < queues.size(); ++subpassIdx) {
+			size_t itemCount = queues[subpassIdx].getItems().size();
+			size_t first = (itemCount * w) / workerCount;
+			size_t last = (itemCount * (w + 1)) / workerCount;
+			hash_combine(signature, queues[subpassIdx].hashRange(first, last - first));
+		}
+		auto &buffers = secondaryCommandBuffers[w];
+		if (buffers.size() >= buffersPerWorker && secondarySignatures[w] == signature) return;
+
+		/* Resetting the pool returns every secondary buffer it owns to the initial state */
+		vkResetCommandPool(VKDK::device, recordingPools[w], 0);
+		secondarySignatures[w] = 0;
+		if (buffers.size() < buffersPerWorker) {
+			uint32_t first = (uint32_t)buffers.size();
+			buffers.resize(buffersPerWorker);
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = recordingPools[w];
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandBufferCount = buffersPerWorker - first;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(VKDK::device, &allocInfo, &buffers[first]));
+		}
+
+		for (uint32_t i = 0; i < commandBuffers.size(); ++i) {
+			for (uint32_t subpassIdx = 0; subpassIdx < queues.size(); ++subpassIdx) {
+				VkCommandBuffer commandBuffer = buffers[i * queues.size() + subpassIdx];
+
+				VkCommandBufferInheritanceInfo inheritanceInfo = {};
+				inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+				inheritanceInfo.renderPass = renderpass;
+				inheritanceInfo.subpass = subpassIdx;
+				inheritanceInfo.framebuffer = frameBuffers[i];
+
+				VkCommandBufferBeginInfo beginInfo = {};
+				beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+				beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+				beginInfo.pInheritanceInfo = &inheritanceInfo;
+				vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+				/* Dynamic state isn't inherited from the primary command buffer */
+				setViewportAndScissor(commandBuffer);
+
+				size_t itemCount = queues[subpassIdx].getItems().size();
+				size_t first = (itemCount * w) / workerCount;
+				size_t last = (itemCount * (w + 1)) / workerCount;
+				queues[subpassIdx].record(commandBuffer, first, last - first);
+
+				VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+			}
+		}
+		secondarySignatures[w] = signature;
+	};
+
+	/* Ranges are handed to the shared worker pool, whose threads are reused across recordings. The calling
+		thread records too. Each range is recorded by one thread, so its command pool is never used concurrently. */
+	Tools::WorkerPool::Get().run(workerCount, recordWorker);
+}
+
+Components::Math::Perspective::IndirectDraws *Components::Math::Perspective::getIndirectDraws(
+	std::string entityName, std::shared_ptr<Components::Meshes::Mesh> meshComponent) 
+{
+	if (!frustumCulling && !clusterCulling && !occlusionCulling) return nullptr;
+
+	auto &meshlets = meshComponent->mesh->getMeshlets();
+	bool clustered = clusterCulling && meshlets.size() > 1;
+	uint32_t drawCount = (clustered) ? (uint32_t)meshlets.size() : 1;
+
+	auto existing = indirectDraws.find(entityName);
+	if (existing != indirectDraws.end() && existing->second.drawCount == drawCount && existing->second.clustered == clustered)
+		return &existing->second;
+
+	IndirectDraws draws;
+	draws.drawCount = drawCount;
+	draws.clustered = clustered;
+	draws.viewMask = (1u << viewCount) - 1;
+	draws.commands.create(draws.drawCount * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+	/* Until the first cull, everything is drawn. The other frame slots are filled once recording is done. */
+	auto commands = draws.commands.getData<VkDrawIndexedIndirectCommand>();
+	for (uint32_t i = 0; i < draws.drawCount; ++i) {
+		commands[i].indexCount = (clustered) ? meshlets[i].indexCount : meshComponent->mesh->getTotalIndices();
+		commands[i].instanceCount = 1;
+		commands[i].firstIndex = (clustered) ? meshlets[i].firstIndex : 0;
+		commands[i].vertexOffset = 0;
+		commands[i].firstInstance = 0;
+	}
+
+	if (existing != indirectDraws.end())
+		existing->second.commands.destroy();
+	indirectDraws[entityName] = draws;
+	return &indirectDraws[entityName];
+}
+
+Components::Math::Perspective::InstanceBatch *Components::Math::Perspective::getInstanceBatch(
+	BatchKey batchKey, std::vector<std::string> entityNames, std::shared_ptr<Components::Meshes::Mesh> meshComponent)
+{
+	auto existing = instanceBatches.find(batchKey);
+	if (existing != instanceBatches.end() && existing->second.entities == entityNames)
+		return &existing->second;
+
+	InstanceBatch batch;
+	batch.entities = entityNames;
+
+	batch.instances.create(entityNames.size() * sizeof(Components::Math::TransformBufferObject), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	batch.command.create(sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+	/* Until the first cull, every instance is drawn with its current transform */
+	auto instances = batch.instances.getData<Components::Math::TransformBufferObject>();
+	uint32_t instanceCount = 0;
+	for (auto &name : entityNames) {
+		auto entity = Systems::SceneGraph::Entities.find(name);
+		if (entity == Systems::SceneGraph::Entities.end()) continue;
+		instances[instanceCount].worldToLocal = entity->second->getWorldToLocalMatrix();
+		instances[instanceCount].localToWorld = glm::inverse(instances[instanceCount].worldToLocal);
+		instanceCount++;
+	}
+	auto command = batch.command.getData<VkDrawIndexedIndirectCommand>();
+	command->indexCount = meshComponent->mesh->getTotalIndices();
+	command->instanceCount = instanceCount;
+	command->firstIndex = 0;
+	command->vertexOffset = 0;
+	command->firstInstance = 0;
+
+	if (existing != instanceBatches.end())
+		destroyInstanceBatch(existing->second);
+	instanceBatches[batchKey] = batch;
+	return &instanceBatches[batchKey];
+}
+
+void Components::Math::Perspective::destroyInstanceBatch(InstanceBatch &batch) {
+	batch.instances.destroy();
+	batch.command.destroy();
+}
+
+std::shared_ptr<Components::Math::HiZCuller> Components::Math::Perspective::getHiZCuller() {
+	if (!gpuCulling || viewCount != 1 || !HiZCuller::IsSupported()) return nullptr;
+
+	/* Offscreen perspectives cull against their render texture's depth, and swapchain perspectives against the shared depth
+		buffer, which is only kept between frames if VKDK was initialized with sampledDepth */
+	VkImage depthImage;
+	VkImageView depthImageView;
+	VkFormat depthFormat;
+	if (renderTexture) {
+		depthImage = renderTexture->texture->getDepthImage();
+		depthImageView = renderTexture->texture->getDepthImageView();
+		depthFormat = renderTexture->texture->getDepthFormat();
+	}
+	else if (useSwapchain && VKDK::currentSettings.sampledDepth) {
+		depthImage = VKDK::depthImage;
+		depthImageView = VKDK::depthImageView;
+		depthFormat = VKDK::depthFormat;
+	}
+	else return nullptr;
+
+	/* The swapchain's depth buffer is replaced when the window is resized */
+	if (hiZCuller && hiZCuller->getDepthImage() == depthImage) return hiZCuller;
+	if (hiZCuller) hiZCuller->cleanup();
+	hiZCuller = std::make_shared<HiZCuller>(depthImage, depthImageView, depthFormat, framebufferWidth, framebufferHeight);
+	return hiZCuller;
+}
+
+void Components::Math::Perspective::cull() {
+	culledEntities = 0;
+	culledClusters = 0;
+	for (uint32_t v = 0; v < MAX_MULTIVIEW; ++v) occludedEntities[v] = 0;
+	if (indirectDraws.empty() && instanceBatches.empty()) return;
+
+	/* Commands, instances and GPU culling inputs have a copy per frame in flight. Only this slot's copy is
+		rewritten, which the GPU is done with once the frame that last used the slot has finished. */
+	VKDK::WaitForFrameSlot();
+
+	/* All views of a multiview perspective share the same origin */
+	glm::mat4 viewInverse = glm::inverse(views[0]);
+	glm::vec3 cameraPosition = glm::vec3(viewInverse[3]);
+	glm::vec3 cameraDirection = -glm::vec3(viewInverse[2]);
+	bool orthographic = projections[0][3][3] == 1.0f;
+
+	Frustum worldFrustums[MAX_MULTIVIEW];
+	for (uint32_t v = 0; v < viewCount; ++v)
+		worldFrustums[v] = Frustum(projections[v] * views[v]);
+
+	/* If the scene hierarchy is available, gather visible entities per view from it instead of testing each one */
+	bool useSceneBVH = frustumCulling && Systems::SceneBVH::IsBuilt();
+	std::unordered_map<Entities::Entity*, uint32_t> sceneViewMasks;
+	if (useSceneBVH) {
+		for (uint32_t v = 0; v < viewCount; ++v)
+			for (auto &entity : Systems::SceneBVH::QueryFrustum(worldFrustums[v]))
+				sceneViewMasks[entity.get()] |= (1u << v);
+	}
+
+	/* Rasterize occluders into a coarse depth buffer per view */
+	std::vector<OcclusionBuffer::OccluderInstance> occluders;
+	if (occlusionCulling) {
+		for (auto &entity : Systems::SceneGraph::Entities) {
+			auto occluder = entity.second->getFirstComponent<Components::Meshes::Occluder>();
+			if (!occluder) continue;
+			occluders.push_back({ glm::inverse(entity.second->getWorldToLocalMatrix()), occluder });
+		}
+	}
+	if (!occluders.empty()) {
+		if (occlusionBuffers.size() != viewCount) {
+			/* Keep the framebuffer's aspect ratio, so tiles stay roughly square */
+			uint32_t width = occlusionBufferSize;
+			uint32_t height = occlusionBufferSize;
+			if (framebufferWidth > framebufferHeight) height = std::max(OcclusionBuffer::TileSize, (occlusionBufferSize * framebufferHeight) / framebufferWidth);
+			else if (framebufferHeight > framebufferWidth) width = std::max(OcclusionBuffer::TileSize, (occlusionBufferSize * framebufferWidth) / framebufferHeight);
+			occlusionBuffers.clear();
+			for (uint32_t v = 0; v < viewCount; ++v)
+				occlusionBuffers.push_back(std::make_shared<OcclusionBuffer>(width, height));
+		}
+		uint32_t threadCount = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+		for (uint32_t v = 0; v < viewCount; ++v)
+			occlusionBuffers[v]->render(projections[v] * views[v], occluders, threadCount);
+	}
+
+	/* Entity level test, against the world space bounds from the last transform update. Returns a mask of the views which can see the entity. */
+	auto getViewMask = [&](const std::shared_ptr<Entities::Entity> &entity) {
+		uint32_t viewMask = (1u << viewCount) - 1;
+		/* Entities given bounds since the hierarchy was last updated aren't in it yet, so they're tested directly */
+		if (useSceneBVH && entity->hasBounds && Systems::SceneBVH::Contains(entity.get())) {
+			auto mask = sceneViewMasks.find(entity.get());
+			viewMask = (mask != sceneViewMasks.end()) ? mask->second : 0;
+		}
+		else if (frustumCulling && entity->hasBounds) {
+			viewMask = 0;
+			for (uint32_t v = 0; v < viewCount; ++v) {
+				if (worldFrustums[v].intersectsSphere(entity->worldSphereCenter, entity->worldSphereRadius)
+					&& worldFrustums[v].intersectsAABB(entity->worldAABBMin, entity->worldAABBMax))
+					viewMask |= (1u << v);
+			}
+		}
+
+		/* Occlusion test, only for views which survived frustum culling */
+		if (!occluders.empty() && entity->hasBounds) {
+			for (uint32_t v = 0; v < viewCount; ++v) {
+				if (!(viewMask & (1u << v))) continue;
+				if (occlusionBuffers[v]->isVisible(projections[v] * views[v], entity->worldAABBMin, entity->worldAABBMax)) continue;
+				viewMask &= ~(1u << v);
+				occludedEntities[v]++;
+			}
+		}
+		return viewMask;
+	};
+
+	/* GPU culled batches keep every transform in place, and send their bounds to the culler instead */
+	std::vector<HiZCuller::Instance> gpuInstances;
+	for (auto &pair : instanceBatches) {
+		auto &batch = pair.second;
+		if (batch.gpuBucket == ~0u) continue;
+		auto instances = batch.instances.getData<Components::Math::TransformBufferObject>();
+		for (uint32_t j = 0; j < batch.entities.size(); ++j) {
+			HiZCuller::Instance instance = {};
+			instance.bucket = batch.gpuBucket;
+			instance.instance = j;
+			auto entity = Systems::SceneGraph::Entities.find(batch.entities[j]);
+			if (entity == Systems::SceneGraph::Entities.end()) {
+				instance.flags = HiZCuller::Missing;
+				gpuInstances.push_back(instance);
+				continue;
+			}
+			glm::mat4 worldToLocal = entity->second->getWorldToLocalMatrix();
+			instances[j].worldToLocal = worldToLocal;
+			instances[j].localToWorld = glm::inverse(worldToLocal);
+			if (entity->second->hasBounds) {
+				instance.aabbMin = glm::vec4(entity->second->worldAABBMin, 1.0);
+				instance.aabbMax = glm::vec4(entity->second->worldAABBMax, 1.0);
+				instance.flags = HiZCuller::HasBounds;
+			}
+			gpuInstances.push_back(instance);
+		}
+	}
+	if (hiZCuller && !gpuInstances.empty()) {
+		/* Match the projection used for rendering, so that bounds land on the same depth texels */
+		glm::mat4 projection = projections[0];
+		projection[1][1] *= -1;
+		hiZCuller->update(projection * views[0], gpuInstances, occlusionCulling);
+	}
+
+	/* Pack the transforms of visible instances to the front of each instance buffer */
+	for (auto &pair : instanceBatches) {
+		auto &batch = pair.second;
+		if (batch.gpuBucket != ~0u) continue;
+		auto instances = batch.instances.getData<Components::Math::TransformBufferObject>();
+		uint32_t instanceCount = 0;
+		for (auto &name : batch.entities) {
+			auto entity = Systems::SceneGraph::Entities.find(name);
+			if (entity == Systems::SceneGraph::Entities.end()) continue;
+			if (getViewMask(entity->second) == 0) {
+				culledEntities++;
+				continue;
+			}
+			glm::mat4 worldToLocal = entity->second->getWorldToLocalMatrix();
+			instances[instanceCount].worldToLocal = worldToLocal;
+			instances[instanceCount].localToWorld = glm::inverse(worldToLocal);
+			instanceCount++;
+		}
+		batch.command.getData<VkDrawIndexedIndirectCommand>()->instanceCount = instanceCount;
+	}
+
+	for (auto &pair : indirectDraws) {
+		auto entity = Systems::SceneGraph::Entities.find(pair.first);
+		if (entity == Systems::SceneGraph::Entities.end()) continue;
+		auto meshComponent = entity->second->getFirstComponent<Components::Meshes::Mesh>();
+		if (!meshComponent) continue;
+		auto &draws = pair.second;
+		auto commands = draws.commands.getData<VkDrawIndexedIndirectCommand>();
+		draws.viewMask = getViewMask(entity->second);
+
+		if (draws.viewMask == 0) {
+			for (uint32_t i = 0; i < draws.drawCount; ++i) 
+				commands[i].instanceCount = 0;
+			culledEntities++;
+			continue;
+		}
+
+		if (!draws.clustered) {
+			commands[0].instanceCount = 1;
+			continue;
+		}
+
+		auto &meshlets = meshComponent->mesh->getMeshlets();
+		uint32_t count = std::min((uint32_t)meshlets.size(), draws.drawCount);
+
+		/* Cull clusters in the entity's local space, so meshlet bounds don't need to be transformed */
+		glm::mat4 worldToLocal = entity->second->getWorldToLocalMatrix();
+		glm::mat4 localToWorld = glm::inverse(worldToLocal);
+		Frustum frustums[MAX_MULTIVIEW];
+		for (uint32_t v = 0; v < viewCount; ++v)
+			if (draws.viewMask & (1u << v))
+				frustums[v] = Frustum(projections[v] * views[v] * localToWorld);
+		glm::vec3 localCamera = glm::vec3(worldToLocal * glm::vec4(cameraPosition, 1.0));
+		glm::vec3 localDirection = glm::vec3(worldToLocal * glm::vec4(cameraDirection, 0.0));
+
+		/* Mirroring transforms flip the winding of every triangle, and so which faces the rasterizer culls */
+		bool mirrored = glm::determinant(glm::mat3(localToWorld)) < 0.0f;
+
+		for (uint32_t i = 0; i < count; ++i) {
+			auto &meshlet = meshlets[i];
+			bool visible = false;
+
+			/* Orthographic cones are tested against the view direction, which is only shared by single view perspectives */
+			bool flipped = (draws.clusterFacing < 0) != mirrored;
+			bool backfacing = backfaceClusterCulling && draws.clusterFacing != 0 && ((orthographic) 
+				? (viewCount == 1 && meshlet.isBackfacingDirection(localDirection, flipped)) 
+				: meshlet.isBackfacing(localCamera, flipped));
+			
+			/* Only views which can see the entity need to be tested */
+			if (!backfacing) {
+				for (uint32_t v = 0; v < viewCount; ++v) {
+					if ((draws.viewMask & (1u << v)) && frustums[v].intersectsSphere(meshlet.center, meshlet.radius)) {
+						visible = true;
+						break;
 					}
 				}
 			}
+
+			commands[i].instanceCount = (visible) ? 1 : 0;
+			if (!visible) culledClusters++;
 		}
-		
-		/* End the render pass */
-		vkCmdEndRenderPass(commandBuffers[i]);
-		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffers[i]));
 	}
+
+	/* Submitted ahead of the frame's command buffers on the same queue, so its barriers order the copies after the
+		previous frame's reads, and before this frame's */
+	uint32_t slot = VKDK::GetFrameSlot();
+	if (uploadCommandBuffers.empty()) {
+		uploadCommandBuffers.resize(VKDK::MaxFramesInFlight);
+		VkCommandBufferAllocateInfo allocInfo = vks::initializers::commandBufferAllocateInfo(VKDK::commandPool,
+			VK_COMMAND_BUFFER_LEVEL_PRIMARY, (uint32_t)uploadCommandBuffers.size());
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(VKDK::device, &allocInfo, uploadCommandBuffers.data()));
+	}
+	VkCommandBufferBeginInfo beginInfo = vks::initializers::commandBufferBeginInfo();
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VK_CHECK_RESULT(vkBeginCommandBuffer(uploadCommandBuffers[slot], &beginInfo));
+	recordUploads(uploadCommandBuffers[slot]);
+	VK_CHECK_RESULT(vkEndCommandBuffer(uploadCommandBuffers[slot]));
+
+	VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &uploadCommandBuffers[slot];
+	VK_CHECK_RESULT(vkQueueSubmit(VKDK::graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
+}
+
+void Components::Math::Perspective::recordUploads(VkCommandBuffer commandBuffer) {
+	/* Earlier frames might still be drawing from, or culling with, the buffers about to be overwritten */
+	VkMemoryBarrier readBarrier = vks::initializers::memoryBarrier();
+	readBarrier.srcAccessMask = 0;
+	readBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &readBarrier, 0, nullptr, 0, nullptr);
+
+	for (auto &pair : indirectDraws) pair.second.commands.recordUpload(commandBuffer);
+	for (auto &pair : instanceBatches) {
+		pair.second.instances.recordUpload(commandBuffer);
+		pair.second.command.recordUpload(commandBuffer);
+	}
+	if (hiZCuller) hiZCuller->recordUploads(commandBuffer);
+
+	VkMemoryBarrier uploadBarrier = vks::initializers::memoryBarrier();
+	uploadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	uploadBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &uploadBarrier, 0, nullptr, 0, nullptr);
 }
\ No newline at end of file
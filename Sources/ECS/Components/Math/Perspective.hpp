@@ -19,10 +19,20 @@
 #include "Components/Textures/RenderableTexture2D.hpp"
 #include "Components/Textures/RenderableTextureCube.hpp"
 #include "Components/Component.hpp"
+#include "Components/Meshes/Mesh.hpp"
+#include "Transform.hpp"
+#include "Frustum.hpp"
+#include "FrameUploadBuffer.hpp"
+#include "OcclusionBuffer.hpp"
+#include "HiZCuller.hpp"
+#include "Components/Materials/DescriptorAllocator.hpp"
 
 #include <array>
+#include <map>
 
 namespace Entities { class Entity; }
+namespace Components::Materials { class MaterialInterface; }
+namespace Systems { class RenderQueue; }
 
 namespace Components::Math {
 	struct PerspectiveObject {
@@ -47,6 +57,34 @@ namespace Components::Math {
 		glm::mat4 views[MAX_MULTIVIEW];
 		glm::mat4 projections[MAX_MULTIVIEW];
 
+		/* The number of views rendered by this perspective's render pass (6 for cubemaps) */
+		uint32_t viewCount = 1;
+
+		/* If enabled, entities whose world bounds are outside of every view are skipped. */
+		bool frustumCulling = true;
+
+		/* If enabled, meshes are drawn indirectly as meshlets, and clusters outside of all views
+			or facing away from the camera are skipped. Clusters are only skipped for their facing when
+			the pipeline drawing them culls those faces. */
+		bool clusterCulling = true;
+		bool backfaceClusterCulling = true;
+
+		/* Number of entities and clusters skipped by the last call to cull */
+		uint32_t culledEntities = 0;
+		uint32_t culledClusters = 0;
+
+		/* If enabled, entities with occluder components are rasterized into a coarse depth buffer on the CPU,
+			and entities whose bounds are hidden behind them are skipped. Only enable this for passes which
+			depth test, since passes that don't (like voxelization) still need the hidden entities. */
+		bool occlusionCulling = false;
+
+		/* Number of entities hidden by occluders in each view during the last call to cull */
+		uint32_t occludedEntities[MAX_MULTIVIEW] = {};
+
+		/* Resolution of the occlusion buffers along their widest axis */
+		uint32_t occlusionBufferSize = 256;
+		std::vector<std::shared_ptr<OcclusionBuffer>> occlusionBuffers;
+
 		std::function<void(VkCommandBuffer)> preRenderPassCallback;
 
 		bool canRender = false;
@@ -64,6 +102,85 @@ namespace Components::Math {
 		VkDeviceMemory perspectiveUBOMemory;
 		std::shared_ptr<Components::Textures::Texture> renderTexture = nullptr;
 
+		/* Each entity drawn by this perspective gets a buffer of indirect commands, either one per meshlet,
+			or a single command for the whole mesh. Culling rewrites the instance counts of these commands
+			every frame, in the copy of the current frame slot. */
+		struct IndirectDraws {
+			FrameUploadBuffer commands;
+			uint32_t drawCount = 0;
+			bool clustered = false;
+
+			/* Bit i is set if the entity is visible in view i */
+			uint32_t viewMask = 0;
+
+			/* The faces culled by the pipelines drawing these commands. 1 for back faces, -1 for front faces
+				(or back faces wound clockwise), and 0 if clusters can't be skipped for facing away. */
+			int32_t clusterFacing = 1;
+		};
+		std::unordered_map<std::string, IndirectDraws> indirectDraws;
+
+		/* If enabled, entities sharing a mesh and material instance are drawn with a single instanced draw,
+			for materials which provide an instanced pipeline. */
+		bool instancing = true;
+
+		/* Number of instanced draws recorded, and the entities they replaced */
+		uint32_t instancedDraws = 0;
+		uint32_t instancedEntities = 0;
+
+		/* An instanced draw reads one transform per visible entity from a storage buffer. Culling packs the transforms
+			of visible entities to the front of this buffer and writes their count to the indirect command. Both are
+			buffered per frame in flight, like IndirectDraws. */
+		struct InstanceBatch {
+			FrameUploadBuffer instances;
+			FrameUploadBuffer command;
+			std::vector<std::string> entities;
+
+			/* If this batch is culled on the GPU, the index of its bucket in the Hi-Z culler. Otherwise, ~0u. */
+			uint32_t gpuBucket = ~0u;
+		};
+
+		/* Batches are keyed by the material instance and mesh their entities share */
+		typedef std::pair<Components::Materials::MaterialInterface*, Components::Meshes::MeshInterface*> BatchKey;
+		std::map<BatchKey, InstanceBatch> instanceBatches;
+
+		/* If enabled, instanced batches are culled on the GPU against a depth pyramid built from the previous frame,
+			and every entity which supports instancing is batched, even if it doesn't share its mesh. Requires the
+			Hi-Z compute shaders, and is only used by single view perspectives. Swapchain perspectives also need VKDK
+			to be initialized with sampledDepth. */
+		bool gpuCulling = false;
+		std::shared_ptr<HiZCuller> hiZCuller;
+
+		/* If enabled, large passes are split into ranges recorded on the shared Tools::WorkerPool, each into its own
+			secondary command buffers, which the primary command buffers then execute in order. */
+		bool parallelRecording = true;
+
+		/* Maximum number of recording threads, or 0 to use every hardware thread */
+		uint32_t recordingThreadCount = 0;
+
+		/* Passes with fewer draws than this per thread use fewer threads, down to inline recording on one */
+		uint32_t minDrawsPerThread = 64;
+
+		/* One command pool per recorded range, and that range's secondary command buffers, indexed by
+			primary command buffer and subpass. A range is only ever recorded by one thread at a time. */
+		std::vector<VkCommandPool> recordingPools;
+		std::vector<std::vector<VkCommandBuffer>> secondaryCommandBuffers;
+
+		/* A hash of what each worker's secondary command buffers were recorded with. Workers whose share of the
+			queues hasn't changed keep their recordings, and only the primary command buffers are re-recorded. */
+		std::vector<size_t> secondarySignatures;
+
+		/* Copies each frame slot's commands, instances and culling inputs into the buffers the recording reads,
+			indexed by frame slot */
+		std::vector<VkCommandBuffer> uploadCommandBuffers;
+
+		/* The scene graph version this perspective's command buffers were recorded against, and the clear values
+			used, so that updateRecording can re-record them the same way */
+		bool recorded = false;
+		uint64_t recordedVersion = 0;
+		glm::vec4 recordedClearColor = glm::vec4(0.0);
+		float recordedClearDepth = 1.0f;
+		uint32_t recordedClearStencil = 0;
+
 	public:
 		static std::shared_ptr<Perspective> Create(
       std::string name, VkRenderPass renderpass, 
@@ -76,19 +193,20 @@ namespace Components::Math {
 			return perspective;
 		}
 
-    /* Generates a 2D or Cube texture */
+    /* Generates a 2D or Cube texture. A mipmapped 2D texture has its mip chain rebuilt after every render. */
 		static std::shared_ptr<Perspective> Create(
-      std::string name, uint32_t framebufferWidth, uint32_t framebufferHeight, bool cubemap = false) {
+      std::string name, uint32_t framebufferWidth, uint32_t framebufferHeight, bool cubemap = false, bool mipmapped = false) {
 			std::cout << "ComponentManager: Adding Perspective \"" << name << "\"" << std::endl;
-			auto perspective = std::make_shared<Perspective>(name, framebufferWidth, framebufferHeight, cubemap);
+			auto perspective = std::make_shared<Perspective>(name, framebufferWidth, framebufferHeight, cubemap, mipmapped);
 			Systems::ComponentManager::Perspectives[name] = perspective;
 			return perspective;
 		}
 
 		/* This constructor will generate a renderpass and command buffer on its own, and will render to a 2D texture */
-		Perspective(std::string textureName, uint32_t framebufferWidth, uint32_t framebufferHeight, bool cubemap) {
+		Perspective(std::string textureName, uint32_t framebufferWidth, uint32_t framebufferHeight, bool cubemap, bool mipmapped = false) {
 			this->framebufferWidth = framebufferWidth;
 			this->framebufferHeight = framebufferHeight;
+			this->viewCount = (cubemap) ? 6 : 1;
 			createRenderPass(framebufferWidth, framebufferHeight, (cubemap) ? 6 : 1);
 			createCommandBuffer();
 			createUniformBuffer();
@@ -98,7 +216,7 @@ namespace Components::Math {
       }
       else {
         renderTexture = Components::Textures::RenderableTexture2D::Create(
-          textureName, framebufferWidth, framebufferHeight, renderpass);
+          textureName, framebufferWidth, framebufferHeight, renderpass, mipmapped);
       }
 			frameBuffers.push_back(renderTexture->texture->getFramebuffer());
 			canRender = true;
@@ -246,6 +364,36 @@ namespace Components::Math {
 
 		void recordRenderPass(/*std::shared_ptr<Entities::Entity> scene, */glm::vec4 clearColor, float clearDepth = 1.0f, uint32_t clearStencil = 0);
 
+		/* Re-records this perspective's command buffers if the scene graph changed in a way that affects its render pass
+			since they were last recorded. Returns true if they were re-recorded. Waits for the last frame first, and keeps
+			secondary command buffers whose draws didn't change. */
+		bool updateRecording();
+
+		/* Records each worker's share of the sorted queues into its secondary command buffers, one per primary command buffer and subpass */
+		void recordSecondaryCommandBuffers(std::vector<Systems::RenderQueue> &queues, uint32_t workerCount);
+
+		/* Viewport and scissor covering the whole framebuffer */
+		void setViewportAndScissor(VkCommandBuffer commandBuffer);
+
+		/* Updates the indirect draws recorded by this perspective, dropping meshlets which can't be seen.
+			Writes the current frame slot's copies, waiting only for the frame which last used that slot,
+			then submits their upload ahead of the frame's command buffers. */
+		void cull();
+
+		/* Records the copy of the current frame slot into every buffer read by the recording, with barriers
+			against the previous frame's reads and this frame's draws and culling dispatch */
+		void recordUploads(VkCommandBuffer commandBuffer);
+
+		/* Returns the indirect draws for an entity, or nullptr if culling is disabled */
+		IndirectDraws *getIndirectDraws(std::string entityName, std::shared_ptr<Components::Meshes::Mesh> meshComponent);
+
+		/* Returns the instanced draw for a set of entities sharing a mesh, creating it if needed */
+		InstanceBatch *getInstanceBatch(BatchKey batchKey, std::vector<std::string> entityNames, std::shared_ptr<Components::Meshes::Mesh> meshComponent);
+		void destroyInstanceBatch(InstanceBatch &batch);
+
+		/* Returns the culler for this perspective's depth attachment, creating it if needed, or nullptr if GPU culling can't be used */
+		std::shared_ptr<HiZCuller> getHiZCuller();
+
 		void uploadUBO() {
 			/* Update uniform buffer */
 			PerspectiveBufferObject pbo = {};
@@ -270,6 +418,30 @@ namespace Components::Math {
 			vkDestroyBuffer(VKDK::device, perspectiveUBO, nullptr);
 			vkFreeMemory(VKDK::device, perspectiveUBOMemory, nullptr);
 
+			for (auto &pair : indirectDraws)
+				pair.second.commands.destroy();
+			indirectDraws.clear();
+
+			for (auto &pair : instanceBatches) 
+				destroyInstanceBatch(pair.second);
+			instanceBatches.clear();
+
+			if (hiZCuller) hiZCuller->cleanup();
+			hiZCuller = nullptr;
+
+			if (!uploadCommandBuffers.empty())
+				vkFreeCommandBuffers(VKDK::device, VKDK::commandPool, (uint32_t)uploadCommandBuffers.size(), uploadCommandBuffers.data());
+			uploadCommandBuffers.clear();
+
+			/* Destroying the pools frees their secondary command buffers */
+			for (auto pool : recordingPools)
+				vkDestroyCommandPool(VKDK::device, pool, nullptr);
+			recordingPools.clear();
+			secondaryCommandBuffers.clear();
+			secondarySignatures.clear();
+			Components::Materials::DescriptorAllocator::ReleaseRecording(this);
+			recorded = false;
+
 			if (useSwapchain) return;
 
 			vkDestroyRenderPass(VKDK::device, renderpass, nullptr);
@@ -12,6 +12,8 @@
 #include <glm/gtc/quaternion.hpp>
 #include <glm/common.hpp>
 #include <atomic>
+#include <mutex>
+#include <vector>
 #include <glm/gtc/matrix_access.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/quaternion.hpp>
@@ -77,6 +79,7 @@ namespace Components::Math {
 		*/
 		Transform() {
 			createUniformBuffer();
+			tableIndex = AllocateTableSlot();
 		}
 
 		Transform(const Transform &other) {
@@ -113,6 +116,7 @@ namespace Components::Math {
 
 				this->transformUBO = other.transformUBO;
 				this->transformUBOMemory = other.transformUBOMemory;
+				this->tableIndex = other.tableIndex;
 			}
 			return *this;
 		}
@@ -120,9 +124,52 @@ namespace Components::Math {
 		VkBuffer transformUBO;
 		VkDeviceMemory transformUBOMemory;
 
+		/* Slot in the shared transform table, or ~0u if the table wasn't initialized when this transform was created */
+		uint32_t tableIndex = ~0u;
+
+		/* Every transform also writes its matrices into one slot of a shared storage buffer. Draws can then select
+			their transform with a push constant, so one descriptor set serves every entity using a material. */
+		static void InitializeTable(uint32_t maxTransforms = 16384) {
+			auto &table = GetTable();
+			std::lock_guard<std::mutex> lock(table.mutex);
+			if (table.buffer != VK_NULL_HANDLE) return;
+
+			VKDK::CreateBuffer(maxTransforms * sizeof(TransformBufferObject), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, table.buffer, table.memory);
+			vkMapMemory(VKDK::device, table.memory, 0, maxTransforms * sizeof(TransformBufferObject), 0, (void**)&table.mapped);
+			table.capacity = maxTransforms;
+			table.next = 0;
+			table.freeSlots.clear();
+		}
+
+		static void DestroyTable() {
+			auto &table = GetTable();
+			std::lock_guard<std::mutex> lock(table.mutex);
+			if (table.buffer == VK_NULL_HANDLE) return;
+
+			vkUnmapMemory(VKDK::device, table.memory);
+			vkDestroyBuffer(VKDK::device, table.buffer, nullptr);
+			vkFreeMemory(VKDK::device, table.memory, nullptr);
+			table.buffer = VK_NULL_HANDLE;
+			table.memory = VK_NULL_HANDLE;
+			table.mapped = nullptr;
+			table.capacity = table.next = 0;
+			table.freeSlots.clear();
+		}
+
+		/* Returns the shared transform storage buffer, or VK_NULL_HANDLE if it isn't initialized */
+		static VkBuffer GetTableBuffer() {
+			return GetTable().buffer;
+		}
+
+		uint32_t getTableIndex() {
+			return tableIndex;
+		}
+
 		void createUniformBuffer() {
 			VkDeviceSize bufferSize = sizeof(TransformBufferObject);
-			VKDK::CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, transformUBO, transformUBOMemory);
+			/* Also usable as a single element instance buffer */
+			VKDK::CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, transformUBO, transformUBOMemory);
 		}
 
 		VkBuffer getUBO() {
@@ -143,11 +190,17 @@ namespace Components::Math {
 			vkMapMemory(VKDK::device, transformUBOMemory, 0, sizeof(tbo), 0, &data);
 			memcpy(data, &tbo, sizeof(tbo));
 			vkUnmapMemory(VKDK::device, transformUBOMemory);
+
+			/* The table stays mapped */
+			auto &table = GetTable();
+			if (tableIndex != ~0u && table.mapped) table.mapped[tableIndex] = tbo;
 		}
 
 		void cleanup() {
 			vkDestroyBuffer(VKDK::device, transformUBO, nullptr);
 			vkFreeMemory(VKDK::device, transformUBOMemory, nullptr);
+			ReleaseTableSlot(tableIndex);
+			tableIndex = ~0u;
 		}
 
 		/*
@@ -355,5 +408,39 @@ namespace Components::Math {
 		glm::mat4 LocalToParentMatrix() {
 			return localToParentMatrix.load();
 		}
+
+	private:
+		struct TransformTable {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			TransformBufferObject *mapped = nullptr;
+			uint32_t capacity = 0, next = 0;
+			std::vector<uint32_t> freeSlots;
+			std::mutex mutex;
+		};
+
+		static TransformTable &GetTable() {
+			static TransformTable table;
+			return table;
+		}
+
+		static uint32_t AllocateTableSlot() {
+			auto &table = GetTable();
+			std::lock_guard<std::mutex> lock(table.mutex);
+			if (table.buffer == VK_NULL_HANDLE) return ~0u;
+			if (!table.freeSlots.empty()) {
+				uint32_t slot = table.freeSlots.back();
+				table.freeSlots.pop_back();
+				return slot;
+			}
+			if (table.next >= table.capacity) throw std::runtime_error("transform table is full!");
+			return table.next++;
+		}
+
+		static void ReleaseTableSlot(uint32_t slot) {
+			auto &table = GetTable();
+			std::lock_guard<std::mutex> lock(table.mutex);
+			if (slot != ~0u && table.buffer != VK_NULL_HANDLE) table.freeSlots.push_back(slot);
+		}
 	};
 }
\ No newline at end of file
@@ -2,6 +2,11 @@
 #include "vkdk.hpp"
 #include "Components/Component.hpp"
 #include "Systems/ComponentManager.hpp"
+#include "Systems/AssetRegistry.hpp"
+#include "Meshlets.hpp"
+#include "TriangleBVH.hpp"
+
+#include <future>
 
 namespace Components::Meshes {
 	/* A mesh contains vertex information that has been loaded to the GPU. */
@@ -33,14 +38,82 @@ namespace Components::Meshes {
 		virtual VkBuffer getNormalBuffer() = 0;
 		virtual uint32_t getTotalIndices() = 0;
 		virtual glm::vec3 getCentroid() = 0;
+
+		/* Meshlets partition the index buffer into small clusters which can be culled individually. */
+		const std::vector<Meshlet> &getMeshlets() {
+			return meshlets;
+		}
+
+		/* Object space bounds, computed when the mesh is loaded */
+		glm::vec3 getAABBMin() {
+			return aabbMin;
+		}
+
+		glm::vec3 getAABBMax() {
+			return aabbMax;
+		}
+
+		glm::vec3 getBoundingSphereCenter() {
+			return sphereCenter;
+		}
+
+		float getBoundingSphereRadius() {
+			return sphereRadius;
+		}
+
+		/* Returns the triangle BVH used for ray queries, waiting for it if it's still being built */
+		std::shared_ptr<TriangleBVH> getTriangleBVH() {
+			if (!triangleBVH.valid()) return nullptr;
+			return triangleBVH.get();
+		}
+
+	protected:
+		std::vector<Meshlet> meshlets;
+
+		glm::vec3 aabbMin = glm::vec3(0.0);
+		glm::vec3 aabbMax = glm::vec3(0.0);
+		glm::vec3 sphereCenter = glm::vec3(0.0);
+		float sphereRadius = 0.0;
+
+		std::shared_future<std::shared_ptr<TriangleBVH>> triangleBVH;
+
+		/* Copies the triangles and builds their BVH on another thread, so that meshes can keep loading in parallel */
+		template<typename T>
+		void buildTriangleBVH(const glm::vec3 *points, size_t totalPoints, const T *indices, size_t totalIndices) {
+			std::vector<glm::vec3> pointsCopy(points, points + totalPoints);
+			std::vector<T> indicesCopy(indices, indices + totalIndices);
+			triangleBVH = std::async(std::launch::async, [pointsCopy = std::move(pointsCopy), indicesCopy = std::move(indicesCopy)]() {
+				return std::make_shared<TriangleBVH>(pointsCopy.data(), pointsCopy.size(), indicesCopy.data(), indicesCopy.size());
+			}).share();
+		}
+
+		void computeBounds(const glm::vec3 *points, size_t totalPoints) {
+			if (totalPoints == 0) return;
+			aabbMin = aabbMax = points[0];
+			for (size_t i = 1; i < totalPoints; ++i) {
+				aabbMin = glm::min(aabbMin, points[i]);
+				aabbMax = glm::max(aabbMax, points[i]);
+			}
+
+			/* The sphere is centered on the box, which is tighter than enclosing the box itself */
+			sphereCenter = (aabbMin + aabbMax) * 0.5f;
+			sphereRadius = 0.0f;
+			for (size_t i = 0; i < totalPoints; ++i)
+				sphereRadius = std::max(sphereRadius, glm::length(points[i] - sphereCenter));
+		}
 	};
 
-	/* A mesh component contains a mesh object */
+	/* A mesh component contains a mesh object, which may be shared with other components loaded from the same file */
 	class Mesh : public Component {
 	public:
-		std::unique_ptr<Components::Meshes::MeshInterface> mesh;
+		std::shared_ptr<Components::Meshes::MeshInterface> mesh;
+
+		/* Key of the shared mesh in the asset registry, or empty if this component owns its mesh */
+		std::string assetKey;
+
 		void cleanup() { 
-			mesh->cleanup(); 
+			if (assetKey.empty() || Systems::AssetRegistry::Release(assetKey))
+				mesh->cleanup(); 
 		}
 	};
 }
@@ -5,5 +5,6 @@
 #include "Components/Meshes/Cube.hpp"
 #include "Components/Meshes/Sphere.hpp"
 #include "Components/Meshes/Plane.hpp"
+#include "Components/Meshes/Occluder.hpp"
 
 #include "Components/Component.hpp"
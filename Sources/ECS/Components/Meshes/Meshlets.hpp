@@ -0,0 +1,198 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cfloat>
+#include <cmath>
+
+namespace Components::Meshes {
+	/* A meshlet is a small cluster of neighboring triangles occupying a contiguous range of a mesh's
+		index buffer. Each meshlet carries a bounding sphere and a normal cone, which allows whole clusters
+		to be skipped when they are outside the frustum, or when every triangle in them faces away from the camera.
+	*/
+	struct Meshlet {
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+
+		/* Object space bounding sphere */
+		glm::vec3 center = glm::vec3(0.0);
+		float radius = 0.0;
+
+		/* Normal cone. A cutoff of 1 or more means the cone is too wide to ever be backface culled. */
+		glm::vec3 coneAxis = glm::vec3(0.0, 0.0, 1.0);
+		float coneCutoff = 1.0;
+
+		/* True if all triangles in this meshlet face away from the given (object space) camera position. If flipped,
+			true if they all face towards it instead, for pipelines which cull front faces. */
+		bool isBackfacing(glm::vec3 cameraPosition, bool flipped = false) const {
+			if (coneCutoff >= 1.0f) return false;
+			glm::vec3 d = center - cameraPosition;
+			glm::vec3 axis = (flipped) ? -coneAxis : coneAxis;
+			return glm::dot(d, axis) >= coneCutoff * glm::length(d) + radius;
+		}
+
+		/* Orthographic variant, given the (object space) direction the camera is looking */
+		bool isBackfacingDirection(glm::vec3 viewDirection, bool flipped = false) const {
+			if (coneCutoff >= 1.0f) return false;
+			glm::vec3 axis = (flipped) ? -coneAxis : coneAxis;
+			return glm::dot(glm::normalize(viewDirection), axis) >= coneCutoff;
+		}
+	};
+
+	class Meshlets {
+	public:
+		/* Clusters at most 64 vertices and 124 triangles, which keeps clusters small enough to cull
+			effectively while still amortizing the cost of each indirect draw. */
+		static const uint32_t MaxVertices = 64;
+		static const uint32_t MaxTriangles = 124;
+
+		/* Partitions an indexed triangle list into meshlets. Triangles are grown greedily from a seed
+			triangle across shared vertices, so that each cluster stays spatially coherent. The index
+			array is reordered in place so that each meshlet occupies a contiguous range of indices.
+		*/
+		template<typename T>
+		static std::vector<Meshlet> Build(const glm::vec3 *points, size_t totalPoints, T *indices, size_t totalIndices,
+			uint32_t maxVertices = MaxVertices, uint32_t maxTriangles = MaxTriangles)
+		{
+			std::vector<Meshlet> meshlets;
+			size_t totalTriangles = totalIndices / 3;
+			if (totalTriangles == 0 || totalPoints == 0) return meshlets;
+
+			/* Build a vertex to triangle adjacency table */
+			std::vector<uint32_t> adjacencyOffsets(totalPoints + 1, 0);
+			for (size_t i = 0; i < totalTriangles * 3; ++i)
+				adjacencyOffsets[indices[i] + 1]++;
+			for (size_t i = 0; i < totalPoints; ++i)
+				adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+			std::vector<uint32_t> adjacency(totalTriangles * 3);
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < totalTriangles * 3; ++i)
+				adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+			std::vector<bool> emitted(totalTriangles, false);
+			std::vector<uint32_t> vertexStamp(totalPoints, UINT32_MAX);
+			std::vector<T> reordered;
+			reordered.reserve(totalTriangles * 3);
+
+			std::vector<uint32_t> clusterTriangles;
+			std::vector<uint32_t> candidates;
+			size_t seedCursor = 0;
+
+			while (true) {
+				/* Find the next unemitted triangle to seed a new cluster */
+				while (seedCursor < totalTriangles && emitted[seedCursor]) seedCursor++;
+				if (seedCursor == totalTriangles) break;
+
+				uint32_t clusterId = (uint32_t)meshlets.size();
+				uint32_t clusterVertices = 0;
+				clusterTriangles.clear();
+				candidates.clear();
+
+				auto addTriangle = [&](uint32_t tri) {
+					emitted[tri] = true;
+					clusterTriangles.push_back(tri);
+					for (int k = 0; k < 3; ++k) {
+						T v = indices[tri * 3 + k];
+						if (vertexStamp[v] != clusterId) {
+							vertexStamp[v] = clusterId;
+							clusterVertices++;
+							for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; ++a)
+								if (!emitted[adjacency[a]]) candidates.push_back(adjacency[a]);
+						}
+					}
+				};
+
+				addTriangle((uint32_t)seedCursor);
+
+				while (clusterTriangles.size() < maxTriangles) {
+					/* Prefer candidates which introduce the fewest new vertices */
+					uint32_t best = UINT32_MAX;
+					uint32_t bestNew = 4;
+					for (size_t c = 0; c < candidates.size(); ++c) {
+						uint32_t tri = candidates[c];
+						if (emitted[tri]) continue;
+						uint32_t newVertices = 0;
+						for (int k = 0; k < 3; ++k)
+							newVertices += (vertexStamp[indices[tri * 3 + k]] != clusterId) ? 1 : 0;
+						if (clusterVertices + newVertices > maxVertices) continue;
+						if (newVertices < bestNew || (newVertices == bestNew && tri < best)) {
+							best = tri;
+							bestNew = newVertices;
+							if (bestNew == 0) break;
+						}
+					}
+					if (best == UINT32_MAX) break;
+					addTriangle(best);
+
+					/* Drop emitted candidates so the list doesn't grow without bound */
+					if (candidates.size() > 4 * maxVertices) {
+						candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+							[&](uint32_t t) { return emitted[t]; }), candidates.end());
+					}
+				}
+
+				Meshlet meshlet;
+				meshlet.firstIndex = (uint32_t)reordered.size();
+				meshlet.indexCount = (uint32_t)clusterTriangles.size() * 3;
+				for (auto tri : clusterTriangles) {
+					reordered.push_back(indices[tri * 3 + 0]);
+					reordered.push_back(indices[tri * 3 + 1]);
+					reordered.push_back(indices[tri * 3 + 2]);
+				}
+				computeBounds(meshlet, points, reordered.data());
+				meshlets.push_back(meshlet);
+			}
+
+			/* Any trailing indices which don't form a triangle are kept at the end */
+			for (size_t i = totalTriangles * 3; i < totalIndices; ++i)
+				reordered.push_back(indices[i]);
+
+			std::copy(reordered.begin(), reordered.end(), indices);
+			return meshlets;
+		}
+
+	private:
+		template<typename T>
+		static void computeBounds(Meshlet &meshlet, const glm::vec3 *points, const T *indices) {
+			glm::vec3 minP(FLT_MAX), maxP(-FLT_MAX);
+			for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; ++i) {
+				minP = glm::min(minP, points[indices[i]]);
+				maxP = glm::max(maxP, points[indices[i]]);
+			}
+			meshlet.center = (minP + maxP) * 0.5f;
+			meshlet.radius = 0.0f;
+			for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; ++i)
+				meshlet.radius = std::max(meshlet.radius, glm::length(points[indices[i]] - meshlet.center));
+
+			/* Average the triangle normals to get the cone axis */
+			std::vector<glm::vec3> triangleNormals;
+			glm::vec3 axis(0.0);
+			for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+				glm::vec3 a = points[indices[i]], b = points[indices[i + 1]], c = points[indices[i + 2]];
+				glm::vec3 n = glm::cross(b - a, c - a);
+				float l = glm::length(n);
+				if (l <= 0.0f) continue;
+				n /= l;
+				triangleNormals.push_back(n);
+				axis += n;
+			}
+
+			float axisLength = glm::length(axis);
+			if (triangleNormals.empty() || axisLength <= 0.0f) return;
+			axis /= axisLength;
+
+			/* The cone spread is determined by the triangle normal furthest from the axis */
+			float minDot = 1.0f;
+			for (auto &n : triangleNormals)
+				minDot = std::min(minDot, glm::dot(n, axis));
+
+			/* Cones wider than a hemisphere can always be seen from somewhere */
+			if (minDot <= 0.0f) return;
+
+			meshlet.coneAxis = axis;
+			meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+		}
+	};
+}
@@ -120,6 +120,12 @@ namespace Components::Meshes {
 		}
 
 		computeCentroid();
+		computeBounds(points.data(), points.size());
+
+		/* Reorder indices into meshlets before uploading them */
+		meshlets = Meshlets::Build(points.data(), points.size(), indices.data(), indices.size());
+		buildTriangleBVH(points.data(), points.size(), indices.data(), indices.size());
+
 		createVertexBuffer();
 		createColorBuffer();
 		createIndexBuffer();
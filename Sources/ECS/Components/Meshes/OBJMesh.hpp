@@ -16,8 +16,10 @@ namespace Components::Meshes {
 		static std::shared_ptr<Mesh> Create(std::string name, std::string filepath) {
 			std::cout << "ComponentManager: Adding OBJMesh \"" << name << "\"" << std::endl;
 
+			/* Meshes loaded from the same file share their buffers */
 			auto meshComponent = std::make_shared<Mesh>();
-			meshComponent->mesh = std::make_unique<OBJMesh>(filepath);
+			meshComponent->mesh = Systems::AssetRegistry::Load<MeshInterface>(filepath, "OBJMesh", meshComponent->assetKey,
+				[&]() { return std::make_shared<OBJMesh>(filepath); });
 			Systems::ComponentManager::Meshes[name] = meshComponent;
 			return meshComponent;
 		}
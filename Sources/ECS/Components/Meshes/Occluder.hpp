@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Mesh.hpp"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace Components::Meshes {
+	/* An occluder is a low poly stand in for an entity's mesh, which is rasterized on the CPU to hide entities behind it.
+		Occluders should fit inside the geometry they represent, otherwise visible entities may be culled. */
+	class Occluder : public Component {
+	public:
+		std::vector<glm::vec3> points;
+		std::vector<uint32_t> indices;
+
+		static std::shared_ptr<Occluder> Create(std::string name, std::vector<glm::vec3> points, std::vector<uint32_t> indices) {
+			std::cout << "ComponentManager: Adding Occluder \"" << name << "\"" << std::endl;
+			auto occluder = std::make_shared<Occluder>();
+			occluder->points = points;
+			occluder->indices = indices;
+			Systems::ComponentManager::Occluders[name] = occluder;
+			return occluder;
+		}
+
+		/* Uses a mesh's own triangles as the occluder, which is only sensible for low poly meshes like boxes or walls */
+		static std::shared_ptr<Occluder> Create(std::string name, std::shared_ptr<Mesh> meshComponent) {
+			auto triangleBVH = meshComponent->mesh->getTriangleBVH();
+			if (!triangleBVH) 
+				throw std::runtime_error("Occluder: mesh has no CPU triangles");
+			if (triangleBVH->getTotalTriangles() > MaxTriangles)
+				std::cout << "Occluder: \"" << name << "\" has " << triangleBVH->getTotalTriangles() 
+					<< " triangles, consider a simpler proxy" << std::endl;
+			return Create(name, triangleBVH->getPoints(), triangleBVH->getIndices());
+		}
+
+		static const uint32_t MaxTriangles = 512;
+	};
+}
@@ -36,6 +36,11 @@ namespace Components::Meshes {
 		}
 
 		Plane() {
+			computeBounds(reinterpret_cast<const glm::vec3*>(verts.data()), verts.size() / 3);
+			meshlets = Meshlets::Build(reinterpret_cast<const glm::vec3*>(verts.data()), verts.size() / 3,
+				indices.data(), getTotalIndices());
+			buildTriangleBVH(reinterpret_cast<const glm::vec3*>(verts.data()), verts.size() / 3,
+				indices.data(), getTotalIndices());
 			createVertexBuffer();
 			createTexCoordBuffer();
 			createIndexBuffer();
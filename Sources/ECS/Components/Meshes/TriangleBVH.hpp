@@ -0,0 +1,197 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cmath>
+
+#include "Tools/BVH.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRIANGLE_BVH_SSE
+#include <emmintrin.h>
+#endif
+
+namespace Components::Meshes {
+	/* A CPU copy of a mesh's triangles, along with a surface area heuristic BVH over them, used for
+		ray queries. Distances are in units of the ray direction, so rays may be transformed into
+		object space without renormalizing. */
+	class TriangleBVH {
+	public:
+		struct Hit {
+			uint32_t triangle = 0;
+			glm::vec2 barycentrics = glm::vec2(0.0);
+			float distance = -1.0f;
+		};
+
+		template<typename T>
+		TriangleBVH(const glm::vec3 *points, size_t totalPoints, const T *indices, size_t totalIndices) {
+			this->points.assign(points, points + totalPoints);
+			this->indices.assign(indices, indices + (totalIndices / 3) * 3);
+
+			std::vector<Tools::AABB> triangleBounds(this->indices.size() / 3);
+			for (size_t i = 0; i < triangleBounds.size(); ++i) {
+				triangleBounds[i].expand(points[indices[i * 3 + 0]]);
+				triangleBounds[i].expand(points[indices[i * 3 + 1]]);
+				triangleBounds[i].expand(points[indices[i * 3 + 2]]);
+			}
+			bvh.build(triangleBounds);
+		}
+
+		const std::vector<glm::vec3> &getPoints() const {
+			return points;
+		}
+
+		const std::vector<uint32_t> &getIndices() const {
+			return indices;
+		}
+
+		uint32_t getTotalTriangles() const {
+			return (uint32_t)(indices.size() / 3);
+		}
+
+		/* Returns true and fills in the hit if the ray hits a triangle within tMax */
+		bool intersect(glm::vec3 origin, glm::vec3 direction, float tMax, Hit &hit) const {
+			hit.distance = bvh.intersectRay(origin, direction, tMax, [&](uint32_t triangle, float currentMax) {
+				float t, u, v;
+				if (!intersectTriangle(triangle, origin, direction, currentMax, t, u, v)) return -1.0f;
+				hit.triangle = triangle;
+				hit.barycentrics = glm::vec2(u, v);
+				return t;
+			});
+			return hit.distance >= 0.0f;
+		}
+
+		/* Intersects four rays at once, sharing a single traversal. A node is visited if any active ray hits it,
+			and triangles are tested against all four rays with SIMD. tMax[i] is shortened as hits are found,
+			and hits[i].distance is left negative for rays which miss. */
+		void intersect4(const glm::vec3 origins[4], const glm::vec3 directions[4], float tMax[4], Hit hits[4]) const {
+#ifdef TRIANGLE_BVH_SSE
+			if (bvh.empty()) return;
+
+			__m128 ox = _mm_setr_ps(origins[0].x, origins[1].x, origins[2].x, origins[3].x);
+			__m128 oy = _mm_setr_ps(origins[0].y, origins[1].y, origins[2].y, origins[3].y);
+			__m128 oz = _mm_setr_ps(origins[0].z, origins[1].z, origins[2].z, origins[3].z);
+			__m128 dx = _mm_setr_ps(directions[0].x, directions[1].x, directions[2].x, directions[3].x);
+			__m128 dy = _mm_setr_ps(directions[0].y, directions[1].y, directions[2].y, directions[3].y);
+			__m128 dz = _mm_setr_ps(directions[0].z, directions[1].z, directions[2].z, directions[3].z);
+			__m128 one = _mm_set1_ps(1.0f);
+			__m128 idx = _mm_div_ps(one, dx);
+			__m128 idy = _mm_div_ps(one, dy);
+			__m128 idz = _mm_div_ps(one, dz);
+			__m128 tFar = _mm_loadu_ps(tMax);
+			__m128 zero = _mm_setzero_ps();
+
+			uint32_t stack[64];
+			int stackSize = 0;
+			stack[stackSize++] = 0;
+
+			while (stackSize > 0) {
+				const Tools::BVH::Node &node = bvh.nodes[stack[--stackSize]];
+
+				/* Four wide slab test */
+				__m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds.min.x), ox), idx);
+				__m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds.max.x), ox), idx);
+				__m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds.min.y), oy), idy);
+				__m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds.max.y), oy), idy);
+				__m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds.min.z), oz), idz);
+				__m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds.max.z), oz), idz);
+				__m128 tEnter = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), zero));
+				__m128 tExit = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_min_ps(_mm_max_ps(t0z, t1z), tFar));
+				if (_mm_movemask_ps(_mm_cmple_ps(tEnter, tExit)) == 0) continue;
+
+				if (!node.isLeaf()) {
+					stack[stackSize++] = node.offset + 1;
+					stack[stackSize++] = node.offset;
+					continue;
+				}
+
+				for (uint32_t p = node.offset; p < node.offset + node.count; ++p) {
+					uint32_t triangle = bvh.primitiveIndices[p];
+					const glm::vec3 &a = points[indices[triangle * 3 + 0]];
+					const glm::vec3 &b = points[indices[triangle * 3 + 1]];
+					const glm::vec3 &c = points[indices[triangle * 3 + 2]];
+					__m128 e1x = _mm_set1_ps(b.x - a.x), e1y = _mm_set1_ps(b.y - a.y), e1z = _mm_set1_ps(b.z - a.z);
+					__m128 e2x = _mm_set1_ps(c.x - a.x), e2y = _mm_set1_ps(c.y - a.y), e2z = _mm_set1_ps(c.z - a.z);
+
+					/* Moller-Trumbore, one ray per lane */
+					__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+					__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+					__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+					__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+					__m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+					__m128 valid = _mm_cmpgt_ps(absDet, _mm_set1_ps(1e-12f));
+					__m128 invDet = _mm_div_ps(one, det);
+
+					__m128 sx = _mm_sub_ps(ox, _mm_set1_ps(a.x));
+					__m128 sy = _mm_sub_ps(oy, _mm_set1_ps(a.y));
+					__m128 sz = _mm_sub_ps(oz, _mm_set1_ps(a.z));
+					__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+
+					__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+					__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+					__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+					__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+					__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+					valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+					valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+					valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), one));
+					valid = _mm_and_ps(valid, _mm_cmpge_ps(t, zero));
+					valid = _mm_and_ps(valid, _mm_cmple_ps(t, tFar));
+
+					int hitMask = _mm_movemask_ps(valid);
+					if (hitMask == 0) continue;
+
+					tFar = _mm_or_ps(_mm_and_ps(valid, t), _mm_andnot_ps(valid, tFar));
+					alignas(16) float tLanes[4], uLanes[4], vLanes[4];
+					_mm_store_ps(tLanes, t);
+					_mm_store_ps(uLanes, u);
+					_mm_store_ps(vLanes, v);
+					for (int lane = 0; lane < 4; ++lane) {
+						if (!(hitMask & (1 << lane))) continue;
+						hits[lane].triangle = triangle;
+						hits[lane].barycentrics = glm::vec2(uLanes[lane], vLanes[lane]);
+						hits[lane].distance = tLanes[lane];
+					}
+				}
+			}
+			_mm_storeu_ps(tMax, tFar);
+#else
+			/* Scalar fallback */
+			for (int i = 0; i < 4; ++i) {
+				Hit hit;
+				if (intersect(origins[i], directions[i], tMax[i], hit)) {
+					hits[i] = hit;
+					tMax[i] = hit.distance;
+				}
+			}
+#endif
+		}
+
+	private:
+		std::vector<glm::vec3> points;
+		std::vector<uint32_t> indices;
+		Tools::BVH bvh;
+
+		/* Moller-Trumbore ray triangle intersection */
+		bool intersectTriangle(uint32_t triangle, glm::vec3 origin, glm::vec3 direction, float tMax, float &t, float &u, float &v) const {
+			const glm::vec3 &a = points[indices[triangle * 3 + 0]];
+			const glm::vec3 &b = points[indices[triangle * 3 + 1]];
+			const glm::vec3 &c = points[indices[triangle * 3 + 2]];
+			glm::vec3 e1 = b - a;
+			glm::vec3 e2 = c - a;
+			glm::vec3 p = glm::cross(direction, e2);
+			float det = glm::dot(e1, p);
+			if (std::fabs(det) <= 1e-12f) return false;
+			float invDet = 1.0f / det;
+			glm::vec3 s = origin - a;
+			u = glm::dot(s, p) * invDet;
+			if (u < 0.0f || u > 1.0f) return false;
+			glm::vec3 q = glm::cross(s, e1);
+			v = glm::dot(direction, q) * invDet;
+			if (v < 0.0f || u + v > 1.0f) return false;
+			t = glm::dot(e2, q) * invDet;
+			return t >= 0.0f && t <= tMax;
+		}
+	};
+}
@@ -0,0 +1,493 @@
+#include "BlockCompressor.hpp"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSOR_SSE
+#include <emmintrin.h>
+#endif
+
+namespace Components::Textures {
+	namespace {
+		std::mutex cacheMutex;
+
+		/* A 4x4 block of pixels, one array per channel, with values from 0 to 255 */
+		struct Block {
+			alignas(16) float channels[4][16];
+		};
+
+		/* Palette entries are interpolated between two endpoints, each channel from 0 to 255 */
+		struct Palette {
+			float entries[16][4];
+			int size = 0;
+		};
+
+		/* Packs bits into a 128 bit block, least significant first */
+		struct BitWriter {
+			uint64_t bits[2] = { 0, 0 };
+			uint32_t position = 0;
+
+			void write(uint32_t value, uint32_t count) {
+				for (uint32_t i = 0; i < count; ++i, ++position)
+					if ((value >> i) & 1) bits[position >> 6] |= 1ull << (position & 63);
+			}
+
+			void store(uint8_t *out) {
+				for (uint32_t byte = 0; byte < 16; ++byte)
+					out[byte] = (uint8_t)(bits[byte >> 3] >> (8 * (byte & 7)));
+			}
+		};
+
+		const uint32_t bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		void loadBlock(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Block &block) {
+			/* Blocks hanging over the edge of the image repeat its last row and column */
+			for (uint32_t y = 0; y < 4; ++y) {
+				uint32_t sy = std::min(blockY * 4 + y, height - 1);
+				for (uint32_t x = 0; x < 4; ++x) {
+					uint32_t sx = std::min(blockX * 4 + x, width - 1);
+					const uint8_t *pixel = pixels + ((size_t)sy * width + sx) * 4;
+					for (uint32_t c = 0; c < 4; ++c) block.channels[c][y * 4 + x] = pixel[c];
+				}
+			}
+		}
+
+		/* Finds the closest palette entry to each pixel, measuring only the channels with a non zero weight */
+		void selectIndices(const Block &block, const float weights[4], const Palette &palette, uint8_t indices[16]) {
+#ifdef BLOCK_COMPRESSOR_SSE
+			/* Four pixels at a time */
+			for (int i = 0; i < 16; i += 4) {
+				__m128 pixel[4];
+				for (int c = 0; c < 4; ++c) pixel[c] = _mm_load_ps(block.channels[c] + i);
+
+				__m128 best = _mm_set1_ps(FLT_MAX);
+				__m128i bestIndex = _mm_setzero_si128();
+				for (int p = 0; p < palette.size; ++p) {
+					__m128 distance = _mm_setzero_ps();
+					for (int c = 0; c < 4; ++c) {
+						if (weights[c] == 0.0f) continue;
+						__m128 difference = _mm_sub_ps(pixel[c], _mm_set1_ps(palette.entries[p][c]));
+						distance = _mm_add_ps(distance, _mm_mul_ps(_mm_mul_ps(difference, difference), _mm_set1_ps(weights[c])));
+					}
+					__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+					best = _mm_min_ps(distance, best);
+					bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+				}
+
+				alignas(16) int32_t result[4];
+				_mm_store_si128((__m128i*)result, bestIndex);
+				for (int j = 0; j < 4; ++j) indices[i + j] = (uint8_t)result[j];
+			}
+#else
+			for (int i = 0; i < 16; ++i) {
+				float best = FLT_MAX;
+				for (int p = 0; p < palette.size; ++p) {
+					float distance = 0.0f;
+					for (int c = 0; c < 4; ++c) {
+						float difference = block.channels[c][i] - palette.entries[p][c];
+						distance += difference * difference * weights[c];
+					}
+					if (distance < best) { best = distance; indices[i] = (uint8_t)p; }
+				}
+			}
+#endif
+		}
+
+		/* Fits a line through the block's colors, returning its ends. The direction is the principal axis of the
+			first channelCount channels, found by power iteration on their covariance. */
+		void fitEndpoints(const Block &block, int channelCount, float low[4], float high[4]) {
+			float mean[4] = {}, minimum[4], maximum[4];
+			for (int c = 0; c < channelCount; ++c) {
+				minimum[c] = 255.0f; maximum[c] = 0.0f;
+				for (int i = 0; i < 16; ++i) {
+					mean[c] += block.channels[c][i];
+					minimum[c] = std::min(minimum[c], block.channels[c][i]);
+					maximum[c] = std::max(maximum[c], block.channels[c][i]);
+				}
+				mean[c] /= 16.0f;
+			}
+
+			float covariance[4][4] = {};
+			for (int i = 0; i < 16; ++i)
+				for (int a = 0; a < channelCount; ++a)
+					for (int b = 0; b < channelCount; ++b)
+						covariance[a][b] += (block.channels[a][i] - mean[a]) * (block.channels[b][i] - mean[b]);
+
+			/* Start from the bounding box diagonal, which is already close for most blocks */
+			float axis[4] = {};
+			for (int c = 0; c < channelCount; ++c) axis[c] = maximum[c] - minimum[c];
+			for (int iteration = 0; iteration < 8; ++iteration) {
+				float next[4] = {}, length = 0.0f;
+				for (int a = 0; a < channelCount; ++a) {
+					for (int b = 0; b < channelCount; ++b) next[a] += covariance[a][b] * axis[b];
+					length = std::max(length, std::abs(next[a]));
+				}
+				if (length < 1e-6f) break;
+				for (int c = 0; c < channelCount; ++c) axis[c] = next[c] / length;
+			}
+
+			float length = 0.0f;
+			for (int c = 0; c < channelCount; ++c) length += axis[c] * axis[c];
+			if (length < 1e-12f) {
+				/* A flat block */
+				for (int c = 0; c < 4; ++c) low[c] = high[c] = (c < channelCount) ? mean[c] : 255.0f;
+				return;
+			}
+			length = std::sqrt(length);
+			for (int c = 0; c < channelCount; ++c) axis[c] /= length;
+
+			float tMin = FLT_MAX, tMax = -FLT_MAX;
+			for (int i = 0; i < 16; ++i) {
+				float t = 0.0f;
+				for (int c = 0; c < channelCount; ++c) t += (block.channels[c][i] - mean[c]) * axis[c];
+				tMin = std::min(tMin, t);
+				tMax = std::max(tMax, t);
+			}
+			for (int c = 0; c < 4; ++c) {
+				low[c] = (c < channelCount) ? std::clamp(mean[c] + axis[c] * tMin, 0.0f, 255.0f) : 255.0f;
+				high[c] = (c < channelCount) ? std::clamp(mean[c] + axis[c] * tMax, 0.0f, 255.0f) : 255.0f;
+			}
+		}
+
+		uint16_t packRGB565(const float color[4]) {
+			uint32_t r = (uint32_t)std::lround(color[0] * 31.0f / 255.0f);
+			uint32_t g = (uint32_t)std::lround(color[1] * 63.0f / 255.0f);
+			uint32_t b = (uint32_t)std::lround(color[2] * 31.0f / 255.0f);
+			return (uint16_t)((r << 11) | (g << 5) | b);
+		}
+
+		void unpackRGB565(uint16_t packed, float color[4]) {
+			uint32_t r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+			color[0] = (float)((r << 3) | (r >> 2));
+			color[1] = (float)((g << 2) | (g >> 4));
+			color[2] = (float)((b << 3) | (b >> 2));
+			color[3] = 255.0f;
+		}
+
+		/* Four color BC1 block, also used for the color half of BC3 */
+		void encodeBC1(const Block &block, uint8_t *out) {
+			float low[4], high[4];
+			fitEndpoints(block, 3, low, high);
+
+			uint16_t color0 = packRGB565(high), color1 = packRGB565(low);
+			if (color0 < color1) std::swap(color0, color1);
+
+			uint32_t packedIndices = 0;
+			if (color0 != color1) {
+				Palette palette;
+				palette.size = 4;
+				unpackRGB565(color0, palette.entries[0]);
+				unpackRGB565(color1, palette.entries[1]);
+				for (int c = 0; c < 4; ++c) {
+					palette.entries[2][c] = (2.0f * palette.entries[0][c] + palette.entries[1][c]) / 3.0f;
+					palette.entries[3][c] = (palette.entries[0][c] + 2.0f * palette.entries[1][c]) / 3.0f;
+				}
+
+				const float weights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+				uint8_t indices[16];
+				selectIndices(block, weights, palette, indices);
+				for (int i = 0; i < 16; ++i) packedIndices |= (uint32_t)indices[i] << (2 * i);
+			}
+
+			out[0] = (uint8_t)color0; out[1] = (uint8_t)(color0 >> 8);
+			out[2] = (uint8_t)color1; out[3] = (uint8_t)(color1 >> 8);
+			for (int i = 0; i < 4; ++i) out[4 + i] = (uint8_t)(packedIndices >> (8 * i));
+		}
+
+		/* Eight value BC4 block of a single channel, used for BC3 alpha and both halves of BC5 */
+		void encodeBC4(const Block &block, int channel, uint8_t *out) {
+			float minimum = 255.0f, maximum = 0.0f;
+			for (int i = 0; i < 16; ++i) {
+				minimum = std::min(minimum, block.channels[channel][i]);
+				maximum = std::max(maximum, block.channels[channel][i]);
+			}
+			uint32_t value0 = (uint32_t)std::lround(maximum), value1 = (uint32_t)std::lround(minimum);
+
+			uint64_t packedIndices = 0;
+			if (value0 != value1) {
+				Palette palette = {};
+				palette.size = 8;
+				palette.entries[0][channel] = (float)value0;
+				palette.entries[1][channel] = (float)value1;
+				for (int i = 2; i < 8; ++i)
+					palette.entries[i][channel] = ((8 - i) * (float)value0 + (i - 1) * (float)value1) / 7.0f;
+
+				float weights[4] = {};
+				weights[channel] = 1.0f;
+				uint8_t indices[16];
+				selectIndices(block, weights, palette, indices);
+				for (int i = 0; i < 16; ++i) packedIndices |= (uint64_t)indices[i] << (3 * i);
+			}
+
+			out[0] = (uint8_t)value0;
+			out[1] = (uint8_t)value1;
+			for (int i = 0; i < 6; ++i) out[2 + i] = (uint8_t)(packedIndices >> (8 * i));
+		}
+
+		/* Quantizes an endpoint to 7 bits per channel plus a shared low bit, picking whichever low bit fits best */
+		void quantizeBC7Endpoint(const float endpoint[4], uint32_t quantized[4], uint32_t &pBit) {
+			float bestError = FLT_MAX;
+			for (uint32_t p = 0; p < 2; ++p) {
+				uint32_t candidate[4];
+				float error = 0.0f;
+				for (int c = 0; c < 4; ++c) {
+					candidate[c] = (uint32_t)std::clamp((long)std::lround((endpoint[c] - p) / 2.0f), 0L, 127L);
+					float difference = (float)((candidate[c] << 1) | p) - endpoint[c];
+					error += difference * difference;
+				}
+				if (error < bestError) {
+					bestError = error;
+					pBit = p;
+					std::copy(candidate, candidate + 4, quantized);
+				}
+			}
+		}
+
+		/* BC7 mode 6: a single subset with RGBA endpoints and 4 bit indices */
+		void encodeBC7(const Block &block, uint8_t *out) {
+			float low[4], high[4];
+			fitEndpoints(block, 4, low, high);
+
+			uint32_t endpoints[2][4], pBits[2];
+			quantizeBC7Endpoint(low, endpoints[0], pBits[0]);
+			quantizeBC7Endpoint(high, endpoints[1], pBits[1]);
+
+			Palette palette;
+			palette.size = 16;
+			for (int i = 0; i < 16; ++i) {
+				for (int c = 0; c < 4; ++c) {
+					uint32_t value0 = (endpoints[0][c] << 1) | pBits[0], value1 = (endpoints[1][c] << 1) | pBits[1];
+					palette.entries[i][c] = (float)(((64 - bc7Weights[i]) * value0 + bc7Weights[i] * value1 + 32) >> 6);
+				}
+			}
+
+			const float weights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+			uint8_t indices[16];
+			selectIndices(block, weights, palette, indices);
+
+			/* The first index is stored without its top bit, so it must be below 8 */
+			if (indices[0] & 8) {
+				std::swap(endpoints[0], endpoints[1]);
+				std::swap(pBits[0], pBits[1]);
+				for (int i = 0; i < 16; ++i) indices[i] = 15 - indices[i];
+			}
+
+			BitWriter writer;
+			writer.write(1 << 6, 7);
+			for (int c = 0; c < 4; ++c) {
+				writer.write(endpoints[0][c], 7);
+				writer.write(endpoints[1][c], 7);
+			}
+			writer.write(pBits[0], 1);
+			writer.write(pBits[1], 1);
+			writer.write(indices[0], 3);
+			for (int i = 1; i < 16; ++i) writer.write(indices[i], 4);
+			writer.store(out);
+		}
+
+		void encodeBlock(const Block &block, BlockCompressor::Format format, uint8_t *out) {
+			switch (format) {
+			case BlockCompressor::Format::BC1: encodeBC1(block, out); break;
+			case BlockCompressor::Format::BC3: encodeBC4(block, 3, out); encodeBC1(block, out + 8); break;
+			case BlockCompressor::Format::BC5: encodeBC4(block, 0, out); encodeBC4(block, 1, out + 8); break;
+			case BlockCompressor::Format::BC7: encodeBC7(block, out); break;
+			}
+		}
+
+		/* Encodes one level, splitting its rows of blocks between worker threads */
+		void encodeLevel(const uint8_t *pixels, uint32_t width, uint32_t height, BlockCompressor::Format format, uint8_t *out) {
+			uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+			size_t blockSize = (format == BlockCompressor::Format::BC1) ? 8 : 16;
+
+			uint32_t workerCount = std::max(1u, std::min(std::thread::hardware_concurrency(), blocksY));
+			uint32_t rowsPerWorker = (blocksY + workerCount - 1) / workerCount;
+			std::vector<std::future<void>> workers;
+			for (uint32_t first = 0; first < blocksY; first += rowsPerWorker) {
+				uint32_t last = std::min(blocksY, first + rowsPerWorker);
+				workers.push_back(std::async(std::launch::async, [=]() {
+					Block block;
+					for (uint32_t by = first; by < last; ++by) {
+						for (uint32_t bx = 0; bx < blocksX; ++bx) {
+							loadBlock(pixels, width, height, bx, by, block);
+							encodeBlock(block, format, out + ((size_t)by * blocksX + bx) * blockSize);
+						}
+					}
+				}));
+			}
+			for (auto &worker : workers) worker.get();
+		}
+
+		float srgbToLinear(float value) {
+			return (value <= 0.04045f) ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+		}
+
+		float linearToSrgb(float value) {
+			return (value <= 0.0031308f) ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+		}
+
+		/* Halves an RGBA8 image with a box filter, averaging colors in linear space when srgb is set */
+		std::vector<uint8_t> downsample(const std::vector<uint8_t> &source, uint32_t width, uint32_t height, bool srgb) {
+			static float toLinear[256];
+			static std::once_flag tableFlag;
+			std::call_once(tableFlag, []() {
+				for (int i = 0; i < 256; ++i) toLinear[i] = srgbToLinear(i / 255.0f);
+			});
+
+			uint32_t nextWidth = std::max(1u, width / 2), nextHeight = std::max(1u, height / 2);
+			std::vector<uint8_t> result((size_t)nextWidth * nextHeight * 4);
+			for (uint32_t y = 0; y < nextHeight; ++y) {
+				uint32_t rows[2] = { std::min(2 * y, height - 1), std::min(2 * y + 1, height - 1) };
+				for (uint32_t x = 0; x < nextWidth; ++x) {
+					uint32_t columns[2] = { std::min(2 * x, width - 1), std::min(2 * x + 1, width - 1) };
+					float sum[4] = {};
+					for (auto row : rows) {
+						for (auto column : columns) {
+							const uint8_t *pixel = &source[((size_t)row * width + column) * 4];
+							for (int c = 0; c < 4; ++c)
+								sum[c] += (srgb && c < 3) ? toLinear[pixel[c]] : pixel[c] / 255.0f;
+						}
+					}
+					uint8_t *pixel = &result[((size_t)y * nextWidth + x) * 4];
+					for (int c = 0; c < 4; ++c) {
+						float value = sum[c] / 4.0f;
+						if (srgb && c < 3) value = linearToSrgb(value);
+						pixel[c] = (uint8_t)std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f);
+					}
+				}
+			}
+			return result;
+		}
+
+		/* Levels in a full mip chain */
+		uint32_t getLevelCount(uint32_t width, uint32_t height) {
+			uint32_t levels = 1;
+			while ((std::max(width, height) >> levels) > 0) levels++;
+			return levels;
+		}
+
+		bool getModifiedTime(std::string path, time_t &time) {
+			struct stat st;
+			if (stat(path.c_str(), &st) != 0) return false;
+			time = st.st_mtime;
+			return true;
+		}
+	}
+
+	VkFormat BlockCompressor::GetVkFormat(Format format) {
+		switch (format) {
+		case Format::BC1: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		case Format::BC3: return VK_FORMAT_BC3_UNORM_BLOCK;
+		case Format::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+		default: return VK_FORMAT_BC7_UNORM_BLOCK;
+		}
+	}
+
+	bool BlockCompressor::IsSupported(Format format) {
+		if (!VKDK::deviceFeatures.textureCompressionBC) return false;
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(VKDK::physicalDevice, GetVkFormat(format), &formatProperties);
+		return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+	}
+
+	std::string BlockCompressor::GetCachePath(std::string imagePath, Format format, bool srgb) {
+		/* The source's extension is kept, so that brick.png and brick.jpg don't share a cache */
+		const char *suffixes[] = { ".bc1.ktx", ".bc3.ktx", ".bc5.ktx", ".bc7.ktx" };
+		return imagePath + (srgb ? "" : ".linear") + suffixes[(int)format];
+	}
+
+	bool BlockCompressor::ChooseFormat(const uint8_t *pixels, uint32_t width, uint32_t height, Format &format) {
+		bool opaque = true;
+		for (size_t i = 0; i < (size_t)width * height && opaque; ++i) opaque = pixels[i * 4 + 3] == 255;
+
+		if (opaque && IsSupported(Format::BC1)) format = Format::BC1;
+		else if (IsSupported(Format::BC7)) format = Format::BC7;
+		else if (IsSupported(Format::BC3)) format = Format::BC3;
+		else return false;
+		return true;
+	}
+
+	gli::texture2d BlockCompressor::Encode(const uint8_t *pixels, uint32_t width, uint32_t height, Format format, bool mipmaps,
+		bool srgb)
+	{
+		uint32_t levels = mipmaps ? getLevelCount(width, height) : 1;
+
+		/* gli's format enum matches Vulkan's */
+		gli::texture2d texture((gli::format)GetVkFormat(format), gli::extent2d(width, height), levels);
+
+		/* BC5 holds vectors rather than colors, so its mips are averaged as they are */
+		srgb = srgb && (format != Format::BC5);
+		std::vector<uint8_t> level(pixels, pixels + (size_t)width * height * 4);
+		for (uint32_t i = 0; i < levels; ++i) {
+			encodeLevel(level.data(), width, height, format, (uint8_t*)texture[i].data());
+			if (i + 1 == levels) break;
+			level = downsample(level, width, height, srgb);
+			width = std::max(1u, width / 2);
+			height = std::max(1u, height / 2);
+		}
+		return texture;
+	}
+
+	bool BlockCompressor::LoadCompressed(std::string imagePath, gli::texture2d &texture, bool srgb) {
+		const Format formats[] = { Format::BC5, Format::BC7, Format::BC3, Format::BC1 };
+		if (!IsSupported(Format::BC1) && !IsSupported(Format::BC3) && !IsSupported(Format::BC7)) return false;
+
+		/* Only the header is read, to check the cache against */
+		time_t sourceTime;
+		int sourceWidth, sourceHeight, sourceChannels;
+		if (!getModifiedTime(imagePath, sourceTime)) return false;
+		if (!stbi_info(imagePath.c_str(), &sourceWidth, &sourceHeight, &sourceChannels)) return false;
+
+		/* Use the cache if it's at least as new as the source, and has the source's size and a full mip chain */
+		for (auto format : formats) {
+			std::string cachePath = GetCachePath(imagePath, format, srgb);
+			time_t cacheTime;
+			if (!IsSupported(format) || !getModifiedTime(cachePath, cacheTime) || cacheTime < sourceTime) continue;
+
+			gli::texture2d cached(gli::load(cachePath));
+			if (cached.empty() || (VkFormat)cached.format() != GetVkFormat(format)) continue;
+			if (cached.extent() != gli::extent2d(sourceWidth, sourceHeight)
+				|| cached.levels() != getLevelCount((uint32_t)sourceWidth, (uint32_t)sourceHeight)) {
+				std::cout << "BlockCompressor: Ignoring " << cachePath << ", which doesn't match its source" << std::endl;
+				continue;
+			}
+			texture = cached;
+			return true;
+		}
+
+		/* Flipped like Texture2D's PNG loader, so that both give the same orientation */
+		int width, height, channels;
+		stbi_set_flip_vertically_on_load(true);
+		stbi_uc* pixels = stbi_load(imagePath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+		if (!pixels) return false;
+
+		Format format;
+		if (!ChooseFormat(pixels, (uint32_t)width, (uint32_t)height, format)) {
+			stbi_image_free(pixels);
+			return false;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		texture = Encode(pixels, (uint32_t)width, (uint32_t)height, format, true, srgb);
+		stbi_image_free(pixels);
+		auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+		std::string cachePath = GetCachePath(imagePath, format, srgb);
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (gli::save_ktx(texture, cachePath))
+			std::cout << "BlockCompressor: Encoded " << cachePath << " in " << milliseconds << "ms" << std::endl;
+		else
+			std::cout << "BlockCompressor: Couldn't write " << cachePath << std::endl;
+		return true;
+	}
+}
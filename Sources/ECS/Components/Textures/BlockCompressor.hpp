@@ -0,0 +1,46 @@
+#pragma once
+
+#include "vkdk.hpp"
+
+#include <gli/gli.hpp>
+
+#include <string>
+
+namespace Components::Textures {
+	/* Encodes RGBA8 images, like PNGs loaded through stb_image, into BC block compressed textures with full mip chains.
+
+		LoadCompressed keeps the result next to the source image as a KTX file, named after the whole source file name and
+		the format (for example brick.png is cached as brick.png.bc1.ktx), and reuses it for as long as it's newer than
+		the source and has the source's size. Opaque images are encoded as BC1, and images with alpha as BC7, or BC3 where
+		BC7 can't be sampled. BC5 keeps only the red and green channels, for tangent space normal maps whose shaders
+		rebuild z, so it's only used when asked for.
+
+		Mips of color images are averaged in linear space, since PNG colors are sRGB encoded. Data maps, like specular
+		or roughness maps, are averaged as they are, and cached separately (brick_s.png.linear.bc1.ktx). Blocks are
+		encoded on every core, and the palette search is vectorized with SSE2 where available. */
+	class BlockCompressor {
+	public:
+		enum class Format { BC1, BC3, BC5, BC7 };
+
+		static VkFormat GetVkFormat(Format format);
+
+		/* True if the device can sample textures of the given format */
+		static bool IsSupported(Format format);
+
+		/* Path of the cached KTX file for a source image and format. srgb says whether its mips were averaged as colors. */
+		static std::string GetCachePath(std::string imagePath, Format format, bool srgb = true);
+
+		/* Loads the block compressed version of a PNG, from its cache if that's up to date, or else by encoding it and
+			writing the cache. Returns false if the device can't sample any suitable format, or the PNG can't be read.
+			srgb should be false for images which don't hold colors. */
+		static bool LoadCompressed(std::string imagePath, gli::texture2d &texture, bool srgb = true);
+
+		/* Picks BC1 for opaque pixels, and BC7 or BC3 otherwise. Returns false if neither is supported. */
+		static bool ChooseFormat(const uint8_t *pixels, uint32_t width, uint32_t height, Format &format);
+
+		/* Encodes tightly packed RGBA8 pixels, building the rest of the mip chain from them if mipmaps is set.
+			srgb averages the mips' colors in linear space. BC5 is always averaged as is. */
+		static gli::texture2d Encode(const uint8_t *pixels, uint32_t width, uint32_t height, Format format, bool mipmaps = true,
+			bool srgb = true);
+	};
+}
@@ -0,0 +1,291 @@
+#include "KTXFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Components::Textures {
+	namespace {
+		const uint8_t identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+		struct Header {
+			uint32_t endianness;
+			uint32_t glType;
+			uint32_t glTypeSize;
+			uint32_t glFormat;
+			uint32_t glInternalFormat;
+			uint32_t glBaseInternalFormat;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t numberOfArrayElements;
+			uint32_t numberOfFaces;
+			uint32_t numberOfMipmapLevels;
+			uint32_t bytesOfKeyValueData;
+		};
+
+		size_t alignUp(size_t value, size_t alignment) {
+			return ((value + alignment - 1) / alignment) * alignment;
+		}
+
+		size_t getPageSize() {
+#if defined(_WIN32)
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			return info.dwPageSize;
+#else
+			return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+		}
+	}
+
+	KTXFile::~KTXFile() {
+		close();
+	}
+
+	bool KTXFile::open(std::string path) {
+		close();
+
+		/* Pages are mapped copy on write, since some drivers won't import read only memory */
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		fileHandle = file;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) { close(); return false; }
+		mappingHandle = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		if (!mappingHandle) { close(); return false; }
+		mapping = (uint8_t*)MapViewOfFile(mappingHandle, FILE_MAP_COPY, 0, 0, 0);
+		if (!mapping) { close(); return false; }
+		mappingSize = (size_t)size.QuadPart;
+#else
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0) return false;
+		struct stat st;
+		if (fstat(file, &st) != 0 || st.st_size == 0) { ::close(file); return false; }
+		void *view = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+		::close(file);
+		if (view == MAP_FAILED) return false;
+		mapping = (uint8_t*)view;
+		mappingSize = (size_t)st.st_size;
+#endif
+
+		if (mappingSize < sizeof(identifier) + sizeof(Header) || memcmp(mapping, identifier, sizeof(identifier)) != 0) {
+			close();
+			return false;
+		}
+
+		/* Files written on big endian machines would need every word swapped */
+		Header header;
+		memcpy(&header, mapping + sizeof(identifier), sizeof(Header));
+		if (header.endianness != 0x04030201 || header.pixelWidth == 0) {
+			close();
+			return false;
+		}
+
+		gli::gl GL(gli::gl::PROFILE_KTX);
+		gli::format glFormat = GL.find(
+			static_cast<gli::gl::internal_format>(header.glInternalFormat),
+			static_cast<gli::gl::external_format>(header.glFormat),
+			static_cast<gli::gl::type_format>(header.glType));
+		if (glFormat == gli::FORMAT_UNDEFINED || glFormat == static_cast<gli::format>(gli::FORMAT_INVALID)) {
+			close();
+			return false;
+		}
+		format = (VkFormat)glFormat;
+
+		/* Same targets as gli picks */
+		if (header.numberOfFaces > 1) target = header.numberOfArrayElements > 0 ? gli::TARGET_CUBE_ARRAY : gli::TARGET_CUBE;
+		else if (header.numberOfArrayElements > 0) target = header.pixelHeight == 0 ? gli::TARGET_1D_ARRAY : gli::TARGET_2D_ARRAY;
+		else if (header.pixelHeight == 0) target = gli::TARGET_1D;
+		else if (header.pixelDepth > 0) target = gli::TARGET_3D;
+		else target = gli::TARGET_2D;
+
+		extent = { header.pixelWidth, std::max(header.pixelHeight, 1u), std::max(header.pixelDepth, 1u) };
+		levels = std::max(header.numberOfMipmapLevels, 1u);
+		layers = std::max(header.numberOfArrayElements, 1u);
+		faces = std::max(header.numberOfFaces, 1u);
+
+		/* Each level starts with its size, followed by every face of every layer, each padded to 4 bytes. Levels
+			whose size doesn't add up, like those with padded rows, aren't tightly packed and are left to gli. */
+		size_t offset = sizeof(identifier) + sizeof(Header) + header.bytesOfKeyValueData;
+		for (uint32_t level = 0; level < levels; ++level) {
+			if (offset + sizeof(uint32_t) > mappingSize) { close(); return false; }
+			uint32_t imageSize;
+			memcpy(&imageSize, mapping + offset, sizeof(uint32_t));
+			offset += sizeof(uint32_t);
+
+			size_t faceSize = (size_t)getImageSize(level);
+			size_t stride = alignUp(faceSize, 4);
+			size_t levelSize = stride * layers * faces;
+
+			/* Cubemaps store the size of one face, though gli writes the size of all six */
+			bool cubeFace = target == gli::TARGET_CUBE && imageSize == faceSize;
+			if ((imageSize != alignUp(levelSize, 4) && !cubeFace) || offset + levelSize > mappingSize) {
+				close();
+				return false;
+			}
+
+			levelOffsets.push_back(offset);
+			imageStrides.push_back(stride);
+			offset += alignUp(levelSize, 4);
+		}
+		return true;
+	}
+
+	void KTXFile::close() {
+#if defined(_WIN32)
+		if (mapping) UnmapViewOfFile(mapping);
+		if (mappingHandle) CloseHandle(mappingHandle);
+		if (fileHandle) CloseHandle(fileHandle);
+		fileHandle = mappingHandle = nullptr;
+#else
+		if (mapping) munmap(mapping, mappingSize);
+#endif
+		mapping = nullptr;
+		mappingSize = 0;
+		levelOffsets.clear();
+		imageStrides.clear();
+	}
+
+	VkExtent3D KTXFile::getExtent(uint32_t level) const {
+		return { std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u), std::max(extent.depth >> level, 1u) };
+	}
+
+	VkDeviceSize KTXFile::getImageSize(uint32_t level) const {
+		VkExtent3D levelExtent = getExtent(level);
+		gli::extent3d blockExtent = gli::block_extent((gli::format)format);
+		VkDeviceSize blocks = (VkDeviceSize)((levelExtent.width + blockExtent.x - 1) / blockExtent.x)
+			* ((levelExtent.height + blockExtent.y - 1) / blockExtent.y)
+			* ((levelExtent.depth + blockExtent.z - 1) / blockExtent.z);
+		return blocks * gli::block_size((gli::format)format);
+	}
+
+	const uint8_t *KTXFile::getImage(uint32_t layer, uint32_t face, uint32_t level) const {
+		return mapping + levelOffsets[level] + imageStrides[level] * ((size_t)layer * faces + face);
+	}
+
+	VkDeviceSize KTXFile::getRegions(uint32_t levelCount, VkDeviceSize alignment, std::vector<VkBufferImageCopy> &regions) const {
+		VkDeviceSize offset = 0;
+		levelCount = std::min(levelCount, levels);
+		for (uint32_t layer = 0; layer < layers; ++layer) {
+			for (uint32_t face = 0; face < faces; ++face) {
+				for (uint32_t level = 0; level < levelCount; ++level) {
+					offset = alignUp(offset, alignment);
+					VkBufferImageCopy region = {};
+					region.bufferOffset = offset;
+					region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					region.imageSubresource.mipLevel = level;
+					region.imageSubresource.baseArrayLayer = layer * faces + face;
+					region.imageSubresource.layerCount = 1;
+					region.imageExtent = getExtent(level);
+					regions.push_back(region);
+					offset += getImageSize(level);
+				}
+			}
+		}
+		return offset;
+	}
+
+	void KTXFile::copyImages(const std::vector<VkBufferImageCopy> &regions, uint8_t *destination) const {
+		for (auto &region : regions) {
+			uint32_t layer = region.imageSubresource.baseArrayLayer / faces;
+			uint32_t face = region.imageSubresource.baseArrayLayer % faces;
+			uint32_t level = region.imageSubresource.mipLevel;
+			memcpy(destination + region.bufferOffset, getImage(layer, face, level), (size_t)getImageSize(level));
+		}
+	}
+
+	void KTXFile::createStagingBuffer(uint32_t levelCount, VkBuffer &buffer, VkDeviceMemory &memory, std::vector<VkBufferImageCopy> &regions) const {
+		if (VKDK::externalMemoryHostSupported && importStagingBuffer(levelCount, buffer, memory, regions)) return;
+
+		VkDeviceSize alignment = std::lcm((VkDeviceSize)gli::block_size((gli::format)format), (VkDeviceSize)4);
+		VkDeviceSize size = getRegions(levelCount, alignment, regions);
+		VKDK::CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory);
+
+		void *data;
+		vkMapMemory(VKDK::device, memory, 0, size, 0, &data);
+		copyImages(regions, (uint8_t*)data);
+		vkUnmapMemory(VKDK::device, memory);
+	}
+
+	bool KTXFile::importStagingBuffer(uint32_t levelCount, VkBuffer &buffer, VkDeviceMemory &memory, std::vector<VkBufferImageCopy> &regions) const {
+		/* Copies read each image where it sits in the file, so every image has to meet the copy alignment. The import
+			is rounded up to whole pages, which the mapping covers, so it can't be coarser than a page. */
+		VkDeviceSize alignment = std::lcm((VkDeviceSize)gli::block_size((gli::format)format), (VkDeviceSize)4);
+		VkDeviceSize importAlignment = VKDK::minImportedHostPointerAlignment;
+		if (importAlignment > getPageSize() || ((uintptr_t)mapping % importAlignment) != 0) return false;
+
+		std::vector<VkBufferImageCopy> imported;
+		getRegions(levelCount, 1, imported);
+		for (auto &region : imported) {
+			uint32_t layer = region.imageSubresource.baseArrayLayer / faces;
+			uint32_t face = region.imageSubresource.baseArrayLayer % faces;
+			region.bufferOffset = getImage(layer, face, region.imageSubresource.mipLevel) - mapping;
+			if (region.bufferOffset % alignment != 0) return false;
+		}
+
+		VkDeviceSize size = alignUp(mappingSize, (size_t)importAlignment);
+
+		VkExternalMemoryBufferCreateInfoKHR externalInfo = {};
+		externalInfo.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO_KHR;
+		externalInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.pNext = &externalInfo;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateBuffer(VKDK::device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) return false;
+
+		VkMemoryHostPointerPropertiesEXT hostProperties = {};
+		hostProperties.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(VKDK::device, buffer, &memReqs);
+		if (VKDK::GetMemoryHostPointerProperties(VKDK::device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+			mapping, &hostProperties) != VK_SUCCESS || memReqs.size > size) {
+			vkDestroyBuffer(VKDK::device, buffer, nullptr);
+			return false;
+		}
+
+		/* Any type the pointer can be imported into will do, since the device only reads it once */
+		uint32_t memoryTypeBits = hostProperties.memoryTypeBits & memReqs.memoryTypeBits;
+		if (memoryTypeBits == 0) {
+			vkDestroyBuffer(VKDK::device, buffer, nullptr);
+			return false;
+		}
+		uint32_t memoryTypeIndex = 0;
+		while ((memoryTypeBits & (1u << memoryTypeIndex)) == 0) ++memoryTypeIndex;
+
+		VkImportMemoryHostPointerInfoEXT importInfo = {};
+		importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+		importInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+		importInfo.pHostPointer = mapping;
+
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.pNext = &importInfo;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+		if (vkAllocateMemory(VKDK::device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+			vkDestroyBuffer(VKDK::device, buffer, nullptr);
+			return false;
+		}
+		VK_CHECK_RESULT(vkBindBufferMemory(VKDK::device, buffer, memory, 0));
+
+		regions.insert(regions.end(), imported.begin(), imported.end());
+		return true;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "vkdk.hpp"
+
+#include <gli/gli.hpp>
+
+#include <string>
+#include <vector>
+
+namespace Components::Textures {
+	/* A KTX file mapped into memory, so its images can go straight from the file to a staging buffer instead of
+		through gli::load's read buffer and texture copy. Only the header is parsed, and the level offsets are found in
+		place.
+
+		Where VK_EXT_external_memory_host is enabled, and every image in the file happens to meet the copy alignment,
+		the mapping itself is imported as the staging buffer and nothing is copied on the CPU at all. Otherwise images
+		are copied from the mapping into a regular staging buffer.
+
+		open rejects files it doesn't handle, like big endian files or levels with padded rows, in which case they
+		should be loaded with gli instead. The file stays mapped until the KTXFile is closed or destroyed, so staging
+		buffers created from it must be destroyed first. */
+	class KTXFile {
+	public:
+		KTXFile() = default;
+		~KTXFile();
+		KTXFile(const KTXFile&) = delete;
+		KTXFile &operator=(const KTXFile&) = delete;
+
+		/* Maps and parses the file. Returns false if it can't be read or isn't a layout this reader handles. */
+		bool open(std::string path);
+		void close();
+
+		gli::target getTarget() const { return target; }
+		VkFormat getFormat() const { return format; }
+		VkExtent3D getExtent(uint32_t level = 0) const;
+		uint32_t getLevels() const { return levels; }
+		uint32_t getLayers() const { return layers; }
+		uint32_t getFaces() const { return faces; }
+
+		/* Size of one face of one layer of a level */
+		VkDeviceSize getImageSize(uint32_t level) const;
+
+		/* Points into the mapping at one face of one layer of a level */
+		const uint8_t *getImage(uint32_t layer, uint32_t face, uint32_t level) const;
+
+		/* Lays out the first levelCount levels of every face and layer back to back, each level of a face after the
+			previous one like gli does, with offsets aligned to alignment. Returns the total size. */
+		VkDeviceSize getRegions(uint32_t levelCount, VkDeviceSize alignment, std::vector<VkBufferImageCopy> &regions) const;
+
+		/* Copies the images of regions from the mapping to their offsets in destination */
+		void copyImages(const std::vector<VkBufferImageCopy> &regions, uint8_t *destination) const;
+
+		/* Creates a host visible buffer holding the first levelCount levels of every face and layer, and the regions to
+			copy them to an image with. Imports the mapping where it can, and copies into new memory where it can't. */
+		void createStagingBuffer(uint32_t levelCount, VkBuffer &buffer, VkDeviceMemory &memory, std::vector<VkBufferImageCopy> &regions) const;
+
+	private:
+		bool importStagingBuffer(uint32_t levelCount, VkBuffer &buffer, VkDeviceMemory &memory, std::vector<VkBufferImageCopy> &regions) const;
+
+		uint8_t *mapping = nullptr;
+		size_t mappingSize = 0;
+#if defined(_WIN32)
+		void *fileHandle = nullptr, *mappingHandle = nullptr;
+#endif
+
+		gli::target target = gli::TARGET_2D;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkExtent3D extent = { 0, 0, 0 };
+		uint32_t levels = 0, layers = 0, faces = 0;
+
+		/* Offset of the first image of each level in the mapping, and the distance between its faces and layers */
+		std::vector<size_t> levelOffsets, imageStrides;
+	};
+}
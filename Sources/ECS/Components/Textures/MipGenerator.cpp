@@ -0,0 +1,326 @@
+#include "MipGenerator.hpp"
+#include "Components/Materials/ShaderModules.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Components::Textures {
+	namespace {
+		/* Per image views and descriptor sets of the compute path. Set i reads level i and writes level i + 1. */
+		struct ComputeResources {
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			uint32_t mipLevels = 0, layers = 0;
+			VkDescriptorPool pool = VK_NULL_HANDLE;
+			std::vector<VkImageView> views;
+			std::vector<VkDescriptorSet> sets;
+		};
+
+		std::mutex mutex;
+		VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		std::map<std::string, VkPipeline> pipelines;
+		std::unordered_map<VkImage, ComputeResources> resources;
+
+		const char *shaderSource = ResourcePath "ComputeShaders/MipDownsample/shader.comp";
+
+		/* Storage image format qualifier the downsample shader is compiled with, or null if there's no variant for the format */
+		const char *getQualifier(VkFormat format) {
+			switch (format) {
+			case VK_FORMAT_R8G8B8A8_UNORM: return "rgba8";
+			case VK_FORMAT_R16G16B16A16_SFLOAT: return "rgba16f";
+			case VK_FORMAT_R32G32B32A32_SFLOAT: return "rgba32f";
+			case VK_FORMAT_R32_SFLOAT: return "r32f";
+			default: return nullptr;
+			}
+		}
+
+		std::string getFallbackPath(std::string qualifier) {
+			return ResourcePath "ComputeShaders/MipDownsample/" + qualifier + ".spv";
+		}
+
+		bool isSrgbFormat(VkFormat format) {
+			switch (format) {
+			case VK_FORMAT_R8_SRGB: case VK_FORMAT_R8G8_SRGB: case VK_FORMAT_R8G8B8_SRGB: case VK_FORMAT_B8G8R8_SRGB:
+			case VK_FORMAT_R8G8B8A8_SRGB: case VK_FORMAT_B8G8R8A8_SRGB: case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		bool hasFeatures(VkFormat format, VkFormatFeatureFlags features) {
+			VkFormatProperties properties;
+			vkGetPhysicalDeviceFormatProperties(VKDK::physicalDevice, format, &properties);
+			return (properties.optimalTilingFeatures & features) == features;
+		}
+
+		void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseLevel, uint32_t levelCount, uint32_t layers,
+			VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+			VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
+		{
+			VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstAccessMask = dstAccess;
+			barrier.image = image;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, layers };
+			vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		void freeResources(ComputeResources &entry) {
+			for (auto view : entry.views) vkDestroyImageView(VKDK::device, view, nullptr);
+			if (entry.pool) vkDestroyDescriptorPool(VKDK::device, entry.pool, nullptr);
+			entry = ComputeResources();
+		}
+
+		/* Must be called with the mutex held */
+		VkPipeline getPipeline(std::string qualifier) {
+			auto item = pipelines.find(qualifier);
+			if (item != pipelines.end()) return item->second;
+
+			VkComputePipelineCreateInfo pipelineInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout);
+			pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			pipelineInfo.stage.module = Materials::ShaderModules::Get(shaderSource, VK_SHADER_STAGE_COMPUTE_BIT,
+				{ "FORMAT=" + qualifier }, getFallbackPath(qualifier));
+			pipelineInfo.stage.pName = "main";
+
+			VkPipeline pipeline;
+			auto start = std::chrono::steady_clock::now();
+			if (vkCreateComputePipelines(VKDK::device, VKDK::pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create mip downsample pipeline!");
+			}
+			VKDK::RecordPipelineCreation(1, std::chrono::steady_clock::now() - start);
+			pipelines[qualifier] = pipeline;
+			return pipeline;
+		}
+
+		/* Must be called with the mutex held */
+		ComputeResources &getResources(VkImage image, VkFormat format, uint32_t mipLevels, uint32_t layers) {
+			auto &entry = resources[image];
+			if (entry.pool && entry.format == format && entry.mipLevels == mipLevels && entry.layers == layers) return entry;
+
+			/* A handle reused by a newer image which wasn't released */
+			freeResources(entry);
+			entry.format = format;
+			entry.mipLevels = mipLevels;
+			entry.layers = layers;
+
+			/* Views are arrays even for plain 2D images, so one shader handles 2D textures, cubemaps and arrays */
+			VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+			viewInfo.format = format;
+			viewInfo.image = image;
+			entry.views.resize(mipLevels);
+			for (uint32_t level = 0; level < mipLevels; ++level) {
+				viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, layers };
+				VK_CHECK_RESULT(vkCreateImageView(VKDK::device, &viewInfo, nullptr, &entry.views[level]));
+			}
+
+			uint32_t setCount = mipLevels - 1;
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount),
+			};
+			VkDescriptorPoolCreateInfo poolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, setCount);
+			VK_CHECK_RESULT(vkCreateDescriptorPool(VKDK::device, &poolInfo, nullptr, &entry.pool));
+
+			std::vector<VkDescriptorSetLayout> layouts(setCount, setLayout);
+			entry.sets.resize(setCount);
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(entry.pool, layouts.data(), setCount);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(VKDK::device, &allocInfo, entry.sets.data()));
+			for (uint32_t level = 0; level < setCount; ++level) {
+				VkDescriptorImageInfo source = vks::initializers::descriptorImageInfo(sampler, entry.views[level], VK_IMAGE_LAYOUT_GENERAL);
+				VkDescriptorImageInfo destination = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, entry.views[level + 1], VK_IMAGE_LAYOUT_GENERAL);
+				std::vector<VkWriteDescriptorSet> writes = {
+					vks::initializers::writeDescriptorSet(entry.sets[level], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &source),
+					vks::initializers::writeDescriptorSet(entry.sets[level], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &destination),
+				};
+				vkUpdateDescriptorSets(VKDK::device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+			}
+			return entry;
+		}
+	}
+
+	void MipGenerator::Initialize() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (setLayout) return;
+
+		std::vector<VkDescriptorSetLayoutBinding> bindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo layoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(bindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(VKDK::device, &layoutInfo, nullptr, &setLayout));
+
+		/* The only push constant says whether texels are sRGB encoded */
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = vks::initializers::pipelineLayoutCreateInfo(&setLayout);
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(VKDK::device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
+
+		/* Texels are read with texelFetch, so filtering doesn't matter */
+		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.maxAnisotropy = 1.0f;
+		VK_CHECK_RESULT(vkCreateSampler(VKDK::device, &samplerInfo, nullptr, &sampler));
+	}
+
+	void MipGenerator::Destroy() {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &item : resources) freeResources(item.second);
+		resources.clear();
+		for (auto &item : pipelines) vkDestroyPipeline(VKDK::device, item.second, nullptr);
+		pipelines.clear();
+		if (sampler) vkDestroySampler(VKDK::device, sampler, nullptr);
+		if (pipelineLayout) vkDestroyPipelineLayout(VKDK::device, pipelineLayout, nullptr);
+		if (setLayout) vkDestroyDescriptorSetLayout(VKDK::device, setLayout, nullptr);
+		sampler = VK_NULL_HANDLE;
+		pipelineLayout = VK_NULL_HANDLE;
+		setLayout = VK_NULL_HANDLE;
+	}
+
+	uint32_t MipGenerator::GetMipLevels(uint32_t width, uint32_t height, uint32_t depth) {
+		uint32_t largest = std::max({ width, height, depth });
+		uint32_t levels = 1;
+		while ((largest >> levels) > 0) levels++;
+		return levels;
+	}
+
+	bool MipGenerator::SupportsBlit(VkFormat format) {
+		return hasFeatures(format, VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT
+			| VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+	}
+
+	bool MipGenerator::UseCompute(VkFormat format, VkImageViewType viewType, bool srgb) {
+		/* The downsample shader only handles 2D levels (and arrays of them) */
+		if (viewType == VK_IMAGE_VIEW_TYPE_3D || viewType == VK_IMAGE_VIEW_TYPE_1D || viewType == VK_IMAGE_VIEW_TYPE_1D_ARRAY) return false;
+		if (!setLayout) return false;
+
+		auto qualifier = getQualifier(format);
+		if (!qualifier) return false;
+		if (!hasFeatures(format, VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) return false;
+		if (!Materials::ShaderModules::CanLoad(shaderSource, getFallbackPath(qualifier))) return false;
+
+		/* If the shader isn't available, sRGB data in UNORM images is still blitted, just not gamma correctly */
+		return !SupportsBlit(format) || (srgb && !isSrgbFormat(format));
+	}
+
+	bool MipGenerator::CanGenerate(VkFormat format, VkImageViewType viewType, bool srgb) {
+		return UseCompute(format, viewType, srgb) || SupportsBlit(format);
+	}
+
+	VkImageUsageFlags MipGenerator::GetRequiredUsage(VkFormat format, VkImageViewType viewType, bool srgb) {
+		if (UseCompute(format, viewType, srgb)) return VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		return VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+
+	void MipGenerator::Generate(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkExtent3D extent,
+		uint32_t mipLevels, uint32_t layers, VkImageViewType viewType, VkImageLayout oldLayout, VkImageLayout newLayout, bool srgb)
+	{
+		if (mipLevels <= 1) {
+			if (oldLayout != newLayout)
+				imageBarrier(commandBuffer, image, 0, 1, layers, oldLayout, newLayout,
+					VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+					VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+			return;
+		}
+
+		if (UseCompute(format, viewType, srgb))
+			GenerateCompute(commandBuffer, image, format, extent, mipLevels, layers, oldLayout, newLayout, srgb);
+		else if (SupportsBlit(format))
+			GenerateBlit(commandBuffer, image, extent, mipLevels, layers, viewType, oldLayout, newLayout);
+		else
+			throw std::runtime_error("mip maps can't be generated for this image format!");
+	}
+
+	void MipGenerator::GenerateBlit(VkCommandBuffer commandBuffer, VkImage image, VkExtent3D extent,
+		uint32_t mipLevels, uint32_t layers, VkImageViewType viewType, VkImageLayout oldLayout, VkImageLayout newLayout)
+	{
+		imageBarrier(commandBuffer, image, 0, 1, layers, oldLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		imageBarrier(commandBuffer, image, 1, mipLevels - 1, layers, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		bool volume = (viewType == VK_IMAGE_VIEW_TYPE_3D);
+		for (uint32_t level = 1; level < mipLevels; ++level) {
+			VkImageBlit blit = {};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, layers };
+			blit.srcOffsets[1].x = (int32_t)std::max(1u, extent.width >> (level - 1));
+			blit.srcOffsets[1].y = (int32_t)std::max(1u, extent.height >> (level - 1));
+			blit.srcOffsets[1].z = volume ? (int32_t)std::max(1u, extent.depth >> (level - 1)) : 1;
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, layers };
+			blit.dstOffsets[1].x = (int32_t)std::max(1u, extent.width >> level);
+			blit.dstOffsets[1].y = (int32_t)std::max(1u, extent.height >> level);
+			blit.dstOffsets[1].z = volume ? (int32_t)std::max(1u, extent.depth >> level) : 1;
+			vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1, &blit, VK_FILTER_LINEAR);
+
+			/* The level just written is the source of the next one */
+			imageBarrier(commandBuffer, image, level, 1, layers, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		}
+
+		imageBarrier(commandBuffer, image, 0, mipLevels, layers, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, newLayout,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	}
+
+	void MipGenerator::GenerateCompute(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkExtent3D extent,
+		uint32_t mipLevels, uint32_t layers, VkImageLayout oldLayout, VkImageLayout newLayout, bool srgb)
+	{
+		VkPipeline pipeline;
+		std::vector<VkDescriptorSet> sets;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pipeline = getPipeline(getQualifier(format));
+			sets = getResources(image, format, mipLevels, layers).sets;
+		}
+
+		imageBarrier(commandBuffer, image, 0, 1, layers, oldLayout, VK_IMAGE_LAYOUT_GENERAL,
+			VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		imageBarrier(commandBuffer, image, 1, mipLevels - 1, layers, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+			0, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		uint32_t srgbFlag = srgb ? 1 : 0;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &srgbFlag);
+		for (uint32_t level = 1; level < mipLevels; ++level) {
+			uint32_t levelWidth = std::max(1u, extent.width >> level);
+			uint32_t levelHeight = std::max(1u, extent.height >> level);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &sets[level - 1], 0, nullptr);
+			vkCmdDispatch(commandBuffer, (levelWidth + 7) / 8, (levelHeight + 7) / 8, layers);
+
+			imageBarrier(commandBuffer, image, level, 1, layers, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		}
+
+		imageBarrier(commandBuffer, image, 0, mipLevels, layers, VK_IMAGE_LAYOUT_GENERAL, newLayout,
+			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	}
+
+	void MipGenerator::Release(VkImage image) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto item = resources.find(image);
+		if (item == resources.end()) return;
+		freeResources(item->second);
+		resources.erase(item);
+	}
+}
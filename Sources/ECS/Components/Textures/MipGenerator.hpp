@@ -0,0 +1,47 @@
+#pragma once
+
+#include "vkdk.hpp"
+
+namespace Components::Textures {
+	/* Builds the mip chain of an image from its first level, for textures which are loaded or rendered without one.
+
+		Where the format supports linear filtering as a blit source and destination, each level is blitted from the
+		one above it. Otherwise, or when a UNORM image holds sRGB encoded colors (like PNGs loaded as R8G8B8A8_UNORM),
+		a compute pass averages each 2x2 block instead, converting sRGB colors to linear before averaging. Images with
+		an sRGB format are already filtered in linear space by the blit.
+
+		The compute path keeps a view and descriptor set per level of each image it runs on, so that command buffers
+		recorded once and submitted every frame stay valid. Those are freed by Release. */
+	class MipGenerator {
+	public:
+		static void Initialize();
+		static void Destroy();
+
+		/* Number of levels in a full mip chain for the given extent */
+		static uint32_t GetMipLevels(uint32_t width, uint32_t height, uint32_t depth = 1);
+
+		/* True if Generate can build mips for images of this format and view type */
+		static bool CanGenerate(VkFormat format, VkImageViewType viewType, bool srgb = false);
+
+		/* Usage flags an image needs, on top of its own, for Generate to work on it */
+		static VkImageUsageFlags GetRequiredUsage(VkFormat format, VkImageViewType viewType, bool srgb = false);
+
+		/* Records building levels 1 to mipLevels - 1 of every layer from level 0. Level 0 must be in oldLayout, the
+			contents of the other levels are discarded, and every level is left in newLayout. srgb says the texels hold
+			sRGB encoded colors, whatever the format. */
+		static void Generate(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkExtent3D extent,
+			uint32_t mipLevels, uint32_t layers, VkImageViewType viewType, VkImageLayout oldLayout, VkImageLayout newLayout,
+			bool srgb = false);
+
+		/* Frees what the compute path kept for an image. Call before destroying any image passed to Generate. */
+		static void Release(VkImage image);
+
+	private:
+		static bool SupportsBlit(VkFormat format);
+		static bool UseCompute(VkFormat format, VkImageViewType viewType, bool srgb);
+		static void GenerateBlit(VkCommandBuffer commandBuffer, VkImage image, VkExtent3D extent,
+			uint32_t mipLevels, uint32_t layers, VkImageViewType viewType, VkImageLayout oldLayout, VkImageLayout newLayout);
+		static void GenerateCompute(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkExtent3D extent,
+			uint32_t mipLevels, uint32_t layers, VkImageLayout oldLayout, VkImageLayout newLayout, bool srgb);
+	};
+}
@@ -9,21 +9,23 @@ namespace Components::Textures {
 	class RenderableTexture2D : public TextureInterface {
   private:
     VkRenderPass renderPass;
+    VkImageView attachmentImageView = VK_NULL_HANDLE;
 
 	public:
-		static std::shared_ptr<Texture>Create(std::string name, int width, int height, VkRenderPass &renderPass) 
+		/* If mipmapped, the attachment has a full mip chain, which the perspective rendering to it rebuilds after each pass */
+		static std::shared_ptr<Texture>Create(std::string name, int width, int height, VkRenderPass &renderPass, bool mipmapped = false) 
 		{
 			std::cout << "ComponentManager: Adding RenderableTexture2D \"" << name << "\"" << std::endl;
 
 			auto tex = std::make_shared<Texture>();
-			auto rt2d = std::make_shared<RenderableTexture2D>(width, height, renderPass);
+			auto rt2d = std::make_shared<RenderableTexture2D>(width, height, renderPass, mipmapped);
 			tex->texture = rt2d;
 			Systems::ComponentManager::Textures[name] = tex;
 			return tex;
 		}
 
 		/* Constructors */
-		RenderableTexture2D(int width, int height, VkRenderPass &renderPass) {
+		RenderableTexture2D(int width, int height, VkRenderPass &renderPass, bool mipmapped = false) {
 			/* Save the image/framebuffer width and height. */
 			this->width = width;
 			this->height = height;
@@ -32,14 +34,21 @@ namespace Components::Textures {
       this->viewType = VK_IMAGE_VIEW_TYPE_2D;
 			this->renderPass = renderPass;
 
+			colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+			if (mipmapped && MipGenerator::CanGenerate(colorFormat, viewType))
+				colorMipLevels = MipGenerator::GetMipLevels(width, height);
+
 			createColorImageResources();
 			createDepthStencilResources();
 			createFrameBuffer();
 		}
 
-		void createColorImageResources() {
-			colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+		void cleanup() {
+			if (attachmentImageView) vkDestroyImageView(VKDK::device, attachmentImageView, nullptr);
+			TextureInterface::cleanup();
+		}
 
+		void createColorImageResources() {
 			VkImageCreateInfo imageInfo = {};
 			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 			imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -54,6 +63,7 @@ namespace Components::Textures {
 
 			/* We will sample directly from the color attachment*/
 			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			if (colorMipLevels > 1) imageInfo.usage |= MipGenerator::GetRequiredUsage(colorFormat, viewType);
 
 			VkMemoryAllocateInfo memAlloc = {};
 			memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
@@ -76,17 +86,23 @@ namespace Components::Textures {
 			colorImageViewInfo.subresourceRange = {};
 			colorImageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			colorImageViewInfo.subresourceRange.baseMipLevel = 0;
-			colorImageViewInfo.subresourceRange.levelCount = 1;
+			colorImageViewInfo.subresourceRange.levelCount = colorMipLevels;
 			colorImageViewInfo.subresourceRange.baseArrayLayer = 0;
 			colorImageViewInfo.subresourceRange.layerCount = 1;
 			colorImageViewInfo.image = colorImage;
 			VK_CHECK_RESULT(vkCreateImageView(VKDK::device, &colorImageViewInfo, nullptr, &colorImageView));
 
+			/* Framebuffer attachments can only have one level, so a mipmapped image needs a second view to render into */
+			if (colorMipLevels > 1) {
+				colorImageViewInfo.subresourceRange.levelCount = 1;
+				VK_CHECK_RESULT(vkCreateImageView(VKDK::device, &colorImageViewInfo, nullptr, &attachmentImageView));
+			}
+
 			/* Create a sampler to sample from the attachment in the fragment shader */
 			VkSamplerCreateInfo samplerInfo = {};
 			samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 			samplerInfo.magFilter = VK_FILTER_NEAREST;
-			samplerInfo.minFilter = VK_FILTER_NEAREST;
+			samplerInfo.minFilter = (colorMipLevels > 1) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
 			samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 			samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
 			samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
@@ -94,9 +110,9 @@ namespace Components::Textures {
 			samplerInfo.mipLodBias = 0.0;
 			samplerInfo.maxAnisotropy = 1.0;
 			samplerInfo.minLod = 0.0;
-			samplerInfo.maxLod = 1.0;
+			samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 			samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-			VK_CHECK_RESULT(vkCreateSampler(VKDK::device, &samplerInfo, nullptr, &colorSampler));
+			colorSampler = SamplerCache::Get(samplerInfo);
 		}
 
 		void createDepthStencilResources() {
@@ -150,7 +166,7 @@ namespace Components::Textures {
 
 		void createFrameBuffer() {
 			VkImageView attachments[2];
-			attachments[0] = colorImageView;
+			attachments[0] = (attachmentImageView) ? attachmentImageView : colorImageView;
 			attachments[1] = depthImageView;
 
 			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
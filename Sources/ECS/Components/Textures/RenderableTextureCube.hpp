@@ -92,9 +92,9 @@ namespace Components::Textures {
       samplerInfo.mipLodBias = 0.0;
       samplerInfo.maxAnisotropy = 1.0;
       samplerInfo.minLod = 0.0;
-      samplerInfo.maxLod = (float)colorMipLevels;
+      samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
       samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-      VK_CHECK_RESULT(vkCreateSampler(VKDK::device, &samplerInfo, nullptr, &colorSampler));
+      colorSampler = SamplerCache::Get(samplerInfo);
     }
 
     void createDepthStencilResources() {
@@ -160,7 +160,7 @@ namespace Components::Textures {
       samplerInfo.minLod = 0.0;
       samplerInfo.maxLod = 1.0f;
       samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-      VK_CHECK_RESULT(vkCreateSampler(VKDK::device, &samplerInfo, nullptr, &depthSampler));
+      depthSampler = SamplerCache::Get(samplerInfo);
     }
  
     void createFrameBuffer() {
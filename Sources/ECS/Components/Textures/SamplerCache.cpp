@@ -0,0 +1,108 @@
+#include "SamplerCache.hpp"
+
+#include <array>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+namespace Components::Textures {
+	namespace {
+		/* Every field of VkSamplerCreateInfo after pNext, with floats kept as their bits */
+		typedef std::array<uint32_t, 16> Key;
+
+		struct KeyHash {
+			size_t operator()(const Key &key) const {
+				uint64_t hash = 14695981039346656037ull;
+				for (uint32_t value : key) {
+					hash ^= value;
+					hash *= 1099511628211ull;
+				}
+				return (size_t)hash;
+			}
+		};
+
+		struct Entry {
+			VkSampler sampler = VK_NULL_HANDLE;
+			uint32_t references = 0;
+		};
+
+		std::mutex mutex;
+		std::unordered_map<Key, Entry, KeyHash> entries;
+		std::unordered_map<VkSampler, Key> keys;
+
+		uint32_t floatBits(float value) {
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+
+		Key getKey(const VkSamplerCreateInfo &info) {
+			return { {
+				info.flags, (uint32_t)info.magFilter, (uint32_t)info.minFilter, (uint32_t)info.mipmapMode,
+				(uint32_t)info.addressModeU, (uint32_t)info.addressModeV, (uint32_t)info.addressModeW,
+				floatBits(info.mipLodBias), info.anisotropyEnable, floatBits(info.maxAnisotropy),
+				info.compareEnable, (uint32_t)info.compareOp, floatBits(info.minLod), floatBits(info.maxLod),
+				(uint32_t)info.borderColor, info.unnormalizedCoordinates
+			} };
+		}
+
+		/* Destroys one unreferenced sampler. Returns false if every sampler is in use. */
+		bool evict() {
+			for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+				if (entry->second.references > 0 || !entry->second.sampler) continue;
+				vkDestroySampler(VKDK::device, entry->second.sampler, nullptr);
+				keys.erase(entry->second.sampler);
+				entries.erase(entry);
+				return true;
+			}
+			return false;
+		}
+	}
+
+	void SamplerCache::Destroy() {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &entry : entries)
+			vkDestroySampler(VKDK::device, entry.second.sampler, nullptr);
+		entries.clear();
+		keys.clear();
+	}
+
+	VkSampler SamplerCache::Get(const VkSamplerCreateInfo &info) {
+		if (info.pNext) throw std::runtime_error("SamplerCache: samplers with pNext chains can't be shared!");
+
+		Key key = getKey(info);
+		std::lock_guard<std::mutex> lock(mutex);
+		auto &entry = entries[key];
+		if (!entry.sampler) {
+			uint32_t limit = VKDK::deviceProperties.limits.maxSamplerAllocationCount;
+			if (limit && entries.size() > limit && !evict()) {
+				entries.erase(key);
+				throw std::runtime_error("SamplerCache: every one of the device's samplers is in use!");
+			}
+			if (vkCreateSampler(VKDK::device, &info, nullptr, &entry.sampler) != VK_SUCCESS) {
+				entries.erase(key);
+				throw std::runtime_error("SamplerCache: failed to create sampler!");
+			}
+			keys[entry.sampler] = key;
+		}
+		entry.references++;
+		return entry.sampler;
+	}
+
+	void SamplerCache::Release(VkSampler sampler) {
+		if (!sampler) return;
+		std::lock_guard<std::mutex> lock(mutex);
+		auto key = keys.find(sampler);
+		if (key == keys.end()) {
+			vkDestroySampler(VKDK::device, sampler, nullptr);
+			return;
+		}
+		auto &entry = entries[key->second];
+		if (entry.references > 0) entry.references--;
+	}
+
+	uint32_t SamplerCache::GetSamplerCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return (uint32_t)entries.size();
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "vkdk.hpp"
+
+namespace Components::Textures {
+	/* Shares samplers between textures. Only a handful of sampler configurations are ever used, so rather than each
+		texture creating its own, samplers are looked up by a hash of their create info and reference counted.
+
+		Samplers whose last reference is released stay cached, since the next texture loaded likely wants the same
+		one. They're only destroyed to make room when the device's maxSamplerAllocationCount is reached, or by
+		Destroy. Since a sampler handle is the same for every texture with the same settings, shared samplers also
+		suit immutable sampler bindings. */
+	class SamplerCache {
+	public:
+		static void Destroy();
+
+		/* Returns a sampler created from info, holding a reference to it until Release. pNext chains aren't supported. */
+		static VkSampler Get(const VkSamplerCreateInfo &info);
+
+		/* Drops a reference to a sampler from Get. Samplers which didn't come from the cache are destroyed. */
+		static void Release(VkSampler sampler);
+
+		/* Number of samplers the cache currently holds, whether referenced or not */
+		static uint32_t GetSamplerCount();
+	};
+}
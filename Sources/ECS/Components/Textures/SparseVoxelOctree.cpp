@@ -0,0 +1,321 @@
+#include "SparseVoxelOctree.hpp"
+#include "Components/Materials/ShaderModules.hpp"
+#include "Systems/ComponentManager.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace Components::Textures {
+	namespace {
+		const char *shaderSource = ResourcePath "ComputeShaders/OctreeBuild/shader.comp";
+
+		/* Matches the push constants of the build shader */
+		struct PushConstants {
+			uint32_t level;
+			uint32_t maxDepth;
+		};
+
+		std::string getFallbackPath(uint32_t pass) {
+			return ResourcePath "ComputeShaders/OctreeBuild/pass" + std::to_string(pass) + ".spv";
+		}
+
+		/* Every pass reads what the one before it wrote, and some read their dispatch size from it */
+		void computeBarrier(VkCommandBuffer commandBuffer) {
+			VkMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+	}
+
+	bool SparseVoxelOctree::IsSupported() {
+		/* The precompiled Voxelize and Blinn shaders don't include the octree paths, so they must be compiled from source */
+		return VKDK::deviceFeatures.fragmentStoresAndAtomics
+			&& Materials::ShaderModules::IsCompilerAvailable()
+			&& Materials::ShaderModules::CanLoad(shaderSource);
+	}
+
+	std::shared_ptr<Texture> SparseVoxelOctree::Create(std::string name, uint32_t maxDepth, uint32_t brickPoolSize, uint32_t maxFragments) {
+		std::cout << "ComponentManager: Adding SparseVoxelOctree \"" << name << "\"" << std::endl;
+
+		auto texComponent = std::make_shared<Texture>();
+		texComponent->texture = std::make_shared<SparseVoxelOctree>(maxDepth, brickPoolSize, maxFragments);
+		Systems::ComponentManager::Textures[name] = texComponent;
+		return texComponent;
+	}
+
+	SparseVoxelOctree::SparseVoxelOctree(uint32_t maxDepth, uint32_t brickPoolSize, uint32_t maxFragments) {
+		if (maxDepth < 1 || maxDepth > MaxDepth)
+			throw std::runtime_error("SparseVoxelOctree: depth must be between 1 and " + std::to_string(MaxDepth) + "!");
+
+		/* Node indices keep their top bit free for flagging nodes to subdivide */
+		if (brickPoolSize < 1 || brickPoolSize > 512)
+			throw std::runtime_error("SparseVoxelOctree: brick pool size must be between 1 and 512!");
+		if (brickPoolSize * 2 > VKDK::deviceProperties.limits.maxImageDimension3D)
+			throw std::runtime_error("SparseVoxelOctree: brick pool is larger than the device's largest 3D image!");
+
+		this->maxDepth = maxDepth;
+		this->maxTiles = brickPoolSize * brickPoolSize * brickPoolSize;
+		this->maxFragments = maxFragments;
+		viewType = VK_IMAGE_VIEW_TYPE_3D;
+
+		createBrickPool(brickPoolSize);
+		createBuffers();
+		createPipelines();
+	}
+
+	void SparseVoxelOctree::createBrickPool(uint32_t brickPoolSize) {
+		/* Averages of sparse children quickly fall below what 8 bits can hold, so bricks are half floats */
+		colorFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+		width = height = depth = brickPoolSize * 2;
+		colorMipLevels = 1;
+
+		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
+		imageInfo.imageType = VK_IMAGE_TYPE_3D;
+		imageInfo.format = colorFormat;
+		imageInfo.extent = { width, height, depth };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(VKDK::device, &imageInfo, nullptr, &colorImage));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(VKDK::device, colorImage, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = VKDK::FindMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(VKDK::device, &memAlloc, nullptr, &colorImageMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(VKDK::device, colorImage, colorImageMemory, 0));
+
+		/* Like the dense volume, the brick pool stays in the general layout to be written by shaders */
+		VkCommandBuffer commandBuffer = VKDK::beginSingleTimeCommands();
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		setImageLayout(commandBuffer, colorImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresourceRange);
+		VKDK::endSingleTimeCommands(commandBuffer);
+		colorImageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		createColorImageView();
+
+		/* Samples are clamped inside a brick by the shader, so the edge mode never shows */
+		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
+		sampler.magFilter = VK_FILTER_LINEAR;
+		sampler.minFilter = VK_FILTER_LINEAR;
+		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler.maxAnisotropy = 1.0f;
+		sampler.maxLod = 0.0f;
+		sampler.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+		colorSampler = SamplerCache::Get(sampler);
+	}
+
+	void SparseVoxelOctree::createBuffers() {
+		VKDK::CreateBuffer(sizeof(State), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+			| VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, stateBuffer, stateMemory);
+		VKDK::CreateBuffer(VkDeviceSize(maxTiles) * 8 * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, nodeBuffer, nodeMemory);
+
+		/* Each fragment is its packed voxel, followed by its packed color */
+		VKDK::CreateBuffer(sizeof(FragmentListHeader) + VkDeviceSize(maxFragments) * 2 * sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, fragmentBuffer, fragmentMemory);
+
+		/* The counts start out zeroed, so nothing is reported before the first build */
+		VKDK::CreateBuffer(4 * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, countsBuffer, countsMemory);
+		VK_CHECK_RESULT(vkMapMemory(VKDK::device, countsMemory, 0, 4 * sizeof(uint32_t), 0, (void**)&counts));
+		memset(counts, 0, 4 * sizeof(uint32_t));
+	}
+
+	void SparseVoxelOctree::createPipelines() {
+		std::vector<VkDescriptorSetLayoutBinding> bindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		};
+		VkDescriptorSetLayoutCreateInfo layoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(bindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(VKDK::device, &layoutInfo, nullptr, &setLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = vks::initializers::pipelineLayoutCreateInfo(&setLayout);
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(VKDK::device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
+
+		/* Every pass is the same source, compiled with PASS selecting its step */
+		std::vector<std::shared_future<VkShaderModule>> modules;
+		for (uint32_t pass = 0; pass < PassCount; ++pass)
+			modules.push_back(Materials::ShaderModules::GetAsync(shaderSource, VK_SHADER_STAGE_COMPUTE_BIT,
+				{ "PASS=" + std::to_string(pass) }, getFallbackPath(pass)));
+
+		for (uint32_t pass = 0; pass < PassCount; ++pass) {
+			VkComputePipelineCreateInfo pipelineInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout);
+			pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			pipelineInfo.stage.module = modules[pass].get();
+			pipelineInfo.stage.pName = "main";
+
+			auto start = std::chrono::steady_clock::now();
+			if (vkCreateComputePipelines(VKDK::device, VKDK::pipelineCache, 1, &pipelineInfo, nullptr, &pipelines[pass]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create octree build pipeline!");
+			}
+			VKDK::RecordPipelineCreation(1, std::chrono::steady_clock::now() - start);
+		}
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),
+		};
+		VkDescriptorPoolCreateInfo poolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(VKDK::device, &poolInfo, nullptr, &descriptorPool));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &setLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(VKDK::device, &allocInfo, &descriptorSet));
+
+		VkDescriptorBufferInfo state = { stateBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo nodes = { nodeBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo fragments = { fragmentBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorImageInfo bricks = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, colorImageView, VK_IMAGE_LAYOUT_GENERAL);
+		std::vector<VkWriteDescriptorSet> writes = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &state),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &nodes),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &fragments),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3, &bricks),
+		};
+		vkUpdateDescriptorSets(VKDK::device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+	}
+
+	void SparseVoxelOctree::reset(VkCommandBuffer commandBuffer) {
+		/* Last frame's build and lookups must finish before anything is cleared */
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+		/* Only the root's tile is allocated, and level 0 is that tile */
+		State state = {};
+		state.tileCount = 1;
+		state.maxTiles = maxTiles;
+		FragmentListHeader header = {};
+		header.capacity = maxFragments;
+		vkCmdUpdateBuffer(commandBuffer, stateBuffer, 0, sizeof(State), &state);
+		vkCmdUpdateBuffer(commandBuffer, fragmentBuffer, 0, sizeof(FragmentListHeader), &header);
+		vkCmdFillBuffer(commandBuffer, nodeBuffer, 0, VK_WHOLE_SIZE, 0);
+
+		/* Empty children are never written by the build, so they need to start out transparent */
+		VkClearColorValue clearColor = {};
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vkCmdClearColorImage(commandBuffer, colorImage, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresourceRange);
+
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	void SparseVoxelOctree::dispatch(VkCommandBuffer commandBuffer, Pass pass, uint32_t level, VkDeviceSize argsOffset) {
+		PushConstants pushConstants = { level, maxDepth };
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[pass]);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+		if (pass == FinishLevel) vkCmdDispatch(commandBuffer, 1, 1, 1);
+		else vkCmdDispatchIndirect(commandBuffer, stateBuffer, argsOffset);
+		computeBarrier(commandBuffer);
+	}
+
+	void SparseVoxelOctree::build(VkCommandBuffer commandBuffer) {
+		/* Wait for the fragments appended by the voxelization pass */
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+		VkDeviceSize fragmentArgs = offsetof(State, fragmentArgs);
+		auto levelArgs = [](uint32_t level) { return offsetof(State, levelArgs) + level * 4 * sizeof(uint32_t); };
+
+		/* Top down, each level's tiles are those allocated while subdividing the level above it. The first
+			FinishLevel also sizes the fragment passes. */
+		for (uint32_t level = 0; level < maxDepth; ++level) {
+			dispatch(commandBuffer, FinishLevel, level, 0);
+			dispatch(commandBuffer, FlagNodes, level, fragmentArgs);
+			dispatch(commandBuffer, SubdivideNodes, level, levelArgs(level));
+		}
+
+		/* Bottom up, leaves get their fragments' colors, and every other level averages its children */
+		dispatch(commandBuffer, StoreLeaves, maxDepth, fragmentArgs);
+		for (uint32_t level = maxDepth; level-- > 0;)
+			dispatch(commandBuffer, AverageNodes, level, levelArgs(level));
+
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		/* Copy the counts out for checkOverflow. Both buffers are device local. */
+		VkBufferCopy tileCounts = { offsetof(State, tileCount), 0, 2 * sizeof(uint32_t) };
+		VkBufferCopy fragmentCounts = { offsetof(FragmentListHeader, count), 2 * sizeof(uint32_t), 2 * sizeof(uint32_t) };
+		vkCmdCopyBuffer(commandBuffer, stateBuffer, countsBuffer, 1, &tileCounts);
+		vkCmdCopyBuffer(commandBuffer, fragmentBuffer, countsBuffer, 1, &fragmentCounts);
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	bool SparseVoxelOctree::checkOverflow() {
+		VKDK::WaitForFrame();
+		uint32_t tileCount = counts[0], tileLimit = counts[1], fragmentCount = counts[2], fragmentCapacity = counts[3];
+
+		/* Only changes are reported, rather than every frame */
+		bool tilesOver = tileCount > tileLimit, fragmentsOver = fragmentCount > fragmentCapacity;
+		if (tilesOver && !tilesOverflowed)
+			VKDK::print("SparseVoxelOctree: needed " + std::to_string(tileCount) + " tiles, but the brick pool only holds "
+				+ std::to_string(tileLimit) + ". Parts of the volume will be missing.", true);
+		if (fragmentsOver && !fragmentsOverflowed)
+			VKDK::print("SparseVoxelOctree: voxelization produced " + std::to_string(fragmentCount) + " fragments, but the list only holds "
+				+ std::to_string(fragmentCapacity) + ". Parts of the volume will be missing.", true);
+		tilesOverflowed = tilesOver;
+		fragmentsOverflowed = fragmentsOver;
+		return tilesOver || fragmentsOver;
+	}
+
+	void SparseVoxelOctree::cleanup() {
+		for (auto &pipeline : pipelines) {
+			if (pipeline) vkDestroyPipeline(VKDK::device, pipeline, nullptr);
+			pipeline = VK_NULL_HANDLE;
+		}
+		if (descriptorPool) vkDestroyDescriptorPool(VKDK::device, descriptorPool, nullptr);
+		if (pipelineLayout) vkDestroyPipelineLayout(VKDK::device, pipelineLayout, nullptr);
+		if (setLayout) vkDestroyDescriptorSetLayout(VKDK::device, setLayout, nullptr);
+		descriptorPool = VK_NULL_HANDLE;
+		pipelineLayout = VK_NULL_HANDLE;
+		setLayout = VK_NULL_HANDLE;
+
+		if (counts) vkUnmapMemory(VKDK::device, countsMemory);
+		counts = nullptr;
+
+		VkBuffer buffers[] = { stateBuffer, nodeBuffer, fragmentBuffer, countsBuffer };
+		VkDeviceMemory memories[] = { stateMemory, nodeMemory, fragmentMemory, countsMemory };
+		for (auto buffer : buffers) if (buffer) vkDestroyBuffer(VKDK::device, buffer, nullptr);
+		for (auto memory : memories) if (memory) vkFreeMemory(VKDK::device, memory, nullptr);
+		stateBuffer = nodeBuffer = fragmentBuffer = countsBuffer = VK_NULL_HANDLE;
+		stateMemory = nodeMemory = fragmentMemory = countsMemory = VK_NULL_HANDLE;
+
+		TextureInterface::cleanup();
+	}
+}
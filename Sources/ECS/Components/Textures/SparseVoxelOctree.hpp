@@ -0,0 +1,105 @@
+#pragma once
+
+#include "vkdk.hpp"
+#include "Texture.hpp"
+
+#include <memory>
+#include <string>
+
+namespace Components::Textures {
+	/* A sparse alternative to voxelizing into a dense Texture3D. Instead of storing every voxel of the volume, only
+		the nodes of an octree around surfaces are kept, so the effective resolution can go much higher in the same
+		memory.
+
+		The Voxelize material appends a fragment to a list for each voxel it covers. build then subdivides the octree
+		one level at a time from those fragments, writes each fragment's color to its leaf, and averages children into
+		their parents up to the root, giving every level what a mip of the dense volume would hold.
+
+		Nodes are allocated in tiles of 8 siblings from the node pool, where each node holds the index of its
+		children's tile. Every tile also owns a 2x2x2 brick in the brick pool, a 3D image with one texel per node,
+		which is this texture's color image. Materials sample it by walking the node pool down to a node's parent, then
+		filtering within the parent's brick. Filtering doesn't cross into neighboring bricks.
+
+		The octree is rebuilt from scratch every frame: reset must be recorded before the voxelization pass, and build
+		after it. */
+	class SparseVoxelOctree : public TextureInterface {
+	public:
+		/* Deepest octree supported, limited by the 10 bits per axis fragments store their voxel in */
+		static const uint32_t MaxDepth = 10;
+
+		/* True if the build shaders can be compiled, along with the octree variants of the Voxelize and Blinn shaders */
+		static bool IsSupported();
+
+		/* An octree with 2^maxDepth voxels along each side at its leaves, and room for brickPoolSize^3 tiles of nodes.
+			Surfaces need roughly a tile for every 4 leaf voxels they cover, plus a third more for the levels above. */
+		static std::shared_ptr<Texture> Create(std::string name, uint32_t maxDepth, uint32_t brickPoolSize = 64, uint32_t maxFragments = 1 << 21);
+
+		SparseVoxelOctree(uint32_t maxDepth, uint32_t brickPoolSize, uint32_t maxFragments);
+
+		void cleanup();
+
+		uint32_t getMaxDepth() { return maxDepth; }
+
+		/* Voxels along each side of the volume at the deepest level */
+		uint32_t getResolution() { return 1u << maxDepth; }
+
+		/* The child tile index of every node, read when sampling the octree */
+		VkBuffer getNodeBuffer() { return nodeBuffer; }
+
+		/* The list the Voxelize material appends fragments to */
+		VkBuffer getFragmentBuffer() { return fragmentBuffer; }
+
+		/* Records emptying the octree and fragment list. Must be recorded outside of a render pass. */
+		void reset(VkCommandBuffer commandBuffer);
+
+		/* Records building the octree from the fragments appended since reset. Must be recorded outside of a render pass. */
+		void build(VkCommandBuffer commandBuffer);
+
+		/* Waits for the last submitted frame, then warns if its build ran out of tiles or fragments. Nodes past the
+			limit are left empty, so surfaces go missing from the volume. Returns true if either overflowed. */
+		bool checkOverflow();
+
+	private:
+		/* Matches the State buffer in the build shader */
+		struct State {
+			uint32_t tileCount;
+			uint32_t maxTiles;
+			uint32_t pad0, pad1;
+			uint32_t fragmentArgs[4];
+			uint32_t levelArgs[MaxDepth + 1][4];
+			uint32_t levelStarts[MaxDepth + 2];
+		};
+
+		/* Matches the header of the FragmentList buffers in the build and Voxelize shaders */
+		struct FragmentListHeader {
+			uint32_t count;
+			uint32_t capacity;
+			uint32_t pad0, pad1;
+		};
+
+		enum Pass { FinishLevel, FlagNodes, SubdivideNodes, StoreLeaves, AverageNodes, PassCount };
+
+		uint32_t maxDepth, maxTiles, maxFragments;
+
+		VkBuffer stateBuffer = VK_NULL_HANDLE, nodeBuffer = VK_NULL_HANDLE, fragmentBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory stateMemory = VK_NULL_HANDLE, nodeMemory = VK_NULL_HANDLE, fragmentMemory = VK_NULL_HANDLE;
+
+		/* Host visible copy of the tile count and limit, followed by the fragment count and capacity, written at the
+			end of every build */
+		VkBuffer countsBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory countsMemory = VK_NULL_HANDLE;
+		uint32_t *counts = nullptr;
+		bool tilesOverflowed = false, fragmentsOverflowed = false;
+
+		VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipelines[PassCount] = {};
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+		void createBrickPool(uint32_t brickPoolSize);
+		void createBuffers();
+		void createPipelines();
+		void dispatch(VkCommandBuffer commandBuffer, Pass pass, uint32_t level, VkDeviceSize argsOffset);
+	};
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "vkdk.hpp"
+#include "Texture.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Components::Textures {
+	/* A texture whose image is decoded and uploaded in the background by the TextureStreamer.
+
+		Until the image is resident, every getter forwards to a placeholder (DefaultTexture, DefaultTextureCube or
+		DefaultTexture3D, depending on the view type), so materials can bind the texture right away. Once the upload
+		has finished, the getters switch over to the real image and perspectives are told to re-record. */
+	class StreamedTexture : public TextureInterface {
+	public:
+		StreamedTexture(std::string imagePath, VkImageViewType viewType, std::shared_ptr<TextureInterface> placeholder, bool srgb = true) {
+			this->imagePath = imagePath;
+			this->viewType = viewType;
+			this->placeholder = placeholder;
+			this->srgb = srgb;
+		}
+
+		std::string getPath() { return imagePath; }
+
+		/* True if the image holds colors, rather than data like a specular map. Until createImage, this is what was
+			asked for. Afterwards, it's whether the decoded texels are sRGB encoded. */
+		bool isSrgb() { return srgb; }
+
+		/* True once the real image can be sampled */
+		bool isResident() { return resident; }
+
+		/* Fraction of the screen covered by the largest entity sampling this texture, as of the last streamer update */
+		float getPriority() { return priority; }
+		void setPriority(float priority) { this->priority = priority; }
+
+		/* Layout the image is left in once uploaded. 3D textures stay in the general layout, like Texture3D. */
+		VkImageLayout getResidentLayout() {
+			return (viewType == VK_IMAGE_VIEW_TYPE_3D) ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+
+		/* Creates the (still empty) image, its view and its sampler. Called by the streamer before recording the upload.
+			Images decoded with a single level get a full mip chain, built on the GPU after the upload. srgb says the
+			texels hold sRGB colors, like PNGs decoded to UNORM. */
+		void createImage(VkFormat format, VkExtent3D extent, uint32_t mipLevels, uint32_t layers, bool srgb = false) {
+			colorFormat = format;
+			width = extent.width;
+			height = extent.height;
+			depth = extent.depth;
+			colorMipLevels = mipLevels;
+			this->layers = layers;
+			this->srgb = srgb;
+
+			generateMips = (mipLevels == 1) && MipGenerator::CanGenerate(format, viewType, srgb);
+			if (generateMips) colorMipLevels = MipGenerator::GetMipLevels(width, height, depth);
+
+			VkImageCreateInfo imageCreateInfo = {};
+			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageCreateInfo.imageType = (viewType == VK_IMAGE_VIEW_TYPE_3D) ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D;
+			imageCreateInfo.format = colorFormat;
+			imageCreateInfo.mipLevels = colorMipLevels;
+			imageCreateInfo.arrayLayers = layers;
+			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageCreateInfo.extent = extent;
+			imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			if (generateMips) imageCreateInfo.usage |= MipGenerator::GetRequiredUsage(format, viewType, srgb);
+			if (viewType == VK_IMAGE_VIEW_TYPE_CUBE) imageCreateInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+			VK_CHECK_RESULT(vkCreateImage(VKDK::device, &imageCreateInfo, nullptr, &colorImage));
+
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(VKDK::device, colorImage, &memReqs);
+
+			VkMemoryAllocateInfo memAllocInfo = {};
+			memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			memAllocInfo.allocationSize = memReqs.size;
+			memAllocInfo.memoryTypeIndex = VKDK::FindMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(VKDK::device, &memAllocInfo, nullptr, &colorImageMemory));
+			VK_CHECK_RESULT(vkBindImageMemory(VKDK::device, colorImage, colorImageMemory, 0));
+
+			createColorImageView();
+			createImageSampler();
+		}
+
+		/* Records copying regions of a staging buffer into the image, leaving it in its resident layout */
+		void recordUpload(VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, const std::vector<VkBufferImageCopy> &regions) {
+			VkImageSubresourceRange subresourceRange = {};
+			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			subresourceRange.baseMipLevel = 0;
+			subresourceRange.levelCount = colorMipLevels;
+			subresourceRange.layerCount = layers;
+
+			setImageLayout(commandBuffer, colorImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				subresourceRange, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+			vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, colorImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				(uint32_t)regions.size(), regions.data());
+
+			if (generateMips) {
+				generateColorMipMaps(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, getResidentLayout(), srgb);
+				return;
+			}
+
+			/* Written out, since setImageLayout leaves the access mask empty when transitioning to the general layout */
+			VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = getResidentLayout();
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barrier.image = colorImage;
+			barrier.subresourceRange = subresourceRange;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		/* Switches every getter over to the uploaded image. Only call once the upload has completed on the GPU. */
+		void setResident() {
+			colorImageLayout = getResidentLayout();
+			resident = true;
+		}
+
+		VkImageView getColorImageView() { return resident ? colorImageView : placeholder->getColorImageView(); };
+		VkSampler getColorSampler() { return resident ? colorSampler : placeholder->getColorSampler(); };
+		VkImageLayout getColorImageLayout() { return resident ? colorImageLayout : placeholder->getColorImageLayout(); };
+		VkImage getColorImage() { return resident ? colorImage : placeholder->getColorImage(); };
+		uint32_t getColorMipLevels() { return resident ? colorMipLevels : placeholder->getColorMipLevels(); };
+		VkFormat getColorFormat() { return resident ? colorFormat : placeholder->getColorFormat(); };
+		uint32_t getWidth() { return resident ? width : placeholder->getWidth(); }
+		uint32_t getHeight() { return resident ? height : placeholder->getHeight(); }
+		uint32_t getDepth() { return resident ? depth : placeholder->getDepth(); }
+		uint32_t getTotalLayers() { return resident ? layers : placeholder->getTotalLayers(); }
+
+	private:
+		std::string imagePath;
+		std::shared_ptr<TextureInterface> placeholder;
+
+		/* Set on the render thread after the image handles, and read by recording threads */
+		std::atomic<bool> resident{ false };
+		float priority = 0.0f;
+		bool generateMips = false, srgb = false;
+
+		/* Matches the samplers of Texture2D, TextureCube and Texture3D */
+		void createImageSampler() {
+			VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
+			sampler.magFilter = VK_FILTER_LINEAR;
+			sampler.minFilter = VK_FILTER_LINEAR;
+			sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+			if (viewType == VK_IMAGE_VIEW_TYPE_2D) {
+				sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+				sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+			}
+			else if (viewType == VK_IMAGE_VIEW_TYPE_CUBE) {
+				sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+				sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+			}
+			else {
+				sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+				sampler.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+			}
+			sampler.addressModeV = sampler.addressModeU;
+			sampler.addressModeW = sampler.addressModeU;
+			sampler.mipLodBias = 0.0f;
+			sampler.compareOp = VK_COMPARE_OP_NEVER;
+			sampler.minLod = 0.0f;
+			sampler.maxLod = VK_LOD_CLAMP_NONE;
+			sampler.maxAnisotropy = 1.0f;
+			sampler.anisotropyEnable = VK_FALSE;
+			if (VKDK::deviceFeatures.samplerAnisotropy) {
+				sampler.maxAnisotropy = VKDK::deviceProperties.limits.maxSamplerAnisotropy;
+				sampler.anisotropyEnable = VK_TRUE;
+			}
+			colorSampler = SamplerCache::Get(sampler);
+		}
+	};
+}
@@ -11,17 +11,28 @@
 #include "vkdk.hpp"
 #include "stb_image.h"
 #include "Components/Component.hpp"
+#include "Systems/AssetRegistry.hpp"
+#include "MipGenerator.hpp"
+#include "SamplerCache.hpp"
+#include "TextureTable.hpp"
 
 namespace Components::Textures {
 	class TextureInterface {
 	public:
     virtual void cleanup() {
+      /* Free anything kept for generating mips of the color image */
+      if (colorImage) MipGenerator::Release(colorImage);
+
       /* Destroy frame buffer */
       if (framebuffer) vkDestroyFramebuffer(VKDK::device, framebuffer, nullptr);
 
-      /* Destroy samplers */
-      if (colorSampler) vkDestroySampler(VKDK::device, colorSampler, nullptr);
-      if (depthSampler) vkDestroySampler(VKDK::device, depthSampler, nullptr);
+      /* Release samplers, which are shared with other textures */
+      SamplerCache::Release(colorSampler);
+      SamplerCache::Release(depthSampler);
+
+      /* Free the views' slots in the bindless texture table, so they can be given to other textures */
+      if (colorImageView) TextureTable::Release(colorImageView);
+      if (depthImageView) TextureTable::Release(depthImageView);
 
       /* Destroy Image Views */
       if (colorImageView) vkDestroyImageView(VKDK::device, colorImageView, nullptr);
@@ -51,6 +62,7 @@ namespace Components::Textures {
     virtual uint32_t getHeight() { return height; }
     virtual uint32_t getDepth() { return depth; }
     virtual uint32_t getTotalLayers() { return 1; }
+    virtual VkImageViewType getViewType() { return viewType; }
 
 		// Create an image memory barrier for changing the layout of
 		// an image and put it into an active command buffer
@@ -195,6 +207,12 @@ namespace Components::Textures {
 			setImageLayout(cmdbuffer, image, oldImageLayout, newImageLayout, subresourceRange, srcStageMask, dstStageMask);
 		}
 
+    /* Records rebuilding every mip level of the color image from its first level. See MipGenerator::Generate. */
+    void generateColorMipMaps(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout, bool srgb = false) {
+      MipGenerator::Generate(commandBuffer, colorImage, colorFormat, { width, height, depth }, colorMipLevels,
+        layers, viewType, oldLayout, newLayout, srgb);
+    }
+
     void createColorImageView() {
       // Create image view
       VkImageViewCreateInfo view = vks::initializers::imageViewCreateInfo();
@@ -220,14 +238,20 @@ namespace Components::Textures {
     VkSampler colorSampler = VK_NULL_HANDLE, depthSampler = VK_NULL_HANDLE;
     VkFramebuffer framebuffer = VK_NULL_HANDLE;
     uint32_t width = 1, height = 1, depth = 1, colorMipLevels = 1, layers = 1;
-    VkImageViewType viewType;
+    VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D;
   };
 
 	class Texture : public Component {
 	public:
     std::shared_ptr<TextureInterface> texture;
+
+    /* Key of the shared texture in the asset registry, or empty if this component owns its texture */
+    std::string assetKey;
+
 		void cleanup() {
-			texture->cleanup();
+			/* Shared textures are destroyed along with their last component */
+			if (assetKey.empty() || Systems::AssetRegistry::Release(assetKey))
+				texture->cleanup();
 		}
 	};
 }
@@ -15,6 +15,10 @@
 #pragma once
 #include "vkdk.hpp"
 #include "Texture.hpp"
+#include "TextureStreamer.hpp"
+#include "BlockCompressor.hpp"
+#include "TextureTranscoder.hpp"
+#include "KTXFile.hpp"
 
 #include <gli/gli.hpp>
 
@@ -24,46 +28,76 @@ namespace Components::Textures {
   class Texture2D : public TextureInterface {
 
   public:
-    /* Component Generator */
-    static std::shared_ptr<Texture> Create(std::string name, std::string imagePath = ResourcePath "Defaults/UV_Grid_Sm.ktx") {
+    /* Component Generator. srgb should be false for PNGs which don't hold colors, like specular maps, so that their
+      mips aren't averaged as sRGB. */
+    static std::shared_ptr<Texture> Create(std::string name, std::string imagePath = ResourcePath "Defaults/UV_Grid_Sm.ktx", bool srgb = true) {
       std::cout << "ComponentManager: Adding Texture2D \"" << name << "\"" << std::endl;
 
-      auto tex2d = std::make_shared<Texture2D>(imagePath);
       auto texComponent = std::make_shared<Texture>();
-      texComponent->texture = tex2d;
+      texComponent->texture = Systems::AssetRegistry::Load<TextureInterface>(imagePath, srgb ? "Texture2D" : "Texture2D linear",
+        texComponent->assetKey, [&]() { return std::make_shared<Texture2D>(imagePath, srgb); });
+      Systems::ComponentManager::Textures[name] = texComponent;
+      return texComponent;
+    }
+
+    /* Like Create, but the image is loaded in the background. DefaultTexture is sampled until it's resident. */
+    static std::shared_ptr<Texture> CreateAsync(std::string name, std::string imagePath, bool srgb = true) {
+      std::cout << "ComponentManager: Adding Texture2D \"" << name << "\" (streamed)" << std::endl;
+
+      auto texComponent = std::make_shared<Texture>();
+      texComponent->texture = Systems::AssetRegistry::Load<TextureInterface>(imagePath,
+        srgb ? "Texture2D streamed" : "Texture2D streamed linear", texComponent->assetKey,
+        [&]() { return TextureStreamer::Load(imagePath, VK_IMAGE_VIEW_TYPE_2D, srgb); });
       Systems::ComponentManager::Textures[name] = texComponent;
       return texComponent;
     }
 
     /* Constructors */
-    Texture2D(std::string imagePath = ResourcePath "Defaults/missing-texture.ktx") {
+    Texture2D(std::string imagePath = ResourcePath "Defaults/missing-texture.ktx", bool srgb = true) {
       viewType = VK_IMAGE_VIEW_TYPE_2D;
       struct stat st;
       if (stat(imagePath.c_str(), &st) != 0) {
         std::cout << imagePath + " does not exist!" << std::endl;
         imagePath = ResourcePath "Defaults/missing-texture.ktx";
       }
+      gli::texture2d compressed;
       if (imagePath.substr(imagePath.find_last_of(".") + 1) == "ktx") {
         createTextureImageKTX(imagePath);
       }
+      /* Prefer a block compressed copy of PNGs, when the device can sample one */
+      else if (BlockCompressor::LoadCompressed(imagePath, compressed, srgb)) {
+        createTextureImageKTX(compressed, imagePath);
+      }
       else {
-        createTextureImagePNG(imagePath);
+        createTextureImagePNG(imagePath, srgb);
       }
       createImageView();
       createImageSampler();
     }
 
     void createTextureImageKTX(std::string imagePath) {
+      /* Stage straight from the mapped file when the device can sample it as is */
+      KTXFile ktx;
+      if (ktx.open(imagePath) && ktx.getTarget() == gli::TARGET_2D && TextureTranscoder::IsSupported(ktx.getFormat())) {
+        createTextureImageKTX(ktx);
+        return;
+      }
+      ktx.close();
+
       /* Load the texture */
       gli::texture2d tex2D(gli::load(imagePath));
       assert(!tex2D.empty());
+      createTextureImageKTX(tex2D, imagePath);
+    }
 
+    void createTextureImageKTX(gli::texture2d &tex2D, std::string imagePath) {
       VkFormatProperties formatProperties;
 
       width = (uint32_t)(tex2D[0].extent().x);
       height = (uint32_t)(tex2D[0].extent().y);
       colorMipLevels = (uint32_t)(tex2D.levels());
       colorFormat = (VkFormat)tex2D.format();
+      uint32_t storedMipLevels = colorMipLevels;
 
       // Get device properites for the requested texture format
       vkGetPhysicalDeviceFormatProperties(VKDK::physicalDevice, colorFormat, &formatProperties);
@@ -72,11 +106,22 @@ namespace Components::Textures {
         && formatProperties.linearTilingFeatures == 0
         && formatProperties.optimalTilingFeatures == 0)
       {
+        /* Decode the blocks on the CPU, and upload them in a format the device can sample */
+        gli::texture transcoded;
+        if (TextureTranscoder::Transcode(tex2D, imagePath, transcoded)) {
+          gli::texture2d transcoded2D(transcoded);
+          createTextureImageKTX(transcoded2D, imagePath);
+          return;
+        }
         std::cout << "Unsupported image format for " << imagePath << std::endl;
         createTextureImageKTX(ResourcePath "Defaults/missing-texture.ktx");
         return;
       }
 
+      /* Build the mip chain on the GPU if the file only holds the first level */
+      bool generateMips = (storedMipLevels == 1) && MipGenerator::CanGenerate(colorFormat, viewType);
+      if (generateMips) colorMipLevels = MipGenerator::GetMipLevels(width, height);
+
       /* Create staging buffer */
       VkBuffer stagingBuffer;
       VkDeviceMemory stagingBufferMemory;
@@ -94,7 +139,7 @@ namespace Components::Textures {
       std::vector<VkBufferImageCopy> bufferCopyRegions;
       uint32_t offset = 0;
 
-      for (uint32_t i = 0; i < colorMipLevels; i++)
+      for (uint32_t i = 0; i < storedMipLevels; i++)
       {
         VkBufferImageCopy bufferCopyRegion = {};
         bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -111,6 +156,28 @@ namespace Components::Textures {
         offset += static_cast<uint32_t>(tex2D[i].size());
       }
 
+      uploadKTX(stagingBuffer, stagingBufferMemory, bufferCopyRegions, generateMips);
+    }
+
+    void createTextureImageKTX(KTXFile &ktx) {
+      width = ktx.getExtent().width;
+      height = ktx.getExtent().height;
+      colorMipLevels = ktx.getLevels();
+      colorFormat = ktx.getFormat();
+
+      bool generateMips = (colorMipLevels == 1) && MipGenerator::CanGenerate(colorFormat, viewType);
+      if (generateMips) colorMipLevels = MipGenerator::GetMipLevels(width, height);
+
+      VkBuffer stagingBuffer;
+      VkDeviceMemory stagingBufferMemory;
+      std::vector<VkBufferImageCopy> bufferCopyRegions;
+      ktx.createStagingBuffer(ktx.getLevels(), stagingBuffer, stagingBufferMemory, bufferCopyRegions);
+
+      uploadKTX(stagingBuffer, stagingBufferMemory, bufferCopyRegions, generateMips);
+    }
+
+    /* Creates the image, copies the staged levels into it, and frees the staging buffer */
+    void uploadKTX(VkBuffer stagingBuffer, VkDeviceMemory stagingBufferMemory, std::vector<VkBufferImageCopy> &bufferCopyRegions, bool generateMips) {
       // Create optimal tiled target image
       VkImageCreateInfo imageCreateInfo = {};
       imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -125,6 +192,7 @@ namespace Components::Textures {
       imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
       imageCreateInfo.extent = { width, height, 1 };
       imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+      if (generateMips) imageCreateInfo.usage |= MipGenerator::GetRequiredUsage(colorFormat, viewType);
 
       VK_CHECK_RESULT(vkCreateImage(VKDK::device, &imageCreateInfo, nullptr, &colorImage));
 
@@ -178,12 +246,15 @@ namespace Components::Textures {
 
       // Change texture image layout to shader read after all mip levels have been copied
       colorImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      setImageLayout(
-        copyCmd,
-        colorImage,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        colorImageLayout,
-        subresourceRange);
+      if (generateMips)
+        generateColorMipMaps(copyCmd, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, colorImageLayout);
+      else
+        setImageLayout(
+          copyCmd,
+          colorImage,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          colorImageLayout,
+          subresourceRange);
 
       VKDK::FlushCommandBuffer(copyCmd, VKDK::graphicsQueue, true);
 
@@ -192,7 +263,7 @@ namespace Components::Textures {
       vkFreeMemory(VKDK::device, stagingBufferMemory, nullptr);
     }
 
-    void createTextureImagePNG(std::string imagePath) {
+    void createTextureImagePNG(std::string imagePath, bool srgb = true) {
       /* For PNG, we assume the following format */
       colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
 
@@ -220,16 +291,31 @@ namespace Components::Textures {
       /* Clean up original image array */
       stbi_image_free(pixels);
 
-      createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, 
-        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorImageMemory);
+      /* Color PNGs hold sRGB colors in a UNORM image, so their mips are averaged in linear space */
+      VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+      colorMipLevels = 1;
+      if (MipGenerator::CanGenerate(colorFormat, viewType, srgb)) {
+        colorMipLevels = MipGenerator::GetMipLevels(width, height);
+        usage |= MipGenerator::GetRequiredUsage(colorFormat, viewType, srgb);
+      }
+
+      createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, usage,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorImageMemory, colorMipLevels);
 
       transitionImageLayout(colorImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, 
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
       copyBufferToImage(stagingBuffer, colorImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
 
-      transitionImageLayout(colorImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+      colorImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      if (colorMipLevels > 1) {
+        VkCommandBuffer commandBuffer = VKDK::beginSingleTimeCommands();
+        generateColorMipMaps(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, colorImageLayout, srgb);
+        VKDK::endSingleTimeCommands(commandBuffer);
+      }
+      else {
+        transitionImageLayout(colorImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+      }
 
       vkDestroyBuffer(VKDK::device, stagingBuffer, nullptr);
       vkFreeMemory(VKDK::device, stagingBufferMemory, nullptr);
@@ -280,7 +366,7 @@ namespace Components::Textures {
       barrier.image = image;
       barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
       barrier.subresourceRange.baseMipLevel = 0;
-      barrier.subresourceRange.levelCount = 1;
+      barrier.subresourceRange.levelCount = colorMipLevels;
       barrier.subresourceRange.baseArrayLayer = 0;
       barrier.subresourceRange.layerCount = 1;
       barrier.srcAccessMask = 0; // TODO
@@ -320,14 +406,14 @@ namespace Components::Textures {
     }
 
     void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
-      VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+      VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, uint32_t mipLevels = 1) {
       VkImageCreateInfo imageInfo = {};
       imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
       imageInfo.imageType = VK_IMAGE_TYPE_2D;
       imageInfo.extent.width = width;
       imageInfo.extent.height = height;
       imageInfo.extent.depth = 1;
-      imageInfo.mipLevels = 1;
+      imageInfo.mipLevels = mipLevels;
       imageInfo.arrayLayers = 1;
       imageInfo.format = format;
       imageInfo.tiling = tiling;
@@ -393,8 +479,9 @@ namespace Components::Textures {
       sampler.mipLodBias = 0.0f;
       sampler.compareOp = VK_COMPARE_OP_NEVER;
       sampler.minLod = 0.0f;
-      // Set max level-of-detail to mip level count of the texture
-      sampler.maxLod = (float)colorMipLevels;
+      // Leave the level-of-detail unclamped, since the view already limits it to the texture's mip levels, and
+      // textures with different mip counts can then share the sampler
+      sampler.maxLod = VK_LOD_CLAMP_NONE;
       // Enable anisotropic filtering
       // This feature is optional, so we must check if it's supported on the device
       if (VKDK::deviceFeatures.samplerAnisotropy)
@@ -410,7 +497,7 @@ namespace Components::Textures {
         sampler.anisotropyEnable = VK_FALSE;
       }
       sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-      VK_CHECK_RESULT(vkCreateSampler(VKDK::device, &sampler, nullptr, &colorSampler));
+      colorSampler = SamplerCache::Get(sampler);
     }
   };
 }
\ No newline at end of file
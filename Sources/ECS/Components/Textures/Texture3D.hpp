@@ -15,6 +15,8 @@
 #pragma once
 #include "vkdk.hpp"
 #include "Texture.hpp"
+#include "TextureStreamer.hpp"
+#include "KTXFile.hpp"
 #include <assert.h>
 #include <gli/gli.hpp>
 
@@ -39,9 +41,23 @@ namespace Components::Textures {
 		static std::shared_ptr<Texture> Create(std::string name, std::string filePath = ResourcePath "Defaults/missing-volume.ktx", bool genMipmaps = false) {
 			std::cout << "ComponentManager: Adding Texture3D \"" << name << "\"" << std::endl;
 
-			auto tex3D = std::make_shared<Texture3D>(filePath, genMipmaps);
+			/* Volumes with and without generated mips are different assets */
 			auto texComponent = std::make_shared<Texture>();
-			texComponent->texture = tex3D;
+			texComponent->texture = Systems::AssetRegistry::Load<TextureInterface>(filePath,
+				genMipmaps ? "Texture3D mipmapped" : "Texture3D", texComponent->assetKey,
+				[&]() { return std::make_shared<Texture3D>(filePath, genMipmaps); });
+			Systems::ComponentManager::Textures[name] = texComponent;
+			return texComponent;
+		}
+
+		/* Like Create, but the image is loaded in the background. DefaultTexture3D is sampled until it's resident.
+			Streamed volumes keep the mip levels stored in the file. */
+		static std::shared_ptr<Texture> CreateAsync(std::string name, std::string filePath) {
+			std::cout << "ComponentManager: Adding Texture3D \"" << name << "\" (streamed)" << std::endl;
+
+			auto texComponent = std::make_shared<Texture>();
+			texComponent->texture = Systems::AssetRegistry::Load<TextureInterface>(filePath, "Texture3D streamed", texComponent->assetKey,
+				[&]() { return TextureStreamer::Load(filePath, VK_IMAGE_VIEW_TYPE_3D); });
 			Systems::ComponentManager::Textures[name] = texComponent;
 			return texComponent;
 		}
@@ -89,7 +105,7 @@ namespace Components::Textures {
 			this->height = height;
 			this->depth = depth;
 			colorMipLevels = 1;
-			if (genMipmaps) colorMipLevels = (uint32_t)(std::floor(std::log2(std::max(std::max(width, height), depth))) + 1);
+			if (genMipmaps) colorMipLevels = MipGenerator::GetMipLevels(width, height, depth);
 
 			// Get device properites for the requested texture format
 			vkGetPhysicalDeviceFormatProperties(VKDK::physicalDevice, colorFormat, &formatProperties);
@@ -153,8 +169,16 @@ namespace Components::Textures {
 		}
 
 		void createTextureImageKTX(std::string imagePath, bool genMipmaps = false) {
-			/* Load the texture */
+			/* Volumes are staged straight from the mapped file, since they're too large to copy around twice */
 			colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+			KTXFile ktx;
+			if (ktx.open(imagePath) && ktx.getTarget() == gli::TARGET_3D && ktx.getFormat() == colorFormat) {
+				createTextureImageKTX(ktx, genMipmaps);
+				return;
+			}
+			ktx.close();
+
+			/* Load the texture */
 			gli::texture3d tex3D(gli::load(imagePath));
 			assert(!tex3D.empty());
 
@@ -165,7 +189,7 @@ namespace Components::Textures {
 			depth = static_cast<uint32_t>(tex3D[0].extent().z);
 			colorMipLevels = static_cast<uint32_t>(tex3D.levels());
 
-			if (genMipmaps) colorMipLevels = (uint32_t)(std::floor(std::log2(std::max(std::max(width, height), depth))) + 1);
+			if (genMipmaps) colorMipLevels = MipGenerator::GetMipLevels(width, height, depth);
 
 			// Get device properites for the requested texture format
 			vkGetPhysicalDeviceFormatProperties(VKDK::physicalDevice, colorFormat, &formatProperties);
@@ -206,6 +230,28 @@ namespace Components::Textures {
 				if (genMipmaps) break;
 			}
 
+			uploadKTX(stagingBuffer, stagingBufferMemory, bufferCopyRegions, genMipmaps);
+		}
+
+		void createTextureImageKTX(KTXFile &ktx, bool genMipmaps) {
+			width = ktx.getExtent().width;
+			height = ktx.getExtent().height;
+			depth = ktx.getExtent().depth;
+			colorMipLevels = ktx.getLevels();
+
+			if (genMipmaps) colorMipLevels = MipGenerator::GetMipLevels(width, height, depth);
+
+			/* If we're going to generate our own mipmaps, just stage the first level */
+			VkBuffer stagingBuffer;
+			VkDeviceMemory stagingBufferMemory;
+			std::vector<VkBufferImageCopy> bufferCopyRegions;
+			ktx.createStagingBuffer(genMipmaps ? 1 : ktx.getLevels(), stagingBuffer, stagingBufferMemory, bufferCopyRegions);
+
+			uploadKTX(stagingBuffer, stagingBufferMemory, bufferCopyRegions, genMipmaps);
+		}
+
+		/* Creates the volume, copies the staged levels into it, and frees the staging buffer */
+		void uploadKTX(VkBuffer stagingBuffer, VkDeviceMemory stagingBufferMemory, std::vector<VkBufferImageCopy> &bufferCopyRegions, bool genMipmaps) {
 			// Create optimal tiled target image
 			VkImageCreateInfo imageCreateInfo = {};
 			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -303,8 +349,8 @@ namespace Components::Textures {
 			sampler.mipLodBias = 0.0f;
 			sampler.compareOp = VK_COMPARE_OP_NEVER;
 			sampler.minLod = 0.0f;
-			// Set max level-of-detail to mip level count of the texture
-			sampler.maxLod = (float)colorMipLevels;
+			// The view limits the level-of-detail to the mip levels of the texture
+			sampler.maxLod = VK_LOD_CLAMP_NONE;
 			// Enable anisotropic filtering
 			// This feature is optional, so we must check if it's supported on the device
 			if (VKDK::deviceFeatures.samplerAnisotropy)
@@ -320,83 +366,12 @@ namespace Components::Textures {
 				sampler.anisotropyEnable = VK_FALSE;
 			}
 			sampler.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
-			VK_CHECK_RESULT(vkCreateSampler(VKDK::device, &sampler, nullptr, &colorSampler));
+			colorSampler = SamplerCache::Get(sampler);
 		}
 
-    /* Todo: move to interface */
+		/* Rebuilds every mip level from the first, leaving the image in its general layout */
 		void generateColorMipMap(VkCommandBuffer cmdBuffer) {
-			VkImageSubresourceRange subresourceRange = {};
-			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			subresourceRange.levelCount = 1;
-			subresourceRange.layerCount = layers;
-
-			setImageLayout(
-				cmdBuffer,
-				colorImage,
-				colorImageLayout,
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				subresourceRange);
-
-			for (uint32_t i = 1; i < colorMipLevels; i++)
-			{
-				VkImageBlit imageBlit{};
-
-				// Source
-				imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				imageBlit.srcSubresource.layerCount = 1;
-				imageBlit.srcSubresource.mipLevel = i - 1;
-				imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
-				imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
-				imageBlit.srcOffsets[1].z = int32_t(height >> (i - 1));
-
-				// Destination
-				imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				imageBlit.dstSubresource.layerCount = 1;
-				imageBlit.dstSubresource.mipLevel = i;
-				imageBlit.dstOffsets[1].x = int32_t(width >> i);
-				imageBlit.dstOffsets[1].y = int32_t(height >> i);
-				imageBlit.dstOffsets[1].z = int32_t(depth >> i);
-
-				VkImageSubresourceRange mipSubRange = {};
-				mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				mipSubRange.baseMipLevel = i;
-				mipSubRange.levelCount = 1;
-				mipSubRange.layerCount = 1;
-
-				// Transition current mip level to transfer dest
-				setImageLayout(
-					cmdBuffer,
-					colorImage,
-					VK_IMAGE_LAYOUT_UNDEFINED,
-					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-					mipSubRange);
-
-				vkCmdBlitImage(
-					cmdBuffer,
-					colorImage,
-					VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-					colorImage,
-					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-					1,
-					&imageBlit,
-          VK_FILTER_LINEAR);
-
-				setImageLayout(
-					cmdBuffer,
-          colorImage,
-					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-					VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-					mipSubRange);
-			}
-
-			/* Finally, transfer back to general */
-			subresourceRange.levelCount = colorMipLevels;
-			setImageLayout(
-				cmdBuffer,
-				colorImage,
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				VK_IMAGE_LAYOUT_GENERAL,
-				subresourceRange);
+			generateColorMipMaps(cmdBuffer, colorImageLayout, colorImageLayout);
 		}
 	};	
 }
\ No newline at end of file
@@ -15,6 +15,9 @@
 #pragma once
 #include "vkdk.hpp"
 #include "Texture.hpp"
+#include "TextureStreamer.hpp"
+#include "TextureTranscoder.hpp"
+#include "KTXFile.hpp"
 #include <assert.h>
 #include <gli/gli.hpp>
 
@@ -26,9 +29,20 @@ namespace Components::Textures {
     static std::shared_ptr<Texture> Create(std::string name, std::string imagePath = ResourcePath "Defaults/missing-texcube.ktx") {
       std::cout << "ComponentManager: Adding TextureCube \"" << name << "\"" << std::endl;
       
-      auto texCube = std::make_shared<TextureCube>(imagePath);
       auto texComponent = std::make_shared<Texture>();
-      texComponent->texture = texCube;
+      texComponent->texture = Systems::AssetRegistry::Load<TextureInterface>(imagePath, "TextureCube", texComponent->assetKey,
+        [&]() { return std::make_shared<TextureCube>(imagePath); });
+      Systems::ComponentManager::Textures[name] = texComponent;
+      return texComponent;
+    }
+
+    /* Like Create, but the image is loaded in the background. DefaultTextureCube is sampled until it's resident. */
+    static std::shared_ptr<Texture> CreateAsync(std::string name, std::string imagePath) {
+      std::cout << "ComponentManager: Adding TextureCube \"" << name << "\" (streamed)" << std::endl;
+
+      auto texComponent = std::make_shared<Texture>();
+      texComponent->texture = Systems::AssetRegistry::Load<TextureInterface>(imagePath, "TextureCube streamed", texComponent->assetKey,
+        [&]() { return TextureStreamer::Load(imagePath, VK_IMAGE_VIEW_TYPE_CUBE); });
       Systems::ComponentManager::Textures[name] = texComponent;
       return texComponent;
     }
@@ -73,14 +87,26 @@ namespace Components::Textures {
 		}
 
 		void createTextureImageKTX(std::string cubemapPath) {
+			/* Faces are staged straight from the mapped file when the device can sample them as they are */
+			KTXFile ktx;
+			if (ktx.open(cubemapPath) && ktx.getTarget() == gli::TARGET_CUBE && TextureTranscoder::IsSupported(ktx.getFormat())) {
+				createTextureImageKTX(ktx);
+				return;
+			}
+			ktx.close();
+
 			/* Load the texture */
 			gli::texture_cube texCube(gli::load(cubemapPath));
 			assert(!texCube.empty());
+			createTextureImageKTX(texCube, cubemapPath);
+		}
 
+		void createTextureImageKTX(gli::texture_cube &texCube, std::string cubemapPath) {
 			width = texCube.extent().x;
 			height = texCube.extent().y;
 			colorMipLevels = (uint32_t)texCube.levels();
       colorFormat = (VkFormat)texCube.format();
+      uint32_t storedMipLevels = colorMipLevels;
 
       // Get device properites for the requested texture format			
       VkFormatProperties formatProperties;
@@ -90,11 +116,22 @@ namespace Components::Textures {
         && formatProperties.linearTilingFeatures == 0
         && formatProperties.optimalTilingFeatures == 0) 
       {
+        /* Fall back to a transcoded copy of every face */
+        gli::texture transcoded;
+        if (TextureTranscoder::Transcode(texCube, cubemapPath, transcoded)) {
+          gli::texture_cube transcodedCube(transcoded);
+          createTextureImageKTX(transcodedCube, cubemapPath);
+          return;
+        }
         std::cout << "Unsupported image format for " << cubemapPath << std::endl;
         createTextureImageKTX(ResourcePath "Defaults/missing-texcube.ktx");
         return;
       }
 
+      /* Build the mip chain on the GPU if the file only holds the first level of each face */
+      bool generateMips = (storedMipLevels == 1) && MipGenerator::CanGenerate(colorFormat, viewType);
+      if (generateMips) colorMipLevels = MipGenerator::GetMipLevels(width, height);
+
 			VkMemoryAllocateInfo memAllocInfo = {};
 			memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 			VkMemoryRequirements memReqs;
@@ -125,6 +162,55 @@ namespace Components::Textures {
 			memcpy(data, texCube.data(), texCube.size());
 			vkUnmapMemory(VKDK::device, stagingBufferMemory);
 
+			// Setup buffer copy regions for each face including all of it's miplevels
+			std::vector<VkBufferImageCopy> bufferCopyRegions;
+			uint32_t offset = 0;
+
+			for (int face = 0; face < 6; ++face) {
+				for (unsigned level = 0; level < storedMipLevels; ++level) {
+					VkBufferImageCopy bufferCopyRegion = {};
+					bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					bufferCopyRegion.imageSubresource.mipLevel = (uint32_t)level;
+					bufferCopyRegion.imageSubresource.baseArrayLayer = face;
+					bufferCopyRegion.imageSubresource.layerCount = 1;
+					bufferCopyRegion.imageExtent.width = texCube[face][level].extent().x;
+					bufferCopyRegion.imageExtent.height = texCube[face][level].extent().y;
+					bufferCopyRegion.imageExtent.depth = 1;
+					bufferCopyRegion.bufferOffset = offset;
+
+					bufferCopyRegions.push_back(bufferCopyRegion);
+
+					// Increase offset into staging buffer for next level / face
+					offset += (uint32_t)texCube[face][level].size();
+				}
+			}
+
+			uploadKTX(stagingBuffer, stagingBufferMemory, bufferCopyRegions, generateMips);
+		}
+
+		void createTextureImageKTX(KTXFile &ktx) {
+			width = ktx.getExtent().width;
+			height = ktx.getExtent().height;
+			colorMipLevels = ktx.getLevels();
+			colorFormat = ktx.getFormat();
+
+			bool generateMips = (colorMipLevels == 1) && MipGenerator::CanGenerate(colorFormat, viewType);
+			if (generateMips) colorMipLevels = MipGenerator::GetMipLevels(width, height);
+
+			VkBuffer stagingBuffer;
+			VkDeviceMemory stagingBufferMemory;
+			std::vector<VkBufferImageCopy> bufferCopyRegions;
+			ktx.createStagingBuffer(ktx.getLevels(), stagingBuffer, stagingBufferMemory, bufferCopyRegions);
+
+			uploadKTX(stagingBuffer, stagingBufferMemory, bufferCopyRegions, generateMips);
+		}
+
+		/* Creates the cube image, copies the staged faces into it, and frees the staging buffer */
+		void uploadKTX(VkBuffer stagingBuffer, VkDeviceMemory stagingBufferMemory, std::vector<VkBufferImageCopy> &bufferCopyRegions, bool generateMips) {
+			VkMemoryAllocateInfo memAllocInfo = {};
+			memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			VkMemoryRequirements memReqs;
+
 			// Create optimal tiled target image
 			VkImageCreateInfo imageCreateInfo = {};
 			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -138,6 +224,7 @@ namespace Components::Textures {
 			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 			imageCreateInfo.extent = { width, height, 1 };
 			imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			if (generateMips) imageCreateInfo.usage |= MipGenerator::GetRequiredUsage(colorFormat, viewType);
 			// Cube faces count as array layers in Vulkan
 			imageCreateInfo.arrayLayers = layers;
 			// This flag is required for cube map images
@@ -151,29 +238,7 @@ namespace Components::Textures {
 			VK_CHECK_RESULT(vkAllocateMemory(VKDK::device, &memAllocInfo, nullptr, &colorImageMemory));
 			VK_CHECK_RESULT(vkBindImageMemory(VKDK::device, colorImage, colorImageMemory, 0));
 
-			// Setup buffer copy regions for each face including all of it's miplevels
 			VkCommandBuffer copyCmd = VKDK::CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-			std::vector<VkBufferImageCopy> bufferCopyRegions;
-			uint32_t offset = 0;
-
-			for (int face = 0; face < 6; ++face) {
-				for (unsigned level = 0; level < colorMipLevels; ++level) {
-					VkBufferImageCopy bufferCopyRegion = {};
-					bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-					bufferCopyRegion.imageSubresource.mipLevel = (uint32_t)level;
-					bufferCopyRegion.imageSubresource.baseArrayLayer = face;
-					bufferCopyRegion.imageSubresource.layerCount = 1;
-					bufferCopyRegion.imageExtent.width = texCube[face][level].extent().x;
-					bufferCopyRegion.imageExtent.height = texCube[face][level].extent().y;
-					bufferCopyRegion.imageExtent.depth = 1;
-					bufferCopyRegion.bufferOffset = offset;
-
-					bufferCopyRegions.push_back(bufferCopyRegion);
-
-					// Increase offset into staging buffer for next level / face
-					offset += (uint32_t)texCube[face][level].size();
-				}
-			}
 
 			// Image barrier for optimal image (target)
 			// Set initial layout for all array layers (faces) of the optimal (target) tiled texture
@@ -202,12 +267,15 @@ namespace Components::Textures {
 
 			// Change texture image layout to shader read after all faces have been copied
 			colorImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			setImageLayout(
-				copyCmd,
-				colorImage,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        colorImageLayout,
-				subresourceRange);
+			if (generateMips)
+				generateColorMipMaps(copyCmd, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, colorImageLayout);
+			else
+				setImageLayout(
+					copyCmd,
+					colorImage,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					colorImageLayout,
+					subresourceRange);
 
 			VKDK::FlushCommandBuffer(copyCmd, VKDK::graphicsQueue, true);
 
@@ -228,7 +296,7 @@ namespace Components::Textures {
 			sampler.mipLodBias = 0.0f;
 			sampler.compareOp = VK_COMPARE_OP_NEVER;
 			sampler.minLod = 0.0f;
-			sampler.maxLod = (float)colorMipLevels;
+			sampler.maxLod = VK_LOD_CLAMP_NONE;
 			sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 			sampler.maxAnisotropy = 1.0f;
 			if (VKDK::deviceFeatures.samplerAnisotropy)
@@ -236,7 +304,7 @@ namespace Components::Textures {
 				sampler.maxAnisotropy = VKDK::deviceProperties.limits.maxSamplerAnisotropy;
 				sampler.anisotropyEnable = VK_TRUE;
 			}
-			VK_CHECK_RESULT(vkCreateSampler(VKDK::device, &sampler, nullptr, &colorSampler));
+			colorSampler = SamplerCache::Get(sampler);
 		}
   };
 }
\ No newline at end of file
@@ -0,0 +1,504 @@
+#include "TextureStreamer.hpp"
+#include "BlockCompressor.hpp"
+#include "TextureTranscoder.hpp"
+#include "KTXFile.hpp"
+
+#include "Systems/ComponentManager.hpp"
+#include "Systems/SceneGraph.hpp"
+#include "Entities/Entity.hpp"
+
+#include <gli/gli.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
+#include <sys/stat.h>
+
+namespace Components::Textures {
+	namespace {
+		/* An image decoded on a worker thread, with copy regions relative to the start of its data */
+		struct DecodedImage {
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			VkExtent3D extent = { 1, 1, 1 };
+			uint32_t mipLevels = 1, layers = 1;
+			bool srgb = false;
+			VkDeviceSize alignment = 4;
+			std::vector<uint8_t> data;
+			std::vector<VkBufferImageCopy> regions;
+		};
+
+		struct Decode {
+			std::shared_ptr<StreamedTexture> texture;
+			std::future<DecodedImage> image;
+		};
+
+		struct Decoded {
+			std::shared_ptr<StreamedTexture> texture;
+			DecodedImage image;
+		};
+
+		/* One upload per update. Its textures become resident, and its staging memory is freed, once the fence signals. */
+		struct Submission {
+			uint64_t id;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			std::vector<std::shared_ptr<StreamedTexture>> textures;
+			std::vector<std::pair<VkBuffer, VkDeviceMemory>> stagingBuffers;
+		};
+
+		/* Part of the ring used by a submission. Ranges are allocated and freed in order. */
+		struct StagingRange {
+			VkDeviceSize begin, end;
+			uint64_t submission;
+		};
+
+		std::mutex mutex;
+		bool initialized = false;
+		std::shared_ptr<TextureInterface> placeholder2D, placeholderCube, placeholder3D;
+
+		/* Requested from any thread, and not yet being decoded */
+		std::vector<std::shared_ptr<StreamedTexture>> queued;
+		std::atomic<size_t> pendingCount{ 0 };
+
+		/* Only touched by the thread calling Update */
+		std::vector<Decode> decoding;
+		std::vector<Decoded> decoded;
+		std::deque<Submission> submissions;
+		std::deque<StagingRange> stagingRanges;
+		uint64_t nextSubmission = 0;
+		uint32_t decodeLimit = 1;
+		VkDeviceSize updateBudget = 0;
+
+		VkBuffer ringBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory ringMemory = VK_NULL_HANDLE;
+		VkDeviceSize ringCapacity = 0;
+		uint8_t *ringData = nullptr;
+
+		std::string getFallbackPath(VkImageViewType viewType) {
+			if (viewType == VK_IMAGE_VIEW_TYPE_CUBE) return ResourcePath "Defaults/missing-texcube.ktx";
+			if (viewType == VK_IMAGE_VIEW_TYPE_3D) return ResourcePath "Defaults/missing-volume.ktx";
+			return ResourcePath "Defaults/missing-texture.ktx";
+		}
+
+		bool decodeTexture(const gli::texture &texture, std::string imagePath, VkImageViewType viewType, DecodedImage &image);
+
+		bool decodeKTX(std::string imagePath, VkImageViewType viewType, DecodedImage &image) {
+			/* Sampleable files are copied once, from the mapping into the image, rather than through gli */
+			KTXFile ktx;
+			if (ktx.open(imagePath) && TextureTranscoder::IsSupported(ktx.getFormat())) {
+				bool matches;
+				if (viewType == VK_IMAGE_VIEW_TYPE_CUBE) matches = ktx.getTarget() == gli::TARGET_CUBE;
+				else if (viewType == VK_IMAGE_VIEW_TYPE_3D) matches = ktx.getTarget() == gli::TARGET_3D;
+				else matches = ktx.getTarget() == gli::TARGET_2D;
+				if (matches) {
+					image.format = ktx.getFormat();
+					image.extent = ktx.getExtent();
+					image.mipLevels = ktx.getLevels();
+					image.layers = ktx.getLayers() * ktx.getFaces();
+					image.alignment = std::lcm((VkDeviceSize)gli::block_size((gli::format)image.format), (VkDeviceSize)4);
+					image.data.resize((size_t)ktx.getRegions(image.mipLevels, image.alignment, image.regions));
+					ktx.copyImages(image.regions, image.data.data());
+					return true;
+				}
+			}
+			ktx.close();
+
+			gli::texture texture = gli::load(imagePath);
+			if (texture.empty()) return false;
+			return decodeTexture(texture, imagePath, viewType, image);
+		}
+
+		bool decodeTexture(const gli::texture &texture, std::string imagePath, VkImageViewType viewType, DecodedImage &image) {
+
+			bool matches;
+			if (viewType == VK_IMAGE_VIEW_TYPE_CUBE) matches = texture.faces() == 6 && texture.layers() == 1;
+			else if (viewType == VK_IMAGE_VIEW_TYPE_3D) matches = texture.target() == gli::TARGET_3D;
+			else matches = texture.faces() == 1 && texture.layers() == 1 && texture.extent().z == 1;
+			if (!matches) {
+				std::cout << imagePath << " doesn't match the requested texture type" << std::endl;
+				return false;
+			}
+
+			image.format = (VkFormat)texture.format();
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(VKDK::physicalDevice, image.format, &formatProperties);
+			if ((formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0) {
+				/* Decode the blocks here on the worker, into a format the device can sample */
+				gli::texture transcoded;
+				if (TextureTranscoder::Transcode(texture, imagePath, transcoded))
+					return decodeTexture(transcoded, imagePath, viewType, image);
+				std::cout << "Unsupported image format for " << imagePath << std::endl;
+				return false;
+			}
+
+			image.extent = { (uint32_t)texture.extent().x, (uint32_t)texture.extent().y, (uint32_t)texture.extent().z };
+			image.mipLevels = (uint32_t)texture.levels();
+			image.layers = (uint32_t)(texture.layers() * texture.faces());
+			image.alignment = std::lcm((VkDeviceSize)gli::block_size(texture.format()), (VkDeviceSize)4);
+
+			/* gli stores every level of every face of every layer back to back */
+			auto base = (const uint8_t*)texture.data();
+			image.data.assign(base, base + texture.size());
+			for (size_t layer = 0; layer < texture.layers(); ++layer) {
+				for (size_t face = 0; face < texture.faces(); ++face) {
+					for (size_t level = 0; level < texture.levels(); ++level) {
+						VkBufferImageCopy region = {};
+						region.bufferOffset = (const uint8_t*)texture.data(layer, face, level) - base;
+						region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+						region.imageSubresource.mipLevel = (uint32_t)level;
+						region.imageSubresource.baseArrayLayer = (uint32_t)(layer * texture.faces() + face);
+						region.imageSubresource.layerCount = 1;
+						region.imageExtent = { (uint32_t)texture.extent(level).x, (uint32_t)texture.extent(level).y,
+							(uint32_t)texture.extent(level).z };
+						image.regions.push_back(region);
+					}
+				}
+			}
+			return true;
+		}
+
+		bool decodePNG(std::string imagePath, bool srgb, DecodedImage &image) {
+			/* Like Texture2D, PNGs are expanded to RGBA */
+			int texWidth, texHeight, texChannels;
+			stbi_uc* pixels = stbi_load(imagePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+			if (!pixels) return false;
+
+			image.format = VK_FORMAT_R8G8B8A8_UNORM;
+			image.srgb = srgb;
+			image.extent = { (uint32_t)texWidth, (uint32_t)texHeight, 1 };
+			image.data.assign(pixels, pixels + (size_t)texWidth * texHeight * 4);
+			stbi_image_free(pixels);
+
+			VkBufferImageCopy region = {};
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent = image.extent;
+			image.regions.push_back(region);
+			return true;
+		}
+
+		/* Runs on a worker thread. Falls back to the missing texture for the view type, like the synchronous loaders. */
+		DecodedImage decode(std::string imagePath, VkImageViewType viewType, bool srgb) {
+			DecodedImage image;
+			struct stat st;
+			if (stat(imagePath.c_str(), &st) != 0) {
+				std::cout << imagePath + " does not exist!" << std::endl;
+			}
+			else if (imagePath.substr(imagePath.find_last_of(".") + 1) == "ktx") {
+				if (decodeKTX(imagePath, viewType, image)) return image;
+			}
+			else if (viewType == VK_IMAGE_VIEW_TYPE_2D) {
+				/* Like Texture2D, prefer a block compressed copy. Encoding it here keeps it off the render thread. */
+				gli::texture2d compressed;
+				if (BlockCompressor::LoadCompressed(imagePath, compressed, srgb) && decodeTexture(compressed, imagePath, viewType, image)) return image;
+				image = DecodedImage();
+				if (decodePNG(imagePath, srgb, image)) return image;
+			}
+
+			image = DecodedImage();
+			std::string fallbackPath = getFallbackPath(viewType);
+			if (imagePath != fallbackPath && decodeKTX(fallbackPath, viewType, image)) return image;
+			throw std::runtime_error("failed to load texture image " + imagePath + "!");
+		}
+
+		/* Fraction of a view covered by a bounding sphere, 0 if it's outside the view, and 1 if the eye is inside it */
+		float getScreenCoverage(glm::vec3 center, float radius, glm::mat4 &view, glm::mat4 &projection) {
+			glm::vec4 viewCenter = view * glm::vec4(center, 1.0);
+			float distance = -viewCenter.z;
+			if (glm::length(glm::vec3(viewCenter)) <= radius) return 1.0f;
+			if (distance + radius <= 0.0f) return 0.0f;
+
+			/* Projected radius in normalized device coordinates, which span 2 units on each axis */
+			distance = std::max(distance, 1e-3f);
+			float scale = std::max(std::abs(projection[0][0]), std::abs(projection[1][1]));
+			float projectedRadius = radius * scale / distance;
+
+			glm::vec4 clip = projection * viewCenter;
+			if (clip.w > 0.0f) {
+				glm::vec2 ndc = glm::vec2(clip) / clip.w;
+				if (std::abs(ndc.x) > 1.0f + projectedRadius || std::abs(ndc.y) > 1.0f + projectedRadius) return 0.0f;
+			}
+			return std::min(1.0f, 3.14159265f * projectedRadius * projectedRadius / 4.0f);
+		}
+
+		/* Finds space for size bytes in the ring. Returns false if the ring is too full until earlier uploads finish. */
+		bool allocateStaging(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset) {
+			auto alignUp = [alignment](VkDeviceSize value) { return ((value + alignment - 1) / alignment) * alignment; };
+			if (stagingRanges.empty()) {
+				offset = 0;
+				return size <= ringCapacity;
+			}
+
+			VkDeviceSize tail = stagingRanges.front().begin;
+			VkDeviceSize head = stagingRanges.back().end;
+			bool wrapped = stagingRanges.back().begin < tail;
+			VkDeviceSize start = alignUp(head);
+			if (!wrapped) {
+				if (start + size <= ringCapacity) { offset = start; return true; }
+				if (size <= tail) { offset = 0; return true; }
+				return false;
+			}
+			if (start + size <= tail) { offset = start; return true; }
+			return false;
+		}
+	}
+
+	void TextureStreamer::Initialize(VkDeviceSize ringSize, VkDeviceSize uploadBudget, uint32_t maxDecodes) {
+		/* Placeholders are looked up once, so that Load doesn't touch the component manager */
+		auto getPlaceholder = [](std::string name) {
+			auto texture = Systems::ComponentManager::Textures.find(name);
+			if (texture == Systems::ComponentManager::Textures.end())
+				throw std::runtime_error("placeholder texture " + name + " must be created before texture streaming is initialized!");
+			return texture->second->texture;
+		};
+
+		std::lock_guard<std::mutex> lock(mutex);
+		placeholder2D = getPlaceholder("DefaultTexture");
+		placeholderCube = getPlaceholder("DefaultTextureCube");
+		placeholder3D = getPlaceholder("DefaultTexture3D");
+
+		uint32_t cores = std::thread::hardware_concurrency();
+		decodeLimit = (maxDecodes != 0) ? maxDecodes : std::max(1u, (cores > 2) ? cores - 2 : 1u);
+		updateBudget = uploadBudget;
+		ringCapacity = ringSize;
+
+		VKDK::CreateBuffer(ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ringBuffer, ringMemory);
+		VK_CHECK_RESULT(vkMapMemory(VKDK::device, ringMemory, 0, ringSize, 0, (void**)&ringData));
+
+		/* stb's flip setting is global, so set it once here rather than from every decode */
+		stbi_set_flip_vertically_on_load(true);
+		initialized = true;
+	}
+
+	void TextureStreamer::Destroy() {
+		if (!initialized) return;
+
+		/* Let decodes and uploads in flight finish. Their textures keep sampling their placeholders. */
+		for (auto &job : decoding) job.image.wait();
+		decoding.clear();
+		decoded.clear();
+		FinishUploads(true);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		queued.clear();
+		pendingCount = 0;
+
+		vkUnmapMemory(VKDK::device, ringMemory);
+		vkDestroyBuffer(VKDK::device, ringBuffer, nullptr);
+		vkFreeMemory(VKDK::device, ringMemory, nullptr);
+		ringBuffer = VK_NULL_HANDLE;
+		ringMemory = VK_NULL_HANDLE;
+		ringData = nullptr;
+		placeholder2D = placeholderCube = placeholder3D = nullptr;
+		initialized = false;
+	}
+
+	std::shared_ptr<StreamedTexture> TextureStreamer::Load(std::string imagePath, VkImageViewType viewType, bool srgb) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!initialized) throw std::runtime_error("texture streaming is not initialized!");
+
+		std::shared_ptr<TextureInterface> placeholder;
+		switch (viewType) {
+		case VK_IMAGE_VIEW_TYPE_2D: placeholder = placeholder2D; break;
+		case VK_IMAGE_VIEW_TYPE_CUBE: placeholder = placeholderCube; break;
+		case VK_IMAGE_VIEW_TYPE_3D: placeholder = placeholder3D; break;
+		default: throw std::runtime_error("texture streaming only supports 2D, cube, and 3D textures!");
+		}
+
+		auto texture = std::make_shared<StreamedTexture>(imagePath, viewType, placeholder, srgb);
+		queued.push_back(texture);
+		++pendingCount;
+		return texture;
+	}
+
+	void TextureStreamer::Update() {
+		if (!initialized || pendingCount == 0) return;
+		FinishUploads(false);
+		UpdatePriorities();
+		UpdateDecodes();
+		UploadDecoded();
+	}
+
+	void TextureStreamer::Flush() {
+		while (initialized && pendingCount > 0) {
+			Update();
+			if (!submissions.empty()) FinishUploads(true);
+			else if (!decoding.empty()) decoding.front().image.wait();
+		}
+	}
+
+	size_t TextureStreamer::GetPendingCount() {
+		return pendingCount;
+	}
+
+	void TextureStreamer::UpdatePriorities() {
+		std::vector<std::shared_ptr<StreamedTexture>> pending;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending = queued;
+		}
+		for (auto &job : decoding) pending.push_back(job.texture);
+		for (auto &image : decoded) pending.push_back(image.texture);
+		if (pending.empty()) return;
+
+		/* Largest coverage of any entity sampling each texture, from any view of any perspective */
+		std::unordered_map<TextureInterface*, float> coverage;
+		for (auto &pair : Systems::SceneGraph::Entities) {
+			auto entity = pair.second;
+			if (!entity->hasBounds || !entity->isActive()) continue;
+			auto materials = entity->getComponents<Components::Materials::Material>();
+			if (materials.empty()) continue;
+
+			float entityCoverage = 0.0f;
+			for (auto &perspective : Systems::ComponentManager::Perspectives) {
+				for (uint32_t i = 0; i < perspective.second->viewCount; ++i) {
+					entityCoverage = std::max(entityCoverage, getScreenCoverage(entity->worldSphereCenter,
+						entity->worldSphereRadius, perspective.second->views[i], perspective.second->projections[i]));
+				}
+			}
+
+			for (auto &material : materials) {
+				if (!material->material) continue;
+				for (auto &texture : material->material->getTextures()) {
+					if (!texture || !texture->texture) continue;
+					float &textureCoverage = coverage[texture->texture.get()];
+					textureCoverage = std::max(textureCoverage, entityCoverage);
+				}
+			}
+		}
+
+		for (auto &texture : pending) {
+			auto found = coverage.find(texture.get());
+			texture->setPriority((found != coverage.end()) ? found->second : 0.0f);
+		}
+	}
+
+	void TextureStreamer::UpdateDecodes() {
+		/* Collect finished decodes */
+		for (auto job = decoding.begin(); job != decoding.end();) {
+			if (job->image.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				++job;
+				continue;
+			}
+			try {
+				decoded.push_back({ job->texture, job->image.get() });
+			}
+			catch (std::exception &e) {
+				/* Nothing could be loaded, so the texture keeps its placeholder */
+				std::cout << e.what() << std::endl;
+				--pendingCount;
+			}
+			job = decoding.erase(job);
+		}
+
+		/* Start the most important queued decodes, keeping a bound on how many decoded images wait for upload */
+		std::lock_guard<std::mutex> lock(mutex);
+		if (queued.empty()) return;
+		std::stable_sort(queued.begin(), queued.end(), [](const std::shared_ptr<StreamedTexture> &a, const std::shared_ptr<StreamedTexture> &b) {
+			return a->getPriority() > b->getPriority();
+		});
+		size_t started = 0;
+		while (started < queued.size() && decoding.size() < decodeLimit && decoding.size() + decoded.size() < 2 * decodeLimit) {
+			auto texture = queued[started++];
+			decoding.push_back({ texture, std::async(std::launch::async, decode, texture->getPath(), texture->getViewType(), texture->isSrgb()) });
+		}
+		queued.erase(queued.begin(), queued.begin() + started);
+	}
+
+	void TextureStreamer::UploadDecoded() {
+		if (decoded.empty()) return;
+		std::stable_sort(decoded.begin(), decoded.end(), [](const Decoded &a, const Decoded &b) {
+			return a.texture->getPriority() > b.texture->getPriority();
+		});
+
+		Submission submission;
+		submission.id = nextSubmission;
+		VkDeviceSize uploaded = 0;
+		auto upload = decoded.begin();
+
+		/* Always upload at least one image, so that images larger than the budget still make progress */
+		while (upload != decoded.end() && (uploaded == 0 || uploaded + upload->image.data.size() <= updateBudget)) {
+			auto &image = upload->image;
+			VkDeviceSize size = image.data.size();
+			VkBuffer stagingBuffer;
+			VkDeviceSize stagingOffset = 0;
+
+			if (size <= ringCapacity) {
+				/* Keep priority order. Whatever doesn't fit waits for earlier uploads to free their part of the ring. */
+				if (!allocateStaging(size, image.alignment, stagingOffset)) break;
+				memcpy(ringData + stagingOffset, image.data.data(), size);
+				stagingRanges.push_back({ stagingOffset, stagingOffset + size, submission.id });
+				stagingBuffer = ringBuffer;
+			}
+			else {
+				VkDeviceMemory stagingMemory;
+				VKDK::CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
+				void *data;
+				vkMapMemory(VKDK::device, stagingMemory, 0, size, 0, &data);
+				memcpy(data, image.data.data(), size);
+				vkUnmapMemory(VKDK::device, stagingMemory);
+				submission.stagingBuffers.push_back({ stagingBuffer, stagingMemory });
+			}
+
+			if (submission.commandBuffer == VK_NULL_HANDLE)
+				submission.commandBuffer = VKDK::CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+			for (auto &region : image.regions) region.bufferOffset += stagingOffset;
+			upload->texture->createImage(image.format, image.extent, image.mipLevels, image.layers, image.srgb);
+			upload->texture->recordUpload(submission.commandBuffer, stagingBuffer, image.regions);
+			submission.textures.push_back(upload->texture);
+
+			uploaded += size;
+			upload = decoded.erase(upload);
+		}
+		if (submission.commandBuffer == VK_NULL_HANDLE) return;
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(submission.commandBuffer));
+		VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo();
+		VK_CHECK_RESULT(vkCreateFence(VKDK::device, &fenceInfo, nullptr, &submission.fence));
+
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &submission.commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(VKDK::graphicsQueue, 1, &submitInfo, submission.fence));
+
+		submissions.push_back(submission);
+		++nextSubmission;
+	}
+
+	void TextureStreamer::FinishUploads(bool wait) {
+		bool finished = false;
+		while (!submissions.empty()) {
+			auto &submission = submissions.front();
+			if (wait) vkWaitForFences(VKDK::device, 1, &submission.fence, VK_TRUE, UINT64_MAX);
+			else if (vkGetFenceStatus(VKDK::device, submission.fence) != VK_SUCCESS) break;
+
+			for (auto &texture : submission.textures) {
+				texture->setResident();
+				--pendingCount;
+			}
+
+			vkFreeCommandBuffers(VKDK::device, VKDK::commandPool, 1, &submission.commandBuffer);
+			vkDestroyFence(VKDK::device, submission.fence, nullptr);
+			for (auto &stagingBuffer : submission.stagingBuffers) {
+				vkDestroyBuffer(VKDK::device, stagingBuffer.first, nullptr);
+				vkFreeMemory(VKDK::device, stagingBuffer.second, nullptr);
+			}
+			while (!stagingRanges.empty() && stagingRanges.front().submission == submission.id)
+				stagingRanges.pop_front();
+
+			submissions.pop_front();
+			finished = true;
+		}
+
+		/* Descriptor sets and bindless indices pick up the new views once perspectives re-record */
+		if (finished) Systems::SceneGraph::MarkDirty();
+	}
+}
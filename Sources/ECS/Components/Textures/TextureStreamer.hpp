@@ -0,0 +1,50 @@
+#pragma once
+
+#include "vkdk.hpp"
+#include "StreamedTexture.hpp"
+
+#include <memory>
+#include <string>
+
+namespace Components::Textures {
+	/* Loads textures in the background, so that scenes don't stall while large images are decoded and uploaded.
+
+		Load returns a StreamedTexture right away, which samples the placeholder texture for its view type. Images are
+		decoded from .ktx (gli) or .png (stb) on worker threads. Decoded images are copied into a persistently mapped
+		staging ring and uploaded with a single submission per frame, limited by an upload budget. Once a submission's
+		fence signals, its textures switch to their real images, its part of the ring is reused, and every perspective
+		re-records.
+
+		Textures covering more of the screen are decoded and uploaded first. Each update, every pending texture is
+		given the largest screen coverage of any active entity whose material samples it, across every perspective. */
+	class TextureStreamer {
+	public:
+		/* ringSize is the size of the staging ring, uploadBudget the most bytes uploaded per update, and maxDecodes
+			the most images decoded at once, or 0 for one per spare core. Images larger than the ring are staged
+			through a buffer of their own. */
+		static void Initialize(VkDeviceSize ringSize = 64 * 1024 * 1024, VkDeviceSize uploadBudget = 16 * 1024 * 1024,
+			uint32_t maxDecodes = 0);
+		static void Destroy();
+
+		/* Returns a texture which samples the placeholder for its view type until the image at the given path is
+			resident. srgb should be false for PNGs which don't hold colors. Safe to call from any thread. */
+		static std::shared_ptr<StreamedTexture> Load(std::string imagePath, VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D,
+			bool srgb = true);
+
+		/* Reprioritizes pending textures, starts decoding, uploads decoded images, and swaps in finished ones.
+			Call once per frame, from the thread submitting to the graphics queue. */
+		static void Update();
+
+		/* Updates until every texture requested so far is resident */
+		static void Flush();
+
+		/* Number of requested textures which aren't resident yet */
+		static size_t GetPendingCount();
+
+	private:
+		static void UpdatePriorities();
+		static void UpdateDecodes();
+		static void UploadDecoded();
+		static void FinishUploads(bool wait);
+	};
+}
@@ -0,0 +1,208 @@
+#include "TextureTable.hpp"
+#include "Texture.hpp"
+
+#include <algorithm>
+
+namespace Components::Textures {
+	namespace {
+		std::mutex mutex;
+		bool enabled = false;
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	}
+
+	TextureTable::Array &TextureTable::GetArray(VkImageViewType viewType, uint32_t &binding) {
+		static Array arrays[3];
+		switch (viewType) {
+		case VK_IMAGE_VIEW_TYPE_2D: binding = Binding2D; break;
+		case VK_IMAGE_VIEW_TYPE_CUBE: binding = BindingCube; break;
+		case VK_IMAGE_VIEW_TYPE_3D: binding = Binding3D; break;
+		default: throw std::runtime_error("texture table only supports 2D, cube, and 3D views!");
+		}
+		return arrays[binding];
+	}
+
+	void TextureTable::Initialize(uint32_t max2D, uint32_t maxCube, uint32_t max3D) {
+		if (!VKDK::descriptorIndexingSupported) return;
+		std::lock_guard<std::mutex> lock(mutex);
+
+		/* Every combined image sampler counts against both the sampler and sampled image limits. Leave some room
+			for the per draw descriptors of bindless materials. */
+		auto &limits = VKDK::descriptorIndexingProperties;
+		uint32_t limit = std::min({
+			limits.maxPerStageDescriptorUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+			limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxDescriptorSetUpdateAfterBindSampledImages });
+		limit = (limit > 16) ? limit - 16 : limit;
+		while (max2D + maxCube + max3D > limit && (max2D > 1 || maxCube > 1 || max3D > 1)) {
+			max2D = std::max(1u, max2D / 2);
+			maxCube = std::max(1u, maxCube / 2);
+			max3D = std::max(1u, max3D / 2);
+		}
+
+		uint32_t binding;
+		GetArray(VK_IMAGE_VIEW_TYPE_2D, binding).capacity = max2D;
+		GetArray(VK_IMAGE_VIEW_TYPE_CUBE, binding).capacity = maxCube;
+		GetArray(VK_IMAGE_VIEW_TYPE_3D, binding).capacity = max3D;
+
+		uint32_t counts[3] = { max2D, maxCube, max3D };
+		std::vector<VkDescriptorSetLayoutBinding> bindings(3);
+		std::vector<VkDescriptorBindingFlagsEXT> bindingFlags(3);
+		for (uint32_t i = 0; i < 3; ++i) {
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			bindings[i].descriptorCount = counts[i];
+			bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+			bindings[i].pImmutableSamplers = nullptr;
+
+			/* Unused slots are never read, and new slots can be written while the table is in use */
+			bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT
+				| VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+				| VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+		}
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		bindingFlagsInfo.bindingCount = (uint32_t)bindingFlags.size();
+		bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+		layoutInfo.bindingCount = (uint32_t)bindings.size();
+		layoutInfo.pBindings = bindings.data();
+
+		if (vkCreateDescriptorSetLayout(VKDK::device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create texture table descriptor set layout!");
+		}
+
+		VkDescriptorPoolSize poolSize = {};
+		poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSize.descriptorCount = max2D + maxCube + max3D;
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+		poolInfo.maxSets = 1;
+
+		if (vkCreateDescriptorPool(VKDK::device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create texture table descriptor pool!");
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		if (vkAllocateDescriptorSets(VKDK::device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate texture table descriptor set!");
+		}
+
+		enabled = true;
+	}
+
+	void TextureTable::Destroy() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!enabled) return;
+
+		vkDestroyDescriptorPool(VKDK::device, pool, nullptr);
+		vkDestroyDescriptorSetLayout(VKDK::device, layout, nullptr);
+		pool = VK_NULL_HANDLE;
+		layout = VK_NULL_HANDLE;
+		descriptorSet = VK_NULL_HANDLE;
+
+		uint32_t binding;
+		for (auto viewType : { VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_VIEW_TYPE_CUBE, VK_IMAGE_VIEW_TYPE_3D })
+			GetArray(viewType, binding) = Array();
+		enabled = false;
+	}
+
+	bool TextureTable::IsEnabled() {
+		return enabled;
+	}
+
+	uint32_t TextureTable::GetIndex(VkImageView imageView, VkSampler sampler, VkImageViewType viewType, VkImageLayout imageLayout) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!enabled) throw std::runtime_error("texture table is not enabled!");
+
+		uint32_t binding;
+		auto &array = GetArray(viewType, binding);
+		auto existing = array.slots.find({ imageView, sampler });
+		if (existing != array.slots.end()) return existing->second;
+
+		uint32_t slot;
+		if (!array.freeSlots.empty()) {
+			slot = array.freeSlots.back();
+			array.freeSlots.pop_back();
+		}
+		else if (array.next < array.capacity) {
+			slot = array.next++;
+		}
+		else {
+			throw std::runtime_error("texture table is full!");
+		}
+
+		/* The slot isn't read by any pending command buffer, so it can be written now */
+		VkDescriptorImageInfo imageInfo = {};
+		imageInfo.imageView = imageView;
+		imageInfo.sampler = sampler;
+		imageInfo.imageLayout = imageLayout;
+
+		VkWriteDescriptorSet descriptorWrite = {};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = descriptorSet;
+		descriptorWrite.dstBinding = binding;
+		descriptorWrite.dstArrayElement = slot;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(VKDK::device, 1, &descriptorWrite, 0, nullptr);
+
+		array.slots[{ imageView, sampler }] = slot;
+		return slot;
+	}
+
+	uint32_t TextureTable::GetColorIndex(std::shared_ptr<Texture> texture, VkImageLayout imageLayout) {
+		return GetIndex(texture->texture->getColorImageView(), texture->texture->getColorSampler(),
+			texture->texture->getViewType(), imageLayout);
+	}
+
+	uint32_t TextureTable::GetDepthIndex(std::shared_ptr<Texture> texture, VkImageLayout imageLayout) {
+		return GetIndex(texture->texture->getDepthImageView(), texture->texture->getDepthSampler(),
+			texture->texture->getViewType(), imageLayout);
+	}
+
+	void TextureTable::Release(VkImageView imageView) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!enabled) return;
+
+		uint32_t binding;
+		for (auto viewType : { VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_VIEW_TYPE_CUBE, VK_IMAGE_VIEW_TYPE_3D }) {
+			auto &array = GetArray(viewType, binding);
+			for (auto slot = array.slots.begin(); slot != array.slots.end();) {
+				if (slot->first.first == imageView) {
+					array.freeSlots.push_back(slot->second);
+					slot = array.slots.erase(slot);
+				}
+				else ++slot;
+			}
+		}
+	}
+
+	VkDescriptorSetLayout TextureTable::GetDescriptorSetLayout() {
+		return layout;
+	}
+
+	VkDescriptorSet TextureTable::GetDescriptorSet() {
+		return descriptorSet;
+	}
+
+	void TextureTable::Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkPipelineBindPoint bindPoint) {
+		if (!enabled) return;
+		vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "vkdk.hpp"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Components::Textures {
+	class Texture;
+
+	/* A single global descriptor set holding large arrays of every sampled texture, for bindless materials.
+
+		Binding 0 is an array of 2D textures, binding 1 an array of cubemaps, and binding 2 an array of 3D textures.
+		A texture is added to the table the first time its index is requested, and materials pass that index to
+		their shaders in uniform or storage buffer data instead of binding the texture per draw.
+
+		Requires VK_EXT_descriptor_indexing. Bindings are partially bound and update after bind, so textures can be
+		added while command buffers using the table are pending. If the extension isn't available, IsEnabled returns
+		false and materials should fall back to per draw texture descriptors. */
+	class TextureTable {
+	public:
+		static const uint32_t Binding2D = 0;
+		static const uint32_t BindingCube = 1;
+		static const uint32_t Binding3D = 2;
+
+		/* Creates the table with room for the given number of textures of each type, reduced to fit device limits */
+		static void Initialize(uint32_t max2D = 1024, uint32_t maxCube = 128, uint32_t max3D = 32);
+		static void Destroy();
+
+		static bool IsEnabled();
+
+		/* Returns the index of a view/sampler pair within the array matching the view type, adding it if needed */
+		static uint32_t GetIndex(VkImageView imageView, VkSampler sampler, VkImageViewType viewType,
+			VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		static uint32_t GetColorIndex(std::shared_ptr<Texture> texture, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		static uint32_t GetDepthIndex(std::shared_ptr<Texture> texture, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		/* Frees every slot holding the given view. Only safe once no recorded draws still read those indices. */
+		static void Release(VkImageView imageView);
+
+		static VkDescriptorSetLayout GetDescriptorSetLayout();
+		static VkDescriptorSet GetDescriptorSet();
+
+		/* Binds the table to set 0 of a pipeline layout whose first set layout is the table's */
+		static void Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout,
+			VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+	private:
+		struct Array {
+			uint32_t capacity = 0;
+			uint32_t next = 0;
+			std::vector<uint32_t> freeSlots;
+			std::map<std::pair<VkImageView, VkSampler>, uint32_t> slots;
+		};
+
+		static Array &GetArray(VkImageViewType viewType, uint32_t &binding);
+	};
+}
@@ -0,0 +1,977 @@
+#include "TextureTranscoder.hpp"
+#include "BlockCompressor.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+namespace Components::Textures {
+	namespace {
+		std::mutex cacheMutex;
+
+		enum class Codec { BC1, BC1A, BC2, BC3, BC4, BC5, ETC2, ETC2A1, ETC2A8, ASTC };
+
+		struct BlockInfo {
+			Codec codec = Codec::BC1;
+			uint32_t width = 4, height = 4;
+			uint32_t size = 16;
+			bool srgb = false;
+		};
+
+		/* Decoded blocks are at most 12x12 texels, stored row by row */
+		typedef uint8_t Texels[144][4];
+
+		/* Blocks which break the rules decode to magenta, as the ASTC spec asks */
+		const uint8_t errorColor[4] = { 255, 0, 255, 255 };
+
+		bool getBlockInfo(VkFormat format, BlockInfo &info) {
+			info = BlockInfo();
+			switch (format) {
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK: info.srgb = true; [[fallthrough]];
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK: info.codec = Codec::BC1; info.size = 8; return true;
+			case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: info.srgb = true; [[fallthrough]];
+			case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: info.codec = Codec::BC1A; info.size = 8; return true;
+			case VK_FORMAT_BC2_SRGB_BLOCK: info.srgb = true; [[fallthrough]];
+			case VK_FORMAT_BC2_UNORM_BLOCK: info.codec = Codec::BC2; return true;
+			case VK_FORMAT_BC3_SRGB_BLOCK: info.srgb = true; [[fallthrough]];
+			case VK_FORMAT_BC3_UNORM_BLOCK: info.codec = Codec::BC3; return true;
+			case VK_FORMAT_BC4_UNORM_BLOCK: info.codec = Codec::BC4; info.size = 8; return true;
+			case VK_FORMAT_BC5_UNORM_BLOCK: info.codec = Codec::BC5; return true;
+			case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK: info.srgb = true; [[fallthrough]];
+			case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK: info.codec = Codec::ETC2; info.size = 8; return true;
+			case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK: info.srgb = true; [[fallthrough]];
+			case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK: info.codec = Codec::ETC2A1; info.size = 8; return true;
+			case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK: info.srgb = true; [[fallthrough]];
+			case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK: info.codec = Codec::ETC2A8; return true;
+			default: break;
+			}
+
+			/* ASTC formats come in UNORM / SRGB pairs, one pair per footprint */
+			if (format < VK_FORMAT_ASTC_4x4_UNORM_BLOCK || format > VK_FORMAT_ASTC_12x12_SRGB_BLOCK) return false;
+			const uint32_t footprints[14][2] = { { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+				{ 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 } };
+			uint32_t index = (uint32_t)(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK);
+			info.codec = Codec::ASTC;
+			info.width = footprints[index / 2][0];
+			info.height = footprints[index / 2][1];
+			info.srgb = (index & 1) != 0;
+			return true;
+		}
+
+		uint8_t clampByte(int value) {
+			return (uint8_t)std::min(255, std::max(0, value));
+		}
+
+		/* BC */
+
+		void decodeBC1(const uint8_t *block, bool alpha, bool fourColor, Texels texels) {
+			uint32_t endpoints[2] = { (uint32_t)(block[0] | (block[1] << 8)), (uint32_t)(block[2] | (block[3] << 8)) };
+			int palette[4][4];
+			for (int e = 0; e < 2; ++e) {
+				int r = (endpoints[e] >> 11) & 31, g = (endpoints[e] >> 5) & 63, b = endpoints[e] & 31;
+				palette[e][0] = (r << 3) | (r >> 2);
+				palette[e][1] = (g << 2) | (g >> 4);
+				palette[e][2] = (b << 3) | (b >> 2);
+				palette[e][3] = 255;
+			}
+			for (int c = 0; c < 3; ++c) {
+				if (endpoints[0] > endpoints[1] || fourColor) {
+					palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+					palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+				}
+				else {
+					palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+					palette[3][c] = 0;
+				}
+			}
+			palette[2][3] = 255;
+			palette[3][3] = (endpoints[0] <= endpoints[1] && !fourColor && alpha) ? 0 : 255;
+
+			uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+			for (int i = 0; i < 16; ++i)
+				for (int c = 0; c < 4; ++c) texels[i][c] = (uint8_t)palette[(indices >> (2 * i)) & 3][c];
+		}
+
+		/* The interpolated single channel blocks of BC3 alpha, BC4 and BC5 */
+		void decodeBCChannel(const uint8_t *block, int channel, Texels texels) {
+			int palette[8] = { block[0], block[1] };
+			if (palette[0] > palette[1]) {
+				for (int i = 1; i < 7; ++i) palette[i + 1] = ((7 - i) * palette[0] + i * palette[1] + 3) / 7;
+			}
+			else {
+				for (int i = 1; i < 5; ++i) palette[i + 1] = ((5 - i) * palette[0] + i * palette[1] + 2) / 5;
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+
+			uint64_t indices = 0;
+			for (int i = 0; i < 6; ++i) indices |= (uint64_t)block[2 + i] << (8 * i);
+			for (int i = 0; i < 16; ++i) texels[i][channel] = (uint8_t)palette[(indices >> (3 * i)) & 7];
+		}
+
+		/* ETC2, with blocks stored as big endian 64 bit words. Texels are indexed column by column. */
+
+		const int etcModifiers[8][4] = {
+			{ 2, 8, -2, -8 }, { 5, 17, -5, -17 }, { 9, 29, -9, -29 }, { 13, 42, -13, -42 },
+			{ 18, 60, -18, -60 }, { 24, 80, -24, -80 }, { 33, 106, -33, -106 }, { 47, 183, -47, -183 } };
+
+		const int etcDistances[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+		const int eacModifiers[16][8] = {
+			{ -3, -6, -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 }, { -2, -5, -8, -13, 1, 4, 7, 12 },
+			{ -2, -4, -6, -13, 1, 3, 5, 12 }, { -3, -6, -8, -12, 2, 5, 7, 11 }, { -3, -7, -9, -11, 2, 6, 8, 10 },
+			{ -4, -7, -8, -11, 3, 6, 7, 10 }, { -3, -5, -8, -11, 2, 4, 7, 10 }, { -2, -6, -8, -10, 1, 5, 7, 9 },
+			{ -2, -5, -8, -10, 1, 4, 7, 9 }, { -2, -4, -8, -10, 1, 3, 7, 9 }, { -2, -5, -7, -10, 1, 4, 6, 9 },
+			{ -3, -4, -7, -10, 2, 3, 6, 9 }, { -1, -2, -3, -10, 0, 1, 2, 9 }, { -4, -6, -8, -9, 3, 5, 7, 8 },
+			{ -3, -5, -7, -9, 2, 4, 6, 8 } };
+
+		uint64_t readBigEndian(const uint8_t *block) {
+			uint64_t bits = 0;
+			for (int i = 0; i < 8; ++i) bits = (bits << 8) | block[i];
+			return bits;
+		}
+
+		int extend4(int value) { return (value << 4) | value; }
+		int extend5(int value) { return (value << 3) | (value >> 2); }
+		int extend6(int value) { return (value << 2) | (value >> 4); }
+		int extend7(int value) { return (value << 1) | (value >> 6); }
+
+		void decodeETC2(const uint8_t *block, bool punchThrough, Texels texels) {
+			uint64_t bits = readBigEndian(block);
+			auto field = [bits](int high, int low) { return (int)((bits >> low) & ((1ull << (high - low + 1)) - 1)); };
+
+			/* Without punch-through alpha, bit 33 picks differential mode. With it, it's the opaque flag instead,
+				and there's no individual mode. */
+			bool differential = field(33, 33) != 0;
+			bool opaque = !punchThrough || differential;
+			int colors[2][3];
+			int paint[4][3];
+			bool usePaint = false;
+
+			if (!punchThrough && !differential) {
+				for (int c = 0; c < 3; ++c) {
+					colors[0][c] = extend4(field(63 - 8 * c, 60 - 8 * c));
+					colors[1][c] = extend4(field(59 - 8 * c, 56 - 8 * c));
+				}
+			}
+			else {
+				int base[3], second[3];
+				for (int c = 0; c < 3; ++c) {
+					base[c] = field(63 - 8 * c, 59 - 8 * c);
+					int delta = field(58 - 8 * c, 56 - 8 * c);
+					second[c] = base[c] + ((delta & 4) ? delta - 8 : delta);
+				}
+
+				if (second[0] < 0 || second[0] > 31) {
+					/* T mode */
+					int first[3] = { extend4((field(60, 59) << 2) | field(57, 56)), extend4(field(55, 52)), extend4(field(51, 48)) };
+					int other[3] = { extend4(field(47, 44)), extend4(field(43, 40)), extend4(field(39, 36)) };
+					int distance = etcDistances[(field(35, 34) << 1) | field(32, 32)];
+					for (int c = 0; c < 3; ++c) {
+						paint[0][c] = first[c];
+						paint[1][c] = other[c] + distance;
+						paint[2][c] = other[c];
+						paint[3][c] = other[c] - distance;
+					}
+					usePaint = true;
+				}
+				else if (second[1] < 0 || second[1] > 31) {
+					/* H mode, where the order of the two colors holds the last bit of the distance index */
+					int first[3] = { field(62, 59), (field(58, 56) << 1) | field(52, 52), (field(51, 51) << 3) | field(49, 47) };
+					int other[3] = { field(46, 43), field(42, 39), field(38, 35) };
+					int order = ((first[0] << 8) | (first[1] << 4) | first[2]) >= ((other[0] << 8) | (other[1] << 4) | other[2]);
+					int distance = etcDistances[(field(34, 34) << 2) | (field(32, 32) << 1) | order];
+					for (int c = 0; c < 3; ++c) {
+						paint[0][c] = extend4(first[c]) + distance;
+						paint[1][c] = extend4(first[c]) - distance;
+						paint[2][c] = extend4(other[c]) + distance;
+						paint[3][c] = extend4(other[c]) - distance;
+					}
+					usePaint = true;
+				}
+				else if (second[2] < 0 || second[2] > 31) {
+					/* Planar mode, a gradient through three colors which is always opaque */
+					int origin[3] = { extend6(field(62, 57)), extend7((field(56, 56) << 6) | field(54, 49)),
+						extend6((field(48, 48) << 5) | (field(44, 43) << 3) | field(41, 39)) };
+					int horizontal[3] = { extend6((field(38, 34) << 1) | field(32, 32)), extend7(field(31, 25)), extend6(field(24, 19)) };
+					int vertical[3] = { extend6(field(18, 13)), extend7(field(12, 6)), extend6(field(5, 0)) };
+					for (int y = 0; y < 4; ++y) {
+						for (int x = 0; x < 4; ++x) {
+							for (int c = 0; c < 3; ++c)
+								texels[y * 4 + x][c] = clampByte((x * (horizontal[c] - origin[c]) + y * (vertical[c] - origin[c]) + 4 * origin[c] + 2) >> 2);
+							texels[y * 4 + x][3] = 255;
+						}
+					}
+					return;
+				}
+				else {
+					for (int c = 0; c < 3; ++c) {
+						colors[0][c] = extend5(base[c]);
+						colors[1][c] = extend5(second[c]);
+					}
+				}
+			}
+
+			int tables[2] = { field(39, 37), field(36, 34) };
+			bool flip = field(32, 32) != 0;
+			for (int i = 0; i < 16; ++i) {
+				int x = i / 4, y = i % 4;
+				int index = (field(i + 16, i + 16) << 1) | field(i, i);
+				uint8_t *texel = texels[y * 4 + x];
+
+				/* Without the opaque flag, index 2 is transparent black */
+				if (!opaque && index == 2) {
+					texel[0] = texel[1] = texel[2] = texel[3] = 0;
+					continue;
+				}
+
+				if (usePaint) {
+					for (int c = 0; c < 3; ++c) texel[c] = clampByte(paint[index][c]);
+				}
+				else {
+					int subBlock = flip ? (y >= 2) : (x >= 2);
+					int modifier = (!opaque && index == 0) ? 0 : etcModifiers[tables[subBlock]][index];
+					for (int c = 0; c < 3; ++c) texel[c] = clampByte(colors[subBlock][c] + modifier);
+				}
+				texel[3] = 255;
+			}
+		}
+
+		void decodeEACAlpha(const uint8_t *block, Texels texels) {
+			uint64_t bits = readBigEndian(block);
+			int base = (int)(bits >> 56);
+			int multiplier = (int)((bits >> 52) & 15);
+			const int *modifiers = eacModifiers[(bits >> 48) & 15];
+			for (int i = 0; i < 16; ++i) {
+				int x = i / 4, y = i % 4;
+				texels[y * 4 + x][3] = clampByte(base + modifiers[(bits >> (45 - 3 * i)) & 7] * multiplier);
+			}
+		}
+
+		/* ASTC, following the LDR profile of the Khronos data format specification */
+
+		/* Reads bits least significant first, treating everything from end onwards as zero */
+		struct BitReader {
+			const uint8_t *data;
+			uint32_t position;
+			uint32_t end;
+
+			uint32_t read(uint32_t count) {
+				uint32_t value = 0;
+				for (uint32_t i = 0; i < count; ++i, ++position)
+					if (position < end && ((data[position >> 3] >> (position & 7)) & 1)) value |= 1u << i;
+				return value;
+			}
+		};
+
+		uint32_t readBits(const uint8_t *block, uint32_t position, uint32_t count) {
+			BitReader reader = { block, position, 128 };
+			return reader.read(count);
+		}
+
+		/* Integer sequence encodings, from 2 to 256 levels, as trits, quints and plain bits */
+		struct Encoding {
+			int trits, quints, bits;
+		};
+
+		const Encoding encodings[21] = {
+			{ 0, 0, 1 }, { 1, 0, 0 }, { 0, 0, 2 }, { 0, 1, 0 }, { 1, 0, 1 }, { 0, 0, 3 }, { 0, 1, 1 },
+			{ 1, 0, 2 }, { 0, 0, 4 }, { 0, 1, 2 }, { 1, 0, 3 }, { 0, 0, 5 }, { 0, 1, 3 }, { 1, 0, 4 },
+			{ 0, 0, 6 }, { 0, 1, 4 }, { 1, 0, 5 }, { 0, 0, 7 }, { 0, 1, 5 }, { 1, 0, 6 }, { 0, 0, 8 } };
+
+		uint32_t getSequenceBits(uint32_t count, int quantization) {
+			const Encoding &encoding = encodings[quantization];
+			uint32_t bits = count * encoding.bits;
+			if (encoding.trits) bits += (8 * count + 4) / 5;
+			if (encoding.quints) bits += (7 * count + 2) / 3;
+			return bits;
+		}
+
+		void decodeTrits(int T, int trits[5]) {
+			int C;
+			if (((T >> 2) & 7) == 7) {
+				C = (((T >> 5) & 7) << 2) | (T & 3);
+				trits[4] = 2;
+				trits[3] = 2;
+			}
+			else {
+				C = T & 31;
+				if (((T >> 5) & 3) == 3) {
+					trits[4] = 2;
+					trits[3] = (T >> 7) & 1;
+				}
+				else {
+					trits[4] = (T >> 7) & 1;
+					trits[3] = (T >> 5) & 3;
+				}
+			}
+
+			if ((C & 3) == 3) {
+				trits[2] = 2;
+				trits[1] = (C >> 4) & 1;
+				trits[0] = (((C >> 3) & 1) << 1) | (((C >> 2) & 1) & ~((C >> 3) & 1));
+			}
+			else if (((C >> 2) & 3) == 3) {
+				trits[2] = 2;
+				trits[1] = 2;
+				trits[0] = C & 3;
+			}
+			else {
+				trits[2] = (C >> 4) & 1;
+				trits[1] = (C >> 2) & 3;
+				trits[0] = (((C >> 1) & 1) << 1) | ((C & 1) & ~((C >> 1) & 1));
+			}
+		}
+
+		void decodeQuints(int Q, int quints[3]) {
+			if (((Q >> 1) & 3) == 3 && ((Q >> 5) & 3) == 0) {
+				quints[2] = ((Q & 1) << 2) | ((((Q >> 4) & 1) & ~(Q & 1)) << 1) | (((Q >> 3) & 1) & ~(Q & 1));
+				quints[1] = 4;
+				quints[0] = 4;
+				return;
+			}
+
+			int C;
+			if (((Q >> 1) & 3) == 3) {
+				quints[2] = 4;
+				C = (((Q >> 3) & 3) << 3) | ((~(Q >> 5) & 3) << 1) | (Q & 1);
+			}
+			else {
+				quints[2] = (Q >> 5) & 3;
+				C = Q & 31;
+			}
+
+			if ((C & 7) == 5) {
+				quints[1] = 4;
+				quints[0] = (C >> 3) & 3;
+			}
+			else {
+				quints[1] = (C >> 3) & 3;
+				quints[0] = C & 7;
+			}
+		}
+
+		/* Unpacks count values starting at bit start. Trits come in groups of five sharing 8 bits, and quints in
+			groups of three sharing 7, interleaved with each value's low bits. */
+		void decodeSequence(const uint8_t *data, uint32_t start, uint32_t count, int quantization, int *values) {
+			const Encoding &encoding = encodings[quantization];
+			BitReader reader = { data, start, start + getSequenceBits(count, quantization) };
+			int b = encoding.bits;
+
+			if (encoding.trits) {
+				for (uint32_t i = 0; i < count; i += 5) {
+					int low[5], T = 0, trits[5];
+					low[0] = reader.read(b); T |= reader.read(2);
+					low[1] = reader.read(b); T |= reader.read(2) << 2;
+					low[2] = reader.read(b); T |= reader.read(1) << 4;
+					low[3] = reader.read(b); T |= reader.read(2) << 5;
+					low[4] = reader.read(b); T |= reader.read(1) << 7;
+					decodeTrits(T, trits);
+					for (uint32_t j = 0; j < 5 && i + j < count; ++j) values[i + j] = (trits[j] << b) | low[j];
+				}
+			}
+			else if (encoding.quints) {
+				for (uint32_t i = 0; i < count; i += 3) {
+					int low[3], Q = 0, quints[3];
+					low[0] = reader.read(b); Q |= reader.read(3);
+					low[1] = reader.read(b); Q |= reader.read(2) << 3;
+					low[2] = reader.read(b); Q |= reader.read(2) << 5;
+					decodeQuints(Q, quints);
+					for (uint32_t j = 0; j < 3 && i + j < count; ++j) values[i + j] = (quints[j] << b) | low[j];
+				}
+			}
+			else {
+				for (uint32_t i = 0; i < count; ++i) values[i] = reader.read(b);
+			}
+		}
+
+		int replicateBits(int value, int bits, int toBits) {
+			if (bits == 0) return 0;
+			int result = 0;
+			for (int shift = toBits - bits; shift > -bits; shift -= bits)
+				result |= (shift >= 0) ? (value << shift) : (value >> -shift);
+			return result & ((1 << toBits) - 1);
+		}
+
+		/* Color endpoint values to 0 - 255 */
+		int unquantizeColor(int value, int quantization) {
+			const Encoding &encoding = encodings[quantization];
+			int b = encoding.bits;
+			if (!encoding.trits && !encoding.quints) return replicateBits(value, b, 8);
+
+			int D = value >> b, low = value & ((1 << b) - 1);
+			int A = (low & 1) ? 0x1FF : 0;
+			int B = 0, C = 0, x = low >> 1;
+			if (encoding.trits) {
+				switch (b) {
+				case 1: C = 204; break;
+				case 2: C = 93; B = (x << 8) | (x << 4) | (x << 2) | (x << 1); break;
+				case 3: C = 44; B = (x << 7) | (x << 2) | x; break;
+				case 4: C = 22; B = (x << 6) | x; break;
+				case 5: C = 11; B = (x << 5) | (x >> 2); break;
+				default: C = 5; B = (x << 4) | (x >> 4); break;
+				}
+			}
+			else {
+				switch (b) {
+				case 1: C = 113; break;
+				case 2: C = 54; B = (x << 8) | (x << 3) | (x << 2); break;
+				case 3: C = 26; B = (x << 7) | (x << 1) | (x >> 1); break;
+				case 4: C = 13; B = (x << 6) | (x >> 1); break;
+				default: C = 6; B = (x << 5) | (x >> 3); break;
+				}
+			}
+			int T = (D * C + B) ^ A;
+			return (A & 0x80) | (T >> 2);
+		}
+
+		/* Weights to 0 - 64 */
+		int unquantizeWeight(int value, int quantization) {
+			const Encoding &encoding = encodings[quantization];
+			int b = encoding.bits;
+			int result;
+			if (!encoding.trits && !encoding.quints) {
+				result = replicateBits(value, b, 6);
+			}
+			else if (b == 0) {
+				const int tritLevels[3] = { 0, 32, 63 }, quintLevels[5] = { 0, 16, 32, 47, 63 };
+				result = encoding.trits ? tritLevels[value] : quintLevels[value];
+			}
+			else {
+				int D = value >> b, low = value & ((1 << b) - 1);
+				int A = (low & 1) ? 0x7F : 0;
+				int B = 0, C, x = low >> 1;
+				if (encoding.trits) {
+					if (b == 1) C = 50;
+					else if (b == 2) { C = 23; B = (x << 6) | (x << 2) | x; }
+					else { C = 11; B = (x << 5) | x; }
+				}
+				else {
+					if (b == 1) C = 28;
+					else { C = 13; B = (x << 6) | (x << 1); }
+				}
+				int T = (D * C + B) ^ A;
+				result = (A & 0x20) | (T >> 2);
+			}
+			return (result > 32) ? result + 1 : result;
+		}
+
+		struct BlockMode {
+			uint32_t width, height;
+			bool dualPlane;
+			int quantization;
+		};
+
+		bool decodeBlockMode(uint32_t mode, BlockMode &blockMode) {
+			uint32_t range = (mode >> 4) & 1;
+			bool highPrecision = (mode >> 9) & 1;
+			bool dualPlane = (mode >> 10) & 1;
+			uint32_t A = (mode >> 5) & 3, B;
+
+			if (mode & 3) {
+				range |= (mode & 3) << 1;
+				B = (mode >> 7) & 3;
+				switch ((mode >> 2) & 3) {
+				case 0: blockMode.width = B + 4; blockMode.height = A + 2; break;
+				case 1: blockMode.width = B + 8; blockMode.height = A + 2; break;
+				case 2: blockMode.width = A + 2; blockMode.height = B + 8; break;
+				default:
+					B &= 1;
+					if (mode & 0x100) { blockMode.width = B + 2; blockMode.height = A + 2; }
+					else { blockMode.width = A + 2; blockMode.height = B + 6; }
+					break;
+				}
+			}
+			else {
+				range |= ((mode >> 2) & 3) << 1;
+				if (((mode >> 2) & 3) == 0) return false;
+				B = (mode >> 9) & 3;
+				switch ((mode >> 7) & 3) {
+				case 0: blockMode.width = 12; blockMode.height = A + 2; break;
+				case 1: blockMode.width = A + 2; blockMode.height = 12; break;
+				case 2:
+					blockMode.width = A + 6; blockMode.height = B + 6;
+					dualPlane = false; highPrecision = false;
+					break;
+				default:
+					if (A == 0) { blockMode.width = 6; blockMode.height = 10; }
+					else if (A == 1) { blockMode.width = 10; blockMode.height = 6; }
+					else return false;
+					break;
+				}
+			}
+
+			blockMode.dualPlane = dualPlane;
+			blockMode.quantization = (int)(range - 2) + (highPrecision ? 6 : 0);
+			return true;
+		}
+
+		/* Picks the partition of a texel from a hash of the block's partition index */
+		uint32_t selectPartition(uint32_t seed, uint32_t x, uint32_t y, uint32_t partitionCount, bool smallBlock) {
+			if (smallBlock) {
+				x <<= 1;
+				y <<= 1;
+			}
+			seed += (partitionCount - 1) * 1024;
+
+			uint32_t hash = seed;
+			hash ^= hash >> 15;
+			hash *= 0xEEDE0891;
+			hash ^= hash >> 5;
+			hash += hash << 16;
+			hash ^= hash >> 7;
+			hash ^= hash >> 3;
+			hash ^= hash << 6;
+			hash ^= hash >> 17;
+
+			uint32_t seeds[8];
+			for (int i = 0; i < 8; ++i) {
+				seeds[i] = (hash >> (4 * i)) & 15;
+				seeds[i] *= seeds[i];
+			}
+			int shift1, shift2;
+			if (seed & 1) {
+				shift1 = (seed & 2) ? 4 : 5;
+				shift2 = (partitionCount == 3) ? 6 : 5;
+			}
+			else {
+				shift1 = (partitionCount == 3) ? 6 : 5;
+				shift2 = (seed & 2) ? 4 : 5;
+			}
+			for (int i = 0; i < 8; ++i) seeds[i] >>= (i & 1) ? shift2 : shift1;
+
+			/* The z terms of the hash drop out for 2D blocks */
+			uint32_t a = (seeds[0] * x + seeds[1] * y + (hash >> 14)) & 63;
+			uint32_t b = (seeds[2] * x + seeds[3] * y + (hash >> 10)) & 63;
+			uint32_t c = (partitionCount < 3) ? 0 : (seeds[4] * x + seeds[5] * y + (hash >> 6)) & 63;
+			uint32_t d = (partitionCount < 4) ? 0 : (seeds[6] * x + seeds[7] * y + (hash >> 2)) & 63;
+
+			if (a >= b && a >= c && a >= d) return 0;
+			if (b >= c && b >= d) return 1;
+			if (c >= d) return 2;
+			return 3;
+		}
+
+		/* Moves the top bit of the base into the offset, leaving a signed 6 bit offset */
+		void transferBits(int &offset, int &base) {
+			base = (base >> 1) | (offset & 0x80);
+			offset = (offset >> 1) & 0x3F;
+			if (offset & 0x20) offset -= 0x40;
+		}
+
+		void blueContract(int color[4]) {
+			color[0] = (color[0] + color[2]) >> 1;
+			color[1] = (color[1] + color[2]) >> 1;
+		}
+
+		/* Returns false for the HDR endpoint modes, which the LDR profile treats as errors */
+		bool decodeEndpoints(uint32_t mode, int *v, int e0[4], int e1[4]) {
+			auto set = [](int e[4], int r, int g, int b, int a) { e[0] = r; e[1] = g; e[2] = b; e[3] = a; };
+			switch (mode) {
+			case 0:
+				set(e0, v[0], v[0], v[0], 255);
+				set(e1, v[1], v[1], v[1], 255);
+				break;
+			case 1: {
+				int l0 = (v[0] >> 2) | (v[1] & 0xC0);
+				int l1 = std::min(255, l0 + (v[1] & 0x3F));
+				set(e0, l0, l0, l0, 255);
+				set(e1, l1, l1, l1, 255);
+				break;
+			}
+			case 4:
+				set(e0, v[0], v[0], v[0], v[2]);
+				set(e1, v[1], v[1], v[1], v[3]);
+				break;
+			case 5:
+				transferBits(v[1], v[0]);
+				transferBits(v[3], v[2]);
+				set(e0, v[0], v[0], v[0], v[2]);
+				set(e1, v[0] + v[1], v[0] + v[1], v[0] + v[1], v[2] + v[3]);
+				break;
+			case 6:
+				set(e0, (v[0] * v[3]) >> 8, (v[1] * v[3]) >> 8, (v[2] * v[3]) >> 8, 255);
+				set(e1, v[0], v[1], v[2], 255);
+				break;
+			case 8:
+			case 12: {
+				int a0 = (mode == 12) ? v[6] : 255, a1 = (mode == 12) ? v[7] : 255;
+				if (v[1] + v[3] + v[5] >= v[0] + v[2] + v[4]) {
+					set(e0, v[0], v[2], v[4], a0);
+					set(e1, v[1], v[3], v[5], a1);
+				}
+				else {
+					set(e0, v[1], v[3], v[5], a1);
+					set(e1, v[0], v[2], v[4], a0);
+					blueContract(e0);
+					blueContract(e1);
+				}
+				break;
+			}
+			case 9:
+			case 13: {
+				transferBits(v[1], v[0]);
+				transferBits(v[3], v[2]);
+				transferBits(v[5], v[4]);
+				int a0 = 255, a1 = 255;
+				if (mode == 13) {
+					transferBits(v[7], v[6]);
+					a0 = v[6];
+					a1 = v[6] + v[7];
+				}
+				if (v[1] + v[3] + v[5] >= 0) {
+					set(e0, v[0], v[2], v[4], a0);
+					set(e1, v[0] + v[1], v[2] + v[3], v[4] + v[5], a1);
+				}
+				else {
+					set(e0, v[0] + v[1], v[2] + v[3], v[4] + v[5], a1);
+					set(e1, v[0], v[2], v[4], a0);
+					blueContract(e0);
+					blueContract(e1);
+				}
+				break;
+			}
+			case 10:
+				set(e0, (v[0] * v[3]) >> 8, (v[1] * v[3]) >> 8, (v[2] * v[3]) >> 8, v[4]);
+				set(e1, v[0], v[1], v[2], v[5]);
+				break;
+			default:
+				return false;
+			}
+
+			for (int c = 0; c < 4; ++c) {
+				e0[c] = std::min(255, std::max(0, e0[c]));
+				e1[c] = std::min(255, std::max(0, e1[c]));
+			}
+			return true;
+		}
+
+		void fillBlock(const uint8_t color[4], uint32_t count, Texels texels) {
+			for (uint32_t i = 0; i < count; ++i) memcpy(texels[i], color, 4);
+		}
+
+		void decodeASTC(const uint8_t *block, uint32_t blockWidth, uint32_t blockHeight, bool srgb, Texels texels) {
+			uint32_t texelCount = blockWidth * blockHeight;
+			uint32_t mode = readBits(block, 0, 11);
+
+			/* Void extent blocks hold one 16 bit per channel color for the whole block */
+			if ((mode & 0x1FF) == 0x1FC) {
+				if (mode & 0x200) return fillBlock(errorColor, texelCount, texels);
+				uint8_t color[4];
+				for (int c = 0; c < 4; ++c) color[c] = (uint8_t)(readBits(block, 64 + 16 * c, 16) >> 8);
+				return fillBlock(color, texelCount, texels);
+			}
+
+			BlockMode blockMode;
+			if (!decodeBlockMode(mode, blockMode) || blockMode.width > blockWidth || blockMode.height > blockHeight)
+				return fillBlock(errorColor, texelCount, texels);
+
+			uint32_t planes = blockMode.dualPlane ? 2 : 1;
+			uint32_t weightCount = blockMode.width * blockMode.height * planes;
+			uint32_t weightBits = getSequenceBits(weightCount, blockMode.quantization);
+			uint32_t partitionCount = readBits(block, 11, 2) + 1;
+			if (weightCount > 64 || weightBits < 24 || weightBits > 96 || (partitionCount == 4 && blockMode.dualPlane))
+				return fillBlock(errorColor, texelCount, texels);
+
+			/* Endpoint modes, either one for the block or one per partition. When partitions differ, the extra mode
+				bits sit just below the weights. */
+			uint32_t endpointModes[4];
+			uint32_t partitionIndex = 0, colorStart;
+			uint32_t belowWeights = 128 - weightBits;
+			if (partitionCount == 1) {
+				endpointModes[0] = readBits(block, 13, 4);
+				colorStart = 17;
+			}
+			else {
+				partitionIndex = readBits(block, 13, 10);
+				uint32_t encoded = readBits(block, 23, 6);
+				colorStart = 29;
+				if ((encoded & 3) == 0) {
+					for (uint32_t p = 0; p < partitionCount; ++p) endpointModes[p] = encoded >> 2;
+				}
+				else {
+					uint32_t extraBits = 3 * partitionCount - 4;
+					belowWeights -= extraBits;
+					encoded |= readBits(block, belowWeights, extraBits) << 6;
+					uint32_t baseClass = (encoded & 3) - 1;
+					encoded >>= 2;
+					for (uint32_t p = 0; p < partitionCount; ++p) {
+						endpointModes[p] = (((encoded >> p) & 1) + baseClass) << 2;
+						endpointModes[p] |= (encoded >> (partitionCount + 2 * p)) & 3;
+					}
+				}
+			}
+
+			uint32_t dualChannel = 0;
+			if (blockMode.dualPlane) {
+				belowWeights -= 2;
+				dualChannel = readBits(block, belowWeights, 2);
+			}
+
+			/* Endpoints use the finest quantization that fits between the header and the weights */
+			uint32_t colorCount = 0;
+			for (uint32_t p = 0; p < partitionCount; ++p) colorCount += ((endpointModes[p] >> 2) + 1) * 2;
+			if (colorCount > 18 || belowWeights <= colorStart) return fillBlock(errorColor, texelCount, texels);
+			int colorQuantization = 20;
+			while (colorQuantization >= 0 && getSequenceBits(colorCount, colorQuantization) > belowWeights - colorStart)
+				colorQuantization--;
+			if (colorQuantization < 4) return fillBlock(errorColor, texelCount, texels);
+
+			int colorValues[18];
+			decodeSequence(block, colorStart, colorCount, colorQuantization, colorValues);
+			for (uint32_t i = 0; i < colorCount; ++i) colorValues[i] = unquantizeColor(colorValues[i], colorQuantization);
+
+			int endpoints[4][2][4];
+			for (uint32_t p = 0, offset = 0; p < partitionCount; ++p) {
+				if (!decodeEndpoints(endpointModes[p], colorValues + offset, endpoints[p][0], endpoints[p][1]))
+					return fillBlock(errorColor, texelCount, texels);
+				offset += ((endpointModes[p] >> 2) + 1) * 2;
+			}
+
+			/* Weights are stored from the top of the block down, bit reversed */
+			uint8_t reversed[16];
+			for (int i = 0; i < 16; ++i) {
+				uint8_t byte = block[15 - i], flipped = 0;
+				for (int bit = 0; bit < 8; ++bit) flipped |= ((byte >> bit) & 1) << (7 - bit);
+				reversed[i] = flipped;
+			}
+			int weightValues[64];
+			decodeSequence(reversed, 0, weightCount, blockMode.quantization, weightValues);
+
+			/* Planes are interleaved. Padding past the grid lets the infill read its neighbours unchecked. */
+			int grid[2][96] = {};
+			for (uint32_t i = 0; i < weightCount; ++i)
+				grid[i % planes][i / planes] = unquantizeWeight(weightValues[i], blockMode.quantization);
+
+			/* Bilinearly infill the weight grid to the block's footprint */
+			int scaleX = (1024 + blockWidth / 2) / (blockWidth - 1);
+			int scaleY = (1024 + blockHeight / 2) / (blockHeight - 1);
+			bool smallBlock = texelCount < 31;
+			for (uint32_t y = 0; y < blockHeight; ++y) {
+				for (uint32_t x = 0; x < blockWidth; ++x) {
+					int gridX = (scaleX * x * (blockMode.width - 1) + 32) >> 6;
+					int gridY = (scaleY * y * (blockMode.height - 1) + 32) >> 6;
+					int fractionX = gridX & 15, fractionY = gridY & 15;
+					int index = (gridX >> 4) + (gridY >> 4) * blockMode.width;
+					int w11 = (fractionX * fractionY + 8) >> 4;
+					int w10 = fractionY - w11, w01 = fractionX - w11, w00 = 16 - fractionX - fractionY + w11;
+
+					int weights[2];
+					for (uint32_t plane = 0; plane < planes; ++plane) {
+						const int *g = grid[plane];
+						weights[plane] = (g[index] * w00 + g[index + 1] * w01 + g[index + blockMode.width] * w10
+							+ g[index + blockMode.width + 1] * w11 + 8) >> 4;
+					}
+
+					uint32_t partition = (partitionCount > 1) ? selectPartition(partitionIndex, x, y, partitionCount, smallBlock) : 0;
+					uint8_t *texel = texels[y * blockWidth + x];
+					for (int c = 0; c < 4; ++c) {
+						/* Endpoints are expanded to 16 bits before interpolating */
+						int e0 = endpoints[partition][0][c], e1 = endpoints[partition][1][c];
+						e0 = srgb ? ((e0 << 8) | 0x80) : e0 * 257;
+						e1 = srgb ? ((e1 << 8) | 0x80) : e1 * 257;
+						int weight = (blockMode.dualPlane && (uint32_t)c == dualChannel) ? weights[1] : weights[0];
+						int value = (e0 * (64 - weight) + e1 * weight + 32) >> 6;
+
+						/* sRGB keeps the top 8 bits, while UNORM rounds to the nearest 8 bit value */
+						texel[c] = (uint8_t)(srgb ? (value >> 8) : (value * 255 + 32767) / 65535);
+					}
+				}
+			}
+		}
+
+		void decodeBlock(const BlockInfo &info, const uint8_t *block, Texels texels) {
+			switch (info.codec) {
+			case Codec::BC1: decodeBC1(block, false, false, texels); break;
+			case Codec::BC1A: decodeBC1(block, true, false, texels); break;
+			case Codec::BC2:
+				decodeBC1(block + 8, false, true, texels);
+				for (int i = 0; i < 16; ++i) texels[i][3] = (uint8_t)(((block[i / 2] >> (4 * (i & 1))) & 15) * 17);
+				break;
+			case Codec::BC3:
+				decodeBC1(block + 8, false, true, texels);
+				decodeBCChannel(block, 3, texels);
+				break;
+			case Codec::BC4:
+			case Codec::BC5:
+				for (int i = 0; i < 16; ++i) {
+					texels[i][1] = texels[i][2] = 0;
+					texels[i][3] = 255;
+				}
+				decodeBCChannel(block, 0, texels);
+				if (info.codec == Codec::BC5) decodeBCChannel(block + 8, 1, texels);
+				break;
+			case Codec::ETC2: decodeETC2(block, false, texels); break;
+			case Codec::ETC2A1: decodeETC2(block, true, texels); break;
+			case Codec::ETC2A8:
+				decodeETC2(block + 8, false, texels);
+				decodeEACAlpha(block, texels);
+				break;
+			case Codec::ASTC: decodeASTC(block, info.width, info.height, info.srgb, texels); break;
+			}
+		}
+
+		/* Decodes one image's blocks to tightly packed RGBA8 pixels, spreading rows of blocks over every core */
+		void decodeImage(const BlockInfo &info, const uint8_t *blocks, uint32_t width, uint32_t height, uint8_t *pixels) {
+			uint32_t blocksX = (width + info.width - 1) / info.width, blocksY = (height + info.height - 1) / info.height;
+
+			uint32_t workerCount = std::max(1u, std::min(std::thread::hardware_concurrency(), blocksY));
+			uint32_t rowsPerWorker = (blocksY + workerCount - 1) / workerCount;
+			std::vector<std::future<void>> workers;
+			for (uint32_t first = 0; first < blocksY; first += rowsPerWorker) {
+				uint32_t last = std::min(blocksY, first + rowsPerWorker);
+				workers.push_back(std::async(std::launch::async, [=, &info]() {
+					Texels texels;
+					for (uint32_t by = first; by < last; ++by) {
+						for (uint32_t bx = 0; bx < blocksX; ++bx) {
+							decodeBlock(info, blocks + ((size_t)by * blocksX + bx) * info.size, texels);
+
+							/* Blocks hanging over the edge of the image are cropped */
+							for (uint32_t y = 0; y < info.height && by * info.height + y < height; ++y) {
+								uint32_t columns = std::min(info.width, width - bx * info.width);
+								memcpy(pixels + ((size_t)(by * info.height + y) * width + bx * info.width) * 4,
+									texels[y * info.width], columns * 4);
+							}
+						}
+					}
+				}));
+			}
+			for (auto &worker : workers) worker.get();
+		}
+
+		VkFormat getEncodedFormat(BlockCompressor::Format format, bool srgb) {
+			if (!srgb) return BlockCompressor::GetVkFormat(format);
+			switch (format) {
+			case BlockCompressor::Format::BC1: return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+			case BlockCompressor::Format::BC3: return VK_FORMAT_BC3_SRGB_BLOCK;
+			default: return VK_FORMAT_BC7_SRGB_BLOCK;
+			}
+		}
+
+		bool getModifiedTime(std::string path, time_t &time) {
+			struct stat st;
+			if (stat(path.c_str(), &st) != 0) return false;
+			time = st.st_mtime;
+			return true;
+		}
+
+		bool sameShape(const gli::texture &a, const gli::texture &b) {
+			return a.target() == b.target() && a.extent() == b.extent() && a.layers() == b.layers()
+				&& a.faces() == b.faces() && a.levels() == b.levels();
+		}
+	}
+
+	bool TextureTranscoder::IsSupported(VkFormat format) {
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(VKDK::physicalDevice, format, &formatProperties);
+		return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+	}
+
+	bool TextureTranscoder::CanDecode(VkFormat format) {
+		BlockInfo info;
+		return getBlockInfo(format, info);
+	}
+
+	gli::texture TextureTranscoder::Decode(const gli::texture &texture) {
+		BlockInfo info;
+		if (texture.empty() || !getBlockInfo((VkFormat)texture.format(), info)) return gli::texture();
+
+		gli::texture decoded(texture.target(), info.srgb ? gli::FORMAT_RGBA8_SRGB_PACK8 : gli::FORMAT_RGBA8_UNORM_PACK8,
+			texture.extent(), texture.layers(), texture.faces(), texture.levels());
+
+		for (size_t layer = 0; layer < texture.layers(); ++layer) {
+			for (size_t face = 0; face < texture.faces(); ++face) {
+				for (size_t level = 0; level < texture.levels(); ++level) {
+					auto extent = texture.extent(level);
+					size_t sliceBlocks = texture.size(level) / extent.z;
+					size_t slicePixels = (size_t)extent.x * extent.y * 4;
+					for (int z = 0; z < extent.z; ++z) {
+						decodeImage(info, (const uint8_t*)texture.data(layer, face, level) + z * sliceBlocks,
+							(uint32_t)extent.x, (uint32_t)extent.y, (uint8_t*)decoded.data(layer, face, level) + z * slicePixels);
+					}
+				}
+			}
+		}
+		return decoded;
+	}
+
+	bool TextureTranscoder::Transcode(const gli::texture &texture, std::string imagePath, gli::texture &result) {
+		BlockInfo info;
+		if (texture.empty() || !getBlockInfo((VkFormat)texture.format(), info)) return false;
+
+		const BlockCompressor::Format formats[] = { BlockCompressor::Format::BC7, BlockCompressor::Format::BC3, BlockCompressor::Format::BC1 };
+
+		/* Use the cache if it's at least as new as the source */
+		time_t sourceTime;
+		bool cacheable = getModifiedTime(imagePath, sourceTime);
+		for (auto format : formats) {
+			std::string cachePath = BlockCompressor::GetCachePath(imagePath, format);
+			time_t cacheTime;
+			if (!cacheable || !BlockCompressor::IsSupported(format) || !getModifiedTime(cachePath, cacheTime) || cacheTime < sourceTime) continue;
+
+			gli::texture cached = gli::load(cachePath);
+			if (cached.empty() || (VkFormat)cached.format() != getEncodedFormat(format, info.srgb) || !sameShape(cached, texture)) continue;
+			result = cached;
+			return true;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		gli::texture decoded = Decode(texture);
+
+		/* Any transparent texel in the first level of any face rules out BC1 */
+		bool opaque = true;
+		for (size_t layer = 0; layer < decoded.layers() && opaque; ++layer) {
+			for (size_t face = 0; face < decoded.faces() && opaque; ++face) {
+				auto pixels = (const uint8_t*)decoded.data(layer, face, 0);
+				for (size_t i = 3; i < decoded.size(0) && opaque; i += 4) opaque = pixels[i] == 255;
+			}
+		}
+
+		BlockCompressor::Format format;
+		if (opaque && BlockCompressor::IsSupported(BlockCompressor::Format::BC1)) format = BlockCompressor::Format::BC1;
+		else if (BlockCompressor::IsSupported(BlockCompressor::Format::BC7)) format = BlockCompressor::Format::BC7;
+		else if (BlockCompressor::IsSupported(BlockCompressor::Format::BC3)) format = BlockCompressor::Format::BC3;
+		else {
+			/* RGBA8 can always be sampled, but isn't worth caching */
+			result = decoded;
+			auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+			std::cout << "TextureTranscoder: Decoded " << imagePath << " to RGBA8 in " << milliseconds << "ms" << std::endl;
+			return true;
+		}
+
+		/* Every image keeps its own level, rather than BlockCompressor building a new mip chain */
+		gli::texture encoded(texture.target(), (gli::format)getEncodedFormat(format, info.srgb), texture.extent(),
+			texture.layers(), texture.faces(), texture.levels());
+		for (size_t layer = 0; layer < texture.layers(); ++layer) {
+			for (size_t face = 0; face < texture.faces(); ++face) {
+				for (size_t level = 0; level < texture.levels(); ++level) {
+					auto extent = decoded.extent(level);
+					size_t slicePixels = (size_t)extent.x * extent.y * 4;
+					size_t sliceBlocks = encoded.size(level) / extent.z;
+					for (int z = 0; z < extent.z; ++z) {
+						gli::texture2d slice = BlockCompressor::Encode((const uint8_t*)decoded.data(layer, face, level) + z * slicePixels,
+							(uint32_t)extent.x, (uint32_t)extent.y, format, false);
+						memcpy((uint8_t*)encoded.data(layer, face, level) + z * sliceBlocks, slice.data(), sliceBlocks);
+					}
+				}
+			}
+		}
+		result = encoded;
+		auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+		if (!cacheable) return true;
+		std::string cachePath = BlockCompressor::GetCachePath(imagePath, format);
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if (gli::save_ktx(encoded, cachePath))
+			std::cout << "TextureTranscoder: Transcoded " << imagePath << " to " << cachePath << " in " << milliseconds << "ms" << std::endl;
+		else
+			std::cout << "TextureTranscoder: Couldn't write " << cachePath << std::endl;
+		return true;
+	}
+}
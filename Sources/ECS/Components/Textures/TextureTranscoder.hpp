@@ -0,0 +1,34 @@
+#pragma once
+
+#include "vkdk.hpp"
+
+#include <gli/gli.hpp>
+
+#include <string>
+
+namespace Components::Textures {
+	/* Lets KTX textures in block compressed formats the device can't sample load anyway, so that one copy of an asset
+		works everywhere. Blocks are decoded on the CPU, from ETC2 (RGB, punch-through alpha and EAC alpha), ASTC LDR in
+		every 2D block size, or BC1 to BC5. The texels are then re-encoded by BlockCompressor, as BC1 when opaque and BC7
+		or BC3 otherwise, or left as RGBA8 on devices without BC support. Levels, faces and layers carry over as they are.
+
+		Transcode keeps BC results next to the source as a KTX file, named like BlockCompressor's caches (for example
+		cubemap_etc2_unorm.ktx is cached as cubemap_etc2_unorm.bc1.ktx), and reuses it for as long as it's newer than
+		the source. Blocks are decoded on every core. */
+	class TextureTranscoder {
+	public:
+		/* True if the device can sample textures of the given format */
+		static bool IsSupported(VkFormat format);
+
+		/* True if Decode understands blocks of the given format */
+		static bool CanDecode(VkFormat format);
+
+		/* Decodes every image of a block compressed texture to RGBA8, sRGB if the source is. Returns an empty texture
+			if CanDecode rejects the format. */
+		static gli::texture Decode(const gli::texture &texture);
+
+		/* Converts a texture to a format the device can sample. imagePath is the file it was loaded from, which names
+			the cache. Returns false if the texture's format can't be decoded. */
+		static bool Transcode(const gli::texture &texture, std::string imagePath, gli::texture &result);
+	};
+}
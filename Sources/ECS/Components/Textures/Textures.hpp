@@ -6,6 +6,7 @@
 #include "Texture2D.hpp"
 #include "Texture3D.hpp"
 #include "TextureCube.hpp"
+#include "SparseVoxelOctree.hpp"
 
 #include "RenderableTexture2D.hpp"
 #include "RenderableTextureCube.hpp"
\ No newline at end of file
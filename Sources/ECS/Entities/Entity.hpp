@@ -13,11 +13,14 @@
 #include <memory>
 #include <string>
 #include <typeindex>
+#include <algorithm>
 
 #include "Systems/ComponentManager.hpp"
 #include "Systems/SceneGraph.hpp"
 #include "Components/Math/Transform.hpp"
 #include "Components/Math/Perspective.hpp"
+#include "Components/Meshes/Mesh.hpp"
+#include "Components/Materials/Material.hpp"
 #include "Components/Callbacks/Callbacks.hpp"
 #include "vkdk.hpp"
 
@@ -32,7 +35,8 @@ namespace Entities {
 		/* Used as a key within it's parent's children */
 		std::string name;
 
-		/* If an entity isn't active, its callbacks arent called */
+		/* If an entity isn't active, its callbacks arent called, and neither it nor its children are drawn.
+			Use setActive, so that perspectives know to re-record. */
 		bool active = true;
 
 		std::shared_ptr<Entity> parent = nullptr;
@@ -45,10 +49,21 @@ namespace Entities {
 
 		std::map<std::type_index, std::vector<std::shared_ptr<Component>>> components;
 
+		/* World space bounds of this entity's mesh, updated along with the transform UBO */
+		bool hasBounds = false;
+		glm::vec3 worldAABBMin = glm::vec3(0.0);
+		glm::vec3 worldAABBMax = glm::vec3(0.0);
+		glm::vec3 worldSphereCenter = glm::vec3(0.0);
+		float worldSphereRadius = 0.0;
+
+		/* The local to world matrix the bounds were last computed with */
+		glm::mat4 boundsLocalToWorld = glm::mat4(1.0);
+
 		/* To add an additional component, use this */
 		template <typename T>
 		void addComponent(T component) {
 			components[std::type_index(typeid(*component))].push_back(component);
+			markDirty();
 		}
 
 		/* Variadic template for adding multiple components simultaneously */
@@ -58,6 +73,19 @@ namespace Entities {
 			addComponent(args...);
 		}
 
+		/* Detaches a component previously added to this entity */
+		template <typename T>
+		void removeComponent(T component) {
+			auto componentSet = components.find(std::type_index(typeid(*component)));
+			if (componentSet == components.end()) return;
+
+			/* Mark before removing, so the passes of a removed material are still found */
+			markDirty();
+			auto &set = componentSet->second;
+			set.erase(std::remove(set.begin(), set.end(), std::static_pointer_cast<Component>(component)), set.end());
+			if (set.empty()) components.erase(componentSet);
+		}
+
 		/* To retrieve an additional component, use this */
 		template <typename T>
 		std::shared_ptr<T> getFirstComponent()
@@ -95,6 +123,15 @@ namespace Entities {
 			return entity;
 		}
 
+		/* Removes an entity from the scene graph, and detaches it from its parent */
+		static void Remove(std::string name) {
+			auto entity = Systems::SceneGraph::Entities.find(name);
+			if (entity == Systems::SceneGraph::Entities.end()) return;
+			entity->second->markDirty(true);
+			if (entity->second->parent) entity->second->parent->removeChild(entity->second);
+			Systems::SceneGraph::Entities.erase(entity);
+		}
+
 		Entity(std::string name) : enable_shared_from_this() {
 			this->name = name;
 			transform = Components::Math::Transform::Create(name);
@@ -104,15 +141,41 @@ namespace Entities {
 		void setParent(std::shared_ptr<Entity> parent) {
 			this->parent = parent;
 			parent->children[name] = shared_from_this();
+			markDirty(true);
 		}
 
 		void addChild(std::shared_ptr<Entity> object) {
 			children[object->name] = object;
 			children[object->name]->parent = shared_from_this();
+			object->markDirty(true);
 		}
 
 		void removeChild(std::shared_ptr<Entity> object) {
 			children.erase(object->name);
+			object->markDirty(true);
+		}
+
+		void setActive(bool active) {
+			if (this->active == active) return;
+			this->active = active;
+			markDirty(true);
+		}
+
+		/* Returns false if this entity or any of its parents are inactive */
+		bool isActive() {
+			for (auto entity = this; entity != nullptr; entity = entity->parent.get())
+				if (!entity->active) return false;
+			return true;
+		}
+
+		/* Tells perspectives drawing this entity's materials that their recorded commands are stale */
+		void markDirty(bool includeChildren = false) {
+			for (auto material : getComponents<Components::Materials::Material>())
+				if (material->material) Systems::SceneGraph::MarkDirty(material->material->getPipelineKey().renderpass);
+
+			if (!includeChildren) return;
+			for (auto &child : children)
+				child.second->markDirty(true);
 		}
 
 		glm::mat4 getWorldToLocalMatrix() {
@@ -127,6 +190,34 @@ namespace Entities {
 		glm::mat4 getLocalToWorldMatrix() {
 			return glm::inverse(getWorldToLocalMatrix());
 		}
+
+		/* Transforms the bounds of this entity's mesh into world space */
+		void updateWorldBounds(glm::mat4 localToWorld) {
+			boundsLocalToWorld = localToWorld;
+			auto meshComponent = getFirstComponent<Components::Meshes::Mesh>();
+			if (!meshComponent) {
+				hasBounds = false;
+				return;
+			}
+
+			/* Transform the box's center, and project its extent onto each world axis */
+			glm::vec3 localMin = meshComponent->mesh->getAABBMin();
+			glm::vec3 localMax = meshComponent->mesh->getAABBMax();
+			glm::vec3 center = glm::vec3(localToWorld * glm::vec4((localMin + localMax) * 0.5f, 1.0));
+			glm::vec3 extent = (localMax - localMin) * 0.5f;
+			glm::mat3 absolute = glm::mat3(localToWorld);
+			for (int i = 0; i < 3; ++i) absolute[i] = glm::abs(absolute[i]);
+			glm::vec3 worldExtent = absolute * extent;
+			worldAABBMin = center - worldExtent;
+			worldAABBMax = center + worldExtent;
+
+			/* Spheres grow by the largest axis scale */
+			float maxScale = glm::max(glm::length(glm::vec3(localToWorld[0])),
+				glm::max(glm::length(glm::vec3(localToWorld[1])), glm::length(glm::vec3(localToWorld[2]))));
+			worldSphereCenter = glm::vec3(localToWorld * glm::vec4(meshComponent->mesh->getBoundingSphereCenter(), 1.0));
+			worldSphereRadius = meshComponent->mesh->getBoundingSphereRadius() * maxScale;
+			hasBounds = true;
+		}
 	};
 }
 
@@ -0,0 +1,106 @@
+#include "AssetRegistry.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Systems::AssetRegistry {
+	struct Entry {
+		std::shared_ptr<void> asset;
+		uint32_t references = 0;
+	};
+
+	static std::mutex mutex;
+	static bool contentHashing = false;
+
+	/* Keyed by canonical path and options, or by content hash and options with content hashing on */
+	static std::unordered_map<std::string, Entry> entries;
+
+	/* Canonical path and options to the entry key its contents hashed to */
+	static std::unordered_map<std::string, std::string> keysByPath;
+
+	/* FNV-1a over the file's bytes. Returns false if the file can't be read. */
+	static bool HashFile(const std::string &path, uint64_t &hash) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) return false;
+
+		hash = 14695981039346656037ull;
+		std::vector<char> buffer(1 << 16);
+		while (file) {
+			file.read(buffer.data(), buffer.size());
+			for (std::streamsize i = 0; i < file.gcount(); ++i) {
+				hash ^= (uint8_t)buffer[i];
+				hash *= 1099511628211ull;
+			}
+		}
+		return true;
+	}
+
+	std::shared_ptr<void> Acquire(std::string path, std::string options, std::string &key) {
+		std::error_code error;
+		auto canonical = std::filesystem::weakly_canonical(path, error);
+		std::string pathKey = (error ? path : canonical.generic_string()) + "|" + options;
+
+		bool hashContents;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			hashContents = contentHashing;
+			auto known = keysByPath.find(pathKey);
+			if (known != keysByPath.end()) {
+				key = known->second;
+				auto entry = entries.find(key);
+				if (entry != entries.end()) {
+					entry->second.references++;
+					return entry->second.asset;
+				}
+			}
+		}
+
+		/* Hash outside the lock, since files can be large. Files which can't be read are keyed by path alone. */
+		uint64_t hash;
+		if (hashContents && HashFile(path, hash)) {
+			char hex[17];
+			snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+			key = std::string(hex) + "|" + options;
+		}
+		else key = pathKey;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		keysByPath[pathKey] = key;
+		auto entry = entries.find(key);
+		if (entry == entries.end()) return nullptr;
+		entry->second.references++;
+		return entry->second.asset;
+	}
+
+	void SetContentHashing(bool enabled) {
+		std::lock_guard<std::mutex> lock(mutex);
+		contentHashing = enabled;
+	}
+
+	std::shared_ptr<void> Add(std::string key, std::shared_ptr<void> asset) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto &entry = entries[key];
+		if (!entry.asset) entry.asset = asset;
+		entry.references++;
+		return entry.asset;
+	}
+
+	bool Release(std::string key) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto entry = entries.find(key);
+		if (entry == entries.end()) return true;
+		if (--entry->second.references > 0) return false;
+		entries.erase(entry);
+
+		/* Files may change before they're loaded again, so forget what they hashed to */
+		for (auto path = keysByPath.begin(); path != keysByPath.end();) {
+			if (path->second == key) path = keysByPath.erase(path);
+			else ++path;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+/* Shares assets loaded from files between the components created from them, so that asking for the same texture or
+	mesh under another name costs a lookup rather than another load and upload.
+
+	Assets are keyed by the canonical path of their file plus the options they were loaded with. With content hashing
+	on, they're keyed by a hash of the file's contents instead, so a copy of a file under another path is shared too.
+	Each component holding an asset holds one
+	reference, and the asset should only be cleaned up once Release says the last one is gone. Safe to use from any
+	thread, though loads racing for the same key may both run, with the loser cleaned up. */
+namespace Systems::AssetRegistry {
+	/* Looks up an asset loaded from path with the given options. On a hit the asset gains a reference and is returned.
+		Either way, key is set to the key the asset is (or should be) registered under. */
+	std::shared_ptr<void> Acquire(std::string path, std::string options, std::string &key);
+
+	/* Off by default, since the first Acquire of each path then reads and hashes the whole file on the calling thread.
+		Only affects paths acquired afterwards. */
+	void SetContentHashing(bool enabled);
+
+	/* Registers a freshly loaded asset with one reference. If another thread registered the same key first, that
+		asset gains the reference instead and is returned, and the caller should clean up its own. */
+	std::shared_ptr<void> Add(std::string key, std::shared_ptr<void> asset);
+
+	/* Drops a reference. Returns true if it was the last one, in which case the asset is forgotten and the caller
+		should clean it up. */
+	bool Release(std::string key);
+
+	/* Returns the shared asset for path and options, calling load only if it isn't registered yet */
+	template <class T, class Loader>
+	std::shared_ptr<T> Load(std::string path, std::string options, std::string &key, Loader load) {
+		auto asset = std::static_pointer_cast<T>(Acquire(path, options, key));
+		if (asset) return asset;
+
+		std::shared_ptr<T> loaded = load();
+		asset = std::static_pointer_cast<T>(Add(key, loaded));
+		if (asset != loaded) loaded->cleanup();
+		return asset;
+	}
+}
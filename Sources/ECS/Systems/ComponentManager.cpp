@@ -4,11 +4,16 @@
 #include "Components/Math/Transform.hpp"
 #include "Components/Math/Perspective.hpp"
 #include "Components/Materials/Material.hpp"
+#include "Components/Materials/ShaderModules.hpp"
 #include "Components/Meshes/Mesh.hpp"
 #include "Components/Lights/Light.hpp"
 #include "Components/Callbacks/Callbacks.hpp"
 
 #include "Components/Textures/Textures.hpp"
+#include "Components/Textures/TextureTable.hpp"
+#include "Components/Textures/TextureStreamer.hpp"
+#include "Components/Textures/MipGenerator.hpp"
+#include "Components/Textures/SamplerCache.hpp"
 
 #include "Components/Materials/PipelineParameters.hpp"
 #include "Components/Lights/PointLight/PointLight.hpp"
@@ -18,6 +23,7 @@ namespace Systems::ComponentManager {
 	std::unordered_map<PipelineKey, std::shared_ptr<PipelineParameters>> PipelineSettings;
 	std::unordered_map<std::string, std::shared_ptr<Components::Textures::Texture>> Textures;
 	std::unordered_map<std::string, std::shared_ptr<Components::Meshes::Mesh>> Meshes;
+	std::unordered_map<std::string, std::shared_ptr<Components::Meshes::Occluder>> Occluders;
 	std::unordered_map<std::string, std::shared_ptr<Components::Lights::Light>> Lights;
 	std::unordered_map<std::string, std::shared_ptr<Components::Materials::Material>> Materials;
 	std::unordered_map<std::string, std::shared_ptr<Components::Math::Transform>> Transforms;
@@ -28,11 +34,26 @@ namespace Systems::ComponentManager {
 		/* Initialize Lights */
 		Components::Lights::PointLights::Initialize();
 
+		/* Shared table of transforms, indexed by per draw push constants */
+		Components::Math::Transform::InitializeTable();
+
+		/* Global table of textures for bindless materials, if supported */
+		Components::Textures::TextureTable::Initialize();
+
+		/* Shader modules shared by every material, compiled at runtime when possible */
+		Components::Materials::ShaderModules::Initialize();
+
+		/* Builds mip chains for textures loaded or rendered without one */
+		Components::Textures::MipGenerator::Initialize();
+
 		/* By default, load placeholder textures */
 		Components::Textures::Texture2D::Create("DefaultTexture");
 		Components::Textures::Texture3D::Create("DefaultTexture3D");
 		Components::Textures::TextureCube::Create("DefaultTextureCube");
 
+		/* Streamed textures sample the placeholders above until their images are resident */
+		Components::Textures::TextureStreamer::Initialize();
+
 		/* By default, load the following meshes */
 		Components::Meshes::Sphere::Create("Sphere");
 		Components::Meshes::Plane::Create("Plane");
@@ -40,10 +61,15 @@ namespace Systems::ComponentManager {
 	}
 
 	void Cleanup() {
+		/* Finish any texture uploads in flight before their images are destroyed */
+		Components::Textures::TextureStreamer::Destroy();
+
 		for (auto &pair : Textures)
 			pair.second->cleanup();
 		for (auto &pair : Meshes)
 			pair.second->cleanup();
+		for (auto &pair : Occluders)
+			pair.second->cleanup();
 		for (auto &pair : Lights)
 			pair.second->cleanup();
 		for (auto &pair : Materials)
@@ -57,5 +83,15 @@ namespace Systems::ComponentManager {
 
 		/* Destroy Light Resources */
 		Components::Lights::PointLights::Destroy();
+
+		/* Destroy the bindless texture table, the mip generator, the shared samplers and the transform table */
+		Components::Textures::TextureTable::Destroy();
+		Components::Textures::MipGenerator::Destroy();
+		Components::Textures::SamplerCache::Destroy();
+		Components::Math::Transform::DestroyTable();
+
+		/* Shared shader modules can only go once no pipeline is still being compiled from them */
+		Components::Materials::MaterialInterface::WaitForPipelines();
+		Components::Materials::ShaderModules::Destroy();
 	}
 }
\ No newline at end of file
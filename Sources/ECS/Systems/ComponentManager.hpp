@@ -11,6 +11,7 @@
 namespace Entities { class Entity; }
 namespace Components::Textures { class Texture; }
 namespace Components::Meshes { class Mesh; }
+namespace Components::Meshes { class Occluder; }
 namespace Components::Materials { class Material; }
 namespace Components { class Callbacks; }
 namespace Components::Math { class Transform; }
@@ -24,6 +25,7 @@ namespace Systems::ComponentManager {
 	extern std::unordered_map<PipelineKey, std::shared_ptr<PipelineParameters>> PipelineSettings;
 	extern std::unordered_map<std::string, std::shared_ptr<Components::Textures::Texture>> Textures;
 	extern std::unordered_map<std::string, std::shared_ptr<Components::Meshes::Mesh>> Meshes;
+	extern std::unordered_map<std::string, std::shared_ptr<Components::Meshes::Occluder>> Occluders;
 	extern std::unordered_map<std::string, std::shared_ptr<Components::Lights::Light>> Lights;
 	extern std::unordered_map<std::string, std::shared_ptr<Components::Materials::Material>> Materials;
 	extern std::unordered_map<std::string, std::shared_ptr<Components::Math::Transform>> Transforms;
@@ -0,0 +1,161 @@
+#include "RaycastService.hpp"
+
+#include "vkdk.hpp"
+
+#include "Systems/Systems.hpp"
+#include "Systems/SceneBVH.hpp"
+#include "Entities/Entity.hpp"
+#include "Tools/MPMCQueue.hpp"
+
+#include <chrono>
+
+namespace Systems::RaycastService {
+	struct Request {
+		std::vector<Ray> rays;
+		std::promise<std::vector<Hit>> promise;
+		bool usePromise = false;
+		HitCallback hitCallback;
+		BatchCallback batchCallback;
+	};
+
+	static Tools::MPMCQueue<Request*> requests(1024);
+
+	/* Traces a ray in an entity's local space. Since the direction isn't renormalized, distances match world space.
+		Uses the hierarchy's snapshot of the entity, since its live transform belongs to the update thread. */
+	static bool TraceEntity(const SceneBVH::EntitySnapshot &snapshot, glm::vec3 origin, glm::vec3 direction, float tMax, 
+		Components::Meshes::TriangleBVH::Hit &hit) 
+	{
+		if (!snapshot.mesh) return false;
+		auto triangleBVH = snapshot.mesh->mesh->getTriangleBVH();
+		if (!triangleBVH) return false;
+
+		glm::mat4 worldToLocal = glm::inverse(snapshot.localToWorld);
+		glm::vec3 localOrigin = glm::vec3(worldToLocal * glm::vec4(origin, 1.0));
+		glm::vec3 localDirection = glm::vec3(worldToLocal * glm::vec4(direction, 0.0));
+		return triangleBVH->intersect(localOrigin, localDirection, tMax, hit);
+	}
+
+	Hit Trace(Ray ray) {
+		Hit result;
+		auto sceneHit = SceneBVH::Raycast(ray.origin, ray.direction, ray.maxDistance, 
+			[&](const SceneBVH::EntitySnapshot &snapshot, glm::vec3 origin, glm::vec3 direction, float tMax) {
+				Components::Meshes::TriangleBVH::Hit hit;
+				if (!TraceEntity(snapshot, origin, direction, tMax, hit)) return -1.0f;
+				result.triangle = hit.triangle;
+				result.barycentrics = hit.barycentrics;
+				return hit.distance;
+			});
+		result.entity = sceneHit.entity;
+		result.distance = sceneHit.distance;
+		return result;
+	}
+
+	std::vector<Hit> Trace(const std::vector<Ray> &rays) {
+		std::vector<Hit> results(rays.size());
+		for (size_t first = 0; first < rays.size(); first += 4) {
+			size_t count = std::min((size_t)4, rays.size() - first);
+
+			/* Partial packets are padded by repeating the last ray */
+			glm::vec3 origins[4], directions[4];
+			float tMax[4];
+			for (size_t i = 0; i < 4; ++i) {
+				const Ray &ray = rays[first + std::min(i, count - 1)];
+				origins[i] = ray.origin;
+				directions[i] = ray.direction;
+				tMax[i] = ray.maxDistance;
+			}
+
+			/* Gather every entity that any ray in the packet might hit, in a single traversal */
+			for (const auto &candidate : SceneBVH::QueryRayPacket(origins, directions, tMax)) {
+				if (!candidate.mesh) continue;
+				auto triangleBVH = candidate.mesh->mesh->getTriangleBVH();
+				if (!triangleBVH) continue;
+
+				glm::mat4 worldToLocal = glm::inverse(candidate.localToWorld);
+				glm::vec3 localOrigins[4], localDirections[4];
+				for (int i = 0; i < 4; ++i) {
+					localOrigins[i] = glm::vec3(worldToLocal * glm::vec4(origins[i], 1.0));
+					localDirections[i] = glm::vec3(worldToLocal * glm::vec4(directions[i], 0.0));
+				}
+
+				/* tMax carries the closest hit so far, so only closer hits are reported */
+				Components::Meshes::TriangleBVH::Hit hits[4];
+				triangleBVH->intersect4(localOrigins, localDirections, tMax, hits);
+				for (size_t i = 0; i < count; ++i) {
+					if (hits[i].distance < 0.0f) continue;
+					results[first + i].entity = candidate.entity;
+					results[first + i].triangle = hits[i].triangle;
+					results[first + i].barycentrics = hits[i].barycentrics;
+					results[first + i].distance = hits[i].distance;
+				}
+			}
+		}
+		return results;
+	}
+
+	bool Submit(Ray ray, HitCallback callback) {
+		auto request = new Request();
+		request->rays.push_back(ray);
+		request->hitCallback = callback;
+		if (requests.push(request)) return true;
+		delete request;
+		return false;
+	}
+
+	std::future<std::vector<Hit>> Submit(std::vector<Ray> rays) {
+		auto request = new Request();
+		request->rays = std::move(rays);
+		request->usePromise = true;
+		auto future = request->promise.get_future();
+		if (requests.push(request)) return future;
+		delete request;
+		return std::future<std::vector<Hit>>();
+	}
+
+	bool Submit(std::vector<Ray> rays, BatchCallback callback) {
+		auto request = new Request();
+		request->rays = std::move(rays);
+		request->batchCallback = callback;
+		if (requests.push(request)) return true;
+		delete request;
+		return false;
+	}
+
+	Ray ScreenRay(glm::vec2 pixel, glm::vec2 resolution, glm::mat4 view, glm::mat4 projection) {
+		glm::vec2 ndc = glm::vec2(2.0f * pixel.x / resolution.x - 1.0f, 1.0f - 2.0f * pixel.y / resolution.y);
+		glm::mat4 inverse = glm::inverse(projection * view);
+		glm::vec4 nearPoint = inverse * glm::vec4(ndc, 0.0, 1.0);
+		glm::vec4 farPoint = inverse * glm::vec4(ndc, 1.0, 1.0);
+		Ray ray;
+		ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+		ray.direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - ray.origin);
+		return ray;
+	}
+
+	void Run() {
+		while (!VKDK::ShouldClose() && !Systems::quit) {
+			Request *request;
+			if (!requests.pop(request)) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+
+			if (request->hitCallback) {
+				request->hitCallback(Trace(request->rays[0]));
+			}
+			else {
+				auto hits = Trace(request->rays);
+				if (request->batchCallback) request->batchCallback(hits);
+				if (request->usePromise) request->promise.set_value(hits);
+			}
+			delete request;
+		}
+
+		/* Don't leave anyone waiting on a future */
+		Request *request;
+		while (requests.pop(request)) {
+			if (request->usePromise) request->promise.set_value(std::vector<Hit>(request->rays.size()));
+			delete request;
+		}
+	}
+}
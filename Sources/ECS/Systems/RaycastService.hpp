@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <functional>
+#include <future>
+#include <cfloat>
+
+#include <glm/glm.hpp>
+
+/* Forward Declarations */
+namespace Entities { class Entity; }
+
+/* Traces rays against scene triangles on the raycast thread. Requests may be submitted from any thread 
+	through a lock free queue, and results are returned through futures or callbacks. Callbacks are 
+	called on the raycast thread. */
+namespace Systems::RaycastService {
+	struct Ray {
+		glm::vec3 origin = glm::vec3(0.0);
+		glm::vec3 direction = glm::vec3(0.0, 0.0, -1.0);
+		float maxDistance = FLT_MAX;
+	};
+
+	struct Hit {
+		std::shared_ptr<Entities::Entity> entity = nullptr;
+		uint32_t triangle = 0;
+		glm::vec2 barycentrics = glm::vec2(0.0);
+		float distance = -1.0f;
+
+		bool valid() const { return entity != nullptr; }
+	};
+
+	typedef std::function<void(Hit)> HitCallback;
+	typedef std::function<void(std::vector<Hit>)> BatchCallback;
+
+	/* Queue a single ray. Returns false if the request queue is full. */
+	bool Submit(Ray ray, HitCallback callback);
+
+	/* Queue a batch of rays, which are traced in packets of four. Returns an invalid future if the queue is full. */
+	std::future<std::vector<Hit>> Submit(std::vector<Ray> rays);
+	bool Submit(std::vector<Ray> rays, BatchCallback callback);
+
+	/* Synchronous versions, which run on the calling thread */
+	Hit Trace(Ray ray);
+	std::vector<Hit> Trace(const std::vector<Ray> &rays);
+
+	/* Builds a ray through a pixel, given a view and (unflipped) projection matrix */
+	Ray ScreenRay(glm::vec2 pixel, glm::vec2 resolution, glm::mat4 view, glm::mat4 projection);
+
+	/* Services requests until the application quits. Meant to be assigned to Systems::RaycastSystem. */
+	void Run();
+}
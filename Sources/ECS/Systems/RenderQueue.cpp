@@ -0,0 +1,122 @@
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+#include <typeinfo>
+
+namespace Systems {
+	void RenderQueue::add(PipelineKey pipelineKey, std::shared_ptr<Components::Materials::Material> material,
+		std::shared_ptr<Components::Meshes::Mesh> mesh, VkDescriptorSet descriptorSet,
+		Components::Materials::DrawInfo drawInfo, float depth, bool transparent)
+	{
+		/* A pipeline is identified by the material type, the pipeline key, and the set of pipelines the material
+			draws with, which differs for instanced and specialized variants */
+		size_t pipelineHash = 0;
+		hash_combine(pipelineHash, typeid(*material->material).hash_code());
+		hash_combine(pipelineHash, pipelineKey);
+		hash_combine(pipelineHash, drawInfo.instanced);
+		hash_combine(pipelineHash, (const void*)material->material->getPipelines(drawInfo.instanced));
+
+		uint64_t pipeline = getId(pipelineIds, pipelineHash);
+		uint64_t materialId = getId(materialIds, (const void*)material->material.get());
+		uint64_t meshId = getId(meshIds, (const void*)mesh->mesh.get());
+
+		const uint64_t depthMax = (1ull << DepthBits) - 1;
+		uint64_t quantizedDepth = (uint64_t)(std::min(std::max(depth, 0.0f), 1.0f) * depthMax);
+
+		uint64_t key = (uint64_t)(pipelineKey.subpass & 0xF) << 60;
+		if (!transparent) {
+			key |= pipeline << (DepthBits + 2 * IdBits);
+			key |= materialId << (DepthBits + IdBits);
+			key |= meshId << DepthBits;
+			key |= quantizedDepth;
+		}
+		else {
+			key |= 1ull << 59;
+			key |= (depthMax - quantizedDepth) << (3 * IdBits);
+			key |= pipeline << (2 * IdBits);
+			key |= materialId << IdBits;
+			key |= meshId;
+		}
+
+		RenderItem item;
+		item.sortKey = key;
+		item.pipelineHash = pipelineHash;
+		item.pipelineKey = pipelineKey;
+		item.material = material;
+		item.mesh = mesh;
+		item.descriptorSet = descriptorSet;
+		item.drawInfo = drawInfo;
+		items.push_back(item);
+	}
+
+	void RenderQueue::sort() {
+		if (items.size() < 2) return;
+
+		/* Sort (key, index) pairs instead of moving the items themselves */
+		std::vector<std::pair<uint64_t, uint32_t>> keys(items.size()), scratch(items.size());
+		for (uint32_t i = 0; i < items.size(); ++i)
+			keys[i] = { items[i].sortKey, i };
+
+		for (uint32_t shift = 0; shift < 64; shift += 8) {
+			uint32_t counts[256] = {};
+			for (auto &key : keys)
+				counts[(key.first >> shift) & 0xFF]++;
+
+			/* Skip passes where every key has the same digit */
+			if (counts[(keys[0].first >> shift) & 0xFF] == keys.size()) continue;
+
+			uint32_t offset = 0;
+			for (uint32_t d = 0; d < 256; ++d) {
+				uint32_t count = counts[d];
+				counts[d] = offset;
+				offset += count;
+			}
+			for (auto &key : keys)
+				scratch[counts[(key.first >> shift) & 0xFF]++] = key;
+			keys.swap(scratch);
+		}
+
+		std::vector<RenderItem> sorted;
+		sorted.reserve(items.size());
+		for (auto &key : keys)
+			sorted.push_back(items[key.second]);
+		items.swap(sorted);
+	}
+
+	void RenderQueue::record(VkCommandBuffer commandBuffer) {
+		record(commandBuffer, 0, items.size());
+	}
+
+	void RenderQueue::record(VkCommandBuffer commandBuffer, size_t first, size_t count) {
+		size_t last = std::min(first + count, items.size());
+		for (size_t i = first; i < last; ++i) {
+			auto &item = items[i];
+			if (i == first || item.pipelineHash != items[i - 1].pipelineHash)
+				item.material->material->bindSharedDescriptors(item.pipelineKey, commandBuffer);
+			item.material->material->render(item.pipelineKey, commandBuffer, item.descriptorSet, item.mesh, item.drawInfo);
+		}
+	}
+
+	size_t RenderQueue::hashRange(size_t first, size_t count) {
+		size_t hash = 0;
+		size_t last = std::min(first + count, items.size());
+		hash_combine(hash, last - first);
+		for (size_t i = first; i < last; ++i) {
+			auto &item = items[i];
+			auto &mesh = item.mesh->mesh;
+			auto &drawInfo = item.drawInfo;
+			hash_combine(hash, item.pipelineHash, (const void*)item.material->material.get(), (const void*)mesh.get(),
+				(const void*)mesh->getVertexBuffer(), (const void*)mesh->getIndexBuffer(), (const void*)item.descriptorSet);
+			hash_combine(hash, (const void*)drawInfo.indirectBuffer, drawInfo.indirectOffset, drawInfo.drawCount,
+				(const void*)drawInfo.countBuffer, drawInfo.countOffset, drawInfo.instanced, drawInfo.transformIndex);
+		}
+		return hash;
+	}
+
+	void RenderQueue::clear() {
+		items.clear();
+		pipelineIds.clear();
+		materialIds.clear();
+		meshIds.clear();
+	}
+}
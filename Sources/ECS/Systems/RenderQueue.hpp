@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "vkdk.hpp"
+#include "Components/Materials/Material.hpp"
+#include "Components/Meshes/Mesh.hpp"
+
+namespace Systems {
+	/* A queue of draws for a single render pass. Each draw gets a 64 bit sort key, and the queue is radix
+		sorted before recording, so that opaque draws are grouped by pipeline, material and mesh and drawn
+		roughly front to back, while transparent draws are drawn strictly back to front after them.
+
+		Opaque:      | subpass (4) | 0 | pipeline (12) | material (12) | mesh (12) | depth (23) |
+		Transparent: | subpass (4) | 1 | inverted depth (23) | pipeline (12) | material (12) | mesh (12) |
+	*/
+	class RenderQueue {
+	public:
+		struct RenderItem {
+			uint64_t sortKey = 0;
+			size_t pipelineHash = 0;
+			PipelineKey pipelineKey;
+			std::shared_ptr<Components::Materials::Material> material;
+			std::shared_ptr<Components::Meshes::Mesh> mesh;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			Components::Materials::DrawInfo drawInfo;
+		};
+
+		static const uint32_t DepthBits = 23;
+		static const uint32_t IdBits = 12;
+
+		/* Depth is expected in [0, 1], where 0 is closest to the camera */
+		void add(PipelineKey pipelineKey, std::shared_ptr<Components::Materials::Material> material,
+			std::shared_ptr<Components::Meshes::Mesh> mesh, VkDescriptorSet descriptorSet,
+			Components::Materials::DrawInfo drawInfo, float depth, bool transparent);
+
+		/* Orders items by their sort keys with an LSD radix sort. Stable, so ties keep their insertion order. */
+		void sort();
+
+		/* Records every item in order */
+		void record(VkCommandBuffer commandBuffer);
+
+		/* Records count items in order, starting at first. Separate ranges can be recorded on separate threads.
+			Shared descriptors are bound at the start of each range, and again whenever the pipeline changes. */
+		void record(VkCommandBuffer commandBuffer, size_t first, size_t count);
+
+		/* Hashes everything the commands recorded for a range depend on, so unchanged ranges can keep their recordings */
+		size_t hashRange(size_t first, size_t count);
+
+		void clear();
+
+		const std::vector<RenderItem> &getItems() {
+			return items;
+		}
+
+	private:
+		std::vector<RenderItem> items;
+
+		/* Small dense ids for the sort keys, assigned in order of first appearance */
+		std::unordered_map<size_t, uint32_t> pipelineIds;
+		std::unordered_map<const void*, uint32_t> materialIds;
+		std::unordered_map<const void*, uint32_t> meshIds;
+
+		template<typename K>
+		static uint32_t getId(std::unordered_map<K, uint32_t> &ids, K key) {
+			auto id = ids.find(key);
+			if (id != ids.end()) return id->second;
+			uint32_t next = (uint32_t)ids.size() & ((1u << IdBits) - 1);
+			ids[key] = next;
+			return next;
+		}
+	};
+}
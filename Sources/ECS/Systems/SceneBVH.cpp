@@ -0,0 +1,222 @@
+#include "SceneBVH.hpp"
+
+#include "Systems/SceneGraph.hpp"
+#include "Entities/Entity.hpp"
+
+#include <cmath>
+#include <mutex>
+#include <unordered_map>
+#include <shared_mutex>
+
+namespace Systems::SceneBVH {
+	/* Rebuild the dynamic tree once refitting has grown its SAH cost by this factor */
+	static const float RebuildThreshold = 1.5f;
+
+	/* Entities whose bounds haven't changed for this many updates move to the static tree */
+	static const uint32_t StaticUpdates = 30;
+
+	/* Static entities are built into their own tree with the surface area heuristic, which is only rebuilt when
+		an entity joins or leaves it. Entities which moved recently are refit every update in a separate tree. */
+	struct Tree {
+		Tools::BVH bvh;
+		std::vector<EntitySnapshot> entities;
+		std::vector<Tools::AABB> bounds;
+		float builtCost = 0.0f;
+	};
+
+	/* How long an entity's bounds have been still. Only touched by the thread calling Update. */
+	struct TrackedEntity {
+		std::shared_ptr<Entities::Entity> entity;
+		Tools::AABB bounds;
+		uint32_t unchangedUpdates = 0;
+		bool isStatic = false;
+	};
+	static std::unordered_map<const Entities::Entity*, TrackedEntity> tracked;
+
+	static std::shared_mutex mutex;
+	static Tree staticTree, dynamicTree;
+	static std::unordered_set<const Entities::Entity*> entitySet;
+	static bool invalidated = true;
+
+	static void Build(Tree &tree) {
+		tree.bvh.build(tree.bounds);
+		tree.builtCost = tree.bvh.cost();
+	}
+
+	static EntitySnapshot Snapshot(const std::shared_ptr<Entities::Entity> &entity) {
+		EntitySnapshot snapshot;
+		snapshot.entity = entity;
+		snapshot.localToWorld = entity->boundsLocalToWorld;
+		snapshot.mesh = entity->getFirstComponent<Components::Meshes::Mesh>();
+		return snapshot;
+	}
+
+	static bool SameEntities(const std::vector<EntitySnapshot> &a, const std::vector<EntitySnapshot> &b) {
+		if (a.size() != b.size()) return false;
+		for (size_t i = 0; i < a.size(); ++i)
+			if (a[i].entity != b[i].entity) return false;
+		return true;
+	}
+
+	void Update() {
+		std::unordered_map<const Entities::Entity*, TrackedEntity> current;
+		std::vector<EntitySnapshot> dynamicEntities;
+		std::vector<Tools::AABB> dynamicBounds;
+		bool staticChanged = false;
+		for (const auto &pair : SceneGraph::Entities) {
+			const auto &entity = pair.second;
+			if (!entity->hasBounds) continue;
+			TrackedEntity state;
+			state.entity = entity;
+			state.bounds = Tools::AABB(entity->worldAABBMin, entity->worldAABBMax);
+
+			/* Any movement sends an entity back to the dynamic tree */
+			auto previous = tracked.find(entity.get());
+			bool wasStatic = previous != tracked.end() && previous->second.isStatic;
+			if (previous != tracked.end() && previous->second.bounds.min == state.bounds.min && previous->second.bounds.max == state.bounds.max) {
+				state.unchangedUpdates = previous->second.unchangedUpdates + 1;
+				state.isStatic = wasStatic || state.unchangedUpdates >= StaticUpdates;
+			}
+			if (state.isStatic != wasStatic) staticChanged = true;
+			if (!state.isStatic) {
+				dynamicEntities.push_back(Snapshot(entity));
+				dynamicBounds.push_back(state.bounds);
+			}
+			current.emplace(entity.get(), std::move(state));
+		}
+
+		/* Static entities which were removed, or lost their bounds */
+		for (const auto &pair : tracked)
+			if (pair.second.isStatic && current.find(pair.first) == current.end()) staticChanged = true;
+		tracked.swap(current);
+
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		bool rebuildAll = invalidated;
+		invalidated = false;
+		if (staticChanged || rebuildAll) {
+			staticTree.entities.clear();
+			staticTree.bounds.clear();
+			for (const auto &pair : SceneGraph::Entities) {
+				auto state = tracked.find(pair.second.get());
+				if (state == tracked.end() || !state->second.isStatic) continue;
+				staticTree.entities.push_back(Snapshot(state->second.entity));
+				staticTree.bounds.push_back(state->second.bounds);
+			}
+			Build(staticTree);
+		}
+		else {
+			/* Static bounds haven't changed, but a transform can change without moving them, e.g. a half turn */
+			for (auto &snapshot : staticTree.entities) snapshot = Snapshot(snapshot.entity);
+		}
+
+		bool dynamicChanged = !SameEntities(dynamicEntities, dynamicTree.entities);
+		dynamicTree.entities.swap(dynamicEntities);
+		dynamicTree.bounds.swap(dynamicBounds);
+		if (dynamicChanged || rebuildAll) Build(dynamicTree);
+		else {
+			dynamicTree.bvh.refit(dynamicTree.bounds);
+			if (dynamicTree.bvh.cost() > dynamicTree.builtCost * RebuildThreshold) Build(dynamicTree);
+		}
+
+		if (staticChanged || dynamicChanged || rebuildAll) {
+			entitySet.clear();
+			for (const auto &pair : tracked) entitySet.insert(pair.first);
+		}
+	}
+
+	/* Gathers the entities of both trees whose bounds pass the test. Callers hold the lock. */
+	template<typename BoundsTest>
+	static std::vector<std::shared_ptr<Entities::Entity>> Query(BoundsTest test) {
+		std::vector<std::shared_ptr<Entities::Entity>> results;
+		for (const Tree *tree : { &staticTree, &dynamicTree })
+			tree->bvh.traverse(test, [&](uint32_t p) { if (test(tree->bounds[p])) results.push_back(tree->entities[p].entity); });
+		return results;
+	}
+
+	void Invalidate() {
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		invalidated = true;
+	}
+
+	bool IsBuilt() {
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		return !staticTree.bvh.empty() || !dynamicTree.bvh.empty();
+	}
+
+	bool Contains(const Entities::Entity *entity) {
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		return entitySet.find(entity) != entitySet.end();
+	}
+
+	std::vector<std::shared_ptr<Entities::Entity>> QueryFrustum(const Components::Math::Frustum &frustum) {
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		return Query([&](const Tools::AABB &box) { return frustum.intersectsAABB(box.min, box.max); });
+	}
+
+	std::vector<std::shared_ptr<Entities::Entity>> QuerySphere(glm::vec3 center, float radius) {
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		return Query([&](const Tools::AABB &box) { return box.intersectsSphere(center, radius); });
+	}
+
+	std::vector<std::shared_ptr<Entities::Entity>> QueryAABB(glm::vec3 minP, glm::vec3 maxP) {
+		Tools::AABB query(minP, maxP);
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		return Query([&](const Tools::AABB &box) { return box.intersects(query); });
+	}
+
+	std::vector<std::shared_ptr<Entities::Entity>> QueryRay(glm::vec3 origin, glm::vec3 direction, float maxDistance) {
+		glm::vec3 inverseDirection = 1.0f / direction;
+		float t;
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		return Query([&](const Tools::AABB &box) { return box.intersectsRay(origin, inverseDirection, maxDistance, t); });
+	}
+
+	std::vector<EntitySnapshot> QueryRayPacket(const glm::vec3 origins[4], const glm::vec3 directions[4], const float maxDistances[4]) {
+		glm::vec3 inverseDirections[4];
+		for (int i = 0; i < 4; ++i) inverseDirections[i] = 1.0f / directions[i];
+
+		/* Bounds of the packet's segments, if they're all finite */
+		Tools::AABB packetBounds;
+		bool bounded = true;
+		for (int i = 0; i < 4; ++i) {
+			glm::vec3 end = origins[i] + directions[i] * maxDistances[i];
+			if (!std::isfinite(end.x) || !std::isfinite(end.y) || !std::isfinite(end.z)) bounded = false;
+			packetBounds.expand(origins[i]);
+			packetBounds.expand(end);
+		}
+
+		auto test = [&](const Tools::AABB &box) {
+			if (bounded && !box.intersects(packetBounds)) return false;
+			float t;
+			for (int i = 0; i < 4; ++i)
+				if (box.intersectsRay(origins[i], inverseDirections[i], maxDistances[i], t)) return true;
+			return false;
+		};
+
+		std::vector<EntitySnapshot> results;
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		for (const Tree *tree : { &staticTree, &dynamicTree })
+			tree->bvh.traverse(test, [&](uint32_t p) { if (test(tree->bounds[p])) results.push_back(tree->entities[p]); });
+		return results;
+	}
+
+	RayHit Raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, RayTest rayTest) {
+		RayHit hit;
+		glm::vec3 inverseDirection = 1.0f / direction;
+		std::shared_lock<std::shared_mutex> lock(mutex);
+
+		/* The second tree only has to beat the closest hit in the first */
+		for (const Tree *tree : { &staticTree, &dynamicTree }) {
+			float tMax = (hit.entity) ? hit.distance : maxDistance;
+			float distance = tree->bvh.intersectRay(origin, direction, tMax, [&](uint32_t p, float tMax) {
+				float t = -1.0f;
+				if (rayTest) t = rayTest(tree->entities[p], origin, direction, tMax);
+				else if (!tree->bounds[p].intersectsRay(origin, inverseDirection, tMax, t)) t = -1.0f;
+				if (t >= 0.0f && t <= tMax) hit.entity = tree->entities[p].entity;
+				return t;
+			});
+			if (distance >= 0.0f) hit.distance = distance;
+		}
+		return hit;
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <unordered_set>
+#include <functional>
+
+#include "Tools/BVH.hpp"
+#include "Components/Math/Frustum.hpp"
+
+/* Forward Declarations */
+namespace Entities { class Entity; }
+namespace Components::Meshes { class Mesh; }
+
+/* A bounding volume hierarchy over the world space bounds of every entity with a mesh.
+	Queries may be made from any thread, while updates are expected to come from the thread 
+	which updates entity transforms. */
+namespace Systems::SceneBVH {
+	struct RayHit {
+		std::shared_ptr<Entities::Entity> entity = nullptr;
+		float distance = -1.0f;
+	};
+
+	/* An entity as of the last update. Queries from other threads get these instead of reading the entity's
+		transform and components while the update thread changes them. */
+	struct EntitySnapshot {
+		std::shared_ptr<Entities::Entity> entity;
+		glm::mat4 localToWorld = glm::mat4(1.0);
+		std::shared_ptr<Components::Meshes::Mesh> mesh;
+	};
+
+	/* Optional narrow phase for ray queries. Given an entity and the current closest distance, returns
+		the distance to the entity along the ray, or a negative value on a miss. */
+	typedef std::function<float(const EntitySnapshot &snapshot, glm::vec3 origin, glm::vec3 direction, float tMax)> RayTest;
+
+	/* Brings the hierarchy up to date with the current entity world bounds. Entities whose bounds have been still
+		for a while are kept in a static tree, built with the surface area heuristic and only rebuilt when an entity
+		joins or leaves it. The rest are refit every update, and rebuilt if entities were added or removed, or if
+		refitting has made their tree too loose. */
+	void Update();
+
+	/* Forces a full rebuild on the next update */
+	void Invalidate();
+
+	bool IsBuilt();
+
+	/* True if the entity was part of the last update. Entities added since then aren't returned by any query yet. */
+	bool Contains(const Entities::Entity *entity);
+
+	std::vector<std::shared_ptr<Entities::Entity>> QueryFrustum(const Components::Math::Frustum &frustum);
+	std::vector<std::shared_ptr<Entities::Entity>> QuerySphere(glm::vec3 center, float radius);
+	std::vector<std::shared_ptr<Entities::Entity>> QueryAABB(glm::vec3 minP, glm::vec3 maxP);
+
+	/* Returns every entity whose bounds are hit by the ray within maxDistance, in no particular order */
+	std::vector<std::shared_ptr<Entities::Entity>> QueryRay(glm::vec3 origin, glm::vec3 direction, float maxDistance = FLT_MAX);
+
+	/* Returns every entity whose bounds are hit by any of four rays, in no particular order. The hierarchy is traversed
+		once for the whole packet. Nodes outside the bounds of the packet's segments are skipped without testing each ray. */
+	std::vector<EntitySnapshot> QueryRayPacket(const glm::vec3 origins[4], const glm::vec3 directions[4], const float maxDistances[4]);
+
+	/* Returns the closest entity hit by the ray. Without a narrow phase test, entities are hit at their bounds. */
+	RayHit Raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance = FLT_MAX, RayTest rayTest = nullptr);
+}
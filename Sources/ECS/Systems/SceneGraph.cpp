@@ -2,6 +2,27 @@
 
 #include "Entities/Entity.hpp"
 
+#include <mutex>
+
 namespace Systems::SceneGraph {
 	std::unordered_map<std::string, std::shared_ptr<Entities::Entity>> Entities;
-}
\ No newline at end of file
+
+	namespace {
+		std::mutex versionMutex;
+		uint64_t globalVersion = 0;
+		std::unordered_map<VkRenderPass, uint64_t> passVersions;
+	}
+
+	void MarkDirty(VkRenderPass renderpass) {
+		std::lock_guard<std::mutex> lock(versionMutex);
+		if (renderpass == VK_NULL_HANDLE) globalVersion++;
+		else passVersions[renderpass]++;
+	}
+
+	uint64_t GetVersion(VkRenderPass renderpass) {
+		std::lock_guard<std::mutex> lock(versionMutex);
+		auto version = passVersions.find(renderpass);
+		/* Both counters only grow, so their sum changes whenever either does */
+		return globalVersion + ((version != passVersions.end()) ? version->second : 0);
+	}
+}
@@ -4,9 +4,20 @@
 #include <string>
 #include <unordered_map>
 
+#include "vkdk.hpp"
+
 /* Forward Declarations */
 namespace Entities { class Entity; }
 
 namespace Systems::SceneGraph {
 	extern std::unordered_map<std::string, std::shared_ptr<Entities::Entity>> Entities;
-}
\ No newline at end of file
+
+	/* Change tracking. Anything which changes the draws recorded for a render pass (entities being added, removed
+		or hidden, components being attached or detached, material pipelines being rebuilt) bumps that pass's version,
+		so that perspectives rendering to it know to re-record. A null render pass bumps every pass. 
+		Safe to call from any thread. */
+	void MarkDirty(VkRenderPass renderpass = VK_NULL_HANDLE);
+
+	/* Returns a number which changes whenever the given render pass is marked dirty */
+	uint64_t GetVersion(VkRenderPass renderpass);
+}
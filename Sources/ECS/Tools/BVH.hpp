@@ -0,0 +1,324 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cfloat>
+
+namespace Tools {
+	/* Axis aligned bounding box */
+	struct AABB {
+		glm::vec3 min = glm::vec3(FLT_MAX);
+		glm::vec3 max = glm::vec3(-FLT_MAX);
+
+		AABB() {}
+		AABB(glm::vec3 min, glm::vec3 max) : min(min), max(max) {}
+
+		void expand(const glm::vec3 &p) {
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+
+		void expand(const AABB &other) {
+			min = glm::min(min, other.min);
+			max = glm::max(max, other.max);
+		}
+
+		bool isValid() const {
+			return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+		}
+
+		glm::vec3 centroid() const {
+			return (min + max) * 0.5f;
+		}
+
+		float surfaceArea() const {
+			if (!isValid()) return 0.0f;
+			glm::vec3 d = max - min;
+			return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+		}
+
+		bool intersects(const AABB &other) const {
+			return min.x <= other.max.x && max.x >= other.min.x
+				&& min.y <= other.max.y && max.y >= other.min.y
+				&& min.z <= other.max.z && max.z >= other.min.z;
+		}
+
+		bool intersectsSphere(glm::vec3 center, float radius) const {
+			glm::vec3 closest = glm::clamp(center, min, max);
+			glm::vec3 d = closest - center;
+			return glm::dot(d, d) <= radius * radius;
+		}
+
+		/* Slab test. Returns the entry distance in tNear if the ray hits within [0, tMax] */
+		bool intersectsRay(glm::vec3 origin, glm::vec3 inverseDirection, float tMax, float &tNear) const {
+			glm::vec3 t0 = (min - origin) * inverseDirection;
+			glm::vec3 t1 = (max - origin) * inverseDirection;
+			glm::vec3 tSmall = glm::min(t0, t1);
+			glm::vec3 tBig = glm::max(t0, t1);
+			tNear = std::max(std::max(tSmall.x, tSmall.y), std::max(tSmall.z, 0.0f));
+			float tFar = std::min(std::min(tBig.x, tBig.y), std::min(tBig.z, tMax));
+			return tNear <= tFar;
+		}
+	};
+
+	/* A bounding volume hierarchy over a set of primitive bounds. Builds use a binned surface area heuristic,
+		and when primitives move without being added or removed, the tree can be refit instead of rebuilt. */
+	class BVH {
+	public:
+		struct Node {
+			AABB bounds;
+
+			/* For interior nodes, the index of the left child (the right child follows it).
+				For leaves, the first entry in primitiveIndices. */
+			uint32_t offset = 0;
+
+			/* Zero for interior nodes */
+			uint32_t count = 0;
+
+			bool isLeaf() const { return count > 0; }
+		};
+
+		std::vector<Node> nodes;
+		std::vector<uint32_t> primitiveIndices;
+
+		uint32_t maxLeafSize = 4;
+
+		bool empty() const {
+			return nodes.empty();
+		}
+
+		void clear() {
+			nodes.clear();
+			primitiveIndices.clear();
+		}
+
+		/* Builds the hierarchy from scratch over the given primitive bounds */
+		void build(const std::vector<AABB> &primitiveBounds) {
+			clear();
+			if (primitiveBounds.empty()) return;
+
+			primitiveIndices.resize(primitiveBounds.size());
+			centroids.resize(primitiveBounds.size());
+			for (uint32_t i = 0; i < primitiveBounds.size(); ++i) {
+				primitiveIndices[i] = i;
+				centroids[i] = primitiveBounds[i].centroid();
+			}
+
+			nodes.reserve(primitiveBounds.size() * 2);
+			nodes.emplace_back();
+			nodes[0].offset = 0;
+			nodes[0].count = (uint32_t)primitiveBounds.size();
+			subdivide(0, primitiveBounds, 0);
+			centroids.clear();
+		}
+
+		/* Updates node bounds in place after primitives have moved. Children are always stored after their parents,
+			so walking the nodes in reverse visits children first. */
+		void refit(const std::vector<AABB> &primitiveBounds) {
+			for (int i = (int)nodes.size() - 1; i >= 0; --i) {
+				Node &node = nodes[i];
+				node.bounds = AABB();
+				if (node.isLeaf()) {
+					for (uint32_t p = node.offset; p < node.offset + node.count; ++p)
+						node.bounds.expand(primitiveBounds[primitiveIndices[p]]);
+				}
+				else {
+					node.bounds.expand(nodes[node.offset].bounds);
+					node.bounds.expand(nodes[node.offset + 1].bounds);
+				}
+			}
+		}
+
+		/* The SAH cost of the whole tree, relative to the root. Comparing this against the cost right after a
+			build tells how much refitting has degraded the tree. */
+		float cost() const {
+			if (nodes.empty()) return 0.0f;
+			float rootArea = std::max(nodes[0].bounds.surfaceArea(), FLT_MIN);
+			float total = 0.0f;
+			for (auto &node : nodes) {
+				float relativeArea = node.bounds.surfaceArea() / rootArea;
+				total += (node.isLeaf()) ? relativeArea * node.count * IntersectCost : relativeArea * TraversalCost;
+			}
+			return total;
+		}
+
+		/* Visits every primitive in a leaf whose bounds pass the node test.
+			NodeTest: bool(const AABB&), LeafFunction: void(uint32_t primitive) */
+		template<typename NodeTest, typename LeafFunction>
+		void traverse(NodeTest nodeTest, LeafFunction leafFunction) const {
+			if (nodes.empty()) return;
+			uint32_t stack[64];
+			int stackSize = 0;
+			stack[stackSize++] = 0;
+			while (stackSize > 0) {
+				const Node &node = nodes[stack[--stackSize]];
+				if (!nodeTest(node.bounds)) continue;
+				if (node.isLeaf()) {
+					for (uint32_t p = node.offset; p < node.offset + node.count; ++p)
+						leafFunction(primitiveIndices[p]);
+				}
+				else {
+					stack[stackSize++] = node.offset + 1;
+					stack[stackSize++] = node.offset;
+				}
+			}
+		}
+
+		/* Visits leaves along a ray, nearest first. The primitive function returns a hit distance (or a negative
+			value on a miss), which shrinks the search so that farther nodes are skipped.
+			PrimitiveFunction: float(uint32_t primitive, float tMax) */
+		template<typename PrimitiveFunction>
+		float intersectRay(glm::vec3 origin, glm::vec3 direction, float tMax, PrimitiveFunction primitiveFunction) const {
+			if (nodes.empty()) return -1.0f;
+			glm::vec3 inverseDirection = 1.0f / direction;
+			float closest = -1.0f;
+
+			struct Entry { uint32_t node; float tNear; };
+			Entry stack[64];
+			int stackSize = 0;
+			float tNear;
+			if (!nodes[0].bounds.intersectsRay(origin, inverseDirection, tMax, tNear)) return -1.0f;
+			stack[stackSize++] = { 0, tNear };
+
+			while (stackSize > 0) {
+				Entry entry = stack[--stackSize];
+				if (entry.tNear > tMax) continue;
+				const Node &node = nodes[entry.node];
+				if (node.isLeaf()) {
+					for (uint32_t p = node.offset; p < node.offset + node.count; ++p) {
+						float t = primitiveFunction(primitiveIndices[p], tMax);
+						if (t >= 0.0f && t <= tMax) {
+							tMax = t;
+							closest = t;
+						}
+					}
+					continue;
+				}
+
+				/* Push the farther child first, so the nearer one is popped next */
+				float tLeft, tRight;
+				bool hitLeft = nodes[node.offset].bounds.intersectsRay(origin, inverseDirection, tMax, tLeft);
+				bool hitRight = nodes[node.offset + 1].bounds.intersectsRay(origin, inverseDirection, tMax, tRight);
+				if (hitLeft && hitRight) {
+					if (tLeft <= tRight) {
+						stack[stackSize++] = { node.offset + 1, tRight };
+						stack[stackSize++] = { node.offset, tLeft };
+					}
+					else {
+						stack[stackSize++] = { node.offset, tLeft };
+						stack[stackSize++] = { node.offset + 1, tRight };
+					}
+				}
+				else if (hitLeft) stack[stackSize++] = { node.offset, tLeft };
+				else if (hitRight) stack[stackSize++] = { node.offset + 1, tRight };
+			}
+			return closest;
+		}
+
+	private:
+		static constexpr int BinCount = 12;
+		static constexpr uint32_t MaxDepth = 60;
+		static constexpr float TraversalCost = 1.0f;
+		static constexpr float IntersectCost = 1.0f;
+
+		std::vector<glm::vec3> centroids;
+
+		void subdivide(uint32_t nodeIndex, const std::vector<AABB> &primitiveBounds, uint32_t depth) {
+			uint32_t first = nodes[nodeIndex].offset;
+			uint32_t count = nodes[nodeIndex].count;
+
+			AABB bounds, centroidBounds;
+			for (uint32_t p = first; p < first + count; ++p) {
+				bounds.expand(primitiveBounds[primitiveIndices[p]]);
+				centroidBounds.expand(centroids[primitiveIndices[p]]);
+			}
+			nodes[nodeIndex].bounds = bounds;
+
+			/* Depth is capped so that traversal stacks can't overflow */
+			if (count <= maxLeafSize || depth >= MaxDepth) return;
+
+			/* Find the cheapest split over binned centroids along each axis */
+			int bestAxis = -1;
+			int bestSplit = -1;
+			float bestCost = count * IntersectCost;
+			for (int axis = 0; axis < 3; ++axis) {
+				float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+				if (extent <= 0.0f) continue;
+
+				AABB binBounds[BinCount];
+				uint32_t binCounts[BinCount] = {};
+				float scale = BinCount / extent;
+				for (uint32_t p = first; p < first + count; ++p) {
+					int b = std::min(BinCount - 1, (int)((centroids[primitiveIndices[p]][axis] - centroidBounds.min[axis]) * scale));
+					binCounts[b]++;
+					binBounds[b].expand(primitiveBounds[primitiveIndices[p]]);
+				}
+
+				/* Sweep from both sides to get the area and count on either side of each split */
+				float leftArea[BinCount - 1], rightArea[BinCount - 1];
+				uint32_t leftCount[BinCount - 1], rightCount[BinCount - 1];
+				AABB leftBox, rightBox;
+				uint32_t leftSum = 0, rightSum = 0;
+				for (int i = 0; i < BinCount - 1; ++i) {
+					leftSum += binCounts[i];
+					leftCount[i] = leftSum;
+					leftBox.expand(binBounds[i]);
+					leftArea[i] = leftBox.surfaceArea();
+
+					rightSum += binCounts[BinCount - 1 - i];
+					rightCount[BinCount - 2 - i] = rightSum;
+					rightBox.expand(binBounds[BinCount - 1 - i]);
+					rightArea[BinCount - 2 - i] = rightBox.surfaceArea();
+				}
+
+				float parentArea = std::max(bounds.surfaceArea(), FLT_MIN);
+				for (int i = 0; i < BinCount - 1; ++i) {
+					if (leftCount[i] == 0 || rightCount[i] == 0) continue;
+					float cost = TraversalCost + IntersectCost * (leftArea[i] * leftCount[i] + rightArea[i] * rightCount[i]) / parentArea;
+					if (cost < bestCost) {
+						bestCost = cost;
+						bestAxis = axis;
+						bestSplit = i;
+					}
+				}
+			}
+
+			/* Splitting isn't worth it, but don't let leaves grow unbounded either */
+			uint32_t mid;
+			if (bestAxis == -1) {
+				if (count <= maxLeafSize * 4) return;
+				int axis = 0;
+				glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+				if (extent.y > extent[axis]) axis = 1;
+				if (extent.z > extent[axis]) axis = 2;
+				mid = first + count / 2;
+				std::nth_element(primitiveIndices.begin() + first, primitiveIndices.begin() + mid, primitiveIndices.begin() + first + count,
+					[&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+			}
+			else {
+				float scale = BinCount / (centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis]);
+				auto middle = std::partition(primitiveIndices.begin() + first, primitiveIndices.begin() + first + count,
+					[&](uint32_t p) {
+						int b = std::min(BinCount - 1, (int)((centroids[p][bestAxis] - centroidBounds.min[bestAxis]) * scale));
+						return b <= bestSplit;
+					});
+				mid = (uint32_t)(middle - primitiveIndices.begin());
+			}
+
+			uint32_t leftIndex = (uint32_t)nodes.size();
+			nodes.emplace_back();
+			nodes.emplace_back();
+			nodes[leftIndex].offset = first;
+			nodes[leftIndex].count = mid - first;
+			nodes[leftIndex + 1].offset = mid;
+			nodes[leftIndex + 1].count = first + count - mid;
+			nodes[nodeIndex].offset = leftIndex;
+			nodes[nodeIndex].count = 0;
+
+			subdivide(leftIndex, primitiveBounds, depth + 1);
+			subdivide(leftIndex + 1, primitiveBounds, depth + 1);
+		}
+	};
+}
@@ -16,4 +16,10 @@ static std::vector<char> readFile(const std::string& filename) {
 	file.close();
 
 	return buffer;
-}
\ No newline at end of file
+}
+
+/* Returns true if a file can be opened, used to detect optional shader variants */
+static bool fileExists(const std::string& filename) {
+	std::ifstream file(filename, std::ios::binary);
+	return file.is_open();
+}
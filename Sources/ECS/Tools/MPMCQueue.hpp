@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace Tools {
+	/* A bounded, lock free, multiple producer multiple consumer queue (after Dmitry Vyukov's design).
+		Each slot carries a sequence number which tells producers and consumers whether that slot is
+		ready for them, so the only contention is a compare and swap on the head or tail position.
+		Capacity is rounded up to a power of two. */
+	template<typename T>
+	class MPMCQueue {
+	public:
+		MPMCQueue(size_t capacity) {
+			size_t size = 2;
+			while (size < capacity) size <<= 1;
+			mask = size - 1;
+			slots = std::vector<Slot>(size);
+			for (size_t i = 0; i < size; ++i)
+				slots[i].sequence.store(i, std::memory_order_relaxed);
+			enqueuePosition.store(0, std::memory_order_relaxed);
+			dequeuePosition.store(0, std::memory_order_relaxed);
+		}
+
+		MPMCQueue(const MPMCQueue &) = delete;
+		MPMCQueue &operator=(const MPMCQueue &) = delete;
+
+		/* Returns false if the queue is full */
+		bool push(const T &value) {
+			Slot *slot;
+			size_t position = enqueuePosition.load(std::memory_order_relaxed);
+			while (true) {
+				slot = &slots[position & mask];
+				size_t sequence = slot->sequence.load(std::memory_order_acquire);
+				intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+				if (difference == 0) {
+					if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (difference < 0) return false;
+				else position = enqueuePosition.load(std::memory_order_relaxed);
+			}
+			slot->value = value;
+			slot->sequence.store(position + 1, std::memory_order_release);
+			return true;
+		}
+
+		/* Returns false if the queue is empty */
+		bool pop(T &value) {
+			Slot *slot;
+			size_t position = dequeuePosition.load(std::memory_order_relaxed);
+			while (true) {
+				slot = &slots[position & mask];
+				size_t sequence = slot->sequence.load(std::memory_order_acquire);
+				intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+				if (difference == 0) {
+					if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (difference < 0) return false;
+				else position = dequeuePosition.load(std::memory_order_relaxed);
+			}
+			value = slot->value;
+			slot->sequence.store(position + mask + 1, std::memory_order_release);
+			return true;
+		}
+
+	private:
+		struct Slot {
+			std::atomic<size_t> sequence;
+			T value;
+
+			Slot() {}
+			Slot(const Slot &) : sequence(0), value() {}
+		};
+
+		/* Keep the producer and consumer positions on separate cache lines */
+		alignas(64) std::vector<Slot> slots;
+		size_t mask;
+		alignas(64) std::atomic<size_t> enqueuePosition;
+		alignas(64) std::atomic<size_t> dequeuePosition;
+	};
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "MPMCQueue.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Tools {
+	/* A fixed set of threads, started once and reused, for work which is split into a handful of tasks every frame.
+		Tasks are handed out through an MPMCQueue. The calling thread takes tasks too, then waits for the rest,
+		so a pool of n threads runs up to n + 1 tasks at once. Idle workers sleep until the next run. */
+	class WorkerPool {
+	public:
+		WorkerPool(uint32_t threadCount) : jobs(1024) {
+			for (uint32_t i = 0; i < threadCount; ++i)
+				threads.emplace_back([this]() { work(); });
+		}
+
+		~WorkerPool() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake.notify_all();
+			for (auto &thread : threads) thread.join();
+		}
+
+		WorkerPool(const WorkerPool &) = delete;
+		WorkerPool &operator=(const WorkerPool &) = delete;
+
+		/* Shared by per frame work. Leaves the calling thread's core to the caller, which takes part in every run. */
+		static WorkerPool &Get() {
+			static WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+			return pool;
+		}
+
+		uint32_t getThreadCount() { return (uint32_t)threads.size(); }
+
+		/* Calls task(i) for every i below count, spread over the workers and the calling thread, and returns once
+			all of them are done. Each index runs exactly once, on a single thread. The first exception thrown by
+			a task is rethrown here. Runs from different threads are serialized, and tasks must not start a run. */
+		void run(uint32_t count, const std::function<void(uint32_t)> &task) {
+			std::lock_guard<std::mutex> runLock(runMutex);
+			error = nullptr;
+			remaining = count;
+
+			/* Tasks which don't fit in the queue are run here, after the queued ones are handed out */
+			uint32_t queuedCount = 0;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				while (queuedCount < count && jobs.push({ &task, queuedCount })) queuedCount++;
+				queued += queuedCount;
+			}
+			wake.notify_all();
+
+			Job job;
+			while (pop(job)) execute(job);
+			for (uint32_t i = queuedCount; i < count; ++i) execute({ &task, i });
+
+			std::unique_lock<std::mutex> lock(mutex);
+			done.wait(lock, [this]() { return remaining == 0; });
+			if (error) std::rethrow_exception(error);
+		}
+
+	private:
+		struct Job {
+			const std::function<void(uint32_t)> *task = nullptr;
+			uint32_t index = 0;
+		};
+
+		MPMCQueue<Job> jobs;
+		std::vector<std::thread> threads;
+
+		/* Guards queued, stopping and error, and pairs with the condition variables */
+		std::mutex mutex;
+		std::condition_variable wake, done;
+		uint32_t queued = 0;
+		bool stopping = false;
+		std::exception_ptr error;
+
+		std::atomic<uint32_t> remaining{ 0 };
+		std::mutex runMutex;
+
+		bool pop(Job &job) {
+			if (!jobs.pop(job)) return false;
+			std::lock_guard<std::mutex> lock(mutex);
+			queued--;
+			return true;
+		}
+
+		void execute(const Job &job) {
+			try {
+				(*job.task)(job.index);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!error) error = std::current_exception();
+			}
+			if (remaining.fetch_sub(1) == 1) {
+				std::lock_guard<std::mutex> lock(mutex);
+				done.notify_all();
+			}
+		}
+
+		void work() {
+			while (true) {
+				Job job;
+				while (pop(job)) execute(job);
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this]() { return stopping || queued > 0; });
+				if (stopping) return;
+			}
+		}
+	};
+}
@@ -8,6 +8,8 @@
 
 #include "Systems/Systems.hpp"
 #include "Systems/SceneGraph.hpp"
+#include "Systems/SceneBVH.hpp"
+#include "Systems/RaycastService.hpp"
 #include "Systems/ComponentManager.hpp"
 
 #include "Entities/Entity.hpp"
@@ -104,7 +104,9 @@ namespace PRJ2 {
 				/* Upload Perspective UBOs before render
 					(Todo: implement circular buffering to handle race conditions) */
 				for (auto pair : ComponentManager::Perspectives) {
+					pair.second->updateRecording();
 					pair.second->uploadUBO();
+					pair.second->cull();
 				}
 
 				/* Aquire a new image from the swapchain */
@@ -160,7 +162,12 @@ namespace PRJ2 {
 						auto worldToLocal = pair.second->getWorldToLocalMatrix();
 						auto localToWorld = glm::inverse(worldToLocal);
 						pair.second->transform->uploadUBO(worldToLocal, localToWorld);
+						pair.second->updateWorldBounds(localToWorld);
 					}
+					Systems::SceneBVH::Update();
+
+					/* Swap in streamed textures which finished uploading, and start the next uploads */
+					Components::Textures::TextureStreamer::Update();
 
 					/* Upload Material UBOs */
 					for (auto pair : ComponentManager::Materials) {
@@ -30,6 +30,7 @@ namespace PRJ3 {
 		auto perspective = Math::Perspective::Create("MainPerspective",
 			VKDK::renderPass, VKDK::drawCmdBuffers, VKDK::swapChainFramebuffers,
 			VKDK::swapChainExtent.width, VKDK::swapChainExtent.height);
+		perspective->gpuCulling = true;
 
 		/* Initialize Pipeline Settings */
 		auto pipelineKey = PipelineKey(VKDK::renderPass, 0, 0);
@@ -141,7 +142,9 @@ namespace PRJ3 {
 
 				/* Upload Perspective UBOs before render */
 				for (auto pair : CM::Perspectives) {
+					pair.second->updateRecording();
 					pair.second->uploadUBO();
+					pair.second->cull();
 				}
 
 				/* Aquire a new image from the swapchain */
@@ -196,7 +199,12 @@ namespace PRJ3 {
 						glm::mat4 worldToLocal = pair.second->getWorldToLocalMatrix();
 						glm::mat4 localToWorld = glm::inverse(worldToLocal);
 						pair.second->transform->uploadUBO(worldToLocal, localToWorld);
+						pair.second->updateWorldBounds(localToWorld);
 					}
+					Systems::SceneBVH::Update();
+
+					/* Swap in streamed textures which finished uploading, and start the next uploads */
+					Components::Textures::TextureStreamer::Update();
 
 					/* Upload Material UBOs */
 					for (auto pair : CM::Materials) {
@@ -227,6 +235,8 @@ namespace PRJ3 {
 
 void StartDemo3() {
 	VKDK::InitializationParameters vkdkParams = { 1024, 1024, "Project 3 - Shading", false, false, true };
+	/* The main perspective culls on the GPU against the last frame's depth */
+	vkdkParams.sampledDepth = true;
 	if (VKDK::Initialize(vkdkParams) != VK_SUCCESS) return;
 
 	PRJ3::SetupComponents();
@@ -35,7 +35,7 @@ namespace PRJ4 {
 		/* Textures are loaded using the khronos texture format (.ktx)
 			This format supports precomputed mipmapping, a couple compression formats, cubemaps, 3D textures, etc.
 			To convert from a more common format, like a .png, I recommend using PVRTexTool by Imagination Graphics. */
-		auto atticTexture = Textures::Texture2D::Create("Attic_Texture", ResourcePath "Dachboden/Dachboden_500K_u1_v1.ktx");
+		auto atticTexture = Textures::Texture2D::CreateAsync("Attic_Texture", ResourcePath "Dachboden/Dachboden_500K_u1_v1.ktx");
 
 		/* Load meshes */
 		Meshes::OBJMesh::Create("Attic", ResourcePath "Dachboden/Dachboden_500K.obj");
@@ -114,7 +114,9 @@ namespace PRJ4 {
 
 				/* Upload Perspective UBOs before render */
 				for (auto pair : CM::Perspectives) {
+					pair.second->updateRecording();
 					pair.second->uploadUBO();
+					pair.second->cull();
 				}
 
 				/* Aquire a new image from the swapchain */
@@ -169,7 +171,12 @@ namespace PRJ4 {
 						glm::mat4 worldToLocal = pair.second->getWorldToLocalMatrix();
 						glm::mat4 localToWorld = glm::inverse(worldToLocal);
 						pair.second->transform->uploadUBO(worldToLocal, localToWorld);
+						pair.second->updateWorldBounds(localToWorld);
 					}
+					Systems::SceneBVH::Update();
+
+					/* Swap in streamed textures which finished uploading, and start the next uploads */
+					Components::Textures::TextureStreamer::Update();
 
 					/* Upload Material UBOs */
 					for (auto pair : CM::Materials) {
@@ -29,12 +29,13 @@ namespace PRJ5 {
 		glm::vec3 centroid = teapot->mesh->getCentroid();
 
 		/* Creating a perspective with this constructor will render the scene onto a texture with the same name.
-			In this case, a set of four Texture2D's will be added to the component manager, each of a 512 by 512 resolution
+			In this case, a set of four Texture2D's will be added to the component manager, each of a 512 by 512 resolution.
+			They're mipmapped, since the planes showing them are usually much smaller than 512 pixels on screen.
 		*/
-		auto P1_1 = Math::Perspective::Create("P1_1", 512, 512);
-		auto P1_2 = Math::Perspective::Create("P1_2", 512, 512);
-		auto P1_3 = Math::Perspective::Create("P1_3", 512, 512);
-		auto P1_4 = Math::Perspective::Create("P1_4", 512, 512);
+		auto P1_1 = Math::Perspective::Create("P1_1", 512, 512, false, true);
+		auto P1_2 = Math::Perspective::Create("P1_2", 512, 512, false, true);
+		auto P1_3 = Math::Perspective::Create("P1_3", 512, 512, false, true);
+		auto P1_4 = Math::Perspective::Create("P1_4", 512, 512, false, true);
 
 		/* Setup perspectives for each texture */
 		glm::mat4 view = glm::lookAt(glm::vec3(0.0, -30.0, 12.0), centroid, glm::vec3(0.0, 0.0, 1.0));
@@ -189,7 +190,9 @@ namespace PRJ5 {
 
 				/* Upload Perspective UBOs before render */
 				for (auto pair : CM::Perspectives) {
+					pair.second->updateRecording();
 					pair.second->uploadUBO();
+					pair.second->cull();
 				}
 
 				/* Aquire a new image from the swapchain */
@@ -257,7 +260,12 @@ namespace PRJ5 {
 						glm::mat4 worldToLocal = pair.second->getWorldToLocalMatrix();
 						glm::mat4 localToWorld = glm::inverse(worldToLocal);
 						pair.second->transform->uploadUBO(worldToLocal, localToWorld);
+						pair.second->updateWorldBounds(localToWorld);
 					}
+					Systems::SceneBVH::Update();
+
+					/* Swap in streamed textures which finished uploading, and start the next uploads */
+					Components::Textures::TextureStreamer::Update();
 
 					/* Upload Material UBOs */
 					for (auto pair : CM::Materials) {
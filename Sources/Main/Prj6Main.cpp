@@ -119,26 +119,21 @@ namespace PRJ6 {
 	  auto teapot = Meshes::OBJMesh::Create("Teapot", ResourcePath "Teapot/teapot.obj");
 	  glm::vec3 centroid = teapot->mesh->getCentroid();
 
-	  /* Load Skybox (Example where texture compression could be used) */
-	  std::string texpath;;
-	  VkFormat compressionFormat;
-	  if (VKDK::deviceFeatures.textureCompressionASTC_LDR) {
-		texpath = ResourcePath "SkyboxTextures/Cem/cubemap_etc2_unorm.ktx";
-		compressionFormat = VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK;
-	  }
-	  else if (VKDK::deviceFeatures.textureCompressionETC2) {
-		texpath = ResourcePath "SkyboxTextures/Cem/cubemap_ASTC8X8_unorm.ktx";
-		compressionFormat = VK_FORMAT_ASTC_8x8_UNORM_BLOCK;
-	  }
-	  else if (VKDK::deviceFeatures.textureCompressionBC) {
-		texpath = ResourcePath "SkyboxTextures/Cem/cubemap_BC2_unorm.ktx";
-		compressionFormat = VK_FORMAT_BC2_UNORM_BLOCK;
+	  /* Load Skybox. Use a copy the device can sample as is, or else the ETC2 one, which gets transcoded on load. */
+	  std::pair<std::string, VkFormat> skyboxes[] = {
+		{ ResourcePath "SkyboxTextures/Cem/cubemap_BC2_unorm.ktx", VK_FORMAT_BC2_UNORM_BLOCK },
+		{ ResourcePath "SkyboxTextures/Cem/cubemap_ASTC8X8_unorm.ktx", VK_FORMAT_ASTC_8x8_UNORM_BLOCK },
+		{ ResourcePath "SkyboxTextures/Cem/cubemap_etc2_unorm.ktx", VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK } };
+	  std::string skyboxPath = skyboxes[2].first;
+	  for (auto &skybox : skyboxes) {
+		if (!Textures::TextureTranscoder::IsSupported(skybox.second)) continue;
+		skyboxPath = skybox.first;
+		break;
 	  }
-
-	  Textures::TextureCube::Create("SkyboxTexture", texpath);
+	  Textures::TextureCube::CreateAsync("SkyboxTexture", skyboxPath);
 
 	  /* Load Grass */
-	  Textures::Texture2D::Create("GrassTexture", ResourcePath "SkyboxTextures/Cem/floor.ktx");
+	  Textures::Texture2D::CreateAsync("GrassTexture", ResourcePath "SkyboxTextures/Cem/floor.ktx");
 
 	  /* Setup perspective for a reflection texture */
 	  auto P1 = Math::Perspective::Create("P1", 1024, 1024);
@@ -327,7 +322,9 @@ namespace PRJ6 {
 
 		  /* Upload Perspective UBOs before render */
 		  for (auto pair : CM::Perspectives) {
+			pair.second->updateRecording();
 			pair.second->uploadUBO();
+			pair.second->cull();
 		  }
 
 		  /* Aquire a new image from the swapchain */
@@ -382,7 +379,12 @@ namespace PRJ6 {
 			  glm::mat4 worldToLocal = pair.second->getWorldToLocalMatrix();
 			  glm::mat4 localToWorld = glm::inverse(worldToLocal);
 			  pair.second->transform->uploadUBO(worldToLocal, localToWorld);
+			  pair.second->updateWorldBounds(localToWorld);
 			}
+			Systems::SceneBVH::Update();
+
+			/* Swap in streamed textures which finished uploading, and start the next uploads */
+			Components::Textures::TextureStreamer::Update();
 
 			/* Upload Material UBOs */
 			for (auto pair : CM::Materials) {
@@ -250,7 +250,12 @@ namespace PRJ7 {
 						glm::mat4 worldToLocal = pair.second->getWorldToLocalMatrix();
 						glm::mat4 localToWorld = glm::inverse(worldToLocal);
 						pair.second->transform->uploadUBO(worldToLocal, localToWorld);
+						pair.second->updateWorldBounds(localToWorld);
 					}
+					Systems::SceneBVH::Update();
+
+					/* Swap in streamed textures which finished uploading, and start the next uploads */
+					Components::Textures::TextureStreamer::Update();
 
 					/* Upload Material UBOs */
 					for (auto pair : Systems::ComponentManager::Materials) {
@@ -259,7 +264,9 @@ namespace PRJ7 {
 
 					/* Upload Perspective UBOs before render */
 					for (auto pair : Systems::ComponentManager::Perspectives) {
+						pair.second->updateRecording();
 						pair.second->uploadUBO();
+						pair.second->cull();
 					}
 
 					/* Upload Point Light UBO */
@@ -22,6 +22,10 @@ namespace PRJ8 {
 	void SetupComponents() {
 		CM::Initialize();
 		int voxSize = 128;
+
+		/* A sparse voxel octree reaches 512 voxels a side in a fraction of the memory a dense volume would need */
+		bool sparseVoxels = Textures::SparseVoxelOctree::IsSupported();
+		if (sparseVoxels) voxSize = 512;
 		int shadowSize = 1024;
 
 		/* Load meshes and textures */
@@ -30,12 +34,16 @@ namespace PRJ8 {
 		Meshes::OBJMesh::Create("CubeFrame", ResourcePath "Defaults/CubeFrame.obj");
 
 		Textures::Texture2D::Create("CornellTexture", ResourcePath "Cornell/texture.ktx");
-		Textures::Texture3D::Create("VoxelizationTexture", voxSize, voxSize, voxSize, true);
+		/* The box's six walls alone cover about 6 * 512^2 leaf voxels, which take around 530k tiles with the levels
+			above them. A 96^3 brick pool holds 884k, leaving room for the teapot. */
+		if (sparseVoxels) Textures::SparseVoxelOctree::Create("VoxelizationTexture", 9, 96);
+		else Textures::Texture3D::Create("VoxelizationTexture", voxSize, voxSize, voxSize, true);
 
 		/* Final perspective */
 		auto P2 = Math::Perspective::Create("P2",
 			VKDK::renderPass, VKDK::drawCmdBuffers, VKDK::swapChainFramebuffers,
 			VKDK::swapChainExtent.width, VKDK::swapChainExtent.height);
+		P2->occlusionCulling = true;
 
 		/* Voxilization perspective */
 		auto P1 = Math::Perspective::Create("P1", voxSize, voxSize);
@@ -57,6 +65,7 @@ namespace PRJ8 {
 		auto P2_0_2_Params = PipelineParameters::Create(P2_0_2);
 		P1_0_0_Params->rasterizer.cullMode = VK_CULL_MODE_NONE;
 		P1_0_0_Params->depthStencil.depthTestEnable = VK_FALSE;
+		P2_0_1_Params->setTransparent(true);
 		P2_0_2_Params->rasterizer.cullMode = VK_CULL_MODE_NONE;
 		P2_0_2_Params->rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
 
@@ -166,6 +175,7 @@ namespace PRJ8 {
 		LeftBox->addComponent(CM::Materials["White"]);
 		LeftBox->addComponent(CM::Materials["WhiteVox"]);
 		LeftBox->addComponent(CM::Materials["ShadowMaterial"]);
+		LeftBox->addComponent(Components::Meshes::Occluder::Create("CubeOccluder", CM::Meshes["Cube"]));
 		LeftBox->transform->SetScale(3., 3., 6.);
 		LeftBox->transform->SetPosition(3., -3., -4.);
 		LeftBox->transform->SetRotation(3.14 / 8.0, glm::vec3(0.0, 0.0, 1.0));
@@ -176,6 +186,7 @@ namespace PRJ8 {
 		Right->addComponent(CM::Materials["White"]);
 		Right->addComponent(CM::Materials["WhiteVox"]);
 		Right->addComponent(CM::Materials["ShadowMaterial"]);
+		Right->addComponent(CM::Occluders["CubeOccluder"]);
 		Right->transform->SetScale(3., 3., 3.);
 		Right->transform->SetPosition(-4., 4., -7.);
 		Right->transform->SetRotation(-3.14 / 8.0, glm::vec3(0.0, 0.0, 1.0));
@@ -290,6 +301,12 @@ namespace PRJ8 {
 			P1->preRenderPassCallback = [](VkCommandBuffer commandBuffer) {
 				auto volume = CM::Textures["VoxelizationTexture"];
 				auto texture = volume->texture;
+				auto octree = std::dynamic_pointer_cast<Textures::SparseVoxelOctree>(texture);
+				if (octree) {
+					octree->reset(commandBuffer);
+					return;
+				}
+
 				VkClearColorValue clearColorValue = {};
 				clearColorValue.float32[0] = 0;
 				clearColorValue.float32[1] = 0;
@@ -306,6 +323,12 @@ namespace PRJ8 {
 
 			P2->preRenderPassCallback = [](VkCommandBuffer commandBuffer) {
 				auto volume = CM::Textures["VoxelizationTexture"];
+				auto octree = std::dynamic_pointer_cast<Textures::SparseVoxelOctree>(volume->texture);
+				if (octree) {
+					octree->build(commandBuffer);
+					return;
+				}
+
 				auto texture = std::dynamic_pointer_cast<Textures::Texture3D>(volume->texture);
 				texture->generateColorMipMap(commandBuffer);
 			};
@@ -323,7 +346,12 @@ namespace PRJ8 {
 						glm::mat4 worldToLocal = pair.second->getWorldToLocalMatrix();
 						glm::mat4 localToWorld = glm::inverse(worldToLocal);
 						pair.second->transform->uploadUBO(worldToLocal, localToWorld);
+						pair.second->updateWorldBounds(localToWorld);
 					}
+					Systems::SceneBVH::Update();
+
+					/* Swap in streamed textures which finished uploading, and start the next uploads */
+					Components::Textures::TextureStreamer::Update();
 
 					/* Upload Material UBOs */
 					for (auto pair : CM::Materials) {
@@ -332,9 +360,15 @@ namespace PRJ8 {
 
 					/* Upload Perspective UBOs before render */
 					for (auto pair : CM::Perspectives) {
+						pair.second->updateRecording();
 						pair.second->uploadUBO();
+						pair.second->cull();
 					}
 
+					/* Warn if the last frame's octree didn't fit */
+					auto octree = std::dynamic_pointer_cast<Textures::SparseVoxelOctree>(CM::Textures["VoxelizationTexture"]->texture);
+					if (octree) octree->checkOverflow();
+
 					/* Upload Point Light UBO */
 					Components::Lights::PointLights::UploadUBO();
 
@@ -369,7 +403,7 @@ namespace PRJ8 {
 						P2->recordRenderPass(glm::vec4(0.0, 0.0, 0.0, 0.0));
 						refreshRequired = false;
 					}
-					std::cout << "\r Framerate: " << currentTime - lastTime;
+					std::cout << "\r Framerate: " << currentTime - lastTime << " Occluded: " << P2->occludedEntities[0] << "   ";
 					lastTime = currentTime;
 				}
 			}
@@ -384,6 +418,7 @@ namespace PRJ8 {
 
 		Systems::UpdateSystem = []() {
 			auto lastTime = glfwGetTime();
+			bool picking = false;
 			while (!VKDK::ShouldClose() && !Systems::quit) {
 				auto currentTime = glfwGetTime();
 				if (currentTime - lastTime > 1.0 / Systems::UpdateRate) {
@@ -394,11 +429,29 @@ namespace PRJ8 {
 						}
 					}
 
+					/* Pick whatever is under the cursor when the middle mouse button is pressed */
+					bool pressed = glfwGetMouseButton(VKDK::DefaultWindow, GLFW_MOUSE_BUTTON_MIDDLE) == GLFW_PRESS;
+					if (pressed && !picking) {
+						double x, y;
+						glfwGetCursorPos(VKDK::DefaultWindow, &x, &y);
+						auto P2 = CM::Perspectives["P2"];
+						auto ray = Systems::RaycastService::ScreenRay(glm::vec2(x, y),
+							glm::vec2(VKDK::swapChainExtent.width, VKDK::swapChainExtent.height), P2->views[0], P2->projections[0]);
+						Systems::RaycastService::Submit(ray, [](Systems::RaycastService::Hit hit) {
+							if (hit.valid())
+								std::cout << std::endl << "Picked \"" << hit.entity->name << "\" (triangle " << hit.triangle 
+									<< ", distance " << hit.distance << ")" << std::endl;
+						});
+					}
+					picking = pressed;
+
 					lastTime = currentTime;
 				}
 			}
 		};
 
+		Systems::RaycastSystem = Systems::RaycastService::Run;
+
 		Systems::currentThreadType = Systems::SystemTypes::Event;
 	}
 
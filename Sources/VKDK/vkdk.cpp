@@ -49,6 +49,25 @@ namespace VKDK {
 		VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 	};
 
+	bool drawIndirectCountSupported = false;
+	PFN_vkCmdDrawIndexedIndirectCountAMD CmdDrawIndexedIndirectCount = nullptr;
+
+	bool descriptorUpdateTemplateSupported = false;
+	PFN_vkCreateDescriptorUpdateTemplateKHR CreateDescriptorUpdateTemplate = nullptr;
+	PFN_vkDestroyDescriptorUpdateTemplateKHR DestroyDescriptorUpdateTemplate = nullptr;
+	PFN_vkUpdateDescriptorSetWithTemplateKHR UpdateDescriptorSetWithTemplate = nullptr;
+
+	bool physicalDeviceProperties2Supported = false;
+	bool descriptorIndexingSupported = false;
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT descriptorIndexingProperties = {};
+
+	bool externalMemoryHostSupported = false;
+	PFN_vkGetMemoryHostPointerPropertiesEXT GetMemoryHostPointerProperties = nullptr;
+	VkDeviceSize minImportedHostPointerAlignment = 0;
+
+	/* VK_KHR_external_memory needs this instance extension */
+	bool externalMemoryCapabilitiesSupported = false;
+
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;	
 	VkCommandPool commandPool;
@@ -59,6 +78,11 @@ namespace VKDK {
 	VkSurfaceKHR surface;
 	std::vector<VkFramebuffer> swapChainFramebuffers;
 	uint32_t swapIndex = 0;
+
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	bool pipelineCacheWarm = false;
+	std::atomic<uint32_t> pipelinesCreated(0);
+	std::atomic<uint64_t> pipelineCreationTime(0);
 	VkSwapchainKHR swapChain;
 	VkFormat swapChainImageFormat;	
 	VkExtent2D swapChainExtent;	
@@ -66,6 +90,9 @@ namespace VKDK {
 	std::vector<VkImageView> swapChainImageViews;
 	std::atomic_bool prepared = true;	
 	SemaphoreStruct semaphores;
+	VkFence frameFences[MaxFramesInFlight] = {};
+	bool frameFencesPending[MaxFramesInFlight] = {};
+	uint64_t frameIndex = 0;
 
 	/* Image Views */
 
@@ -73,6 +100,7 @@ namespace VKDK {
 	VkImage depthImage;
 	VkDeviceMemory depthImageMemory;
 	VkImageView depthImageView;
+	VkFormat depthFormat;
 
 	VkImage textureImage;
 	VkDeviceMemory textureImageMemory;
@@ -140,6 +168,7 @@ namespace VKDK {
 
 			PickPhysicalDevice();
 			CreateLogicalDevice();
+			CreatePipelineCache();
 			CreateCommandPools();
 
 			CreateSwapChain();
@@ -189,15 +218,21 @@ namespace VKDK {
 	void Terminate() {
 		CleanupSwapChain();
 
+		WaitForFrame();
 		vkDestroySemaphore(device, semaphores.offscreenComplete, nullptr);
 		vkDestroySemaphore(device, semaphores.renderComplete, nullptr);
 		vkDestroySemaphore(device, semaphores.overlayComplete, nullptr);
 		vkDestroySemaphore(device, semaphores.presentComplete, nullptr);
+		for (uint32_t i = 0; i < MaxFramesInFlight; ++i)
+			vkDestroyFence(device, frameFences[i], nullptr);
 
 		vkDestroyCommandPool(device, commandPool, nullptr);
 
 		vkDestroyRenderPass(device, renderPass, nullptr);
 
+		SavePipelineCache();
+		vkDestroyPipelineCache(device, pipelineCache, nullptr);
+
 		vkDestroyDevice(device, nullptr);
 		DestroyDebugReportCallbackEXT(instance, callback, nullptr);
 		vkDestroySurfaceKHR(instance, surface, nullptr);
@@ -362,6 +397,18 @@ namespace VKDK {
 		std::vector<VkExtensionProperties> extensionProperties(extensionCount);
 		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensionProperties.data());
 
+		/* Optional, needed to query features and limits of newer device extensions */
+		for (auto &extension : extensionProperties) {
+			if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0) {
+				extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+				physicalDeviceProperties2Supported = true;
+			}
+			if (strcmp(extension.extensionName, VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME) == 0) {
+				extensions.push_back(VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME);
+				externalMemoryCapabilitiesSupported = true;
+			}
+		}
+
 		/* Check to see if the extensions we have are what are required by GLFW */
 		char** extensionstring = (char**)glfwExtensions;
 		for (int i = 0; i < glfwExtensionCount; ++i) {
@@ -583,8 +630,109 @@ namespace VKDK {
 
 		/* We can specify device specific extensions, like "VK_KHR_swapchain", which may not be 
 		available for particular compute only devices. */
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		std::vector<const char*> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+
+		/* Optional extensions. The KHR and AMD indirect count commands share a signature, so either can be used. */
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+		const char* drawIndirectCountExtension = nullptr;
+		const char* drawIndirectCountFunction = nullptr;
+		bool descriptorUpdateTemplateExtension = false;
+		bool descriptorIndexingExtension = false, maintenance3Extension = false;
+		bool externalMemoryExtension = false, externalMemoryHostExtension = false;
+		for (const auto& extension : availableExtensions) {
+			if (strcmp(extension.extensionName, VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME) == 0) {
+				descriptorUpdateTemplateExtension = true;
+			}
+			if (strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0) {
+				descriptorIndexingExtension = true;
+			}
+			if (strcmp(extension.extensionName, VK_KHR_MAINTENANCE3_EXTENSION_NAME) == 0) {
+				maintenance3Extension = true;
+			}
+			if (strcmp(extension.extensionName, VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME) == 0) {
+				externalMemoryExtension = true;
+			}
+			if (strcmp(extension.extensionName, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) == 0) {
+				externalMemoryHostExtension = true;
+			}
+		}
+
+		/* Bindless textures need runtime sized arrays of sampled images which can be partially bound, and updated
+			while command buffers using them are pending */
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		if (descriptorIndexingExtension && maintenance3Extension && physicalDeviceProperties2Supported) {
+			auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+			auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR");
+			if (getFeatures2 && getProperties2) {
+				VkPhysicalDeviceFeatures2KHR features2 = {};
+				features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+				features2.pNext = &indexingFeatures;
+				getFeatures2(physicalDevice, &features2);
+
+				descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+				VkPhysicalDeviceProperties2KHR properties2 = {};
+				properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+				properties2.pNext = &descriptorIndexingProperties;
+				getProperties2(physicalDevice, &properties2);
+
+				descriptorIndexingSupported = indexingFeatures.runtimeDescriptorArray
+					&& indexingFeatures.descriptorBindingPartiallyBound
+					&& indexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+					&& indexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+			}
+		}
+		if (descriptorIndexingSupported) {
+			/* Only enable what's used */
+			VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledIndexingFeatures = {};
+			enabledIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+			enabledIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+			enabledIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+			enabledIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			enabledIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+			indexingFeatures = enabledIndexingFeatures;
+			createInfo.pNext = &indexingFeatures;
+			enabledExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+			enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		}
+		for (const auto& extension : availableExtensions) {
+			if (strcmp(extension.extensionName, "VK_KHR_draw_indirect_count") == 0) {
+				drawIndirectCountExtension = "VK_KHR_draw_indirect_count";
+				drawIndirectCountFunction = "vkCmdDrawIndexedIndirectCountKHR";
+				break;
+			}
+			if (strcmp(extension.extensionName, VK_AMD_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0) {
+				drawIndirectCountExtension = VK_AMD_DRAW_INDIRECT_COUNT_EXTENSION_NAME;
+				drawIndirectCountFunction = "vkCmdDrawIndexedIndirectCountAMD";
+			}
+		}
+
+		/* Lets mapped files be imported as staging memory rather than copied into it */
+		if (externalMemoryExtension && externalMemoryHostExtension && externalMemoryCapabilitiesSupported && physicalDeviceProperties2Supported) {
+			auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR");
+			if (getProperties2) {
+				VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostProperties = {};
+				hostProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+				VkPhysicalDeviceProperties2KHR properties2 = {};
+				properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+				properties2.pNext = &hostProperties;
+				getProperties2(physicalDevice, &properties2);
+				minImportedHostPointerAlignment = hostProperties.minImportedHostPointerAlignment;
+			}
+		}
+		if (minImportedHostPointerAlignment) {
+			enabledExtensions.push_back(VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME);
+			enabledExtensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+		}
+		if (drawIndirectCountExtension) enabledExtensions.push_back(drawIndirectCountExtension);
+		if (descriptorUpdateTemplateExtension) enabledExtensions.push_back(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 
 		/* Device specific validation layers have been depreciated, but for now just recycle global
@@ -608,6 +756,28 @@ namespace VKDK {
 		*/
 		vkGetDeviceQueue(device, indices.graphicsFamily, 0, &graphicsQueue);
 		vkGetDeviceQueue(device, indices.presentFamily, 0, &presentQueue);
+
+		if (drawIndirectCountExtension) {
+			CmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountAMD)vkGetDeviceProcAddr(device, drawIndirectCountFunction);
+			drawIndirectCountSupported = CmdDrawIndexedIndirectCount != nullptr;
+			if (drawIndirectCountSupported) print("\tEnabled " + std::string(drawIndirectCountExtension));
+		}
+
+		if (descriptorUpdateTemplateExtension) {
+			CreateDescriptorUpdateTemplate = (PFN_vkCreateDescriptorUpdateTemplateKHR)vkGetDeviceProcAddr(device, "vkCreateDescriptorUpdateTemplateKHR");
+			DestroyDescriptorUpdateTemplate = (PFN_vkDestroyDescriptorUpdateTemplateKHR)vkGetDeviceProcAddr(device, "vkDestroyDescriptorUpdateTemplateKHR");
+			UpdateDescriptorSetWithTemplate = (PFN_vkUpdateDescriptorSetWithTemplateKHR)vkGetDeviceProcAddr(device, "vkUpdateDescriptorSetWithTemplateKHR");
+			descriptorUpdateTemplateSupported = CreateDescriptorUpdateTemplate && DestroyDescriptorUpdateTemplate && UpdateDescriptorSetWithTemplate;
+			if (descriptorUpdateTemplateSupported) print("\tEnabled " + std::string(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME));
+		}
+
+		if (descriptorIndexingSupported) print("\tEnabled " + std::string(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME));
+
+		if (minImportedHostPointerAlignment) {
+			GetMemoryHostPointerProperties = (PFN_vkGetMemoryHostPointerPropertiesEXT)vkGetDeviceProcAddr(device, "vkGetMemoryHostPointerPropertiesEXT");
+			externalMemoryHostSupported = GetMemoryHostPointerProperties != nullptr;
+			if (externalMemoryHostSupported) print("\tEnabled " + std::string(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME));
+		}
 	}
 
 	/* Window Surface */
@@ -938,7 +1108,8 @@ namespace VKDK {
 		depthAttachment.format = findDepthFormat();
 		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		/* Depth is only kept if the next frame builds a depth pyramid from it for occlusion culling */
+		depthAttachment.storeOp = (currentSettings.sampledDepth) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -1009,6 +1180,138 @@ namespace VKDK {
 		}
 	}
 
+	namespace {
+		/* Written before the cache data, so a cache from another device or driver is never handed to the driver */
+		struct PipelineCacheFileHeader {
+			char magic[4];
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint32_t driverVersion;
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+			uint64_t dataSize;
+		};
+
+		/* Startup is considered over once no pipeline has been created for this long */
+		const std::chrono::seconds StartupPipelineIdleTime(1);
+		std::atomic<std::chrono::steady_clock::rep> lastPipelineCreation(0);
+		bool startupPipelinesReported = false;
+
+		/* Compares runs with a cold and a warm cache */
+		void PrintPipelineCreation(std::string when) {
+			print("Created " + std::to_string(pipelinesCreated.load()) + " pipelines in "
+				+ std::to_string(pipelineCreationTime.load() / 1000.0) + " ms " + when + " with a "
+				+ (pipelineCacheWarm ? "warm" : "cold") + " pipeline cache", true);
+		}
+
+		PipelineCacheFileHeader GetPipelineCacheFileHeader(uint64_t dataSize) {
+			PipelineCacheFileHeader header = {};
+			memcpy(header.magic, "VKPC", 4);
+			header.vendorID = deviceProperties.vendorID;
+			header.deviceID = deviceProperties.deviceID;
+			header.driverVersion = deviceProperties.driverVersion;
+			memcpy(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+			header.dataSize = dataSize;
+			return header;
+		}
+	}
+
+	void CreatePipelineCache() {
+		std::vector<char> data;
+		pipelineCacheWarm = false;
+
+		/* Exactly one of these is printed once the cache exists */
+		std::string outcome = "Starting with a cold pipeline cache";
+
+		std::ifstream file(currentSettings.pipelineCachePath, std::ios::binary | std::ios::ate);
+		if (!currentSettings.pipelineCachePath.empty() && file.is_open()) {
+			uint64_t fileSize = (uint64_t)file.tellg();
+			file.seekg(0);
+			PipelineCacheFileHeader header = {}, expected = GetPipelineCacheFileHeader(0);
+			file.read((char*)&header, sizeof(header));
+			expected.dataSize = header.dataSize;
+
+			/* A truncated or corrupt file could claim any size, so it has to match what's actually there */
+			if (!file || header.dataSize != fileSize - sizeof(header)) {
+				outcome = "Discarded corrupt pipeline cache " + currentSettings.pipelineCachePath + ", starting cold";
+				file.close();
+				std::remove(currentSettings.pipelineCachePath.c_str());
+			}
+			else if (memcmp(&header, &expected, sizeof(header)) != 0) {
+				outcome = "Ignored pipeline cache from another device or driver, starting cold";
+			}
+			else {
+				data.resize((size_t)header.dataSize);
+				file.read(data.data(), data.size());
+				if (!file) {
+					data.clear();
+					outcome = "Failed to read pipeline cache " + currentSettings.pipelineCachePath + ", starting cold";
+				}
+			}
+		}
+
+		VkPipelineCacheCreateInfo cacheInfo = {};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = data.size();
+		cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+		/* The driver may still reject the data, so retry empty rather than failing */
+		if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+			cacheInfo.initialDataSize = 0;
+			cacheInfo.pInitialData = nullptr;
+			data.clear();
+			outcome = "Driver rejected pipeline cache " + currentSettings.pipelineCachePath + ", starting cold";
+			if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create pipeline cache!");
+			}
+		}
+
+		pipelineCacheWarm = !data.empty();
+		if (pipelineCacheWarm) outcome = "Loaded pipeline cache (" + std::to_string(data.size()) + " bytes)";
+		print(outcome);
+	}
+
+	void SavePipelineCache() {
+		if (pipelineCache == VK_NULL_HANDLE || currentSettings.pipelineCachePath.empty()) return;
+
+		PrintPipelineCreation("in total");
+
+		size_t dataSize = 0;
+		if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) return;
+		std::vector<char> data(dataSize);
+		if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS) return;
+
+		/* Write to a temporary file first, so an interrupted save never leaves a truncated cache behind */
+		std::string tempPath = currentSettings.pipelineCachePath + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				print("Failed to write pipeline cache to " + tempPath);
+				return;
+			}
+			auto header = GetPipelineCacheFileHeader(dataSize);
+			file.write((const char*)&header, sizeof(header));
+			file.write(data.data(), dataSize);
+			if (!file) return;
+		}
+		std::remove(currentSettings.pipelineCachePath.c_str());
+		std::rename(tempPath.c_str(), currentSettings.pipelineCachePath.c_str());
+		print("Saved pipeline cache (" + std::to_string(dataSize) + " bytes)");
+	}
+
+	void RecordPipelineCreation(uint32_t count, std::chrono::steady_clock::duration duration) {
+		pipelinesCreated += count;
+		pipelineCreationTime += (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+		lastPipelineCreation = std::chrono::steady_clock::now().time_since_epoch().count();
+	}
+
+	void ReportStartupPipelineCreation() {
+		if (startupPipelinesReported || pipelinesCreated.load() == 0) return;
+		auto last = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(lastPipelineCreation.load()));
+		if (std::chrono::steady_clock::now() - last < StartupPipelineIdleTime) return;
+		PrintPipelineCreation("during startup");
+		startupPipelinesReported = true;
+	}
+
 	void CreateCommandPools() {
 		print("Creating Default Command Pools");
 
@@ -1310,8 +1613,10 @@ namespace VKDK {
 	void CreateDepthResources() {
 		print("Creating Depth Resources");
 
-		VkFormat depthFormat = findDepthFormat();
-		CreateImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
+		depthFormat = findDepthFormat();
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		if (currentSettings.sampledDepth) usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+		CreateImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
 		depthImageView = CreateImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
 
 		/* We need to transition this depth image to a usable layout for the GPU */
@@ -1456,6 +1761,15 @@ namespace VKDK {
 
 			throw std::runtime_error("failed to create semaphores!");
 		}
+
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		for (uint32_t i = 0; i < MaxFramesInFlight; ++i) {
+			if (vkCreateFence(device, &fenceInfo, nullptr, &frameFences[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create frame fence!");
+			}
+			frameFencesPending[i] = false;
+		}
 	}
 
 	bool VKDK::OptimizeSwapchain(int swapchainResult) {
@@ -1550,10 +1864,40 @@ namespace VKDK {
 		}
 	}
 
+	void WaitForFrame() {
+		for (uint32_t i = 0; i < MaxFramesInFlight; ++i) {
+			if (!frameFencesPending[i]) continue;
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &frameFences[i], VK_TRUE, std::numeric_limits<uint64_t>::max()));
+			frameFencesPending[i] = false;
+		}
+	}
+
+	void WaitForFrameSlot() {
+		uint32_t slot = GetFrameSlot();
+		if (!frameFencesPending[slot]) return;
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &frameFences[slot], VK_TRUE, std::numeric_limits<uint64_t>::max()));
+		frameFencesPending[slot] = false;
+	}
+
+	uint32_t GetFrameSlot() {
+		return (uint32_t)(frameIndex % MaxFramesInFlight);
+	}
+
 	bool VKDK::SubmitFrame() {
 		/* TODO: add support for overlay */
 		bool submitOverlay = false; //settings.overlay && UIOverlay->visible;
 
+		/* Everything this frame rendered has been submitted to the graphics queue by now, so an empty submission
+			signals the fence of this frame's slot once it's all done. The next frame moves on to the next slot. */
+		ReportStartupPipelineCreation();
+
+		uint32_t slot = GetFrameSlot();
+		WaitForFrameSlot();
+		VK_CHECK_RESULT(vkResetFences(device, 1, &frameFences[slot]));
+		VK_CHECK_RESULT(vkQueueSubmit(graphicsQueue, 0, nullptr, frameFences[slot]));
+		frameFencesPending[slot] = true;
+		frameIndex++;
+
 		//if (submitOverlay) {
 		//	// Wait for color attachment output to finish before rendering the text overlay
 		//	VkPipelineStageFlags stageFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -21,6 +21,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <memory>
 #include <atomic>
+#include <chrono>
 #define NUM_DESCRIPTOR_SETS 10
 
 #define NOMINMAX
@@ -42,6 +43,13 @@ namespace VKDK {
 		bool verbose = false;
 		bool vsyncEnabled = false;
     uint32_t apiVersion = VK_API_VERSION_1_0;
+
+		/* File the pipeline cache is loaded from at startup and saved to at shutdown. Empty disables it. */
+		std::string pipelineCachePath = "pipeline_cache.bin";
+
+		/* Keeps the swapchain's depth after each frame and allows sampling it, which GPU culling of
+			swapchain perspectives needs to build its depth pyramid. Costs bandwidth, so it's off by default. */
+		bool sampledDepth = false;
 	};
 	
 	struct QueueFamilyIndices {
@@ -107,6 +115,40 @@ namespace VKDK {
 
 	/* A vector to the requested extensions for the logical device */
 	extern const std::vector<const char*> deviceExtensions;
+
+	/* True if either VK_KHR_draw_indirect_count or VK_AMD_draw_indirect_count was enabled on the logical device */
+	extern bool drawIndirectCountSupported;
+
+	/* Reads the number of indirect draws from a buffer. Null unless drawIndirectCountSupported is true. */
+	extern PFN_vkCmdDrawIndexedIndirectCountAMD CmdDrawIndexedIndirectCount;
+
+	/* True if VK_KHR_descriptor_update_template was enabled on the logical device */
+	extern bool descriptorUpdateTemplateSupported;
+
+	/* Writes every descriptor of a set from a packed struct in one call. Null unless descriptorUpdateTemplateSupported is true. */
+	extern PFN_vkCreateDescriptorUpdateTemplateKHR CreateDescriptorUpdateTemplate;
+	extern PFN_vkDestroyDescriptorUpdateTemplateKHR DestroyDescriptorUpdateTemplate;
+	extern PFN_vkUpdateDescriptorSetWithTemplateKHR UpdateDescriptorSetWithTemplate;
+
+	/* True if VK_KHR_get_physical_device_properties2 was enabled on the instance */
+	extern bool physicalDeviceProperties2Supported;
+
+	/* True if VK_EXT_descriptor_indexing was enabled with runtime descriptor arrays, partially bound bindings,
+		and sampled images which can be updated after binding */
+	extern bool descriptorIndexingSupported;
+
+	/* Limits for descriptors created with the update after bind flags. Only valid if descriptorIndexingSupported is true. */
+	extern VkPhysicalDeviceDescriptorIndexingPropertiesEXT descriptorIndexingProperties;
+
+	/* True if VK_EXT_external_memory_host was enabled, so host allocations like file mappings can be imported as
+		device memory */
+	extern bool externalMemoryHostSupported;
+
+	/* Reports which memory types a host pointer can be imported into. Null unless externalMemoryHostSupported is true. */
+	extern PFN_vkGetMemoryHostPointerPropertiesEXT GetMemoryHostPointerProperties;
+
+	/* Imported host pointers and sizes must be multiples of this. Only valid if externalMemoryHostSupported is true. */
+	extern VkDeviceSize minImportedHostPointerAlignment;
 	
 	/* Handle to the device graphics queue that command buffers are submitted to */
 	extern VkQueue graphicsQueue;
@@ -135,8 +177,15 @@ namespace VKDK {
 	/* Active frame buffer index */
 	extern uint32_t swapIndex;
 
-	/* Pipeline cache object (TODO: figure out how to implement this )*/
-	// VkPipelineCache pipelineCache
+	/* Pipeline cache shared by every pipeline creation. Persisted to InitializationParameters::pipelineCachePath. */
+	extern VkPipelineCache pipelineCache;
+
+	/* True if the pipeline cache was loaded from disk for this device and driver */
+	extern bool pipelineCacheWarm;
+
+	/* Total pipelines created, and the total time spent creating them in microseconds */
+	extern std::atomic<uint32_t> pipelinesCreated;
+	extern std::atomic<uint64_t> pipelineCreationTime;
 
 	/* Wraps the swap chain to present images (framebuffers) to the windowing system */
 	extern VkSwapchainKHR swapChain;
@@ -153,6 +202,12 @@ namespace VKDK {
 	/* Opaque handles to the swaptchain images */
 	extern std::vector<VkImageView> swapChainImageViews;
 
+	/* Depth attachment shared by the swapchain framebuffers. With InitializationParameters::sampledDepth, its contents
+		are kept after each frame, so they can be sampled. */
+	extern VkImage depthImage;
+	extern VkImageView depthImageView;
+	extern VkFormat depthFormat;
+
 	extern std::atomic_bool prepared;
 
 	/* Abstracts a native platform surface or window object for use with Vulkan */
@@ -172,6 +227,13 @@ namespace VKDK {
 	/* Synchronization semaphores */
 	extern SemaphoreStruct semaphores;
 
+	/* Number of frames the CPU can prepare while the GPU is still working on earlier ones. Buffers rewritten every
+		frame keep a copy per frame in flight, indexed by GetFrameSlot. */
+	const uint32_t MaxFramesInFlight = 2;
+
+	/* One fence per frame slot, signaled once the graphics work of the last frame submitted in that slot has finished */
+	extern VkFence frameFences[MaxFramesInFlight];
+
 	/* ------------------------------------------*/
 	/* FUNCTIONS                                 */
 	/* ------------------------------------------*/
@@ -231,6 +293,19 @@ namespace VKDK {
 	/* Create Depth Resources */
 	extern void CreateDepthResources();
 
+	/* Creates the pipeline cache, seeded from disk if the file matches this device and driver */
+	extern void CreatePipelineCache();
+
+	/* Writes the pipeline cache to disk. Called at shutdown, and can be called periodically. */
+	extern void SavePipelineCache();
+
+	/* Adds to the pipeline creation statistics */
+	extern void RecordPipelineCreation(uint32_t count, std::chrono::steady_clock::duration duration);
+
+	/* Prints the pipeline creation statistics once, after pipelines have stopped being created for a moment,
+		so that startup with a cold and a warm cache can be compared. Called by SubmitFrame. */
+	extern void ReportStartupPipelineCreation();
+
 	/* Create Texture Image (TODO: consider removing this) */
 	//extern void CreateTextureImage();
 
@@ -259,6 +334,17 @@ namespace VKDK {
 	extern bool PrepareFrame();
 	extern bool SubmitFrame();
 
+	/* Blocks until the GPU is done with every submitted frame. Command buffers which frames execute, and buffers
+		shared by all frames, can only be rewritten after this returns. */
+	extern void WaitForFrame();
+
+	/* Blocks until the GPU is done with the last frame submitted in the current slot, so that the slot's copies
+		of per frame buffers can be rewritten. Earlier frames in other slots may still be running. */
+	extern void WaitForFrameSlot();
+
+	/* The slot of the frame currently being prepared, between 0 and MaxFramesInFlight. Advanced by SubmitFrame. */
+	extern uint32_t GetFrameSlot();
+
 	struct SubmitToGraphicsQueueInfo {
 		std::vector<VkSemaphore> waitSemaphores;
 		VkPipelineStageFlags submitPipelineStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;